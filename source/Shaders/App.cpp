@@ -2,14 +2,31 @@
 
 #include "AppGlobals.h"
 #include "Utils.h"
+#include <memory>
 
 #define LOWCOST_STARTUP false //set to true to disable post-processing by default
 #define RES_PATH "res/"
+#define ROBOT_BOUNDS_PADDING 1.5f //the robot's bounds are from its bind pose, so give animations some room
+#define MAX_EXTRA_LIGHTS 2048 //upper end of the extra lights slider
+#define TRANSIENT_CONSTANTS_PAGE (256 * 1024) //bytes per page of per-draw constants
+#define TRANSIENT_CONSTANTS_PAGES 64
+#define TRANSIENT_VERTICES_PAGE (64 * 1024) //bytes per page of per-draw vertices
+#define TRANSIENT_VERTICES_PAGES 16
+#define POST_FORMAT DXGI_FORMAT_R32G32B32A32_FLOAT //same as DXFramework's RenderTexture
+#define BLOOM_SCALE 0.7f //bloom's bright pass and horizontal blur run at this fraction of the screen's size
+#define LOD_PIXEL_ERROR 1.f //how far a level of detail may move the surface on screen, in pixels
+#define LOD_SHADOW_PIXEL_ERROR 4.f //same in shadowmap texels; shadows get filtered anyway, so they can go coarser
 
 App::App(){
 }
 
 App::~App(){
+	//first, so that nothing it's still loading turns up halfway through the rest going away
+	AssetLoader* assets = GLOBALS.Assets;
+	GLOBALS.Assets = nullptr;
+	if (assets)
+		delete assets;
+
 	if (leftRightAnimation)
 		delete leftRightAnimation;
 	if (fallingAnimation)
@@ -27,6 +44,12 @@ App::~App(){
 		delete scene;
 	if (robot)
 		delete robot;
+	if (robotPivot)
+		delete robotPivot;
+	if (streamer)
+		delete streamer;
+	if (worldNode)
+		delete worldNode;
 	if (lights)
 		delete[] lights;
 	if (shadowMaps)
@@ -38,8 +61,6 @@ App::~App(){
 
 	if (shader)
 		delete shader;
-	if (lineShader)
-		delete lineShader;
 	if (skinnedShader)
 		delete skinnedShader;
 	if (depthShader)
@@ -58,6 +79,39 @@ App::~App(){
 		delete tessellatedSkinnedDepthShader;
 	if (particlesShader)
 		delete particlesShader;
+	if (momentsShader)
+		delete momentsShader;
+	if (skinnedMomentsShader)
+		delete skinnedMomentsShader;
+	if (shadowBlur)
+		delete shadowBlur;
+	if (shadowBlurQuad)
+		delete shadowBlurQuad;
+	if (lightGrid)
+		delete lightGrid;
+	if (debugDraw)
+		delete debugDraw;
+	if (passRecorder)
+		delete passRecorder;
+	if (frameGraph)
+		delete frameGraph;
+	if (overdrawMeter)
+		delete overdrawMeter;
+	if (occlusionCuller)
+		delete occlusionCuller;
+	if (hiZCuller)
+		delete hiZCuller;
+	if (GLOBALS.Backend) {
+		GLOBALS.Backend->releaseDepthState(prepassDepthState);
+		GLOBALS.Backend->releaseDepthState(equalDepthState);
+	}
+	if (GLOBALS.TargetPool)//after the lights and the graph, which hand their targets back to it
+		delete GLOBALS.TargetPool;
+	GLOBALS.TargetPool = nullptr;
+	if (GLOBALS.TransientConstants)
+		delete GLOBALS.TransientConstants;
+	if (GLOBALS.TransientVertices)
+		delete GLOBALS.TransientVertices;
 
 	if (colourGrading)
 		delete colourGrading;
@@ -68,6 +122,10 @@ App::~App(){
 	if (combine)
 		delete combine;
 
+	//everything that went through the backend is gone by now
+	if (GLOBALS.Backend)
+		delete GLOBALS.Backend;
+
 	//release fbx sdk objects (we've been keeping some around for animation purposes)
 	FBXScene::Release();
 }
@@ -86,66 +144,49 @@ void App::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeight
 	GLOBALS.ScreenWidth = screenWidth;
 	GLOBALS.ScreenHeight = screenHeight;
 	GLOBALS.Hwnd = hwnd;
+	GLOBALS.Backend = new D3D11RenderDevice(GLOBALS.Device, GLOBALS.DeviceContext);
+	GLOBALS.TransientConstants = new TransientBuffer(GLOBALS.Backend, BUFFER_CONSTANT, TRANSIENT_CONSTANTS_PAGE, TRANSIENT_CONSTANTS_PAGES);
+	GLOBALS.TransientVertices = new TransientBuffer(GLOBALS.Backend, BUFFER_VERTEX, TRANSIENT_VERTICES_PAGE, TRANSIENT_VERTICES_PAGES);
+	GLOBALS.Backend->setTransientBuffers(GLOBALS.TransientConstants, GLOBALS.TransientVertices);
+	GLOBALS.TargetPool = new RenderTargetPool(GLOBALS.Device);
+	passRecorder = new PassRecorder(GLOBALS.Backend, TRANSIENT_CONSTANTS_PAGE, TRANSIENT_VERTICES_PAGE, TRANSIENT_VERTICES_PAGES);
+	passRecorder->setWorkers(recordWorkers);
 
-	//load textures
-	textureMgr->loadTexture("lut", (WCHAR*)L"" RES_PATH "LUTs/Lut_blue.png");
-	textureMgr->loadTexture("glow", (WCHAR*)L"" RES_PATH "glow.png");
-	textureMgr->loadTexture("normalmap", (WCHAR*)L"" RES_PATH "Robot_01_Normal.png");
-	textureMgr->loadTexture("displacementmap", (WCHAR*)L"" RES_PATH "Robot_01_Displacement.png");
+	//everything from here on loads in the background, behind a loading screen (see frame())
+	GLOBALS.Assets = new AssetLoader(GLOBALS.Backend, (int)std::thread::hardware_concurrency() - 1);
 
 	//initialize materials
 	material = new Material;
 	material->specularPower = 100.0f;
 
-	//initialize shaders
-	shader = new DefaultShader;
-	lineShader = new LineShader;
-	depthShader = new DepthShader;
-	skinnedShader = new SkinnedShader;
-	skinnedDepthShader = new SkinDepthShader;
-	tessellationShader = new TessellationShader;
-	tessellationDepthShader = new TessellationDepthShader;
-	tessellatedSkinnedShader = new TessellatedSkinnedShader;
-	tessellatedSkinnedDepthShader = new TessellationSkinDepthShader;
-	particlesShader = new ParticlesShader;
-	particlesShader->texture = textureMgr->getTexture("glow");
-	particlesShader->size = 0.4f;
-	textureShader = new PPTextureShader;
-	colourGrading = new ColourGradingShader;
-	colourGrading->fogColour = XMFLOAT3(9.f/255.f, 72.f/255.f, 72.f/255.f);//cool dark-ish blue (light blue looks awesome but then its broken by bloom so whatever)
-	colourGrading->setLut(textureMgr->getTexture("lut"));
-	colourGrading->setTonemapping(1);
-	colourGrading->setExposure(1.687f);
-	colourGrading->setBrightness(-0.072f);
-	colourGrading->setContrast(0.434f);
-	colourGrading->setHue(0);
-	colourGrading->setSaturation(0.855f);
-	colourGrading->setValue(1);
-	colourGrading->vignette = 0.3f;
-	bloom = new BloomShader;
-	bloom->horizontal = true;
-	bloom->distance = 200;
-	bloom->threshold = 0.6f;
-	bloom->intensity = 1.0f;
-	gaussian = new GaussianBlurShader;
-	gaussian->horizontal = false;
-	gaussian->distance = 200;
-	combine = new CombinationShader;
-	colourGradingPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth, GLOBALS.ScreenHeight, colourGrading);
-	bloomPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth * 0.7f, GLOBALS.ScreenHeight * 0.7f, bloom);
-	vGaussianPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth * 0.7f, GLOBALS.ScreenHeight * 0.7f, gaussian);
-	depthPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth, GLOBALS.ScreenHeight, textureShader);
-	combinationPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth, GLOBALS.ScreenHeight, combine);
+	//shaders get their bytecode read on a worker, then get created here along with whatever needs them
+	++pendingLoads;
+	GLOBALS.Assets->load("shaders", []() {
+		WIN32_FIND_DATAA found;
+		HANDLE search = FindFirstFileA(SHADER_PATH "*.cso", &found);
+		if (search == INVALID_HANDLE_VALUE) return;
+		do GLOBALS.Assets->cacheFile(std::string(SHADER_PATH) + found.cFileName);
+		while (FindNextFileA(search, &found));
+		FindClose(search);
+	}, [this]() {
+		initShaders();
+		--pendingLoads;
+	});
+	shadowBlurQuad = new OrthoMesh(GLOBALS.Device, GLOBALS.DeviceContext, GLOBALS.ScreenWidth, GLOBALS.ScreenHeight);
+	frameGraph = new RenderGraph(GLOBALS.TargetPool);
+	overdrawMeter = new OverdrawMeter(GLOBALS.Backend);
+	prepassDepthState = GLOBALS.Backend->createDepthState(COMPARE_LESS, true);
+	equalDepthState = GLOBALS.Backend->createDepthState(COMPARE_EQUAL, false);
 #if LOWCOST_STARTUP
 	disablePostProcessing = true;//bloom & pp is expensive, so i don't necessarily want it by default (especially on my own laptop hehe)
 #endif
 
-	//initialize meshes
+	//initialize meshes; both scenes get imported on workers side by side, and uploaded here once they're done
 	FBXScene::Init();
 	FBXImportArgs fbxArgs;
-	scene = new FBXScene(renderer->getDevice(), renderer->getDeviceContext(), RES_PATH "scene/scene.fbx", fbxArgs);
+	loadScene(RES_PATH "scene/scene.fbx", fbxArgs, &scene);
 	fbxArgs.invertZScale = false;//we need to keep z consistent with skeleton space for skinned meshes (instead we flip z in shader)
-	robot = new FBXScene(renderer->getDevice(), renderer->getDeviceContext(), RES_PATH "Robo_01.fbx", fbxArgs);
+	loadScene(RES_PATH "Robo_01.fbx", fbxArgs, &robot);
 	particles = new ParticlesMesh(1024, -72, 1, 27, 29, -14, 42);
 
 	//extract animations
@@ -159,11 +200,11 @@ void App::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeight
 	stealthLeftRightAnimation = ANIM(152.f, 201.f);
 #undef FRAME
 #undef ANIM
-	if(robot) robot->getAnimator()->transitionTo(walkAnimation, 0);
 
 	//initialize lighting
 	numLights = 6;
 	lights = new ExtendedLight[numLights];
+	shadowQueues.resize(numLights);
 	lights[0].setAmbientColour(42.f/255.f, 89.f/255.f, 109.f/255.f, 1);
 
 	// Street lamp 1 (opposite car)
@@ -216,32 +257,189 @@ void App::init(HINSTANCE hinstance, HWND hwnd, int screenWidth, int screenHeight
 	lights[5].setType(DIRECTIONAL_LIGHT);
 	lights[5].setupShadows();
 
-	shadowMaps = new ID3D11ShaderResourceView*[numLights];
+	shadowMaps = new GpuView*[numLights];
+	lightGrid = new LightGrid;
+	spawnExtraLights(numExtraLights);
 
 	//place camera
 	camera->setPosition(-20, 4, 0);
 	camera->setRotation(0, 90, 0);
 	updateFov();
+}
+
+///Seconds since the process was created, so that startup times cover everything before init() too
+static float secondsSinceLaunch() {
+	FILETIME creation, exit, kernel, user, now;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	GetSystemTimeAsFileTime(&now);
+	ULARGE_INTEGER from, to;
+	from.LowPart = creation.dwLowDateTime;
+	from.HighPart = creation.dwHighDateTime;
+	to.LowPart = now.dwLowDateTime;
+	to.HighPart = now.dwHighDateTime;
+	return (to.QuadPart - from.QuadPart) / 10000000.f;//filetimes are in 100ns
+}
+
+void App::loadScene(const std::string& filename, FBXImportArgs args, FBXScene** out_scene) {
+	//held by both halves of the job, so that a scene that never gets uploaded still gets deleted
+	auto loaded = std::make_shared<std::unique_ptr<FBXScene>>();
+	++pendingLoads;
+	GLOBALS.Assets->load(filename, [loaded, filename, args]() mutable {
+		loaded->reset(new FBXScene(filename, args));
+	}, [this, loaded, out_scene]() {
+		(*loaded)->upload(GLOBALS.Backend);
+		*out_scene = loaded->release();
+		--pendingLoads;
+	});
+}
+
+void App::initShaders() {
+	shader = new DefaultShader;
+	depthShader = new DepthShader;
+	skinnedShader = new SkinnedShader;
+	skinnedDepthShader = new SkinDepthShader;
+	tessellationShader = new TessellationShader;
+	tessellationDepthShader = new TessellationDepthShader;
+	tessellatedSkinnedShader = new TessellatedSkinnedShader;
+	tessellatedSkinnedDepthShader = new TessellationSkinDepthShader;
+	particlesShader = new ParticlesShader;
+	momentsShader = new MomentsShader;
+	skinnedMomentsShader = new SkinMomentsShader;
+	shadowBlur = new GaussianBlurShader;
+	shadowBlur->distance = 4;
+	debugDraw = new DebugDraw;
+	GLOBALS.Assets->requestTexture(RES_PATH "glow.png", &particlesShader->texture, TEXTURE_PLACEHOLDER_BLACK);
+	particlesShader->size = 0.4f;
+	textureShader = new PPTextureShader;
+	colourGrading = new ColourGradingShader;
+	colourGrading->fogColour = XMFLOAT3(9.f/255.f, 72.f/255.f, 72.f/255.f);//cool dark-ish blue (light blue looks awesome but then its broken by bloom so whatever)
+	GLOBALS.Assets->requestTexture(RES_PATH "LUTs/Lut_blue.png", [this](GpuView* lut) { colourGrading->setLut(lut); });
+	colourGrading->setTonemapping(1);
+	colourGrading->setExposure(1.687f);
+	colourGrading->setBrightness(-0.072f);
+	colourGrading->setContrast(0.434f);
+	colourGrading->setHue(0);
+	colourGrading->setSaturation(0.855f);
+	colourGrading->setValue(1);
+	colourGrading->vignette = 0.3f;
+	bloom = new BloomShader;
+	bloom->horizontal = true;
+	bloom->distance = 200;
+	bloom->threshold = 0.6f;
+	bloom->intensity = 1.0f;
+	gaussian = new GaussianBlurShader;
+	gaussian->horizontal = false;
+	gaussian->distance = 200;
+	combine = new CombinationShader;
+	colourGradingPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, colourGrading);
+	bloomPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, bloom);
+	vGaussianPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, gaussian);
+	depthPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, textureShader);
+	combinationPass.Setup(GLOBALS.Device, GLOBALS.DeviceContext, combine);
+	hiZCuller = new HiZCuller();
+}
+
+void App::finishLoading() {
+	loaded = true;
+	GLOBALS.Assets->dropFiles();//bytecode for shaders nothing created
+
+	//the robot walks in circles around a pivot in the street (see frame())
+	worldNode = new SceneNode;
+	worldNode->addChild(scene->getRoot());
+	robotPivot = new SceneNode;
+	robotPivot->setPosition(XMFLOAT3(-10, 0, -2.5f));
+	worldNode->addChild(robotPivot);
+	if (robot) {
+		robotPivot->addChild(robot->getRoot());
+		robot->getRoot()->setPosition(XMFLOAT3(-3, 0, 0));
+	}
+	//the street again, cooked into cells for the city to be streamed from; its first block is where the street is
+	std::string cellIndex = scene->cookCells();
+	if (!cellIndex.empty()) {
+		streamer = new WorldStreamer(cellIndex);
+		worldNode->addChild(streamer->getRoot());
+	}
+	worldNode->update();
+	occlusionCuller = new OcclusionCuller(3);
+	scene->addOccluders(occlusionCuller);
+	scene->addIndirectDraws(hiZCuller);
+
+	if(robot) robot->getAnimator()->transitionTo(walkAnimation, 0);
 
 	//normal and displacement mapping to spice up the robot
 	if(robot){
-		robot->getMesh(0)->setNormalMap(textureMgr->getTexture("normalmap"));
-		robot->getMesh(0)->setDisplacementMap(textureMgr->getTexture("displacementmap"));
+		robot->getMesh(0)->setNormalMap(RES_PATH "Robot_01_Normal.png");
+		robot->getMesh(0)->setDisplacementMap(RES_PATH "Robot_01_Displacement.png");
 		//i want extra shininess on that robot boy
 		robot->getMesh(0)->setMaterialSpecular(5, 5, 5);
 	}
 }
 
+bool App::loadingFrame() {
+	renderer->setBackBufferRenderTarget();
+	renderer->beginScene(9.f / 255.f, 72.f / 255.f, 72.f / 255.f, 1);//the fog's colour, which is most of what the street fades into
+
+	//always shown, whether the ui is or not
+	int done = GLOBALS.Assets->getDone(), total = GLOBALS.Assets->getTotal();
+	ImGui::SetNextWindowPos(ImVec2(GLOBALS.ScreenWidth * 0.5f, GLOBALS.ScreenHeight * 0.5f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+	ImGui::SetNextWindowSize(ImVec2(300, 80));
+	ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse);
+	ImGui::Text("Loading... %d of %d", done, total);
+	ImGui::ProgressBar(total ? (float)done / total : 0);
+	ImGui::Text("%s", GLOBALS.Assets->getCurrent().c_str());
+	ImGui::End();
+	ImGui::Render();
+	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+
+	renderer->endScene();
+
+	if (!loadingScreenTime) {
+		loadingScreenTime = secondsSinceLaunch();
+		printf("Loading screen up %.2fs after launch.\n", loadingScreenTime);
+	}
+	return true;
+}
+
 ///Change fov of projection matrix
 void App::updateFov() {
 	projectionMatrix = Utils::changeFov(renderer->getProjectionMatrix(), fov, (float)GLOBALS.ScreenWidth / GLOBALS.ScreenHeight);
 }
 
+///Small coloured lights scattered along the street, at about head height and above
+void App::spawnExtraLights(int count) {
+	static const XMFLOAT3 neonColours[] = { XMFLOAT3(1, 0.1f, 0.6f), XMFLOAT3(0.1f, 0.9f, 1), XMFLOAT3(0.6f, 0.2f, 1), XMFLOAT3(1, 0.5f, 0.1f), XMFLOAT3(0.3f, 1, 0.3f), XMFLOAT3(1, 0.9f, 0.7f) };
+	extraLights.clear();
+	for (int i = 0; i < count; ++i) {
+		XMFLOAT3 position(Utils::random(-72, 1), Utils::random(0.5f, 12), Utils::random(-14, 42));//same area the rain falls on
+		XMFLOAT3 colour = neonColours[rand() % (sizeof(neonColours) / sizeof(XMFLOAT3))];
+		extraLights.push_back(LightGrid::pointLight(position, colour, Utils::random(3, 8)));
+	}
+}
+
 bool App::frame(){
 	//update base app
 	if (!BaseApplication::frame())
 		return false;
 
+	//whatever the asset loader has ready gets uploaded, a few milliseconds' worth every frame; until the scene and its shaders are in, that's all there is to a frame
+	GLOBALS.Assets->pump();
+	if (!loaded) {
+		if (pendingLoads > 0)
+			return loadingFrame();
+		finishLoading();
+	}
+
+	//a new shadowmap resolution goes to one light per frame, so the pool never holds every light's old and new maps at once
+	if (pendingShadowmapRes > 0) {
+		int i = 0;
+		while (i < numLights && (int)lights[i].getShadowmapRes() == pendingShadowmapRes) ++i;
+		if (i < numLights) {
+			lights[i].setShadowmapRes(pendingShadowmapRes);
+			shadowScheduler.invalidate(i);
+		}
+		else pendingShadowmapRes = 0;
+	}
+
 	//main logic; update animated robot + particles
 	if (robot)
 		robot->update(timer->getTime() * timeScale);
@@ -264,10 +462,21 @@ bool App::frame(){
 	}
 	//robot walks around
 	robotYaw -= timer->getTime();
+	XMFLOAT4 robotRotation;
+	XMStoreFloat4(&robotRotation, XMQuaternionRotationRollPitchYaw(0, robotYaw, 0));
+	robotPivot->setRotation(robotRotation);
+	transformsUpdated = worldNode->update();//only the pivot and what hangs off it
+	if (streamer && streamWorld)
+		streamer->update(camera->getPosition(), timer->getTime(), GLOBALS.Backend);
 
 	//render to screen
 	if (!render())
 		return false;
+
+	if (!firstFrameTime) {
+		firstFrameTime = secondsSinceLaunch();
+		printf("First frame %.2fs after launch, %.2fs after the loading screen.\n", firstFrameTime, firstFrameTime - loadingScreenTime);
+	}
 	return true;
 }
 
@@ -283,22 +492,38 @@ void App::handleInput(float dt) {
 }
 
 ///Render geometry with any custom shaders
-void App::geometry(LitShader* shader, SkinnedShader* skinnedShader, ParticlesShader* particlesShader, XMMATRIX& worldMatrix, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix, XMFLOAT3 cameraPosition, bool sendShadowmaps, D3D_PRIMITIVE_TOPOLOGY top) {
-	//Scene
-	shader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, cameraPosition);
-	shader->setLightParameters(renderer->getDeviceContext(), cameraPosition, &lights, shadowMaps, sendShadowmaps, lighting? numLights : 0);
-	if (scene != nullptr && renderScene) scene->render(shader, nullptr, false, top);
-
-	//Animated robot
-	//Robot walks around (see world matrix)
-	skinnedShader->setShaderParameters(renderer->getDeviceContext(), XMMatrixTranslation(-3, 0, 0) * XMMatrixRotationY(robotYaw) * XMMatrixTranslation(-10, 0, -2.5f), viewMatrix, projectionMatrix, cameraPosition);
-	//  Note: since shaders are packed the same way with the same registers, no need to re-send that same data here! :)
-	//skinnedShader->setLightParameters(renderer->getDeviceContext(), cameraPosition, &lights, shadowMaps, sendShadowmaps, lighting? numLights : 0);
-	if (robot != nullptr && renderRobot) robot->render(skinnedShader, lineShader, renderSkeleton, top);//use skinned shader to render robot
+void App::geometry(RenderDevice* device, RenderQueue& queue, LitShader* shader, SkinnedShader* skinnedShader, ParticlesShader* particlesShader, XMMATRIX& worldMatrix, XMMATRIX& viewMatrix, XMMATRIX& projectionMatrix, XMFLOAT3 cameraPosition, bool sendShadowmaps, int top, float farPlane, unsigned int measurePixels, OcclusionCuller* culler, HiZCuller* hiZ) {
+	//Lights are shared by both shaders: since they're packed the same way with the same registers, no need to send them twice! :)
+	shader->setLightParameters(device, cameraPosition, &lights, shadowMaps, sendShadowmaps, lighting? numLights : 0, farPlane);
+
+	//Scene and animated robot go through the queue, which sorts them by state and skips redundant binds
+	queue.begin(viewMatrix, projectionMatrix, cameraPosition, culler);
+	if (streamer && streamWorld && renderScene) streamer->submit(&queue, shader, top, culler);
+	else if (scene != nullptr && renderScene) scene->submit(&queue, shader, top, culler, hiZ);
+	//Robot walks around (see its pivot)
+	if (robot != nullptr && renderRobot) robot->submit(&queue, skinnedShader, top);//use skinned shader to render robot
+	if (measurePixels == 0) queue.flush(device);
+	else {
+		//whichever pass fills the depth buffer first tells how many fragments per pixel the lit shader runs (or would run, without a pre-pass)
+		overdrawMeter->begin();
+		if (usePrepass) {
+			//depth first, so the lit pass below only shades the front-most fragment of each pixel
+			device->setDepthState(prepassDepthState);
+			queue.flush(device, true);
+			overdrawMeter->end(measurePixels);
+			device->setDepthState(equalDepthState);
+			queue.flush(device);
+			renderer->setZBuffer(true);//DXFramework's own state again, for particles and debug lines
+		}
+		else {
+			queue.flush(device);
+			overdrawMeter->end(measurePixels);
+		}
+	}
 
 	//Particles
 	if (particles && particlesShader) {
-		particlesShader->setShaderParameters(renderer->getDeviceContext(), worldMatrix, viewMatrix, projectionMatrix, cameraPosition);
+		particlesShader->setShaderParameters(device, worldMatrix, viewMatrix, projectionMatrix, cameraPosition);
 		particlesShader->sendParticlesData();
 		particles->sendData(GLOBALS.DeviceContext, D3D_PRIMITIVE_TOPOLOGY_POINTLIST);
 		particlesShader->render(GLOBALS.DeviceContext, particles->getIndexCount());
@@ -306,118 +531,284 @@ void App::geometry(LitShader* shader, SkinnedShader* skinnedShader, ParticlesSha
 	
 }
 
-bool App::render(){
-	XMMATRIX worldMatrix;
-	
-	//update camera position and get matrices
-	camera->update();
-	worldMatrix = renderer->getWorldMatrix();
-	GLOBALS.ViewMatrix = camera->getViewMatrix();
-
-
-// ** shadow mapping passes ** //
-
-	for (int i = 0; i < numLights; ++i) {
-		if (lights[i].StartRecordingShadowmap()) {
+///Gathers caster and receiver bounds for shadow frustum fitting
+void App::gatherShadowBounds() {
+	shadowCasters.clear();
+	shadowReceivers.clear();
+
+	//the robot is the only thing that moves; remember where it was last frame so that its old shadow gets cleaned up too
+	dynamicCasters = robotBounds;
+	robotBounds.clear();
+	if (robot && renderRobot)
+		robot->getBounds(robotBounds, ROBOT_BOUNDS_PADDING);
+	dynamicCasters.insert(dynamicCasters.end(), robotBounds.begin(), robotBounds.end());
+	//so do cells that were just streamed in or out
+	if (streamer)
+		streamer->takeChangedBounds(dynamicCasters);
+
+	//everything we render casts shadows (apart from particles)
+	if (streamer && streamWorld && renderScene)
+		streamer->getBounds(shadowCasters);
+	else if (scene && renderScene)
+		scene->getBounds(shadowCasters);
+	shadowCasters.insert(shadowCasters.end(), robotBounds.begin(), robotBounds.end());
+
+	//past the far plane everything is lost in fog, so no need to get shadows there
+	bool fog = !wireframeToggle && !disablePostProcessing && colourGradingPass.enabled;
+	BoundingFrustum cameraFrustum(projectionMatrix);
+	if (fog) cameraFrustum.Far = GLOBALS.FarPlane;
+	cameraFrustum.Transform(cameraFrustum, XMMatrixInverse(nullptr, GLOBALS.ViewMatrix));
+	XMFLOAT3 corners[BoundingFrustum::CORNER_COUNT];
+	cameraFrustum.GetCorners(corners);
+	BoundingBox visible;
+	BoundingBox::CreateFromPoints(visible, BoundingFrustum::CORNER_COUNT, corners, sizeof(XMFLOAT3));
+
+	//receivers are the visible parts of casters (roughly - we clip them to the box around the camera frustum)
+	for (const BoundingBox& caster : shadowCasters) {
+		BoundingBox receiver;
+		if (cameraFrustum.Intersects(caster) && Utils::intersect(caster, visible, receiver))
+			shadowReceivers.push_back(receiver);
+	}
+}
 
-			//Render geometry from the point of view of this light
-			XMMATRIX lightViewMatrix = lights[i].getView();
-			XMMATRIX lightProjectionMatrix = lights[i].getProjection();
+///Skeleton, bounds, light volumes and clusters, whichever are switched on; they only get drawn on debugDraw's next flush
+void App::gatherDebugDraw() {
+	if (robot != nullptr && renderRobot && renderSkeleton) robot->renderSkeleton(debugDraw);
 
-			geometry(depthShader, skinnedDepthShader, nullptr /*particles dont need to cast shadows*/, worldMatrix, lightViewMatrix, lightProjectionMatrix, lights[i].getPosition(), false);
+	if (showBounds) {
+		for (const BoundingBox& caster : shadowCasters)
+			debugDraw->box(caster, XMFLOAT4(1, 1, 0, 1));
+		for (const BoundingBox& receiver : shadowReceivers)
+			debugDraw->box(receiver, XMFLOAT4(0, 1, 1, 1));
+	}
 
+	if (showLightVolumes) {
+		//what each shadowmap covers
+		for (int i = 0; i < numLights; ++i) {
+			if (lights[i].getType() != INACTIVE_LIGHT && !lights[i].shouldBypassShadows())
+				debugDraw->frustum(lights[i].getShadowmapView() * lights[i].getShadowmapProjection(), XMFLOAT4(1, 0.5f, 0, 1));
+		}
+		//how far each light reaches (directional lights reach everywhere)
+		for (const ClusteredLight& light : lightGrid->getLights()) {
+			if (light.type != DIRECTIONAL_LIGHT)
+				debugDraw->sphere(light.position, light.range, XMFLOAT4(light.colour.x, light.colour.y, light.colour.z, 1));
 		}
-		//keep track of the shadowmap (might be null)
-		shadowMaps[i] = lights[i].StopRecordingShadowmap();
 	}
 
+	if (showClusters) debugDraw->clusters(lightGrid->getBuilder(), GLOBALS.ViewMatrix, projectionMatrix);
+}
 
-// ** depth pass ** //
-
-	if (!wireframeToggle && !disablePostProcessing) {//no need to grab depths if we're not going to render fog
-		depthPass.Begin(renderer, GLOBALS.DeviceContext, XMFLOAT3(0, 0, 0));
+///Declares this frame's passes after the shadowmaps, following whichever effects are switched on; the graph works out which ones are needed and which targets can share textures
+void App::buildFrameGraph() {
+	RenderGraph& graph = *frameGraph;
+	graph.reset();
+	int width = GLOBALS.ScreenWidth, height = GLOBALS.ScreenHeight;
+	int bloomWidth = (int)(width * BLOOM_SCALE), bloomHeight = (int)(height * BLOOM_SCALE);
+	bool post = !wireframeToggle && !disablePostProcessing;//in wireframe mode, we don't want any post processing at all
+	bool useGrading = post && colourGradingPass.enabled;
+	bool useBloom = post && bloomPass.enabled;
+	int pass;
+
+	//shadowmaps outlive the frame, since lights don't all update theirs every frame
+	std::vector<int> shadowmaps(numLights, -1);
+	for (int i = 0; i < numLights; ++i)
+		if (lights[i].getShadowTarget()) shadowmaps[i] = graph.import("shadowmap", lights[i].getShadowTarget());
+
+	//variance shadowmaps get blurred once here rather than on every lookup; lights with the same resolution all blur through the same scratch texture
+	for (int i : shadowPasses) {
+		if (lights[i].getShadowFilter() != SHADOWMAP_VSM) continue;
+		int res = (int)lights[i].getShadowmapRes();
+		int scratch = graph.create("shadow blur", res, res, DXGI_FORMAT_R32G32_FLOAT);
+		int shadowmap = shadowmaps[i];
+		pass = graph.addPass("shadow filter", [this, i, scratch](RenderGraph& g) {
+			lights[i].filterShadowmap(shadowBlur, shadowBlurQuad, camera->getOrthoViewMatrix(), g.getTarget(scratch));
+		});
+		graph.write(pass, scratch);
+		graph.read(pass, shadowmap);
+		graph.write(pass, shadowmap);
+	}
 
-		//Render geometry to depth
-		if (tessellate) {
-			geometry(tessellationDepthShader, tessellatedSkinnedDepthShader, particlesShader/*depth!*/, worldMatrix, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), false, D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-		}
-		else {
-			geometry(depthShader, skinnedDepthShader, particlesShader/*depth!*/, worldMatrix, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), false);
+	//radial depths for the depth view; culled unless it's switched on, since fog reads the scene's own depth buffer
+	int depth = graph.create("depth", width, height, POST_FORMAT, true);
+	pass = graph.addPass("depth", [this, depth](RenderGraph& g) {
+		g.setRenderTarget(depth, true, XMFLOAT4(0, 0, 0, 1));
+		XMMATRIX world = renderer->getWorldMatrix();
+		if (tessellate)
+			geometry(GLOBALS.Backend, renderQueue, tessellationDepthShader, tessellatedSkinnedDepthShader, particlesShader/*depth!*/, world, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), false, TOPOLOGY_PATCHLIST_3, 0, 0, occlusionCulling ? occlusionCuller : nullptr, hiZCulling ? hiZCuller : nullptr);
+		else
+			geometry(GLOBALS.Backend, renderQueue, depthShader, skinnedDepthShader, particlesShader/*depth!*/, world, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), false, TOPOLOGY_TRIANGLELIST, 0, 0, occlusionCulling ? occlusionCuller : nullptr, hiZCulling ? hiZCuller : nullptr);
+	});
+	graph.write(pass, depth);
+
+	//the scene goes wherever the first enabled effect reads from; the graded image is what bloom reads from
+	int graded = useBloom ? graph.create("graded", bloomWidth, bloomHeight, POST_FORMAT, !useGrading) : GRAPH_BACK_BUFFER;
+	int colour = useGrading ? graph.create("scene", width, height, POST_FORMAT, true) : graded;
+	pass = graph.addPass("scene", [this, colour](RenderGraph& g) {
+		//sort lights into clusters for the main camera
+		if (lighting)
+			lightGrid->update(GLOBALS.Backend, lights, numLights, extraLights, GLOBALS.ViewMatrix, projectionMatrix, SCREEN_DEPTH);
+		else
+			lightGrid->update(GLOBALS.Backend, lights, 0, std::vector<ClusteredLight>(), GLOBALS.ViewMatrix, projectionMatrix, SCREEN_DEPTH);
+		lightGrid->bind(GLOBALS.Backend);
+
+		g.setRenderTarget(colour, true, colour == GRAPH_BACK_BUFFER ? XMFLOAT4(1, 1, 1, 1) : XMFLOAT4(0.2f, 0.2f, 0.3f, 1));
+
+		// Geometry
+		XMMATRIX world = renderer->getWorldMatrix();
+		RenderTarget* target = g.getTarget(colour);
+		unsigned int pixels = target ? target->getWidth() * target->getHeight() : GLOBALS.ScreenWidth * GLOBALS.ScreenHeight;
+		if (tessellate)
+			geometry(GLOBALS.Backend, renderQueue, tessellationShader, tessellatedSkinnedShader, particlesShader, world, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), true, TOPOLOGY_PATCHLIST_3, 0, pixels, occlusionCulling ? occlusionCuller : nullptr, hiZCulling ? hiZCuller : nullptr);
+		else
+			geometry(GLOBALS.Backend, renderQueue, shader, skinnedShader, particlesShader, world, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), true, TOPOLOGY_TRIANGLELIST, 0, pixels, occlusionCulling ? occlusionCuller : nullptr, hiZCulling ? hiZCuller : nullptr);
+
+		//this frame's depth, for next frame's hi-z culling; without a depth buffer to read, next frame only gets frustum culled
+		if (hiZCulling && g.getDepthTexture(colour)) {
+			hiZCuller->build(GLOBALS.Backend, g.getDepthTexture(colour), GLOBALS.ViewMatrix * projectionMatrix);
+			g.setRenderTarget(colour);//building unbinds it
 		}
 
-		depthPass.End(renderer);
+		// Debug views, all in one draw
+		gatherDebugDraw();
+		debugDraw->flush(GLOBALS.Backend, GLOBALS.ViewMatrix, projectionMatrix);
+	});
+	for (int shadowmap : shadowmaps)
+		if (shadowmap >= 0) graph.read(pass, shadowmap);
+	graph.write(pass, colour);
+
+	//Apply tonemapping
+	if (useGrading) {
+		pass = graph.addPass("colour grading", [this, colour, graded](RenderGraph& g) {
+			g.setRenderTarget(graded, true, XMFLOAT4(1, 1, 1, 1));//unbinds the scene's depth buffer, so fog can read it
+			colourGrading->setColourGrading(renderer, renderer->getDeviceContext(), camera->getOrthoViewMatrix(), g.getDepthTexture(colour), projectionMatrix);
+			g.setRenderTarget(graded);//re-baking the LUT leaves the back buffer bound
+			colourGradingPass.Render(camera->getOrthoViewMatrix(), g.getTexture(colour));
+		});
+		graph.read(pass, colour);
+		graph.write(pass, graded);
 	}
 
+	if (useBloom) {
+		//Blur horizontally and only keep brightest pixels
+		int bright = graph.create("bloom bright", bloomWidth, bloomHeight, POST_FORMAT);
+		pass = graph.addPass("bloom bright", [this, graded, bright](RenderGraph& g) {
+			g.setRenderTarget(bright, true, XMFLOAT4(1, 1, 1, 1));
+			bloom->setBlur();
+			bloom->setBloom();
+			bloomPass.Render(camera->getOrthoViewMatrix(), g.getTexture(graded));
+		});
+		graph.read(pass, graded);
+		graph.write(pass, bright);
+
+		//Blur vertically...
+		int blurred = graph.create("bloom blurred", width, height, POST_FORMAT);
+		pass = graph.addPass("bloom blur", [this, bright, blurred](RenderGraph& g) {
+			g.setRenderTarget(blurred, true, XMFLOAT4(1, 1, 1, 1));
+			gaussian->setBlur();
+			vGaussianPass.Render(camera->getOrthoViewMatrix(), g.getTexture(bright));
+		});
+		graph.read(pass, bright);
+		graph.write(pass, blurred);
+
+		//And combine results of bloom and what we had before starting bloom (ie colour grading or nothing)
+		pass = graph.addPass("bloom combine", [this, graded, blurred](RenderGraph& g) {
+			g.setRenderTarget(GRAPH_BACK_BUFFER);
+			combine->setTexture1(g.getTexture(graded));
+			combinationPass.Render(camera->getOrthoViewMatrix(), g.getTexture(blurred));
+		});
+		graph.read(pass, graded);
+		graph.read(pass, blurred);
+		graph.write(pass, GRAPH_BACK_BUFFER);
+	}
 
-// ** render geometry ** //
-
-	//clear scene
-	if (!wireframeToggle && !disablePostProcessing) {
-		if(colourGradingPass.enabled)
-			colourGradingPass.Begin(renderer, renderer->getDeviceContext(), XMFLOAT3(0.2f, 0.2f, 0.3f));
-		else if(bloomPass.enabled)
-			bloomPass.Begin(renderer, renderer->getDeviceContext(), XMFLOAT3(0.2f, 0.2f, 0.3f));
-		else renderer->beginScene(1, 1, 1, 1);
+	//Show depth if we need to
+	if (post && showDepth) {
+		pass = graph.addPass("show depth", [this, depth](RenderGraph& g) {
+			g.setRenderTarget(GRAPH_BACK_BUFFER);
+			depthPass.Render(camera->getOrthoViewMatrix(), g.getTexture(depth));
+		});
+		graph.read(pass, depth);
+		graph.write(pass, GRAPH_BACK_BUFFER);
+	}
+}
 
-	} else //in wireframe mode, we don't want any post processing at all.
-		renderer->beginScene(1, 1, 1, 1);
+bool App::render(){
+	//update camera position and get matrices
+	camera->update();
+	GLOBALS.ViewMatrix = camera->getViewMatrix();
+	renderQueue.resetStats();
+	for (RenderQueue& queue : shadowQueues)
+		queue.resetStats();
+	ConstantBlockStats::reset();
 
-	// Geometry
-	if (tessellate) {
-		geometry(tessellationShader, tessellatedSkinnedShader, particlesShader, worldMatrix, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), true, D3D_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
-	}
-	else {
-		geometry(shader, skinnedShader, particlesShader, worldMatrix, GLOBALS.ViewMatrix, projectionMatrix, camera->getPosition(), true);
-	}
+	//levels of detail for each pass's resolution
+	renderQueue.setLevelOfDetail(levelsOfDetail ? (float)GLOBALS.ScreenHeight : 0, LOD_PIXEL_ERROR);
+	for (int i = 0; i < numLights; ++i)
+		shadowQueues[i].setLevelOfDetail(levelsOfDetail ? lights[i].getShadowmapRes() : 0, LOD_SHADOW_PIXEL_ERROR);
 
+	//the pre-pass follows the last few frames' overdraw
+	overdrawMeter->update();
+	usePrepass = prepassMode == PREPASS_ON || (prepassMode == PREPASS_AUTO && overdrawMeter->prepassPaysOff(usePrepass));
 
-// ** post processing ** //
+	//occluders from the main camera, for its passes to test the scene's meshes against
+	if (occlusionCulling)
+		occlusionCuller->render(GLOBALS.ViewMatrix, projectionMatrix);
+	//and the gpu's turn, against last frame's depth; the main camera's passes draw the scene with whatever arguments this leaves
+	if (hiZCulling)
+		hiZCuller->cull(GLOBALS.Backend, GLOBALS.ViewMatrix * projectionMatrix);
 
-	//only do post processing and stuff if not in wireframe mode
-	if (!wireframeToggle && !disablePostProcessing) {
 
-		//end whichever is enabled (or none)
-		colourGradingPass.End();
-		bloomPass.End();
+// ** shadow mapping passes ** //
 
-		// Finish up colour grading if it's enabled
-		if(colourGradingPass.enabled){
+	gatherShadowBounds();
+	shadowPasses.clear();
+	shadowScheduler.schedule(lights, numLights, camera->getPosition(), GLOBALS.ViewMatrix, fitShadows, dynamicCasters);
 
-			//Apply tonemapping
-			bloomPass.Begin();
-			colourGrading->setColourGrading(renderer, renderer->getDeviceContext(), camera->getOrthoViewMatrix(), depthPass.getRenderTexture()->getShaderResourceView());
-			colourGradingPass.Render(camera->getOrthoViewMatrix());
-			bloomPass.End();
+	for (int i = 0; i < numLights; ++i) {
+		//lights that aren't due an update this frame keep their last map
+		if (staggerShadows && !shadowScheduler.shouldUpdate(i)) {
+			shadowMaps[i] = lights[i].getShadowmap();
+			continue;
+		}
+		//fit the light's frustum to the scene; if it doesn't light anything we can see, don't bother rendering its shadowmap,
+		//and drop the last one too, which was fitted to whatever it lit back then
+		if (fitShadows && !lights[i].shouldBypassShadows() && !lights[i].fitShadowFrustum(shadowCasters, shadowReceivers)) {
+			lights[i].clearShadowmap();
+			shadowMaps[i] = nullptr;
+			continue;
+		}
+		if (!lights[i].PrepareShadowmap()) {
+			shadowMaps[i] = nullptr;
+			continue;
 		}
 
-		//Finish up with bloom if it's enabled
-		if (bloomPass.enabled) {
+		//Render geometry from the point of view of this light; recorded by whichever worker picks it up, so only reads from App
+		shadowPasses.push_back(i);
+		passRecorder->add([this, i](RenderDevice* device) {
+			XMMATRIX world = renderer->getWorldMatrix();
+			XMMATRIX lightViewMatrix = lights[i].getShadowmapView();
+			XMMATRIX lightProjectionMatrix = lights[i].getShadowmapProjection();
+			lights[i].StartRecordingShadowmap(device);
+
+			if (lights[i].getShadowFilter() == SHADOWMAP_VSM)
+				geometry(device, shadowQueues[i], momentsShader, skinnedMomentsShader, nullptr /*particles dont need to cast shadows*/, world, lightViewMatrix, lightProjectionMatrix, lights[i].getPosition(), false, TOPOLOGY_TRIANGLELIST, lights[i].getShadowmapFar());
+			else
+				geometry(device, shadowQueues[i], depthShader, skinnedDepthShader, nullptr /*particles dont need to cast shadows*/, world, lightViewMatrix, lightProjectionMatrix, lights[i].getPosition(), false, TOPOLOGY_TRIANGLELIST, lights[i].getShadowmapFar());
+		});
+	}
 
-			//Blur horizontally and only keep brightest pixels
-			vGaussianPass.Begin();
-			bloom->setBlur();
-			bloom->setBloom();
-			bloomPass.Render(camera->getOrthoViewMatrix());
-			vGaussianPass.End();
+	//record every shadow pass at once, then play them back in order
+	passRecorder->run();
+	for (int i : shadowPasses)
+		shadowMaps[i] = lights[i].StopRecordingShadowmap();//keep track of the shadowmap
 
-			//Blur vertically...
-			combinationPass.Begin();
-			gaussian->setBlur();
-			vGaussianPass.Render(camera->getOrthoViewMatrix());
-			combinationPass.End();
 
-			//And combine results of bloom and what we had before starting bloom (ie colour grading or nothing)
-			combine->setTexture1(bloomPass.getRenderTexture()->getShaderResourceView());
-			combinationPass.Render(camera->getOrthoViewMatrix());
-		}
+// ** shadow filtering, depth pass, geometry and post processing ** //
 
-		//Show depth if we need to
-		if (showDepth) {
-			depthPass.Render(camera->getOrthoViewMatrix());
-		}
+	buildFrameGraph();
+	frameGraph->compile();
+	frameGraph->execute();
 
-	}//!wireframe
-	
 
 // ** UI ** //
 
@@ -427,22 +818,24 @@ bool App::render(){
 	//Show shadowmaps
 	if (showShadowmaps) {
 		for (int i = 0; i < numLights; ++i) {
-			ID3D11ShaderResourceView* map = lights[i].getShadowmap();
+			GpuView* map = lights[i].getShadowmap();
 			if (map != nullptr) {
 				#define MAP_SIZE 200.0f
-				OrthoMesh ortho(GLOBALS.Device, GLOBALS.DeviceContext, MAP_SIZE, MAP_SIZE, -GLOBALS.ScreenWidth/2+MAP_SIZE/2+i*MAP_SIZE, -GLOBALS.ScreenHeight/2+MAP_SIZE/2);
-				ortho.sendData(GLOBALS.DeviceContext);
-				textureShader->setShaderParameters(GLOBALS.DeviceContext, worldMatrix, camera->getOrthoViewMatrix(), renderer->getOrthoMatrix(), XMFLOAT3(0,0,0));
-				textureShader->setTextureData(GLOBALS.DeviceContext, map);
-				textureShader->render(GLOBALS.DeviceContext, ortho.getIndexCount());
+				debugDraw->quad(i * MAP_SIZE, GLOBALS.ScreenHeight - MAP_SIZE, MAP_SIZE, MAP_SIZE, map);
 				#undef MAP_SIZE
 			}
 		}
 	}
+	debugDraw->flushOverlay(GLOBALS.Backend, camera->getOrthoViewMatrix(), renderer->getOrthoMatrix());
 
 	//Show ui
 	gui();
 
+	//fence off this frame's per-draw data
+	GLOBALS.TransientConstants->endFrame(GLOBALS.Backend);
+	GLOBALS.TransientVertices->endFrame(GLOBALS.Backend);
+	GLOBALS.TargetPool->endFrame();
+
 	//swap buffers
 	renderer->endScene();
 
@@ -458,6 +851,9 @@ void App::gui()
 
 	// Display FPS
 	ImGui::Text("FPS: %.2f", timer->getFPS());
+	ImGui::Text("Startup: loading screen at %.2fs, first frame at %.2fs", loadingScreenTime, firstFrameTime);
+	if (!GLOBALS.Assets->isIdle())
+		ImGui::Text("Textures: %d of %d loaded, %.2fms uploading", GLOBALS.Assets->getTexturesLoaded(), GLOBALS.Assets->getTextureCount(), GLOBALS.Assets->getUploadTime());
 
 	// Enabling/disabling stuff
 	if (ImGui::CollapsingHeader("Scene parameters")) {
@@ -490,14 +886,38 @@ void App::gui()
 	if (ImGui::CollapsingHeader("Lighting")) {
 		ImGui::Checkbox("Apply lighting", &lighting);
 		ImGui::Checkbox("Normal mapping", &GLOBALS.normalMapping);
+		if (ImGui::SliderInt("Extra lights", &numExtraLights, 0, MAX_EXTRA_LIGHTS))
+			spawnExtraLights(numExtraLights);
+		LightClusterBuilder& clusters = lightGrid->getBuilder();
+		ImGui::Text("%d lights in %dx%dx%d clusters, built in %.3fms", lightGrid->getLightCount(), clusters.getTilesX(), clusters.getTilesY(), clusters.getSlices(), clusters.getBuildTime());
+		ImGui::Text("Lights per cluster: %.2f on average, %u at most", clusters.getAverageLightsPerCluster(), clusters.getMaxLightsPerCluster());
 		ImGui::Text("Shadowmap resolution:");
-		if (ImGui::Button("256")) for (int i = 0; i < numLights; ++i) lights[i].setShadowmapRes(256);
-		if (ImGui::Button("512")) for (int i = 0; i < numLights; ++i) lights[i].setShadowmapRes(512);
-		if (ImGui::Button("1028")) for (int i = 0; i < numLights; ++i) lights[i].setShadowmapRes(1028);
-		if (ImGui::Button("2048")) for (int i = 0; i < numLights; ++i) lights[i].setShadowmapRes(2048);
-		if (ImGui::Button("4096")) for (int i = 0; i < numLights; ++i) lights[i].setShadowmapRes(4096);
+		if (ImGui::Button("256")) pendingShadowmapRes = 256;
+		if (ImGui::Button("512")) pendingShadowmapRes = 512;
+		if (ImGui::Button("1028")) pendingShadowmapRes = 1028;
+		if (ImGui::Button("2048")) pendingShadowmapRes = 2048;
+		if (ImGui::Button("4096")) pendingShadowmapRes = 4096;
 		ImGui::SliderFloat("Shadowmap bias", &GLOBALS.ShadowmapBias, 0, 0.01f);
+		if (ImGui::Button("PCF shadows")) for (int i = 0; i < numLights; ++i) { lights[i].setShadowFilter(SHADOWMAP_PCF); shadowScheduler.invalidate(i); }
+		if (ImGui::Button("Variance shadows")) for (int i = 0; i < numLights; ++i) { lights[i].setShadowFilter(SHADOWMAP_VSM); shadowScheduler.invalidate(i); }
+		ImGui::SliderFloat("Variance shadows blur", &shadowBlur->distance, 1, 16);
 		ImGui::Checkbox("Show shadowmaps", &showShadowmaps);
+		if (ImGui::Checkbox("Fit shadow frustums", &fitShadows) && !fitShadows)
+			for (int i = 0; i < numLights; ++i) {
+				lights[i].resetShadowFrustum();
+				shadowScheduler.invalidate(i);
+			}
+		ImGui::Checkbox("Stagger shadowmap updates", &staggerShadows);
+		if (staggerShadows) {
+			ImGui::SliderInt("Shadowmaps per frame", &shadowScheduler.maxLightsPerFrame, 1, numLights);
+			float megaTexels = shadowScheduler.maxTexelsPerFrame / (1024.f * 1024.f);
+			if (ImGui::SliderFloat("Shadow texels per frame (M)", &megaTexels, 0.25f, 64))
+				shadowScheduler.maxTexelsPerFrame = megaTexels * 1024.f * 1024.f;
+			ImGui::Text("Updated %d shadowmaps, %.2fM texels", shadowScheduler.getUpdatedLights(), shadowScheduler.getUpdatedTexels() / (1024.f * 1024.f));
+		}
+		if (ImGui::SliderInt("Shadow recording threads", &recordWorkers, 0, PASS_RECORDER_MAX_WORKERS))
+			passRecorder->setWorkers(recordWorkers);
+		ImGui::Text("%d shadow passes: %.3fms recording, %.3fms executing", passRecorder->getLastPassCount(), passRecorder->getRecordTime(), passRecorder->getExecuteTime());
 		ImGui::Checkbox("Show out of range shadowmaps", &GLOBALS.ShadowmapSeeErrors);
 		//Control for each light:
 		float amb[3] = { lights[0].getAmbientColour().x, lights[0].getAmbientColour().y, lights[0].getAmbientColour().z };
@@ -534,6 +954,16 @@ void App::gui()
 				float fv = lights[i].getProjectionFov();
 				if (ImGui::SliderFloat(std::string("Shadowmap projection fov (" + std::to_string(i) + ")").c_str(), &fv, 1, 180))
 					lights[i].updateFov(fv);
+				//Shadow filtering
+				bool vsm = lights[i].getShadowFilter() == SHADOWMAP_VSM;
+				if (ImGui::Checkbox(std::string("Variance shadowmap (" + std::to_string(i) + ")").c_str(), &vsm)) {
+					lights[i].setShadowFilter(vsm ? SHADOWMAP_VSM : SHADOWMAP_PCF);
+					shadowScheduler.invalidate(i);
+				}
+				if (fitShadows)
+					ImGui::Text("Fitted: fov %.1f, near %.2f, far %.2f", lights[i].getFittedFov(), lights[i].getShadowNear(), lights[i].getShadowFar());
+				if (staggerShadows)
+					ImGui::Text("Shadowmap waiting for %d frames (priority %.2f)", shadowScheduler.getAge(i), shadowScheduler.getPriority(i));
 			}
 		}
 	}
@@ -556,6 +986,85 @@ void App::gui()
 		bloom->distance = blurDist;
 	}
 
+	// World streaming
+	if (streamer && ImGui::CollapsingHeader("World streaming")) {
+		ImGui::Checkbox("Stream the city", &streamWorld);
+		ImGui::SliderFloat("Streaming radius", &streamer->radius, 10, 300);
+		ImGui::SliderInt("Streaming budget (MB)", &streamer->budget, 8, 1024);
+		ImGui::Text("Cells: %d resident, %d loading, of %d", streamer->getResidentCount(), streamer->getPendingCount(), streamer->getCellCount());
+		ImGui::Text("Resident: %.1fMB of %dMB", streamer->getResidentBytes() / (1024.f * 1024.f), streamer->budget);
+		ImGui::Text("Bandwidth: %.2fMB/s read, %.2fMB/s uploaded", streamer->getReadRate() / (1024.f * 1024.f), streamer->getUploadRate() / (1024.f * 1024.f));
+	}
+
+	// Render queue stats, summed over every pass this frame
+	if (ImGui::CollapsingHeader("Render queue")) {
+		RenderQueueStats stats = renderQueue.getStats();
+		for (RenderQueue& queue : shadowQueues)
+			stats += queue.getStats();
+		ImGui::Combo("Depth pre-pass", &prepassMode, "Off\0On\0Auto\0");
+		ImGui::Text("Overdraw: %.2f fragments per pixel, %s", overdrawMeter->getOverdraw(), usePrepass ? "drawing a pre-pass" : "no pre-pass");
+		ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+		if (occlusionCulling)
+			ImGui::Text("Occlusion: %u occluder triangles in %.2fms; of %u meshes tested, %u off screen, %u hidden", occlusionCuller->getRasterizedTriangles(), occlusionCuller->getRenderTime(), occlusionCuller->getTested(), occlusionCuller->getOffscreen(), occlusionCuller->getOccluded());
+		ImGui::Checkbox("Hi-Z culling", &hiZCulling);
+		if (hiZCulling) {
+			ImGui::Text("Hi-Z: %u static meshes culled on the gpu", hiZCuller->getDrawCount());
+			if (ImGui::Button("Validate hi-z against the cpu"))
+				hiZCuller->validateNextFrame();
+			if (!hiZCuller->getValidation().empty())
+				ImGui::Text("%s", hiZCuller->getValidation().c_str());
+		}
+		if (ImGui::Checkbox("Meshlet culling", &meshletCulling)) {
+			renderQueue.setMeshletCulling(meshletCulling);
+			for (RenderQueue& queue : shadowQueues)
+				queue.setMeshletCulling(meshletCulling);
+		}
+		if (meshletCulling)
+			ImGui::Text("Meshlets: %u tested, %u off screen, %u back facing", stats.meshlets, stats.meshletsOffscreen, stats.meshletsBackfacing);
+		ImGui::Checkbox("Levels of detail", &levelsOfDetail);
+		if (levelsOfDetail)
+			ImGui::Text("Draws per level: %u, %u, %u, %u", stats.lodDraws[0], stats.lodDraws[1], stats.lodDraws[2], stats.lodDraws[3]);
+		ImGui::Text("%u draws, %u of them indirect", stats.draws, stats.indirectDraws);
+		ImGui::Text("Instances: %u drawn, %u culled", stats.instances, stats.instancesCulled);
+		ImGui::Text("Transforms: %u updated", transformsUpdated);
+		ImGui::Text("Batched meshes: %u drawn, %u culled", stats.parts, stats.partsCulled);
+		ImGui::Text("Shader stages: %u set, %u skipped", stats.shaderStages, stats.shaderStagesSkipped);
+		ImGui::Text("Input assembler: %u set, %u skipped", stats.inputBinds, stats.inputBindsSkipped);
+		ImGui::Text("Constant buffers: %u written, %u skipped", stats.bufferUpdates, stats.bufferUpdatesSkipped);
+		ImGui::Text("Textures: %u bound, %u skipped", stats.textureBinds, stats.textureBindsSkipped);
+		ImGui::Text("Light/camera blocks: %u bytes in %u uploads, %u bytes in %u unchanged", ConstantBlockStats::uploadedBytes.load(), ConstantBlockStats::uploads.load(), ConstantBlockStats::skippedBytes.load(), ConstantBlockStats::skips.load());
+		RingAllocator& constants = GLOBALS.TransientConstants->getAllocator();
+		ImGui::Text("Per-draw constants: %u bytes (+%u padding) in %u pages of %uKB, %u frames in flight", constants.getBytesAllocated(), constants.getBytesWasted(), constants.getPageCount(), constants.getPageSize() / 1024, GLOBALS.TransientConstants->getPendingFrames());
+		if (!GLOBALS.TransientConstants->usesRing())
+			ImGui::Text("(constant buffer offsets unsupported, using one buffer per shader)");
+		else if (GLOBALS.TransientConstants->getFallbacks() > 0)
+			ImGui::Text("%u constant writes didn't fit and fell back to per shader buffers", GLOBALS.TransientConstants->getFallbacks());
+	}
+
+	// Render graph: what ran this frame, and how many textures its targets needed
+	if (ImGui::CollapsingHeader("Render graph")) {
+		for (int i = 0; i < frameGraph->getPassCount(); ++i)
+			ImGui::Text("%s%s", frameGraph->getPassName(i), frameGraph->isKept(i) ? "" : " (culled)");
+		ImGui::Text("%d transient targets in %d textures", frameGraph->getTransientCount(), frameGraph->getTextureCount());
+		ImGui::Text("%.1fMB, %.1fMB without aliasing", frameGraph->getTextureBytes() / (1024.f * 1024.f), frameGraph->getTransientBytes() / (1024.f * 1024.f));
+	}
+
+	// Render target pool
+	if (ImGui::CollapsingHeader("Render targets")) {
+		RenderTargetPool* pool = GLOBALS.TargetPool;
+		ImGui::Text("%d of %d targets in use", pool->getTargetsInUse(), pool->getTargetCount());
+		ImGui::Text("%.1fMB in use, %.1fMB waiting to be reused", pool->getBytesInUse() / (1024.f * 1024.f), pool->getIdleBytes() / (1024.f * 1024.f));
+		ImGui::Text("%u targets created since startup", pool->getAllocations());
+	}
+
+	// Debug views
+	if (ImGui::CollapsingHeader("Debug draw")) {
+		ImGui::Checkbox("Shadow casters/receivers", &showBounds);
+		ImGui::Checkbox("Light volumes", &showLightVolumes);
+		ImGui::Checkbox("Light clusters", &showClusters);
+		ImGui::Text("%u lines, %u draws", debugDraw->getLastLineCount(), debugDraw->getLastDrawCount());
+	}
+
 	// Particles params
 	if (ImGui::CollapsingHeader("Particles")) {
 		ImGui::SliderFloat("Size", &particlesShader->size, 0, 5);
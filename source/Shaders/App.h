@@ -7,11 +7,12 @@
 #include "Material.h"
 #include "PostProcessingPass.h"
 #include "ColourGradingShader.h"
-#include "LineShader.h"
-#include "Line.h"
+#include "DebugDraw.h"
 #include "SkinnedShader.h"
 #include "DepthShader.h"
 #include "SkinDepthShader.h"
+#include "MomentsShader.h"
+#include "SkinMomentsShader.h"
 #include "GaussianBlurShader.h"
 #include "BloomShader.h"
 #include "CombinationShader.h"
@@ -22,6 +23,21 @@
 #include "TessellationDepthShader.h"
 #include "ParticlesMesh.h"
 #include "ParticlesShader.h"
+#include "ShadowScheduler.h"
+#include "LightGrid.h"
+#include "D3D11RenderDevice.h"
+#include "PassRecorder.h"
+#include "RenderGraph.h"
+#include "OverdrawMeter.h"
+#include "OcclusionCuller.h"
+#include "HiZCuller.h"
+#include "WorldStreamer.h"
+#include "AssetLoader.h"
+
+//depth pre-pass modes
+#define PREPASS_OFF 0
+#define PREPASS_ON 1
+#define PREPASS_AUTO 2 //whenever the measured overdraw says it pays off
 
 class App : public BaseApplication {
 
@@ -36,15 +52,37 @@ public:
 
 protected:
 	bool render() override;
-	void geometry(LitShader* shader, SkinnedShader* skinnedShader, ParticlesShader* particlesShader, XMMATRIX& world, XMMATRIX& view, XMMATRIX& projection, XMFLOAT3 cameraPosition, bool sendShadowmaps, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	///draws the scene and robot through queue onto device, which can be a recorder as long as there are no particles to draw (those still need the immediate context)
+	///the main camera's pass passes its target's pixel count as measurePixels, to have its overdraw measured and get a depth pre-pass when usePrepass is set
+	///passes seen from the main camera can pass a culler rendered from it, to leave out scene meshes hidden behind others, and the hi-z culler, to draw them with the arguments it culled this frame
+	void geometry(RenderDevice* device, RenderQueue& queue, LitShader* shader, SkinnedShader* skinnedShader, ParticlesShader* particlesShader, XMMATRIX& world, XMMATRIX& view, XMMATRIX& projection, XMFLOAT3 cameraPosition, bool sendShadowmaps, int top = TOPOLOGY_TRIANGLELIST, float farPlane = 0, unsigned int measurePixels = 0, OcclusionCuller* culler = nullptr, HiZCuller* hiZ = nullptr);
 	void gui();
 
+	///collects world space bounds of everything that casts shadows, of the parts of it the camera can currently see, and of what moved since last frame
+	void gatherShadowBounds();
+
 	void updateFov();
 
+	///adds whichever debug views are enabled to debugDraw
+	void gatherDebugDraw();
+	///declares everything after the shadow passes to frameGraph
+	void buildFrameGraph();
+
+	///scatters count small unshadowed lights (street lights, neon signs) around the scene
+	void spawnExtraLights(int count);
+
+	///queues an fbx to be imported on a worker, and uploaded into out_scene; counts towards pendingLoads
+	void loadScene(const std::string& filename, FBXImportArgs args, FBXScene** out_scene);
+	///creates every shader, and what needs them; once the loader has read their bytecode
+	void initShaders();
+	///puts the scene together once the shaders, the scene and the robot are in
+	void finishLoading();
+	///a frame of the loading screen, drawn instead of the scene until then
+	bool loadingFrame();
+
 private:
 	///Shaders for geometry
 	LitShader* shader = nullptr;
-	LineShader* lineShader = nullptr;
 	DepthShader* depthShader = nullptr;
 	SkinnedShader* skinnedShader = nullptr;
 	SkinDepthShader* skinnedDepthShader = nullptr;
@@ -52,13 +90,32 @@ private:
 	TessellationDepthShader* tessellationDepthShader = nullptr;
 	TessellatedSkinnedShader* tessellatedSkinnedShader = nullptr;
 	TessellationSkinDepthShader* tessellatedSkinnedDepthShader = nullptr;//these names are getting ridiculous
+	MomentsShader* momentsShader = nullptr;
+	SkinMomentsShader* skinnedMomentsShader = nullptr;
 	ParticlesShader* particlesShader = nullptr;//better ^-^
 
 	///Lighting
 	ExtendedLight* lights = nullptr;
-	ID3D11ShaderResourceView** shadowMaps = nullptr;
+	GpuView** shadowMaps = nullptr;
 	int numLights;
 	bool showShadowmaps = false;//Debug: show shadow maps
+	bool fitShadows = true;//tighten each light's shadow frustum around visible geometry every frame
+	std::vector<BoundingBox> shadowCasters;
+	std::vector<BoundingBox> shadowReceivers;
+	std::vector<BoundingBox> robotBounds;
+	std::vector<BoundingBox> dynamicCasters;//moving casters, both this frame and last frame
+	ShadowScheduler shadowScheduler;
+	bool staggerShadows = true;//only re-render a few shadowmaps per frame
+	int pendingShadowmapRes = 0;//resolution the lights are being switched to, one per frame; 0 once they all have it
+	GaussianBlurShader* shadowBlur = nullptr;//prefilters variance shadowmaps
+	OrthoMesh* shadowBlurQuad = nullptr;
+	std::vector<int> shadowPasses;//lights whose shadowmap gets rendered this frame
+	std::vector<RenderQueue> shadowQueues;//one per light, since their passes get recorded at the same time
+	PassRecorder* passRecorder = nullptr;//records shadow passes on worker threads
+	int recordWorkers = 3;//threads recording them, main thread included; 0 sends them straight to the immediate context
+	LightGrid* lightGrid = nullptr;//clusters every light so fragments only go through the ones that reach them
+	std::vector<ClusteredLight> extraLights;//lights without shadows, on top of the ones above
+	int numExtraLights = 0;
 
 	///Meshes, materials, textures
 	Material* material = nullptr;
@@ -70,30 +127,51 @@ private:
 	bool tessellate = true;
 	bool lighting = true;
 	bool showDepth = false;//when true, overlays the depth map on top of everything
+	RenderQueue renderQueue;//scene and robot draws go through this
+	int prepassMode = PREPASS_AUTO;
+	bool usePrepass = false;//this frame
+	OverdrawMeter* overdrawMeter = nullptr;
+	GpuDepthState* prepassDepthState = nullptr;//less, with writes
+	GpuDepthState* equalDepthState = nullptr;//equal, without writes: the lit pass after a pre-pass
+	OcclusionCuller* occlusionCuller = nullptr;//the scene's biggest meshes, rasterized on the cpu from the main camera every frame
+	bool occlusionCulling = true;
+	HiZCuller* hiZCuller = nullptr;//the scene's meshes again, on the gpu, against the main pass's depth from last frame
+	bool hiZCulling = true;
+	bool meshletCulling = true;//every queue's, shadows included
+	bool levelsOfDetail = true;
+	WorldStreamer* streamer = nullptr;//the street's cells tiled into a city, streamed in around the camera; null if the scene couldn't be cooked
+	bool streamWorld = false;//draws the streamed city instead of the scene
+
+	///Debug views
+	DebugDraw* debugDraw = nullptr;
+	bool showBounds = false;//shadow casters and receivers
+	bool showLightVolumes = false;//shadow frustums and light ranges
+	bool showClusters = false;//light clusters with at least one light in them
 
 	///Post processing shaders and passes
-	PPTextureShader* textureShader;
+	PPTextureShader* textureShader = nullptr;
 	PostProcessingPass depthPass;
-	ColourGradingShader* colourGrading;
+	ColourGradingShader* colourGrading = nullptr;
 	PostProcessingPass colourGradingPass;
-	BloomShader* bloom;
-	GaussianBlurShader* gaussian;
+	BloomShader* bloom = nullptr;
+	GaussianBlurShader* gaussian = nullptr;
 	PostProcessingPass bloomPass;
 	PostProcessingPass vGaussianPass;
-	CombinationShader* combine;
+	CombinationShader* combine = nullptr;
 	PostProcessingPass combinationPass;
+	RenderGraph* frameGraph = nullptr;//rebuilt every frame: shadow filtering, depth, scene and post processing
 	bool showLut = false;//when true, displays the tonemapped LUT used by the colour grading effect
 	bool disablePostProcessing = false;
 	float fov = 60.0f;
 	XMMATRIX projectionMatrix;
 
 	///Animations for the robot
-	Animation* leftRightAnimation;
-	Animation* fallingAnimation;
-	Animation* walkAnimation;
-	Animation* runningAnimation;
-	Animation* stealthAnimation;
-	Animation* stealthLeftRightAnimation;
+	Animation* leftRightAnimation = nullptr;
+	Animation* fallingAnimation = nullptr;
+	Animation* walkAnimation = nullptr;
+	Animation* runningAnimation = nullptr;
+	Animation* stealthAnimation = nullptr;
+	Animation* stealthLeftRightAnimation = nullptr;
 	bool renderSkeleton = false;//when true, displays the joints next to their skinned meshes
 	float timeScale = 1;
 
@@ -101,9 +179,19 @@ private:
 	float lightBlink = 0;//makes street lamp blink somewhat randomly
 	bool lightBlinkState = true;//false->off, true->on
 	float robotYaw = 0;//makes robot turn slowly
+	///the scene and the robot's pivot hang off worldNode, and the robot off its pivot
+	SceneNode* worldNode = nullptr;
+	SceneNode* robotPivot = nullptr;
+	unsigned int transformsUpdated = 0;//by the last update of worldNode
 	float cameraSpeed = 5;
 
 	///Whether to show ui
 	bool showUi = false;
 
+	///Loading
+	int pendingLoads = 0;//jobs init() queued that the first frame can't go without; textures aren't part of them, and show up as placeholders until they're in
+	bool loaded = false;//once finishLoading() has run
+	float loadingScreenTime = 0;//seconds from launch to the first loading screen, and to the first frame of the scene
+	float firstFrameTime = 0;
+
 };
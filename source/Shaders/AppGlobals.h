@@ -9,6 +9,10 @@ extern class TextureManager;
 extern class D3D;
 extern class ID3D11Device;
 extern class ID3D11DeviceContext;
+extern class TransientBuffer;
+extern class RenderDevice;
+extern class RenderTargetPool;
+extern class AssetLoader;
 
 class AppGlobals {
 
@@ -32,6 +36,11 @@ public:
 	ID3D11Device* Device;
 	ID3D11DeviceContext* DeviceContext;
 	HWND Hwnd;
+	RenderDevice* Backend = nullptr;//per-frame buffer writes, binds and draws go through this rather than DeviceContext
+	TransientBuffer* TransientConstants = nullptr;//per-draw constants
+	TransientBuffer* TransientVertices = nullptr;//per-draw dynamic vertices
+	RenderTargetPool* TargetPool = nullptr;//render targets get recycled through this rather than deleted
+	AssetLoader* Assets = nullptr;//textures and other files get loaded in the background through this
 
 	XMMATRIX ViewMatrix;
 	int ScreenWidth;
@@ -0,0 +1,207 @@
+#include "AssetLoader.h"
+
+#include <wincodec.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+
+AssetLoader::AssetLoader(RenderDevice* device, int workers) : device(device) {
+	const unsigned char colours[TEXTURE_PLACEHOLDER_COUNT][4] = { { 255, 255, 255, 255 }, { 128, 128, 255, 255 }, { 0, 0, 0, 255 } };
+	for (int i = 0; i < TEXTURE_PLACEHOLDER_COUNT; ++i)
+		placeholders[i] = device->createTexture(1, 1, colours[i], false);
+
+	workers = (std::max)(1, (std::min)(workers, ASSET_LOADER_MAX_WORKERS));
+	for (int i = 0; i < workers; ++i)
+		threads.push_back(std::thread(&AssetLoader::workerLoop, this));
+}
+
+AssetLoader::~AssetLoader() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+
+	//dropped jobs can hold things that forget() their slots on the way out, so they go without the lock held
+	std::deque<Job> dropped, droppedUploads;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		dropped.swap(work);
+		droppedUploads.swap(uploads);
+	}
+	dropped.clear();
+	droppedUploads.clear();
+
+	for (auto& texture : textures)
+		if (texture.second.view) device->releaseView(texture.second.view);
+	for (int i = 0; i < TEXTURE_PLACEHOLDER_COUNT; ++i)
+		if (placeholders[i]) device->releaseView(placeholders[i]);
+}
+
+void AssetLoader::workerLoop() {
+	CoInitializeEx(nullptr, COINIT_MULTITHREADED);//for WIC
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		wake.wait(guard, [this]() { return quit || !work.empty(); });
+		if (quit) break;
+		Job job = std::move(work.front());
+		work.pop_front();
+		current = job.name;
+
+		guard.unlock();
+		job.work();
+		guard.lock();
+
+		job.work = nullptr;//whatever it captured isn't needed anymore, apart from what upload captured too
+		uploads.push_back(std::move(job));
+	}
+	guard.unlock();
+	CoUninitialize();
+}
+
+void AssetLoader::load(const std::string& name, const std::function<void()>& work, const std::function<void()>& upload) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		++total;
+		if (work) this->work.push_back({ name, work, upload });
+		else uploads.push_back({ name, nullptr, upload });
+	}
+	if (work) wake.notify_one();
+}
+
+void AssetLoader::pump(float budget) {
+	auto start = std::chrono::high_resolution_clock::now();
+	float elapsed = 0;
+	do {
+		Job job;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (uploads.empty()) break;
+			job = std::move(uploads.front());
+			uploads.pop_front();
+		}
+		if (job.upload) job.upload();
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			++done;
+		}
+		elapsed = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	} while (elapsed < budget);
+	uploadTime = elapsed;
+}
+
+AssetLoader::Texture& AssetLoader::findTexture(const std::string& filename) {
+	auto found = textures.find(filename);
+	if (found != textures.end()) return found->second;
+	Texture& texture = textures[filename];
+
+	//decoded on a worker; the pixels only need to live until they're uploaded
+	++total;
+	auto image = std::make_shared<std::vector<unsigned char>>();
+	auto size = std::make_shared<std::pair<unsigned int, unsigned int>>(0, 0);
+	work.push_back({ filename, [filename, image, size]() {
+		if (!decode(filename, *image, size->first, size->second))
+			printf("Error: could not load texture %s.\n", filename.c_str());
+	}, [this, filename, image, size]() {
+		GpuView* view = image->empty() ? nullptr : device->createTexture(size->first, size->second, &(*image)[0], true);
+		std::vector<std::function<void(GpuView*)>> callbacks;
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			Texture& texture = textures[filename];
+			texture.view = view;
+			if (view) {
+				for (GpuView** slot : texture.slots)
+					*slot = view;
+				++texturesLoaded;
+			}
+			//broken textures leave their placeholders
+			texture.slots.clear();
+			callbacks.swap(texture.callbacks);
+		}
+		if (view)
+			for (auto& ready : callbacks)
+				ready(view);
+	} });
+	wake.notify_one();
+	return texture;
+}
+
+void AssetLoader::requestTexture(const std::string& filename, GpuView** slot, int placeholder) {
+	std::lock_guard<std::mutex> guard(lock);
+	Texture& texture = findTexture(filename);
+	if (texture.view) {
+		*slot = texture.view;
+		return;
+	}
+	*slot = placeholders[placeholder];
+	texture.slots.push_back(slot);
+}
+
+void AssetLoader::requestTexture(const std::string& filename, const std::function<void(GpuView*)>& ready) {
+	GpuView* view;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		Texture& texture = findTexture(filename);
+		view = texture.view;
+		if (!view) texture.callbacks.push_back(ready);
+	}
+	if (view) ready(view);
+}
+
+void AssetLoader::forget(GpuView** slot) {
+	std::lock_guard<std::mutex> guard(lock);
+	for (auto& texture : textures) {
+		std::vector<GpuView**>& slots = texture.second.slots;
+		slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+	}
+}
+
+void AssetLoader::cacheFile(const std::string& filename) {
+	std::ifstream input(filename, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(input)), (std::istreambuf_iterator<char>()));
+	std::lock_guard<std::mutex> guard(lock);
+	files[filename].swap(bytes);
+}
+
+bool AssetLoader::takeFile(const std::string& filename, std::vector<char>& out_bytes) {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto found = files.find(filename);
+		if (found != files.end()) {
+			out_bytes.swap(found->second);
+			files.erase(found);
+			return !out_bytes.empty();
+		}
+	}
+	std::ifstream input(filename, std::ios::binary);
+	out_bytes.assign((std::istreambuf_iterator<char>(input)), (std::istreambuf_iterator<char>()));
+	return !out_bytes.empty();
+}
+
+///Same steps as DirectXTK's WIC loader, minus the device, so that it can run on any thread with COM initialised
+bool AssetLoader::decode(const std::string& filename, std::vector<unsigned char>& out_pixels, unsigned int& out_width, unsigned int& out_height) {
+	IWICImagingFactory* factory = nullptr;
+	IWICBitmapDecoder* decoder = nullptr;
+	IWICBitmapFrameDecode* frame = nullptr;
+	IWICFormatConverter* converter = nullptr;
+	std::wstring w_filename = std::wstring(filename.begin(), filename.end());
+	bool ok = SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) &&
+		SUCCEEDED(factory->CreateDecoderFromFilename(w_filename.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(frame->GetSize(&out_width, &out_height)) &&
+		SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+		SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0, WICBitmapPaletteTypeMedianCut));
+	if (ok) {
+		out_pixels.resize(out_width * out_height * 4);
+		ok = SUCCEEDED(converter->CopyPixels(nullptr, out_width * 4, (UINT)out_pixels.size(), &out_pixels[0]));
+	}
+	if (!ok) out_pixels.clear();
+	if (converter) converter->Release();
+	if (frame) frame->Release();
+	if (decoder) decoder->Release();
+	if (factory) factory->Release();
+	return ok;
+}
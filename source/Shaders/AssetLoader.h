@@ -0,0 +1,103 @@
+#pragma once
+
+/// Loads assets in the background: the slow part of each one (reading the file, parsing, decoding) runs on a worker thread, then whatever has to touch
+/// the device gets handed back to the render thread, which runs a few of those every frame in pump() instead of stalling on all of them at once.
+/// Textures are asked for by file name, from any thread; whatever asks gets a placeholder straight away, which gets swapped for the real texture
+/// once it's uploaded. Files read ahead of time (shader bytecode) are kept until whoever needs them takes them.
+
+#include "RenderDevice.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#define ASSET_LOADER_MAX_WORKERS 4
+#define ASSET_UPLOAD_BUDGET 4.f //milliseconds of each frame pump() spends uploading, past the first upload
+
+//what a texture looks like until it's loaded; placeholders are 1x1 textures, shared by everything waiting
+#define TEXTURE_PLACEHOLDER_WHITE 0 //diffuse textures and the like: the material colour on its own
+#define TEXTURE_PLACEHOLDER_NORMAL 1 //flat normal maps
+#define TEXTURE_PLACEHOLDER_BLACK 2 //displacement maps, and anything else that should do nothing until it's there
+#define TEXTURE_PLACEHOLDER_COUNT 3
+
+class AssetLoader {
+
+protected:
+	struct Job {
+		std::string name;
+		std::function<void()> work, upload;
+	};
+
+	struct Texture {
+		GpuView* view = nullptr;//null until uploaded
+		std::vector<GpuView**> slots;//waiting for it
+		std::vector<std::function<void(GpuView*)>> callbacks;//same
+	};
+
+public:
+	///workers get clamped to 1..ASSET_LOADER_MAX_WORKERS
+	AssetLoader(RenderDevice* device, int workers);
+	///waits for whatever the workers are busy with, and drops the rest
+	~AssetLoader();
+
+	///runs work on a worker, then upload on the render thread during a later pump(); either can be empty. Name shows up on the loading screen while it runs
+	void load(const std::string& name, const std::function<void()>& work, const std::function<void()>& upload);
+
+	///points slot at the texture in filename once it's uploaded, and at a placeholder until then. Any thread; every texture only gets loaded once, however often it's asked for.
+	///Slots that go away before then have to be forgotten
+	void requestTexture(const std::string& filename, GpuView** slot, int placeholder = TEXTURE_PLACEHOLDER_WHITE);
+	///same thing, for textures that go through a setter; ready gets called from pump() once it's uploaded, or straight away if it already is
+	void requestTexture(const std::string& filename, const std::function<void(GpuView*)>& ready);
+	void forget(GpuView** slot);
+	inline GpuView* getPlaceholder(int placeholder) { return placeholders[placeholder]; }
+
+	///reads a file on the calling thread and keeps it for takeFile() to pick up later; for work functions to read ahead what an upload is going to need
+	void cacheFile(const std::string& filename);
+	///the file's bytes, cached if they were, otherwise read now; false if it doesn't exist or is empty
+	bool takeFile(const std::string& filename, std::vector<char>& out_bytes);
+	///lets go of cached files nothing took
+	inline void dropFiles() { std::lock_guard<std::mutex> guard(lock); files.clear(); }
+
+	///runs uploads until budget milliseconds are up; render thread only
+	void pump(float budget = ASSET_UPLOAD_BUDGET);
+
+	///loads asked for so far, and the ones that are done (uploaded too)
+	inline int getTotal() { std::lock_guard<std::mutex> guard(lock); return total; }
+	inline int getDone() { std::lock_guard<std::mutex> guard(lock); return done; }
+	inline bool isIdle() { std::lock_guard<std::mutex> guard(lock); return done == total; }
+	///what the workers last started on
+	inline std::string getCurrent() { std::lock_guard<std::mutex> guard(lock); return current; }
+	inline int getTexturesLoaded() { std::lock_guard<std::mutex> guard(lock); return texturesLoaded; }
+	inline int getTextureCount() { std::lock_guard<std::mutex> guard(lock); return (int)textures.size(); }
+	///what pump() took last frame, in milliseconds
+	inline float getUploadTime() { return uploadTime; }
+
+protected:
+	RenderDevice* device;
+	GpuView* placeholders[TEXTURE_PLACEHOLDER_COUNT];
+
+	std::vector<std::thread> threads;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<Job> work;//waiting for a worker
+	std::deque<Job> uploads;//waiting for the render thread
+	bool quit = false;
+	int total = 0, done = 0;
+	std::string current;
+
+	std::map<std::string, Texture> textures;
+	int texturesLoaded = 0;
+	std::map<std::string, std::vector<char>> files;//see cacheFile()
+	float uploadTime = 0;
+
+	void workerLoop();
+	///queues the texture's load if it hasn't been already; with the lock held
+	Texture& findTexture(const std::string& filename);
+	///decodes an image to 32 bit rgba through WIC, on the calling thread
+	static bool decode(const std::string& filename, std::vector<unsigned char>& out_pixels, unsigned int& out_width, unsigned int& out_height);
+
+};
@@ -8,7 +8,7 @@ BloomShader::BloomShader() : GaussianBlurShader(false) {
 
 
 BloomShader::~BloomShader(){
-	bloomBuffer->Release();
+	GLOBALS.Backend->releaseBuffer(bloomBuffer);
 }
 
 void BloomShader::initBuffers() {
@@ -18,17 +18,15 @@ void BloomShader::initBuffers() {
 }
 
 ///Sends data for bloom params
-void BloomShader::setBloom() {
-
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void BloomShader::setBloom(RenderDevice* device) {
 
 	//Send bloom data
-	BloomBufferType* bPtr;
-	GLOBALS.DeviceContext->Map(bloomBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	bPtr = (BloomBufferType*)mappedResource.pData;
-	bPtr->threshold = threshold;
-	bPtr->intensity = intensity;
-	GLOBALS.DeviceContext->Unmap(bloomBuffer, 0);
-	GLOBALS.DeviceContext->PSSetConstantBuffers(1, 1, &bloomBuffer);
+	BloomBufferType* bPtr = (BloomBufferType*)device->map(bloomBuffer, false);
+	if (bPtr) {
+		bPtr->threshold = threshold;
+		bPtr->intensity = intensity;
+		device->unmap(bloomBuffer);
+	}
+	device->setConstantBuffer(STAGE_PS, 1, bloomBuffer);
 
 }
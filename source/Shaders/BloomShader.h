@@ -13,7 +13,7 @@ public:
 	BloomShader();
 	~BloomShader();
 
-	void setBloom();
+	void setBloom(RenderDevice* device);
 
 	///Parameters for blooming
 	float threshold = 1.75f;
@@ -23,6 +23,6 @@ protected:
 	void initBuffers() override;
 
 private:
-	ID3D11Buffer* bloomBuffer;
+	GpuBuffer* bloomBuffer = nullptr;
 };
 
@@ -1,6 +1,7 @@
 #include "ColourGradingShader.h"
 
 #include "AppGlobals.h"
+#include "D3D11RenderDevice.h"
 
 
 ColourGradingShader::ColourGradingShader(){
@@ -15,8 +16,8 @@ ColourGradingShader::ColourGradingShader(){
 
 
 ColourGradingShader::~ColourGradingShader(){
-	colourGradingBuffer->Release();
-	lutSampler->Release();
+	GLOBALS.Backend->releaseBuffer(colourGradingBuffer);
+	GLOBALS.Backend->releaseSampler(lutSampler);
 	delete tonemapShader;
 	delete textureShader;
 	delete renderTexture;
@@ -27,23 +28,13 @@ ColourGradingShader::~ColourGradingShader(){
 void ColourGradingShader::initBuffers() {
 	PostProcessingShader::initBuffers();
 
-	D3D11_SAMPLER_DESC samplerDesc;
-	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.MipLODBias = 0.0f;
-	samplerDesc.MaxAnisotropy = 0;
-	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-	samplerDesc.MinLOD = 0;
-	samplerDesc.MaxLOD = 0;
-	renderer->CreateSamplerState(&samplerDesc, &lutSampler);
+	lutSampler = GLOBALS.Backend->createSampler(FILTER_LINEAR_MIP_POINT, ADDRESS_WRAP);//the lut has no mips
 
 	SETUP_SHADER_BUFFER(ColourGradingType, colourGradingBuffer);
 }
 
-void ColourGradingShader::setColourGrading(D3D* renderer, ID3D11DeviceContext* deviceContext, XMMATRIX orthoViewMatrix, ID3D11ShaderResourceView* depthTexture) {
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void ColourGradingShader::setColourGrading(D3D* renderer, RenderDevice* device, XMMATRIX orthoViewMatrix, GpuView* depthTexture, XMMATRIX projectionMatrix) {
+	ID3D11DeviceContext* deviceContext = renderer->getDeviceContext();//for DXFramework's render texture and mesh
 
 	// Retonemap LUT if needed
 	if (retonemap && lut != nullptr) {
@@ -53,8 +44,8 @@ void ColourGradingShader::setColourGrading(D3D* renderer, ID3D11DeviceContext* d
 		renderTexture->setRenderTarget(deviceContext);
 		renderTexture->clearRenderTarget(deviceContext, 1, 1, 1, 1);
 		orthoMesh->sendData(deviceContext);
-		tonemapShader->setShaderParameters(deviceContext, renderer->getWorldMatrix(), orthoViewMatrix, renderer->getOrthoMatrix(), XMFLOAT3(0,0,0));
-		tonemapShader->setTextureData(deviceContext, lut);
+		tonemapShader->setShaderParameters(device, renderer->getWorldMatrix(), orthoViewMatrix, renderer->getOrthoMatrix(), XMFLOAT3(0,0,0));
+		tonemapShader->setTextureData(device, lut);
 		//pass params
 		tonemapShader->tonemapping = getTonemapping();
 		tonemapShader->exposure = getExposure();
@@ -63,38 +54,40 @@ void ColourGradingShader::setColourGrading(D3D* renderer, ID3D11DeviceContext* d
 		tonemapShader->hue = getHue();
 		tonemapShader->saturation = getSaturation();
 		tonemapShader->value = getValue();
-		tonemapShader->setTonemapping(deviceContext);
+		tonemapShader->setTonemapping(device);
 		tonemapShader->render(deviceContext, orthoMesh->getIndexCount());
 		renderer->setBackBufferRenderTarget();
 		renderer->setZBuffer(true);
 		//grab the tonemapped lut
-		tonemappedLut = renderTexture->getShaderResourceView();
+		tonemappedLut = D3D11RenderDevice::handle(renderTexture->getShaderResourceView());
 	}
 
 	// Send data to fragment shader
-	ColourGradingType* cgPtr;
-	deviceContext->Map(colourGradingBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	cgPtr = (ColourGradingType*)mappedResource.pData;
+	ColourGradingType* cgPtr = (ColourGradingType*)device->map(colourGradingBuffer, false);
+	if (!cgPtr) return;
 	cgPtr->strength = tonemappedLut == nullptr ? 0 : strength;
 	cgPtr->logLutParams = XMFLOAT3(1.0f/LUT_WIDTH, 1.0f/LUT_HEIGHT, LUT_HEIGHT-1.0f);
 	cgPtr->vignette = vignette;
 	cgPtr->chromaticAberrationStrength = chromaticAberrationStrength;
 	cgPtr->chromaticAberrationDistance = chromaticAberrationDistance;
 	cgPtr->fog = fogColour;
-	deviceContext->Unmap(colourGradingBuffer, 0);
-	deviceContext->PSSetConstantBuffers(0, 1, &colourGradingBuffer);
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, projectionMatrix);
+	cgPtr->depthParams = XMFLOAT2(projection._33, projection._43 / GLOBALS.FarPlane);
+	device->unmap(colourGradingBuffer);
+	device->setConstantBuffer(STAGE_PS, 0, colourGradingBuffer);
 
 	// Send LUT
 	if (tonemappedLut != nullptr) {
-		deviceContext->PSSetShaderResources(1, 1, &tonemappedLut);
-		deviceContext->PSSetSamplers(1, 1, &lutSampler);
+		device->setShaderResources(STAGE_PS, 1, 1, &tonemappedLut);
+		device->setSamplers(STAGE_PS, 1, 1, &lutSampler);
 	}
 	else {
 		printf("Error: LUT was not tonemapped.");
 	}
 
 	// Send depth texture
-	deviceContext->PSSetShaderResources(2, 1, &depthTexture);
+	device->setShaderResources(STAGE_PS, 2, 1, &depthTexture);
 }
 
 
@@ -134,8 +127,8 @@ void ColourGradingShader::showLut(D3D* renderer, XMMATRIX orthoViewMatrix) {
 
 	renderer->setZBuffer(false);
 	orthoMeshSmall->sendData(renderer->getDeviceContext());
-	textureShader->setShaderParameters(renderer->getDeviceContext(), renderer->getWorldMatrix(), orthoViewMatrix, renderer->getOrthoMatrix(), XMFLOAT3(0,0,0));
-	textureShader->setTextureData(renderer->getDeviceContext(), tonemappedLut);
+	textureShader->setShaderParameters(GLOBALS.Backend, renderer->getWorldMatrix(), orthoViewMatrix, renderer->getOrthoMatrix(), XMFLOAT3(0,0,0));
+	textureShader->setTextureData(GLOBALS.Backend, tonemappedLut);
 	textureShader->render(renderer->getDeviceContext(), orthoMeshSmall->getIndexCount());
 	renderer->setZBuffer(true);
 
@@ -17,15 +17,15 @@ protected:
 		float vignette;//0..1
 		float chromaticAberrationStrength;//0..1
 		float chromaticAberrationDistance;//0..1
-		XMFLOAT2 pad;
+		XMFLOAT2 depthParams;//projection _33, and _43 over the far plane: gets fog depth back from the depth buffer
 	};
 
 public:
 	ColourGradingShader();
 	~ColourGradingShader();
 
-	///setup the colour grading
-	void setColourGrading(D3D* renderer, ID3D11DeviceContext* deviceContext, XMMATRIX orthoViewMatrix, ID3D11ShaderResourceView* depthTexture);
+	///setup the colour grading; depthTexture is the scene's depth buffer, rendered with projectionMatrix
+	void setColourGrading(D3D* renderer, RenderDevice* device, XMMATRIX orthoViewMatrix, GpuView* depthTexture, XMMATRIX projectionMatrix);
 
 	///debug: show GUI for params
 	void gui();
@@ -34,7 +34,7 @@ public:
 	void showLut(D3D* renderer, XMMATRIX orthoViewMatrix);
 
 	///init the lut
-	inline void setLut(ID3D11ShaderResourceView* view) { lut = view; retonemap = true; }
+	inline void setLut(GpuView* view) { lut = view; retonemap = true; }
 
 	///Parameters
 	float strength = 1;//0..1
@@ -66,10 +66,10 @@ protected:
 	float value = 1;//0..2
 
 private:
-	ID3D11Buffer* colourGradingBuffer = nullptr;
-	ID3D11ShaderResourceView* lut = nullptr;
-	ID3D11ShaderResourceView* tonemappedLut = nullptr;//result of post-processed lut
-	ID3D11SamplerState* lutSampler = nullptr;
+	GpuBuffer* colourGradingBuffer = nullptr;
+	GpuView* lut = nullptr;
+	GpuView* tonemappedLut = nullptr;//result of post-processed lut
+	GpuSampler* lutSampler = nullptr;
 
 	bool retonemap = false;//set to true each time one of the params changes; redoes tonemapping to LUT on this frame when true
 
@@ -11,6 +11,6 @@ CombinationShader::~CombinationShader(){
 }
 
 
-void CombinationShader::setTexture1(ID3D11ShaderResourceView* texture1) {
-	GLOBALS.DeviceContext->PSSetShaderResources(1, 1, &texture1);
+void CombinationShader::setTexture1(RenderDevice* device, GpuView* texture1) {
+	device->setShaderResources(STAGE_PS, 1, 1, &texture1);
 }
\ No newline at end of file
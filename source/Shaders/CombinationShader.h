@@ -7,6 +7,6 @@ public:
 	CombinationShader();
 	~CombinationShader();
 
-	void setTexture1(ID3D11ShaderResourceView* texture1);
+	void setTexture1(RenderDevice* device, GpuView* texture1);
 };
 
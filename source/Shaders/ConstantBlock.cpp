@@ -0,0 +1,6 @@
+#include "ConstantBlock.h"
+
+std::atomic<unsigned int> ConstantBlockStats::uploads(0);
+std::atomic<unsigned int> ConstantBlockStats::uploadedBytes(0);
+std::atomic<unsigned int> ConstantBlockStats::skips(0);
+std::atomic<unsigned int> ConstantBlockStats::skippedBytes(0);
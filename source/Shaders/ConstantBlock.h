@@ -0,0 +1,83 @@
+#pragma once
+
+/// A dynamic constant buffer that keeps a copy of what it last uploaded, so that sending the same data again only costs a memcmp rather than a Map.
+/// Each device and recorder gets its own buffer and copy (by RenderDevice::getSlot()), so passes being recorded on other threads neither race nor skip uploads another list made.
+
+#include <cstring>
+#include <cstdio>
+#include <atomic>
+#include "RenderDevice.h"
+
+///Writes and bytes, summed over every block since the last reset()
+class ConstantBlockStats {
+public:
+	static std::atomic<unsigned int> uploads, uploadedBytes;
+	static std::atomic<unsigned int> skips, skippedBytes;
+
+	///call once per frame
+	static inline void reset() { uploads = uploadedBytes = skips = skippedBytes = 0; }
+};
+
+template<typename T> class ConstantBlock {
+
+public:
+	ConstantBlock() {
+		memset(slots, 0, sizeof(slots));
+	}
+	~ConstantBlock() {
+		for (int i = 0; i < MAX_RENDER_DEVICES; ++i)
+			if (slots[i].buffer) owner->releaseBuffer(slots[i].buffer);
+	}
+
+	///creates the device's buffer; call once before update(). Recorders get theirs the first time they use the block
+	void init(RenderDevice* device) {
+		owner = device;
+		create(device);
+	}
+
+	///uploads data unless it's byte for byte what this device uploaded last; returns whether it had to. Zero data before filling it in, or padding will make every upload look different
+	bool update(RenderDevice* device, const T& data) {
+		Slot& slot = slots[device->getSlot()];
+		if (!slot.buffer && (!owner || !create(device))) return false;
+		GpuBuffer* buffer = slot.buffer;
+		T& contents = slot.contents;
+		if (slot.uploaded && memcmp(&data, &contents, sizeof(T)) == 0) {
+			++ConstantBlockStats::skips;
+			ConstantBlockStats::skippedBytes += sizeof(T);
+			return false;
+		}
+
+		void* mapped = device->map(buffer, false);
+		if (!mapped) return false;
+		memcpy(mapped, &data, sizeof(T));
+		device->unmap(buffer);
+		memcpy(&contents, &data, sizeof(T));
+		slot.uploaded = true;
+
+		++ConstantBlockStats::uploads;
+		ConstantBlockStats::uploadedBytes += sizeof(T);
+		return true;
+	}
+
+	///binds the whole block
+	inline void bind(RenderDevice* device, int stage, unsigned int slot) { device->setConstantBuffer(stage, slot, slots[device->getSlot()].buffer); }
+
+private:
+	struct Slot {
+		GpuBuffer* buffer;
+		T contents;//what the gpu will have, once everything recorded so far has run
+		bool uploaded;//contents are only worth comparing against once there's been one
+	};
+
+	RenderDevice* owner = nullptr;//the device the recorders came from; every slot's buffer goes back to it
+	Slot slots[MAX_RENDER_DEVICES];
+
+	bool create(RenderDevice* device) {
+		Slot& slot = slots[device->getSlot()];
+		slot.buffer = device->createBuffer(sizeof(T), BUFFER_CONSTANT);//recorders create into their device, so this is safe from their thread
+		if (!slot.buffer)
+			printf("Error: could not create %u byte constant buffer.\n", (unsigned int)sizeof(T));
+		return slot.buffer != nullptr;
+	}
+
+};
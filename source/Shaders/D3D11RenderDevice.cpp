@@ -0,0 +1,557 @@
+#include "D3D11RenderDevice.h"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <chrono>
+
+//RenderDevice's values get handed straight over
+static_assert(sizeof(Viewport) == sizeof(D3D11_VIEWPORT), "Viewport has to match D3D11_VIEWPORT");
+static_assert(TOPOLOGY_POINTLIST == D3D11_PRIMITIVE_TOPOLOGY_POINTLIST && TOPOLOGY_LINELIST == D3D11_PRIMITIVE_TOPOLOGY_LINELIST &&
+	TOPOLOGY_TRIANGLELIST == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST && TOPOLOGY_PATCHLIST_3 == D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST, "topologies have to match D3D11's");
+static_assert(COMPARE_NEVER == D3D11_COMPARISON_NEVER && COMPARE_LESS == D3D11_COMPARISON_LESS && COMPARE_EQUAL == D3D11_COMPARISON_EQUAL &&
+	COMPARE_LESS_EQUAL == D3D11_COMPARISON_LESS_EQUAL && COMPARE_GREATER == D3D11_COMPARISON_GREATER && COMPARE_ALWAYS == D3D11_COMPARISON_ALWAYS, "comparisons have to match D3D11's");
+static_assert(FORMAT_UNKNOWN == DXGI_FORMAT_UNKNOWN && FORMAT_R32G32B32A32_FLOAT == DXGI_FORMAT_R32G32B32A32_FLOAT && FORMAT_R32G32B32A32_UINT == DXGI_FORMAT_R32G32B32A32_UINT &&
+	FORMAT_R32G32B32_FLOAT == DXGI_FORMAT_R32G32B32_FLOAT && FORMAT_R32G32_FLOAT == DXGI_FORMAT_R32G32_FLOAT && FORMAT_R32G32_UINT == DXGI_FORMAT_R32G32_UINT &&
+	FORMAT_R32_UINT == DXGI_FORMAT_R32_UINT, "formats have to match DXGI's");
+static_assert(FILTER_LINEAR == D3D11_FILTER_MIN_MAG_MIP_LINEAR && FILTER_LINEAR_MIP_POINT == D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT && FILTER_ANISOTROPIC == D3D11_FILTER_ANISOTROPIC &&
+	FILTER_COMPARISON_LINEAR == D3D11_FILTER_COMPARISON_MIN_MAG_MIP_LINEAR && FILTER_COMPARISON_LINEAR_MIP_POINT == D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT, "filters have to match D3D11's");
+static_assert(ADDRESS_WRAP == D3D11_TEXTURE_ADDRESS_WRAP && ADDRESS_CLAMP == D3D11_TEXTURE_ADDRESS_CLAMP, "address modes have to match D3D11's");
+
+#define FENCE_SPINS 64 //polls before waiting on a fence starts yielding its time slice
+#define FENCE_YIELDS 256 //then before it starts sleeping a millisecond at a time
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext) : device(device), deviceContext(deviceContext) {
+	queryOptions();
+}
+
+D3D11RenderDevice::D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deferredContext, int slot) : device(device), deviceContext(deferredContext) {
+	this->slot = slot;
+	deferred = true;
+	queryOptions();
+}
+
+void D3D11RenderDevice::queryOptions() {
+	//need the 11.1 runtime to bind at an offset, and the driver to allow no-overwrite maps on constant buffers
+	D3D11_FEATURE_DATA_D3D11_OPTIONS options;
+	ZeroMemory(&options, sizeof(options));
+	device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options));
+	deviceContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&deviceContext1);
+	constantOffsets = deviceContext1 && options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer;
+}
+
+D3D11RenderDevice::~D3D11RenderDevice() {
+	if (deviceContext1)
+		deviceContext1->Release();
+	if (deferred)
+		deviceContext->Release();
+}
+
+GpuBuffer* D3D11RenderDevice::createBuffer(unsigned int size, int type) {
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = size;
+	desc.BindFlags = type == BUFFER_CONSTANT ? D3D11_BIND_CONSTANT_BUFFER : type == BUFFER_INDEX ? D3D11_BIND_INDEX_BUFFER : D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+	ID3D11Buffer* buffer = nullptr;
+	if (device->CreateBuffer(&desc, NULL, &buffer) != S_OK) {
+		printf("Error: could not create %u byte buffer.\n", size);
+		return nullptr;
+	}
+	return handle(buffer);
+}
+
+GpuBuffer* D3D11RenderDevice::createStaticBuffer(unsigned int size, int type, const void* data) {
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = size;
+	desc.BindFlags = type == BUFFER_CONSTANT ? D3D11_BIND_CONSTANT_BUFFER : type == BUFFER_INDEX ? D3D11_BIND_INDEX_BUFFER : D3D11_BIND_VERTEX_BUFFER;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = 0;
+	desc.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA initial;
+	initial.pSysMem = data;
+	initial.SysMemPitch = 0;
+	initial.SysMemSlicePitch = 0;
+	ID3D11Buffer* buffer = nullptr;
+	if (device->CreateBuffer(&desc, data ? &initial : NULL, &buffer) != S_OK) {
+		printf("Error: could not create %u byte buffer.\n", size);
+		return nullptr;
+	}
+	return handle(buffer);
+}
+
+void D3D11RenderDevice::releaseBuffer(GpuBuffer* buffer) {
+	if (buffer)
+		get(buffer)->Release();
+}
+
+void* D3D11RenderDevice::map(GpuBuffer* buffer, bool noOverwrite) {
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (deviceContext->Map(get(buffer), 0, noOverwrite ? D3D11_MAP_WRITE_NO_OVERWRITE : D3D11_MAP_WRITE_DISCARD, 0, &mappedResource) != S_OK)
+		return nullptr;
+	return mappedResource.pData;
+}
+
+void D3D11RenderDevice::unmap(GpuBuffer* buffer) {
+	deviceContext->Unmap(get(buffer), 0);
+}
+
+void D3D11RenderDevice::copyBuffer(GpuBuffer* destination, unsigned int destinationOffset, GpuBuffer* source, unsigned int sourceOffset, unsigned int size) {
+	D3D11_BOX box = { sourceOffset, 0, 0, sourceOffset + size, 1, 1 };
+	deviceContext->CopySubresourceRegion(get(destination), 0, destinationOffset, 0, 0, get(source), 0, &box);
+}
+
+bool D3D11RenderDevice::readBuffer(GpuBuffer* buffer, std::vector<unsigned char>& out_bytes) {
+	if (deferred) {
+		printf("Error: buffers can't be read back on a recorder.\n");
+		return false;
+	}
+	D3D11_BUFFER_DESC desc;
+	get(buffer)->GetDesc(&desc);
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+	ID3D11Buffer* staging = nullptr;
+	if (device->CreateBuffer(&desc, NULL, &staging) != S_OK) {
+		printf("Error: could not create staging buffer.\n");
+		return false;
+	}
+	deviceContext->CopyResource(staging, get(buffer));
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	bool ok = deviceContext->Map(staging, 0, D3D11_MAP_READ, 0, &mapped) == S_OK;
+	if (ok) {
+		out_bytes.resize(desc.ByteWidth);
+		memcpy(&out_bytes[0], mapped.pData, desc.ByteWidth);
+		deviceContext->Unmap(staging, 0);
+	}
+	else
+		printf("Error: could not map staging buffer.\n");
+	staging->Release();
+	return ok;
+}
+
+GpuBuffer* D3D11RenderDevice::createShaderBuffer(unsigned int count, unsigned int stride, int format, GpuView** out_view) {
+	*out_view = nullptr;
+
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.ByteWidth = count * stride;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = format == FORMAT_UNKNOWN ? D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : 0;
+	desc.StructureByteStride = format == FORMAT_UNKNOWN ? stride : 0;
+	ID3D11Buffer* buffer = nullptr;
+	if (device->CreateBuffer(&desc, NULL, &buffer) != S_OK) {
+		printf("Error: could not create shader buffer of %u elements.\n", count);
+		return nullptr;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	ZeroMemory(&srvDesc, sizeof(srvDesc));
+	srvDesc.Format = (DXGI_FORMAT)format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = count;
+	ID3D11ShaderResourceView* view = nullptr;
+	device->CreateShaderResourceView(buffer, &srvDesc, &view);
+	*out_view = handle(view);
+	return handle(buffer);
+}
+
+void D3D11RenderDevice::releaseView(GpuView* view) {
+	if (view)
+		get(view)->Release();
+}
+
+GpuBuffer* D3D11RenderDevice::createIndirectBuffer(unsigned int count, const unsigned int* initial, GpuUnorderedView** out_view) {
+	*out_view = nullptr;
+
+	D3D11_BUFFER_DESC desc;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.ByteWidth = count * sizeof(unsigned int);
+	desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+	desc.CPUAccessFlags = 0;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_DRAWINDIRECT_ARGS;//can't be structured, so the view is typed
+	desc.StructureByteStride = 0;
+	D3D11_SUBRESOURCE_DATA data;
+	data.pSysMem = initial;
+	data.SysMemPitch = 0;
+	data.SysMemSlicePitch = 0;
+	ID3D11Buffer* buffer = nullptr;
+	if (device->CreateBuffer(&desc, initial ? &data : NULL, &buffer) != S_OK) {
+		printf("Error: could not create indirect buffer of %u values.\n", count);
+		return nullptr;
+	}
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+	ZeroMemory(&uavDesc, sizeof(uavDesc));
+	uavDesc.Format = DXGI_FORMAT_R32_UINT;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements = count;
+	ID3D11UnorderedAccessView* view = nullptr;
+	device->CreateUnorderedAccessView(buffer, &uavDesc, &view);
+	*out_view = handle(view);
+	return handle(buffer);
+}
+
+void D3D11RenderDevice::releaseView(GpuUnorderedView* view) {
+	if (view)
+		get(view)->Release();
+}
+
+GpuView* D3D11RenderDevice::createTexture(unsigned int width, unsigned int height, const unsigned char* pixels, bool mips) {
+	if (deferred) {
+		printf("Error: textures can't be created on a recorder.\n");
+		return nullptr;
+	}
+	//mips get generated on the gpu, which needs the texture to be a render target too
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = mips ? 0 : 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (mips ? D3D11_BIND_RENDER_TARGET : 0);
+	desc.MiscFlags = mips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+	ID3D11Texture2D* texture = nullptr;
+	ID3D11ShaderResourceView* view = nullptr;
+	if (device->CreateTexture2D(&desc, nullptr, &texture) != S_OK || device->CreateShaderResourceView(texture, nullptr, &view) != S_OK) {
+		printf("Error: could not create a %ux%u texture.\n", width, height);
+		if (texture) texture->Release();
+		return nullptr;
+	}
+	deviceContext->UpdateSubresource(texture, 0, nullptr, pixels, width * 4, 0);
+	if (mips) deviceContext->GenerateMips(view);
+	texture->Release();//the view keeps it alive
+	return handle(view);
+}
+
+GpuShader* D3D11RenderDevice::createShader(int stage, const void* bytecode, size_t size) {
+	ID3D11DeviceChild* shader = nullptr;
+	HRESULT result = E_INVALIDARG;
+	switch (stage) {
+	case STAGE_VS: result = device->CreateVertexShader(bytecode, size, NULL, (ID3D11VertexShader**)&shader); break;
+	case STAGE_HS: result = device->CreateHullShader(bytecode, size, NULL, (ID3D11HullShader**)&shader); break;
+	case STAGE_DS: result = device->CreateDomainShader(bytecode, size, NULL, (ID3D11DomainShader**)&shader); break;
+	case STAGE_GS: result = device->CreateGeometryShader(bytecode, size, NULL, (ID3D11GeometryShader**)&shader); break;
+	case STAGE_PS: result = device->CreatePixelShader(bytecode, size, NULL, (ID3D11PixelShader**)&shader); break;
+	case STAGE_CS: result = device->CreateComputeShader(bytecode, size, NULL, (ID3D11ComputeShader**)&shader); break;
+	}
+	if (result != S_OK) {
+		printf("Error: could not create shader for stage %d.\n", stage);
+		return nullptr;
+	}
+	return (GpuShader*)shader;
+}
+
+void D3D11RenderDevice::releaseShader(GpuShader* shader) {
+	if (shader)
+		((ID3D11DeviceChild*)shader)->Release();
+}
+
+GpuLayout* D3D11RenderDevice::createLayout(const VertexElement* elements, unsigned int count, const void* bytecode, size_t size) {
+	std::vector<D3D11_INPUT_ELEMENT_DESC> descs(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		const VertexElement& element = elements[i];
+		descs[i].SemanticName = element.semantic;
+		descs[i].SemanticIndex = element.index;
+		descs[i].Format = (DXGI_FORMAT)element.format;
+		descs[i].InputSlot = element.slot;
+		descs[i].AlignedByteOffset = element.offset == VERTEX_APPEND ? D3D11_APPEND_ALIGNED_ELEMENT : element.offset;
+		descs[i].InputSlotClass = element.perInstance ? D3D11_INPUT_PER_INSTANCE_DATA : D3D11_INPUT_PER_VERTEX_DATA;
+		descs[i].InstanceDataStepRate = element.perInstance ? 1 : 0;
+	}
+	ID3D11InputLayout* layout = nullptr;
+	if (device->CreateInputLayout(&descs[0], count, bytecode, size, &layout) != S_OK) {
+		printf("Error: could not create input layout of %u elements.\n", count);
+		return nullptr;
+	}
+	return (GpuLayout*)layout;
+}
+
+void D3D11RenderDevice::releaseLayout(GpuLayout* layout) {
+	if (layout)
+		((ID3D11InputLayout*)layout)->Release();
+}
+
+GpuSampler* D3D11RenderDevice::createSampler(int filter, int address, int comparison) {
+	D3D11_SAMPLER_DESC desc;
+	ZeroMemory(&desc, sizeof(desc));
+	desc.Filter = (D3D11_FILTER)filter;
+	desc.AddressU = desc.AddressV = desc.AddressW = (D3D11_TEXTURE_ADDRESS_MODE)address;
+	desc.MaxAnisotropy = 1;
+	desc.ComparisonFunc = (D3D11_COMPARISON_FUNC)comparison;
+	desc.MinLOD = 0;
+	desc.MaxLOD = D3D11_FLOAT32_MAX;
+	ID3D11SamplerState* sampler = nullptr;
+	if (device->CreateSamplerState(&desc, &sampler) != S_OK) {
+		printf("Error: could not create sampler.\n");
+		return nullptr;
+	}
+	return (GpuSampler*)sampler;
+}
+
+void D3D11RenderDevice::releaseSampler(GpuSampler* sampler) {
+	if (sampler)
+		((ID3D11SamplerState*)sampler)->Release();
+}
+
+GpuQuery* D3D11RenderDevice::createFence() {
+	D3D11_QUERY_DESC desc;
+	desc.Query = D3D11_QUERY_EVENT;
+	desc.MiscFlags = 0;
+	ID3D11Query* query = nullptr;
+	if (device->CreateQuery(&desc, &query) != S_OK) {
+		printf("Error: could not create fence.\n");
+		return nullptr;
+	}
+	return (GpuQuery*)query;
+}
+
+void D3D11RenderDevice::releaseFence(GpuQuery* fence) {
+	if (fence)
+		((ID3D11Query*)fence)->Release();
+}
+
+void D3D11RenderDevice::signalFence(GpuQuery* fence) {
+	deviceContext->End((ID3D11Query*)fence);
+}
+
+bool D3D11RenderDevice::fenceReached(GpuQuery* fence, bool wait) {
+	//event queries have no data, S_OK just means the gpu got there
+	ID3D11Query* query = (ID3D11Query*)fence;
+	if (!wait)
+		return deviceContext->GetData(query, NULL, 0, D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK;
+	//the first poll flushes, so the gpu has the fence; after a few tries, give the time to other threads, then sleep, since a whole frame may be left to wait for
+	HRESULT result;
+	for (int tries = 0; (result = deviceContext->GetData(query, NULL, 0, tries == 0 ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH)) == S_FALSE; ++tries) {
+		if (tries < FENCE_SPINS) continue;
+		if (tries < FENCE_SPINS + FENCE_YIELDS) std::this_thread::yield();
+		else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return result == S_OK;
+}
+
+GpuQuery* D3D11RenderDevice::createOcclusionQuery() {
+	D3D11_QUERY_DESC desc;
+	desc.Query = D3D11_QUERY_OCCLUSION;
+	desc.MiscFlags = 0;
+	ID3D11Query* query = nullptr;
+	if (device->CreateQuery(&desc, &query) != S_OK) {
+		printf("Error: could not create occlusion query.\n");
+		return nullptr;
+	}
+	return (GpuQuery*)query;
+}
+
+void D3D11RenderDevice::releaseQuery(GpuQuery* query) {
+	if (query)
+		((ID3D11Query*)query)->Release();
+}
+
+void D3D11RenderDevice::beginQuery(GpuQuery* query) {
+	deviceContext->Begin((ID3D11Query*)query);
+}
+
+void D3D11RenderDevice::endQuery(GpuQuery* query) {
+	deviceContext->End((ID3D11Query*)query);
+}
+
+bool D3D11RenderDevice::getQueryResult(GpuQuery* query, unsigned long long& out_samples) {
+	if (deferred) {
+		printf("Error: query results can't be read on a recorder.\n");
+		return false;
+	}
+	UINT64 samples;
+	if (deviceContext->GetData((ID3D11Query*)query, &samples, sizeof(samples), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) return false;
+	out_samples = samples;
+	return true;
+}
+
+void D3D11RenderDevice::setInputLayout(GpuLayout* layout) {
+	deviceContext->IASetInputLayout((ID3D11InputLayout*)layout);
+}
+
+void D3D11RenderDevice::setShader(int stage, GpuShader* shader) {
+	switch (stage) {
+	case STAGE_VS: deviceContext->VSSetShader((ID3D11VertexShader*)shader, NULL, 0); break;
+	case STAGE_HS: deviceContext->HSSetShader((ID3D11HullShader*)shader, NULL, 0); break;
+	case STAGE_DS: deviceContext->DSSetShader((ID3D11DomainShader*)shader, NULL, 0); break;
+	case STAGE_GS: deviceContext->GSSetShader((ID3D11GeometryShader*)shader, NULL, 0); break;
+	case STAGE_PS: deviceContext->PSSetShader((ID3D11PixelShader*)shader, NULL, 0); break;
+	case STAGE_CS: deviceContext->CSSetShader((ID3D11ComputeShader*)shader, NULL, 0); break;
+	}
+}
+
+void D3D11RenderDevice::setConstantBuffer(int stage, unsigned int slot, GpuBuffer* constants, unsigned int offset, unsigned int size) {
+	ID3D11Buffer* buffer = get(constants);
+	if (size == 0) {//whole buffer
+		switch (stage) {
+		case STAGE_VS: deviceContext->VSSetConstantBuffers(slot, 1, &buffer); break;
+		case STAGE_HS: deviceContext->HSSetConstantBuffers(slot, 1, &buffer); break;
+		case STAGE_DS: deviceContext->DSSetConstantBuffers(slot, 1, &buffer); break;
+		case STAGE_GS: deviceContext->GSSetConstantBuffers(slot, 1, &buffer); break;
+		case STAGE_PS: deviceContext->PSSetConstantBuffers(slot, 1, &buffer); break;
+		case STAGE_CS: deviceContext->CSSetConstantBuffers(slot, 1, &buffer); break;
+		}
+		return;
+	}
+
+	if (!deviceContext1) {
+		printf("Error: constant buffer offsets are not supported on this device.\n");
+		return;
+	}
+	//offset and size are counted in 16 byte constants
+	UINT firstConstant = offset / 16;
+	UINT numConstants = size / 16;
+	switch (stage) {
+	case STAGE_VS: deviceContext1->VSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	case STAGE_HS: deviceContext1->HSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	case STAGE_DS: deviceContext1->DSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	case STAGE_GS: deviceContext1->GSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	case STAGE_PS: deviceContext1->PSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	case STAGE_CS: deviceContext1->CSSetConstantBuffers1(slot, 1, &buffer, &firstConstant, &numConstants); break;
+	}
+}
+
+void D3D11RenderDevice::setShaderResources(int stage, unsigned int slot, unsigned int count, GpuView* const* handles) {
+	ID3D11ShaderResourceView* const* views = (ID3D11ShaderResourceView* const*)handles;
+	switch (stage) {
+	case STAGE_VS: deviceContext->VSSetShaderResources(slot, count, views); break;
+	case STAGE_HS: deviceContext->HSSetShaderResources(slot, count, views); break;
+	case STAGE_DS: deviceContext->DSSetShaderResources(slot, count, views); break;
+	case STAGE_GS: deviceContext->GSSetShaderResources(slot, count, views); break;
+	case STAGE_PS: deviceContext->PSSetShaderResources(slot, count, views); break;
+	case STAGE_CS: deviceContext->CSSetShaderResources(slot, count, views); break;
+	}
+}
+
+void D3D11RenderDevice::setSamplers(int stage, unsigned int slot, unsigned int count, GpuSampler* const* handles) {
+	ID3D11SamplerState* const* samplers = (ID3D11SamplerState* const*)handles;
+	switch (stage) {
+	case STAGE_VS: deviceContext->VSSetSamplers(slot, count, samplers); break;
+	case STAGE_HS: deviceContext->HSSetSamplers(slot, count, samplers); break;
+	case STAGE_DS: deviceContext->DSSetSamplers(slot, count, samplers); break;
+	case STAGE_GS: deviceContext->GSSetSamplers(slot, count, samplers); break;
+	case STAGE_PS: deviceContext->PSSetSamplers(slot, count, samplers); break;
+	case STAGE_CS: deviceContext->CSSetSamplers(slot, count, samplers); break;
+	}
+}
+
+void D3D11RenderDevice::setUnorderedViews(unsigned int slot, unsigned int count, GpuUnorderedView* const* views) {
+	deviceContext->CSSetUnorderedAccessViews(slot, count, (ID3D11UnorderedAccessView* const*)views, nullptr);
+}
+
+GpuDepthState* D3D11RenderDevice::createDepthState(int test, bool write) {
+	D3D11_DEPTH_STENCIL_DESC desc;
+	ZeroMemory(&desc, sizeof(desc));
+	desc.DepthEnable = TRUE;
+	desc.DepthWriteMask = write ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	desc.DepthFunc = (D3D11_COMPARISON_FUNC)test;
+	desc.StencilEnable = FALSE;
+	ID3D11DepthStencilState* state = nullptr;
+	if (device->CreateDepthStencilState(&desc, &state) != S_OK) {
+		printf("Error: could not create depth state.\n");
+		return nullptr;
+	}
+	return (GpuDepthState*)state;
+}
+
+void D3D11RenderDevice::releaseDepthState(GpuDepthState* state) {
+	if (state)
+		((ID3D11DepthStencilState*)state)->Release();
+}
+
+void D3D11RenderDevice::setDepthState(GpuDepthState* state) {
+	deviceContext->OMSetDepthStencilState((ID3D11DepthStencilState*)state, 0);
+}
+
+void D3D11RenderDevice::setVertexBuffer(GpuBuffer* buffer, unsigned int stride, unsigned int offset, unsigned int slot) {
+	ID3D11Buffer* vertexBuffer = get(buffer);
+	deviceContext->IASetVertexBuffers(slot, 1, &vertexBuffer, &stride, &offset);
+}
+
+void D3D11RenderDevice::setIndexBuffer(GpuBuffer* buffer) {
+	deviceContext->IASetIndexBuffer(get(buffer), DXGI_FORMAT_R32_UINT, 0);
+}
+
+void D3D11RenderDevice::setTopology(int topology) {
+	deviceContext->IASetPrimitiveTopology((D3D11_PRIMITIVE_TOPOLOGY)topology);
+}
+
+void D3D11RenderDevice::draw(unsigned int vertexCount, unsigned int startVertex) {
+	deviceContext->Draw(vertexCount, startVertex);
+}
+
+void D3D11RenderDevice::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) {
+	deviceContext->DrawIndexed(indexCount, startIndex, baseVertex);
+}
+
+void D3D11RenderDevice::drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) {
+	deviceContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+}
+
+void D3D11RenderDevice::drawIndexedIndirect(GpuBuffer* args, unsigned int offset) {
+	deviceContext->DrawIndexedInstancedIndirect(get(args), offset);
+}
+
+void D3D11RenderDevice::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ) {
+	deviceContext->Dispatch(groupsX, groupsY, groupsZ);
+}
+
+void D3D11RenderDevice::setRenderTarget(GpuTarget* target, GpuDepthTarget* depth, const Viewport& viewport) {
+	ID3D11RenderTargetView* rtv = get(target);
+	deviceContext->OMSetRenderTargets(1, &rtv, get(depth));
+	deviceContext->RSSetViewports(1, (const D3D11_VIEWPORT*)&viewport);
+}
+
+void D3D11RenderDevice::clear(GpuTarget* target, const float colour[4], GpuDepthTarget* depth) {
+	deviceContext->ClearRenderTargetView(get(target), colour);
+	if (depth)
+		deviceContext->ClearDepthStencilView(get(depth), D3D11_CLEAR_DEPTH, 1.0f, 0);
+}
+
+RenderDevice* D3D11RenderDevice::createRecorder() {
+	if (deferred) {
+		printf("Error: recorders can't make recorders of their own.\n");
+		return nullptr;
+	}
+	int recorderSlot = nextSlot();
+	if (recorderSlot < 0) {
+		printf("Error: no more than %d recorders per device.\n", MAX_RENDER_DEVICES - 1);
+		return nullptr;
+	}
+	ID3D11DeviceContext* deferredContext = nullptr;
+	if (device->CreateDeferredContext(0, &deferredContext) != S_OK) {
+		printf("Error: could not create deferred context.\n");
+		return nullptr;
+	}
+	return new D3D11RenderDevice(device, deferredContext, recorderSlot);
+}
+
+GpuCommandList* D3D11RenderDevice::finishRecording() {
+	if (!deferred) {
+		printf("Error: only recorders can finish a command list.\n");
+		return nullptr;
+	}
+	ID3D11CommandList* list = nullptr;
+	if (deviceContext->FinishCommandList(FALSE, &list) != S_OK) {
+		printf("Error: could not finish command list.\n");
+		return nullptr;
+	}
+	return (GpuCommandList*)list;
+}
+
+void D3D11RenderDevice::execute(GpuCommandList* list) {
+	if (!list) return;
+	ID3D11CommandList* commands = (ID3D11CommandList*)list;
+	deviceContext->ExecuteCommandList(commands, TRUE);//keep whatever DXFramework had bound here
+	commands->Release();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/// RenderDevice that forwards everything to an immediate D3D11 context, or, for its recorders, to a deferred one.
+/// Every handle it gives out is the D3D11 object itself, cast; shaders are whichever ID3D11*Shader their stage needs.
+
+#include "RenderDevice.h"
+#include <d3d11_1.h>
+
+class D3D11RenderDevice : public RenderDevice {
+
+public:
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deviceContext);
+	///a recorder, with its own deferred context (released along with it)
+	D3D11RenderDevice(ID3D11Device* device, ID3D11DeviceContext* deferredContext, int slot);
+	~D3D11RenderDevice();
+
+	GpuBuffer* createBuffer(unsigned int size, int type) override;
+	GpuBuffer* createStaticBuffer(unsigned int size, int type, const void* data) override;
+	void releaseBuffer(GpuBuffer* buffer) override;
+	void* map(GpuBuffer* buffer, bool noOverwrite) override;
+	void unmap(GpuBuffer* buffer) override;
+	void copyBuffer(GpuBuffer* destination, unsigned int destinationOffset, GpuBuffer* source, unsigned int sourceOffset, unsigned int size) override;
+	bool readBuffer(GpuBuffer* buffer, std::vector<unsigned char>& out_bytes) override;
+	GpuBuffer* createShaderBuffer(unsigned int count, unsigned int stride, int format, GpuView** out_view) override;
+	void releaseView(GpuView* view) override;
+	GpuBuffer* createIndirectBuffer(unsigned int count, const unsigned int* initial, GpuUnorderedView** out_view) override;
+	void releaseView(GpuUnorderedView* view) override;
+	inline bool supportsConstantOffsets() override { return constantOffsets; }
+
+	GpuView* createTexture(unsigned int width, unsigned int height, const unsigned char* pixels, bool mips) override;
+
+	GpuShader* createShader(int stage, const void* bytecode, size_t size) override;
+	void releaseShader(GpuShader* shader) override;
+	GpuLayout* createLayout(const VertexElement* elements, unsigned int count, const void* bytecode, size_t size) override;
+	void releaseLayout(GpuLayout* layout) override;
+	GpuSampler* createSampler(int filter, int address, int comparison = COMPARE_ALWAYS) override;
+	void releaseSampler(GpuSampler* sampler) override;
+
+	GpuQuery* createFence() override;
+	void releaseFence(GpuQuery* fence) override;
+	void signalFence(GpuQuery* fence) override;
+	///waiting polls with a back-off rather than spinning, since D3D11 has no blocking wait on a query
+	bool fenceReached(GpuQuery* fence, bool wait) override;
+
+	GpuQuery* createOcclusionQuery() override;
+	void releaseQuery(GpuQuery* query) override;
+	void beginQuery(GpuQuery* query) override;
+	void endQuery(GpuQuery* query) override;
+	bool getQueryResult(GpuQuery* query, unsigned long long& out_samples) override;
+
+	void setInputLayout(GpuLayout* layout) override;
+	void setShader(int stage, GpuShader* shader) override;
+	void setConstantBuffer(int stage, unsigned int slot, GpuBuffer* buffer, unsigned int offset = 0, unsigned int size = 0) override;
+	void setShaderResources(int stage, unsigned int slot, unsigned int count, GpuView* const* views) override;
+	void setSamplers(int stage, unsigned int slot, unsigned int count, GpuSampler* const* samplers) override;
+	void setUnorderedViews(unsigned int slot, unsigned int count, GpuUnorderedView* const* views) override;
+	GpuDepthState* createDepthState(int test, bool write) override;
+	void releaseDepthState(GpuDepthState* state) override;
+	void setDepthState(GpuDepthState* state) override;
+
+	void setVertexBuffer(GpuBuffer* buffer, unsigned int stride, unsigned int offset = 0, unsigned int slot = 0) override;
+	void setIndexBuffer(GpuBuffer* buffer) override;
+	void setTopology(int topology) override;
+
+	void draw(unsigned int vertexCount, unsigned int startVertex = 0) override;
+	void drawIndexed(unsigned int indexCount, unsigned int startIndex = 0, int baseVertex = 0) override;
+	void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex = 0, int baseVertex = 0, unsigned int startInstance = 0) override;
+	void drawIndexedIndirect(GpuBuffer* args, unsigned int offset) override;
+	void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1) override;
+
+	void setRenderTarget(GpuTarget* target, GpuDepthTarget* depth, const Viewport& viewport) override;
+	void clear(GpuTarget* target, const float colour[4], GpuDepthTarget* depth) override;
+
+	RenderDevice* createRecorder() override;
+	GpuCommandList* finishRecording() override;
+	void execute(GpuCommandList* list) override;
+	inline bool isRecorder() override { return deferred; }
+
+	///handles are the D3D11 objects themselves; these go back and forth, for what still gets made outside a device (DXFramework's meshes and render
+	///textures, RenderTarget's and HiZPyramid's textures) and for the few calls that have no RenderDevice equivalent
+	static inline GpuBuffer* handle(ID3D11Buffer* buffer) { return (GpuBuffer*)buffer; }
+	static inline GpuView* handle(ID3D11ShaderResourceView* view) { return (GpuView*)view; }
+	static inline GpuUnorderedView* handle(ID3D11UnorderedAccessView* view) { return (GpuUnorderedView*)view; }
+	static inline GpuTarget* handle(ID3D11RenderTargetView* view) { return (GpuTarget*)view; }
+	static inline GpuDepthTarget* handle(ID3D11DepthStencilView* view) { return (GpuDepthTarget*)view; }
+	static inline ID3D11Buffer* get(GpuBuffer* buffer) { return (ID3D11Buffer*)buffer; }
+	static inline ID3D11ShaderResourceView* get(GpuView* view) { return (ID3D11ShaderResourceView*)view; }
+	static inline ID3D11UnorderedAccessView* get(GpuUnorderedView* view) { return (ID3D11UnorderedAccessView*)view; }
+	static inline ID3D11RenderTargetView* get(GpuTarget* target) { return (ID3D11RenderTargetView*)target; }
+	static inline ID3D11DepthStencilView* get(GpuDepthTarget* depth) { return (ID3D11DepthStencilView*)depth; }
+
+	///for the DXFramework calls that still want a context; on a recorder, this is its deferred context
+	inline ID3D11DeviceContext* getContext() { return deviceContext; }
+
+protected:
+	ID3D11Device* device;
+	ID3D11DeviceContext* deviceContext;
+	ID3D11DeviceContext1* deviceContext1 = nullptr;//only needed for constants at an offset
+	bool constantOffsets = false;
+	bool deferred = false;
+
+	///checks what the context can do with constant buffers
+	void queryOptions();
+
+};
@@ -0,0 +1,190 @@
+#include "DebugDraw.h"
+
+#include "AppGlobals.h"
+#include "TransientBuffer.h"
+
+#define SPHERE_SEGMENTS 16 //per circle
+
+DebugDraw::DebugDraw() {
+	lineShader = new DebugShader;
+	quadShader = new PPTextureShader;
+	lineFallback = createFallback(chunkSize(sizeof(LineVertex), 2) * sizeof(LineVertex));
+	quadFallback = createFallback(chunkSize(sizeof(QuadVertex), 6) * sizeof(QuadVertex));
+}
+
+DebugDraw::~DebugDraw() {
+	if (lineShader)
+		delete lineShader;
+	if (quadShader)
+		delete quadShader;
+	GLOBALS.Backend->releaseBuffer(lineFallback);
+	GLOBALS.Backend->releaseBuffer(quadFallback);
+}
+
+GpuBuffer* DebugDraw::createFallback(unsigned int size) {
+	GpuBuffer* buffer = GLOBALS.Backend->createBuffer(size, BUFFER_VERTEX);
+	if (!buffer)
+		printf("Error: could not create %u byte debug vertex buffer.\n", size);
+	return buffer;
+}
+
+unsigned int DebugDraw::chunkSize(unsigned int stride, unsigned int verticesPerPrimitive) {
+	unsigned int vertices = GLOBALS.TransientVertices->getAllocator().getPageSize() / stride;
+	return vertices / verticesPerPrimitive * verticesPerPrimitive;
+}
+
+void DebugDraw::line(const XMFLOAT3& from, const XMFLOAT3& to, const XMFLOAT4& colour) {
+	LineVertex vertex;
+	vertex.colour = colour;
+	vertex.position = from;
+	lines.push_back(vertex);
+	vertex.position = to;
+	lines.push_back(vertex);
+}
+
+void DebugDraw::box(const BoundingBox& box, const XMFLOAT4& colour) {
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	this->box(corners, colour);
+}
+
+void DebugDraw::box(const XMFLOAT3* corners, const XMFLOAT4& colour) {
+	for (int i = 0; i < 4; ++i) {
+		line(corners[i], corners[(i + 1) % 4], colour);//first face
+		line(corners[4 + i], corners[4 + (i + 1) % 4], colour);//opposite face
+		line(corners[i], corners[4 + i], colour);//in between
+	}
+}
+
+void DebugDraw::frustum(const XMMATRIX& viewProjection, const XMFLOAT4& colour) {
+	//clip space box, near face first
+	static const XMFLOAT3 clipCorners[8] = {
+		XMFLOAT3(-1, -1, 0), XMFLOAT3(1, -1, 0), XMFLOAT3(1, 1, 0), XMFLOAT3(-1, 1, 0),
+		XMFLOAT3(-1, -1, 1), XMFLOAT3(1, -1, 1), XMFLOAT3(1, 1, 1), XMFLOAT3(-1, 1, 1)
+	};
+	XMMATRIX inverse = XMMatrixInverse(nullptr, viewProjection);
+	XMFLOAT3 corners[8];
+	XMVector3TransformCoordStream(corners, sizeof(XMFLOAT3), clipCorners, sizeof(XMFLOAT3), 8, inverse);
+	box(corners, colour);
+}
+
+void DebugDraw::sphere(const XMFLOAT3& centre, float radius, const XMFLOAT4& colour) {
+	for (int i = 0; i < SPHERE_SEGMENTS; ++i) {
+		float a0 = XM_2PI * i / SPHERE_SEGMENTS;
+		float a1 = XM_2PI * (i + 1) / SPHERE_SEGMENTS;
+		float c0 = cosf(a0) * radius, s0 = sinf(a0) * radius;
+		float c1 = cosf(a1) * radius, s1 = sinf(a1) * radius;
+		line(XMFLOAT3(centre.x + c0, centre.y + s0, centre.z), XMFLOAT3(centre.x + c1, centre.y + s1, centre.z), colour);
+		line(XMFLOAT3(centre.x + c0, centre.y, centre.z + s0), XMFLOAT3(centre.x + c1, centre.y, centre.z + s1), colour);
+		line(XMFLOAT3(centre.x, centre.y + c0, centre.z + s0), XMFLOAT3(centre.x, centre.y + c1, centre.z + s1), colour);
+	}
+}
+
+void DebugDraw::quad(float x, float y, float width, float height, GpuView* texture) {
+	//ortho space has its origin in the middle of the screen, y up
+	float left = x - GLOBALS.ScreenWidth / 2.0f;
+	float right = left + width;
+	float top = GLOBALS.ScreenHeight / 2.0f - y;
+	float bottom = top - height;
+
+	QuadVertex corners[4];
+	corners[0] = { XMFLOAT3(left, top, 0), XMFLOAT2(0, 0), XMFLOAT3(0, 0, -1) };
+	corners[1] = { XMFLOAT3(right, top, 0), XMFLOAT2(1, 0), XMFLOAT3(0, 0, -1) };
+	corners[2] = { XMFLOAT3(left, bottom, 0), XMFLOAT2(0, 1), XMFLOAT3(0, 0, -1) };
+	corners[3] = { XMFLOAT3(right, bottom, 0), XMFLOAT2(1, 1), XMFLOAT3(0, 0, -1) };
+	const int order[6] = { 0, 1, 2, 2, 1, 3 };//clockwise
+	for (int i : order)
+		quadVertices.push_back(corners[i]);
+	quadTextures.push_back(texture);
+}
+
+void DebugDraw::clusters(LightClusterBuilder& builder, const XMMATRIX& view, const XMMATRIX& projection) {
+	const std::vector<XMUINT2>& clusterRanges = builder.getClusters();
+	unsigned int maxLights = builder.getMaxLightsPerCluster();
+	if (clusterRanges.empty() || maxLights == 0) return;
+
+	int tilesX = builder.getTilesX(), tilesY = builder.getTilesY(), slices = builder.getSlices();
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&proj, projection);
+	float tanHalfX = 1.0f / proj._11;
+	float tanHalfY = 1.0f / proj._22;
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+
+	for (int z = 0; z < slices; ++z) {
+		//same slicing as LightClusterBuilder: slice = log(depth) * scale + bias
+		float nearDepth = expf((z - builder.getSliceBias()) / builder.getSliceScale());
+		float farDepth = expf((z + 1 - builder.getSliceBias()) / builder.getSliceScale());
+		for (int y = 0; y < tilesY; ++y) {
+			for (int x = 0; x < tilesX; ++x) {
+				unsigned int count = clusterRanges[(z * tilesY + y) * tilesX + x].y;
+				if (count == 0) continue;
+
+				float x0 = (-1 + 2.0f * x / tilesX) * tanHalfX, x1 = (-1 + 2.0f * (x + 1) / tilesX) * tanHalfX;
+				float y0 = (1 - 2.0f * (y + 1) / tilesY) * tanHalfY, y1 = (1 - 2.0f * y / tilesY) * tanHalfY;//rows go top to bottom
+				XMFLOAT3 corners[8] = {
+					XMFLOAT3(x0 * nearDepth, y0 * nearDepth, nearDepth), XMFLOAT3(x1 * nearDepth, y0 * nearDepth, nearDepth),
+					XMFLOAT3(x1 * nearDepth, y1 * nearDepth, nearDepth), XMFLOAT3(x0 * nearDepth, y1 * nearDepth, nearDepth),
+					XMFLOAT3(x0 * farDepth, y0 * farDepth, farDepth), XMFLOAT3(x1 * farDepth, y0 * farDepth, farDepth),
+					XMFLOAT3(x1 * farDepth, y1 * farDepth, farDepth), XMFLOAT3(x0 * farDepth, y1 * farDepth, farDepth)
+				};
+				XMVector3TransformCoordStream(corners, sizeof(XMFLOAT3), corners, sizeof(XMFLOAT3), 8, inverseView);
+
+				float heat = maxLights > 1 ? float(count - 1) / (maxLights - 1) : 0;
+				box(corners, XMFLOAT4(heat, 1 - heat, 0, 1));
+			}
+		}
+	}
+}
+
+void DebugDraw::flush(RenderDevice* device, const XMMATRIX& view, const XMMATRIX& projection) {
+	lastLineCount = (unsigned int)lines.size() / 2;
+	lastDrawCount = 0;
+	if (lines.empty()) return;
+
+	lineShader->setShaderParameters(device, XMMatrixIdentity(), view, projection, XMFLOAT3(0, 0, 0));
+	device->setTopology(TOPOLOGY_LINELIST);
+
+	unsigned int perChunk = chunkSize(sizeof(LineVertex), 2);
+	for (unsigned int first = 0; first < lines.size(); first += perChunk) {
+		unsigned int count = (std::min)(perChunk, (unsigned int)lines.size() - first);
+		void* data = device->getTransientVertices()->map(device, count * sizeof(LineVertex), lineFallback);
+		if (!data) break;
+		memcpy(data, &lines[first], count * sizeof(LineVertex));
+		device->getTransientVertices()->unmapVertices(device, sizeof(LineVertex));
+		lineShader->renderUnindexed(device, count);
+		++lastDrawCount;
+	}
+
+	lines.clear();
+}
+
+void DebugDraw::flushOverlay(RenderDevice* device, const XMMATRIX& orthoView, const XMMATRIX& ortho) {
+	if (quadTextures.empty()) return;
+
+	quadShader->setShaderParameters(device, XMMatrixIdentity(), orthoView, ortho, XMFLOAT3(0, 0, 0));
+	device->setTopology(TOPOLOGY_TRIANGLELIST);
+
+	unsigned int perChunk = chunkSize(sizeof(QuadVertex), 6) / 6;//in quads
+	unsigned int numQuads = (unsigned int)quadTextures.size();
+	for (unsigned int first = 0; first < numQuads; first += perChunk) {
+		unsigned int count = (std::min)(perChunk, numQuads - first);
+		void* data = device->getTransientVertices()->map(device, count * 6 * sizeof(QuadVertex), quadFallback);
+		if (!data) break;
+		memcpy(data, &quadVertices[first * 6], count * 6 * sizeof(QuadVertex));
+		device->getTransientVertices()->unmapVertices(device, sizeof(QuadVertex));
+
+		//one draw per run of quads sharing a texture
+		unsigned int run = first;
+		while (run < first + count) {
+			unsigned int end = run + 1;
+			while (end < first + count && quadTextures[end] == quadTextures[run]) ++end;
+			quadShader->setTextureData(device, quadTextures[run]);
+			quadShader->renderUnindexed(device, (end - run) * 6, (run - first) * 6);
+			++lastDrawCount;
+			run = end;
+		}
+	}
+
+	quadVertices.clear();
+	quadTextures.clear();
+}
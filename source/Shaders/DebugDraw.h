@@ -0,0 +1,72 @@
+#pragma once
+
+/// Immediate mode debug drawing: anything can add lines, boxes, spheres or screen space textured quads during the frame,
+/// they pile up on the cpu and get written to the transient vertex buffer in one go when flushed, with one draw per primitive type
+/// (more only if there are more vertices than fit in a transient page, or for quads with different textures).
+
+#include "DXF.h"
+#include <DirectXCollision.h>
+#include <vector>
+#include "DebugShader.h"
+#include "PPTextureShader.h"
+#include "LightClusterBuilder.h"
+
+class DebugDraw {
+
+protected:
+	struct LineVertex {
+		XMFLOAT3 position;
+		XMFLOAT4 colour;
+	};
+
+	///same layout as BaseMesh::VertexType, which the post processing shaders expect
+	struct QuadVertex {
+		XMFLOAT3 position;
+		XMFLOAT2 texture;
+		XMFLOAT3 normal;
+	};
+
+public:
+	DebugDraw();
+	~DebugDraw();
+
+	void line(const XMFLOAT3& from, const XMFLOAT3& to, const XMFLOAT4& colour);
+	void box(const BoundingBox& box, const XMFLOAT4& colour);
+	///any hexahedron, corners ordered as BoundingBox::GetCorners() or BoundingFrustum::GetCorners() (one face, then the opposite one in the same order)
+	void box(const XMFLOAT3* corners, const XMFLOAT4& colour);
+	///whatever a view and projection pair can see
+	void frustum(const XMMATRIX& viewProjection, const XMFLOAT4& colour);
+	///three circles around the centre
+	void sphere(const XMFLOAT3& centre, float radius, const XMFLOAT4& colour);
+	///textured quad on top of everything else, in pixels from the top left of the screen
+	void quad(float x, float y, float width, float height, GpuView* texture);
+	///outlines every cluster the builder put lights in, from green (one light) to red (the most lights)
+	void clusters(LightClusterBuilder& builder, const XMMATRIX& view, const XMMATRIX& projection);
+
+	///draws and forgets every line added since the last flush
+	void flush(RenderDevice* device, const XMMATRIX& view, const XMMATRIX& projection);
+	///draws and forgets every quad added since the last flushOverlay
+	void flushOverlay(RenderDevice* device, const XMMATRIX& orthoView, const XMMATRIX& ortho);
+
+	inline unsigned int getLastLineCount() { return lastLineCount; }
+	inline unsigned int getLastDrawCount() { return lastDrawCount; }
+
+protected:
+	DebugShader* lineShader = nullptr;
+	PPTextureShader* quadShader = nullptr;
+	std::vector<LineVertex> lines;
+	std::vector<QuadVertex> quadVertices;//6 per quad
+	std::vector<GpuView*> quadTextures;
+
+	//only used if the transient buffer can't take the vertices
+	GpuBuffer* lineFallback = nullptr;
+	GpuBuffer* quadFallback = nullptr;
+
+	unsigned int lastLineCount = 0;
+	unsigned int lastDrawCount = 0;
+
+	///how many vertices fit in one transient page, rounded down to whole primitives
+	unsigned int chunkSize(unsigned int stride, unsigned int verticesPerPrimitive);
+	GpuBuffer* createFallback(unsigned int size);
+
+};
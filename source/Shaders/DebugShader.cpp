@@ -0,0 +1,10 @@
+#include "DebugShader.h"
+
+
+
+DebugShader::DebugShader() {
+	SETUP_SHADER_COLOUR(debug_vs, color_fs);
+}
+
+DebugShader::~DebugShader(){
+}
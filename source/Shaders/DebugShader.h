@@ -0,0 +1,12 @@
+#pragma once
+#include "Shader.h"
+
+///Flat coloured lines for DebugDraw; vertices are a position and a colour
+class DebugShader : public Shader{
+public:
+	DebugShader();
+	~DebugShader();
+
+protected:
+	inline void initBuffers() override {}
+};
@@ -3,7 +3,7 @@
 
 
 DepthShader::DepthShader(){
-	SETUP_SHADER(depth_vs, depth_fs);
+	SETUP_SHADER_POSITION(depth_vs, depth_fs);
 }
 
 
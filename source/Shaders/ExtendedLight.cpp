@@ -1,53 +1,125 @@
 #include "ExtendedLight.h"
 
 #include "AppGlobals.h"
-#include "PostProcessingPass.h"
-#include "PPTextureShader.h"
+#include "RenderTargetPool.h"
+#include "GaussianBlurShader.h"
 #include "Utils.h"
 
+#define FIT_MARGIN 1.05f //extra room around fitted frustums, so displacement and filtering don't fall off the edges
+#define FIT_MAX_FOV 175.f //perspective frustums degenerate past this
+#define FIT_ORTHO_SNAP 1.f //ortho bounds get snapped to this many world units to keep directional shadows from swimming around when the camera moves
+
 ExtendedLight::ExtendedLight() {
 }
 
 ExtendedLight::~ExtendedLight() {
-	if (shadowsSetup) {
-		delete texShader;
-		delete depthPass;
+	if (shadowTarget && GLOBALS.TargetPool)
+		GLOBALS.TargetPool->release(shadowTarget);
+}
+
+void ExtendedLight::createShadowTargets() {
+	if (shadowTarget)
+		GLOBALS.TargetPool->release(shadowTarget);
+	shadowMap = nullptr;
+	if (shadowFilter == SHADOWMAP_VSM) {
+		shadowTarget = GLOBALS.TargetPool->acquire(shadowMapRes, shadowMapRes, DXGI_FORMAT_R32G32_FLOAT, true, true);
+	}
+	else {
+		shadowTarget = GLOBALS.TargetPool->acquire(shadowMapRes, shadowMapRes, DXGI_FORMAT_R32_FLOAT);
 	}
 }
 
 ///Prepares this light for shadow mapping
 void ExtendedLight::setupShadows() {
-	if (shadowsSetup) {
-		delete texShader;
-		delete depthPass;
-	}
-	texShader = new PPTextureShader;
-	depthPass = new PostProcessingPass;
-	depthPass->Setup(GLOBALS.Device, GLOBALS.DeviceContext, shadowMapRes, shadowMapRes, texShader);
+	createShadowTargets();
 	setShadowmapSize(shadowmapWorldSize);//generate projection or ortho matrix
+	shadowmapView = getView();
+	shadowmapProjection = getProjection();
 	shadowsSetup = true;
 }
 
 ///We're assuming the ortho/projection matrix has been generated on this light!
-bool ExtendedLight::StartRecordingShadowmap() {
+bool ExtendedLight::PrepareShadowmap() {
 	if (shouldBypassShadows()) return false;//cannot have shadowmaps for point lights or spotlights yet
 
 	generateViewMatrix();
-	depthPass->Begin(GLOBALS.Renderer, GLOBALS.DeviceContext, XMFLOAT3(0,0,0));
-
+	shadowmapView = getView();
+	shadowmapProjection = getProjection();
+	shadowmapFar = getShadowFar();
 	return true;
 }
 
-ID3D11ShaderResourceView* ExtendedLight::StopRecordingShadowmap() {
+void ExtendedLight::StartRecordingShadowmap(RenderDevice* device) {
+	shadowTarget->setRenderTarget(device);
+	if (shadowFilter == SHADOWMAP_VSM)
+		shadowTarget->clear(device, 1, 1, 0, 1);//moments store distance rather than 1-distance, so empty is 1
+	else
+		shadowTarget->clear(device, 0, 0, 0, 1);
+}
+
+GpuView* ExtendedLight::StopRecordingShadowmap() {
 	if (shouldBypassShadows()) return nullptr;
 
-	depthPass->End();
+	GLOBALS.Renderer->setBackBufferRenderTarget();
+	GLOBALS.Renderer->resetViewport();
 
-	shadowMap = depthPass->getRenderTexture()->getShaderResourceView();
+	shadowMap = shadowTarget->getShaderResourceView();
 
 	return shadowMap;
 }
 
+///Separable blur of the moments, back into the shadowmap itself, then mips so that lookups can use trilinear filtering
+void ExtendedLight::filterShadowmap(GaussianBlurShader* blur, OrthoMesh* quad, XMMATRIX orthoViewMatrix, RenderTarget* scratch) {
+	if (shouldBypassShadows() || shadowFilter != SHADOWMAP_VSM) return;
+
+	ID3D11DeviceContext* deviceContext = GLOBALS.DeviceContext;//for DXFramework's quad
+	RenderDevice* device = GLOBALS.Backend;
+	GpuView* nullView = nullptr;
+	GLOBALS.Renderer->setZBuffer(false);
+	quad->sendData(deviceContext);
+	blur->texelSize = XMFLOAT2(1.0f / shadowMapRes, 1.0f / shadowMapRes);
+
+	//horizontal, into the scratch target
+	scratch->setRenderTarget(device);
+	blur->horizontal = true;
+	blur->setBlur(device);
+	blur->setShaderParameters(device, GLOBALS.Renderer->getWorldMatrix(), orthoViewMatrix, GLOBALS.Renderer->getOrthoMatrix(), XMFLOAT3(0, 0, 0));
+	blur->setTextureData(device, shadowTarget->getShaderResourceView());
+	blur->render(deviceContext, quad->getIndexCount());
+	device->setShaderResources(STAGE_PS, 0, 1, &nullView);//so we can render to the shadowmap again
+
+	//vertical, back into the shadowmap
+	shadowTarget->setRenderTarget(device);
+	blur->horizontal = false;
+	blur->setBlur(device);
+	blur->setTextureData(device, scratch->getShaderResourceView());
+	blur->render(deviceContext, quad->getIndexCount());
+	device->setShaderResources(STAGE_PS, 0, 1, &nullView);
+
+	GLOBALS.Renderer->setBackBufferRenderTarget();
+	GLOBALS.Renderer->resetViewport();
+	GLOBALS.Renderer->setZBuffer(true);
+	blur->texelSize = XMFLOAT2(0, 0);
+
+	shadowTarget->generateMips(deviceContext);
+}
+
+void ExtendedLight::getShadowTexelSize(float& out_perspective, float& out_orthographic) {
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&proj, shadowmapProjection);
+	float texel = 2.0f / (proj._11 * shadowMapRes);//width covered at distance 1 (perspective) or at any distance (orthographic), over the resolution
+	bool perspective = proj._34 != 0;
+	out_perspective = perspective ? texel : 0;
+	out_orthographic = perspective ? 0 : texel;
+}
+
+void ExtendedLight::setShadowFilter(int filter) {
+	if (filter == shadowFilter) return;
+	shadowFilter = filter;
+	if (!shouldBypassShadows())
+		createShadowTargets();
+}
+
 void ExtendedLight::updateFov(float fov){
 	projectionFov = fov;
 	projection = Utils::changeFov(getProjectionMatrix(), projectionFov);
@@ -56,7 +128,7 @@ void ExtendedLight::updateFov(float fov){
 void ExtendedLight::setShadowmapRes(int res) {
 	shadowMapRes = res;
 	if (shouldBypassShadows()) return;
-	depthPass->setSize(res, res);
+	createShadowTargets();//can't resize textures; the old one goes back to the pool, which frees it once idle targets take up too much
 }
 
 void ExtendedLight::setShadowmapSize(float sz) {
@@ -68,3 +140,116 @@ void ExtendedLight::setShadowmapSize(float sz) {
 		updateFov(projectionFov);
 	}
 }
+
+///Builds the world space volume covered by the user-defined (unfitted) frustum, from the view matrix the light currently holds
+void ExtendedLight::getMaxVolume(BoundingFrustum& out_frustum, BoundingOrientedBox& out_box) {
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, getViewMatrix());
+	if (type == DIRECTIONAL_LIGHT) {
+		BoundingOrientedBox(XMFLOAT3(0, 0, 500.05f), XMFLOAT3(shadowmapWorldSize / 2, shadowmapWorldSize / 2, 499.95f), XMFLOAT4(0, 0, 0, 1)).Transform(out_box, inverseView);
+	}
+	else {
+		float fov = Utils::clamp(projectionFov, 1, FIT_MAX_FOV);
+		BoundingFrustum(XMMatrixPerspectiveFovLH(Utils::degToRad(fov), 1, 0.1f, 1000.f)).Transform(out_frustum, inverseView);
+	}
+}
+
+bool ExtendedLight::affects(const BoundingBox& box) {
+	if (shouldBypassShadows() || type == INACTIVE_LIGHT) return false;
+	BoundingFrustum frustum;
+	BoundingOrientedBox orthoBox;
+	getMaxVolume(frustum, orthoBox);
+	return type == DIRECTIONAL_LIGHT ? orthoBox.Intersects(box) : frustum.Intersects(box);
+}
+
+float ExtendedLight::getShadowFar() {
+	return fitted ? shadowFar : GLOBALS.FarPlane;
+}
+
+///Fits the shadow projection to what's actually going to be visible this frame
+bool ExtendedLight::fitShadowFrustum(const std::vector<BoundingBox>& casters, const std::vector<BoundingBox>& receivers) {
+	if (shouldBypassShadows()) return false;
+
+	generateViewMatrix();
+	XMMATRIX view = getViewMatrix();
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+	bool ortho = type == DIRECTIONAL_LIGHT;
+
+	//largest volume this light can cover (what it'd use without fitting), in world space
+	float maxFov = Utils::clamp(projectionFov, 1, FIT_MAX_FOV);
+	BoundingFrustum maxFrustum;
+	BoundingOrientedBox maxBox;
+	getMaxVolume(maxFrustum, maxBox);
+
+	//Receivers: find how wide the frustum needs to be and how far it needs to reach
+	float maxTan = 0, maxDist = 0;
+	XMFLOAT2 minXY(FLT_MAX, FLT_MAX), maxXY(-FLT_MAX, -FLT_MAX);
+	bool straddles = false;//true if a receiver goes behind the light, in which case we need the widest fov anyways
+	bool anyReceiver = false;
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	for (const BoundingBox& box : receivers) {
+		if (ortho ? !maxBox.Intersects(box) : !maxFrustum.Intersects(box)) continue;
+		anyReceiver = true;
+		box.GetCorners(corners);
+		for (int c = 0; c < BoundingBox::CORNER_COUNT; ++c) {
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMLoadFloat3(&corners[c]), view));
+			maxDist = fmaxf(maxDist, sqrtf(p.x * p.x + p.y * p.y + p.z * p.z));
+			if (ortho) {
+				minXY = XMFLOAT2(fminf(minXY.x, p.x), fminf(minXY.y, p.y));
+				maxXY = XMFLOAT2(fmaxf(maxXY.x, p.x), fmaxf(maxXY.y, p.y));
+			}
+			else if (p.z <= 0.1f) straddles = true;
+			else maxTan = fmaxf(maxTan, fmaxf(fabsf(p.x), fabsf(p.y)) / p.z);
+		}
+	}
+	if (!anyReceiver) return false;//nothing visible can be lit by this light
+
+	//depths are stored as radial distance from the light, so far needs to cover the furthest corner rather than the furthest z
+	float farPlane = Utils::clamp(maxDist * FIT_MARGIN, 1, 1000);
+
+	//Width of the frustum
+	float fov = maxFov;
+	if (ortho) {
+		float half = shadowmapWorldSize / 2;
+		minXY = XMFLOAT2(floorf(Utils::clamp(minXY.x, -half, half) / FIT_ORTHO_SNAP) * FIT_ORTHO_SNAP, floorf(Utils::clamp(minXY.y, -half, half) / FIT_ORTHO_SNAP) * FIT_ORTHO_SNAP);
+		maxXY = XMFLOAT2(ceilf(Utils::clamp(maxXY.x, -half, half) / FIT_ORTHO_SNAP) * FIT_ORTHO_SNAP, ceilf(Utils::clamp(maxXY.y, -half, half) / FIT_ORTHO_SNAP) * FIT_ORTHO_SNAP);
+		if (maxXY.x - minXY.x < FIT_ORTHO_SNAP) maxXY.x = minXY.x + FIT_ORTHO_SNAP;
+		if (maxXY.y - minXY.y < FIT_ORTHO_SNAP) maxXY.y = minXY.y + FIT_ORTHO_SNAP;
+	}
+	else if (!straddles) {
+		fov = Utils::clamp(Utils::radToDeg(2 * atanf(maxTan)) * FIT_MARGIN, 1, maxFov);
+	}
+
+	//Casters: anything inside the fitted volume must lie beyond the near plane
+	BoundingFrustum fittedFrustum;
+	BoundingOrientedBox fittedBox;
+	if (ortho) {
+		BoundingOrientedBox(XMFLOAT3((minXY.x + maxXY.x) / 2, (minXY.y + maxXY.y) / 2, (0.1f + farPlane) / 2), XMFLOAT3((maxXY.x - minXY.x) / 2, (maxXY.y - minXY.y) / 2, (farPlane - 0.1f) / 2), XMFLOAT4(0, 0, 0, 1)).Transform(fittedBox, inverseView);
+	}
+	else {
+		BoundingFrustum(XMMatrixPerspectiveFovLH(Utils::degToRad(fov), 1, 0.1f, farPlane)).Transform(fittedFrustum, inverseView);
+	}
+	float nearPlane = farPlane;
+	for (const BoundingBox& box : casters) {
+		if (ortho ? !fittedBox.Intersects(box) : !fittedFrustum.Intersects(box)) continue;
+		box.GetCorners(corners);
+		for (int c = 0; c < BoundingBox::CORNER_COUNT; ++c) {
+			XMFLOAT3 p;
+			XMStoreFloat3(&p, XMVector3TransformCoord(XMLoadFloat3(&corners[c]), view));
+			nearPlane = fminf(nearPlane, p.z);
+		}
+	}
+	nearPlane = Utils::clamp(nearPlane / FIT_MARGIN, 0.1f, farPlane * 0.5f);
+
+	//Build the fitted projection
+	if (ortho)
+		fittedProjection = XMMatrixOrthographicOffCenterLH(minXY.x, maxXY.x, minXY.y, maxXY.y, nearPlane, farPlane);
+	else
+		fittedProjection = XMMatrixPerspectiveFovLH(Utils::degToRad(fov), 1, nearPlane, farPlane);
+	shadowNear = nearPlane;
+	shadowFar = farPlane;
+	fittedFov = fov;
+	fitted = true;
+
+	return true;
+}
@@ -3,6 +3,9 @@
 /// Adds functionality to the Light class for light types, attenuation, shadow mapping, etc.
 
 #include "DXF.h"
+#include "RenderDevice.h"
+#include <DirectXCollision.h>
+#include <vector>
 
 #define INACTIVE_LIGHT 0
 #define POINT_LIGHT 1
@@ -11,8 +14,12 @@
 
 #define SHADOWMAP_RES 2048 //default shadowmap res
 
-extern class PPTextureShader;
-extern class PostProcessingPass;
+//shadow filtering modes; must match the shadowmap modes in default_fs
+#define SHADOWMAP_PCF 1 //depth only, filtered at lookup with comparison taps
+#define SHADOWMAP_VSM 2 //variance shadowmaps: depth moments, blurred once per light and mipmapped, then a single filtered fetch at lookup
+
+extern class RenderTarget;
+extern class GaussianBlurShader;
 
 class ExtendedLight : public Light {
 
@@ -21,15 +28,32 @@ protected:
 	float type = POINT_LIGHT;
 
 	//Shadow mapping:
-	PostProcessingPass* depthPass = nullptr;
-	PPTextureShader* texShader = nullptr;
+	RenderTarget* shadowTarget = nullptr;//single channel float for PCF (so we can use comparison samplers on it), two channels with mips for VSM
+	int shadowFilter = SHADOWMAP_PCF;
 	bool shadowsSetup = false;
-	ID3D11ShaderResourceView* shadowMap = nullptr;
+	GpuView* shadowMap = nullptr;
 	float shadowmapWorldSize = 50;
 	float projectionFov = 60;
 	float shadowMapRes = SHADOWMAP_RES;
 	XMMATRIX projection;
 
+	//Shadow frustum fitting; when fitted, the projection/ortho matrix above is only used as an upper bound
+	bool fitted = false;
+	XMMATRIX fittedProjection;
+	float shadowNear = 0.1f;
+	float shadowFar = 1000.f;
+	float fittedFov = 60;
+
+	//what the shadowmap was last rendered with, set by PrepareShadowmap(); it has to be sampled with these until the next one, however the frustum moves in between
+	XMMATRIX shadowmapView, shadowmapProjection;
+	float shadowmapFar = 1000.f;
+
+	///world space volume covered by the user-defined shadow frustum
+	void getMaxVolume(BoundingFrustum& out_frustum, BoundingOrientedBox& out_box);
+
+	///(re)creates shadowmap render targets for the current resolution and filtering mode
+	void createShadowTargets();
+
 public:
 	ExtendedLight();
 	~ExtendedLight();
@@ -58,24 +82,57 @@ public:
 	///Sets up for shadowmap generation
 	void setupShadows();//call this once after creating the light
 
-	///returns whether a shadow map will be created for this light, and starts recording the map if true
-	bool StartRecordingShadowmap();
+	///returns whether a shadow map will be created for this light, and if so updates its view matrix and keeps the matrices it'll be rendered with; call on the main thread, before any pass is recorded
+	bool PrepareShadowmap();
 
-	///call after StartRecordingShadowmap(), once all geometry has been rendered to the shadowmap
-	ID3D11ShaderResourceView* StopRecordingShadowmap();
+	///binds and clears the shadowmap on device (which may be a recorder); call after PrepareShadowmap() returned true
+	void StartRecordingShadowmap(RenderDevice* device);
+
+	///call after StartRecordingShadowmap(), once all geometry has been rendered to the shadowmap (and executed, if it was recorded)
+	GpuView* StopRecordingShadowmap();
+
+	///VSM only, call after StopRecordingShadowmap(): blurs the moments (through an ortho quad covering the screen) and builds mips
+	///scratch holds the horizontally blurred moments; it must be a two channel float target of the shadowmap's resolution
+	void filterShadowmap(GaussianBlurShader* blur, OrthoMesh* quad, XMMATRIX orthoViewMatrix, RenderTarget* scratch);
+	inline RenderTarget* getShadowTarget() { return shadowTarget; }
+
+	///SHADOWMAP_PCF or SHADOWMAP_VSM
+	void setShadowFilter(int filter);
+	inline int getShadowFilter() { return shadowFilter; }
 
 	///use this to get projection/ortho matrix and view matrix from this light
-	inline XMMATRIX getProjection() { return type == DIRECTIONAL_LIGHT ? getOrthoMatrix() : projection; }//this projection matrix has had its fov changed
+	inline XMMATRIX getProjection() { return fitted ? fittedProjection : type == DIRECTIONAL_LIGHT ? getOrthoMatrix() : projection; }//this projection matrix has had its fov changed
 	inline XMMATRIX getView() { return getViewMatrix(); }
+	///the matrices and far plane the current shadowmap was rendered with, which is what to render and sample it with; lights that skip a frame keep theirs
+	inline XMMATRIX getShadowmapView() { return shadowmapView; }
+	inline XMMATRIX getShadowmapProjection() { return shadowmapProjection; }
+	inline float getShadowmapFar() { return shadowmapFar; }
 
 	void updateFov(float fov);
 
+	///Tightens the shadow frustum (near/far and fov, or ortho bounds for directional lights) around the receivers the camera can see and the casters that could shadow them.
+	///The frustum set up by the user is used as the largest allowed volume. Returns false if no visible receiver falls within that volume, in which case the shadowmap can be skipped.
+	bool fitShadowFrustum(const std::vector<BoundingBox>& casters, const std::vector<BoundingBox>& receivers);
+	///whether the box lies within the volume covered by this light's last shadowmap (as set up by the user, not fitted)
+	bool affects(const BoundingBox& box);
+	///goes back to the user-defined shadow frustum
+	inline void resetShadowFrustum() { fitted = false; }
+
+	///distance at which stored shadowmap depths reach 0; the camera's far plane until the frustum has been fitted
+	float getShadowFar();
+	inline float getShadowNear() { return fitted ? shadowNear : 0.1f; }
+	inline float getFittedFov() { return fitted ? fittedFov : projectionFov; }
+	///world size of a texel of the current shadowmap: out_perspective * distance from the light + out_orthographic (one of them is always 0)
+	void getShadowTexelSize(float& out_perspective, float& out_orthographic);
+
 	///Getters and setters for shadowmaps
 	inline float getShadowmapRes() { return shadowMapRes; }
 	void setShadowmapRes(int res);
 	inline float getShadowmapSize() { return shadowmapWorldSize; }
 	void setShadowmapSize(float sz);
-	inline ID3D11ShaderResourceView* getShadowmap() { return shadowMap; }
+	inline GpuView* getShadowmap() { return shadowMap; }
+	///forgets the last shadowmap, so the light casts no shadows until it renders another one; the target is kept for that
+	inline void clearShadowmap() { shadowMap = nullptr; }
 	inline float getProjectionFov() { return projectionFov; }
 
 };
\ No newline at end of file
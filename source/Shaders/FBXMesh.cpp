@@ -2,6 +2,11 @@
 
 #include "Utils.h"
 #include "AppGlobals.h"
+#include "AssetLoader.h"
+#include "D3D11RenderDevice.h"
+#include <fstream>
+#include <algorithm>
+#include <cfloat>
 
 #define VERBOSE false //turn to true to get verbose import output to console
 
@@ -13,14 +18,65 @@
 #endif
 
 FBXMesh::FBXMesh(){
+	vertexBuffer = indexBuffer = nullptr;//BaseMesh's, never created; see positionBuffer
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	instances.push_back(identity);
+}
+
+FBXMesh::FBXMesh(CookedMesh& cooked, RenderDevice* device) {
+	vertexBuffer = indexBuffer = nullptr;
+	vertexCount = (int)cooked.positions.size();
+	bounds = cooked.bounds;
+	material = cooked.hasMaterial ? new Material(cooked.material) : nullptr;
+	splitMeshlets = !cooked.meshlets.empty();
+	//the street's textures are normally loaded already, by whatever imported it
+	requestMap(cooked.texture, &texture, textureName, TEXTURE_PLACEHOLDER_WHITE);
+	requestMap(cooked.normalMap, &normalMap, normalMapName, TEXTURE_PLACEHOLDER_NORMAL);
+	requestMap(cooked.displacementMap, &displacementMap, displacementMapName, TEXTURE_PLACEHOLDER_BLACK);
+
+	positionBuffer = device->createStaticBuffer(sizeof(XMFLOAT3) * vertexCount, BUFFER_VERTEX, &cooked.positions[0]);
+	attributeBuffer = device->createStaticBuffer((unsigned int)cooked.attributes.size(), BUFFER_VERTEX, &cooked.attributes[0]);
+
+	lods.swap(cooked.lods);
+	meshlets.swap(cooked.meshlets);
+	parts.swap(cooked.parts);
+	occluder.swap(cooked.occluder);
+	instances.swap(cooked.instances);
+	lodIndices.swap(cooked.indices);
+	indexCount = lods[0].indexCount;
+	uploadLods(device);
+	uploadInstances(device);
+	std::vector<XMFLOAT3>().swap(cooked.positions);
+	std::vector<unsigned char>().swap(cooked.attributes);
 }
 
 FBXMesh::~FBXMesh(){
+	//maps that haven't loaded yet would otherwise get written to after we're gone
+	if (GLOBALS.Assets) {
+		GLOBALS.Assets->forget(&texture);
+		GLOBALS.Assets->forget(&normalMap);
+		GLOBALS.Assets->forget(&displacementMap);
+	}
+	if (vertices)
+		delete[] vertices;
+	if (indices)
+		delete[] indices;
 	if(material)
 		delete material;
+	if (GLOBALS.Backend) {
+		if (positionBuffer)
+			GLOBALS.Backend->releaseBuffer(positionBuffer);
+		if (attributeBuffer)
+			GLOBALS.Backend->releaseBuffer(attributeBuffer);
+		if (instanceBuffer)
+			GLOBALS.Backend->releaseBuffer(instanceBuffer);
+		if (lodIndexBuffer)
+			GLOBALS.Backend->releaseBuffer(lodIndexBuffer);
+	}
 }
 
-void FBXMesh::importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, ID3D11Device* device, ID3D11DeviceContext* deviceContext) {
+void FBXMesh::importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, RenderDevice* device) {
 
 	echo("\tImporting mesh %s", fbxMesh->GetName());
 
@@ -113,10 +169,43 @@ void FBXMesh::importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::st
 		}
 	}
 
+	//keep track of bounds before we throw the vertices away
+	BoundingBox::CreateFromPoints(bounds, vertexCount, &vertices[0].position, sizeof(VertexType_Tangent));
+
+	keepSource(vertices, sizeof(VertexType_Tangent), nullptr);
+
 	importMaterials(material, folderPath);
 
-	//initialize directx buffers
-	initBuffers(device);
+	//create the gpu buffers, unless that's for later
+	if (device) createBuffers(device);
+}
+
+void FBXMesh::uploadBuffers(RenderDevice* device) {
+	if (!positionBuffer) createBuffers(device);
+}
+
+void FBXMesh::requestMap(const std::string& filename, GpuView** slot, std::string& out_name, int placeholder) {
+	out_name = filename;
+	if (filename.empty()) return;
+	if (GLOBALS.Assets) {
+		GLOBALS.Assets->forget(slot);//a map asked for before (say, the material's) mustn't land on top of this one once it loads
+		GLOBALS.Assets->requestTexture(filename, slot, placeholder);
+		return;
+	}
+	//no loader, so it gets loaded right now
+	if (!GLOBALS.TextureManager->getTexture(filename)) {
+		std::wstring w_filename = std::wstring(filename.begin(), filename.end());//convert it to widestring
+		GLOBALS.TextureManager->loadTexture(filename, (WCHAR*)w_filename.c_str());
+	}
+	*slot = D3D11RenderDevice::handle(GLOBALS.TextureManager->getTexture(filename));
+}
+
+void FBXMesh::setNormalMap(const std::string& filename) {
+	requestMap(filename, &normalMap, normalMapName, TEXTURE_PLACEHOLDER_NORMAL);
+}
+
+void FBXMesh::setDisplacementMap(const std::string& filename) {
+	requestMap(filename, &displacementMap, displacementMapName, TEXTURE_PLACEHOLDER_BLACK);
 }
 
 ///Imports the diffuse texture for the mesh
@@ -150,9 +239,7 @@ void FBXMesh::importMaterials(FbxSurfaceMaterial* material, std::string folderPa
 					Utils::split(splitFilename.back(), '\\', &splitFilename);
 					filename = folderPath + splitFilename.back();//add the folder path beforehand to make it relative
 					echo("\t\t\tAssigning texture %s", filename.c_str());
-					std::wstring w_filename = std::wstring(filename.begin(), filename.end());//convert it to widestring
-					GLOBALS.TextureManager->loadTexture(filename, (WCHAR*)w_filename.c_str());
-					this->texture = GLOBALS.TextureManager->getTexture(filename);
+					requestMap(filename, &this->texture, textureName, TEXTURE_PLACEHOLDER_WHITE);
 				}
 				else {
 					echo("\t\t\tTexture was null!");
@@ -185,9 +272,7 @@ void FBXMesh::importMaterials(FbxSurfaceMaterial* material, std::string folderPa
 					Utils::split(splitFilename.back(), '\\', &splitFilename);
 					filename = folderPath + splitFilename.back();//add the folder path beforehand to make it relative
 					echo("\t\t\tAssigning displacement map %s", filename.c_str());
-					std::wstring w_filename = std::wstring(filename.begin(), filename.end());//convert it to widestring
-					GLOBALS.TextureManager->loadTexture(filename, (WCHAR*)w_filename.c_str());
-					this->displacementMap = GLOBALS.TextureManager->getTexture(filename);
+					setDisplacementMap(filename);
 
 					//Assign normal map as well, assuming same name with "-normal" added to it (cos i can't figure out how to add one in maya lmao)
 					std::vector<std::string> filenameAndExtension;
@@ -197,9 +282,7 @@ void FBXMesh::importMaterials(FbxSurfaceMaterial* material, std::string folderPa
 						normalFilename += "." + filenameAndExtension[i];
 					normalFilename += "-normal." + filenameAndExtension.back();
 					echo("\t\t\tAssigning normal map %s", normalFilename.c_str());
-					std::wstring w_normalfilename = std::wstring(normalFilename.begin(), normalFilename.end());//convert it to widestring
-					GLOBALS.TextureManager->loadTexture(normalFilename, (WCHAR*)w_normalfilename.c_str());
-					this->normalMap = GLOBALS.TextureManager->getTexture(normalFilename);
+					setNormalMap(normalFilename);
 
 				}
 				else {
@@ -238,19 +321,16 @@ void FBXMesh::importMaterials(FbxSurfaceMaterial* material, std::string folderPa
 }
 
 void FBXMesh::initBuffers(ID3D11Device* device) {
+	createBuffers(GLOBALS.Backend);
+}
+
+void FBXMesh::createBuffers(RenderDevice* device) {
 	
 	//fill vertex and index buffers for gpu
-	D3D11_SUBRESOURCE_DATA vertexData, indexData;
-
-	//setup vertex buffer
-	D3D11_BUFFER_DESC vertexBufferDesc = { sizeof(VertexType_Tangent) * vertexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_VERTEX_BUFFER, 0, 0, 0 };
-	vertexData = { vertices, 0 , 0 };
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
+	initStreams(device, vertices, sizeof(VertexType_Tangent));
 
 	//setup index buffer
-	D3D11_BUFFER_DESC indexBufferDesc = { sizeof(unsigned long) * indexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_INDEX_BUFFER, 0, 0, 0 };
-	indexData = { indices, 0, 0 };
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	lodIndexBuffer = device->createStaticBuffer(sizeof(unsigned long) * indexCount, BUFFER_INDEX, indices);
 
 	//get rid of temporary buffers
 	delete[] vertices;
@@ -259,6 +339,316 @@ void FBXMesh::initBuffers(ID3D11Device* device) {
 	indices = nullptr;
 }
 
+void FBXMesh::initStreams(RenderDevice* device, const void* source, unsigned int stride) {
+	XMFLOAT3* positions = new XMFLOAT3[vertexCount];
+	VertexType_Attributes* attributes = new VertexType_Attributes[vertexCount];
+	for (int i = 0; i < vertexCount; ++i) {
+		const VertexType_Tangent& vertex = *(const VertexType_Tangent*)((const char*)source + i * stride);
+		positions[i] = vertex.position;
+		attributes[i].texture = vertex.texture;
+		attributes[i].normal = vertex.normal;
+		attributes[i].tangent = vertex.tangent;
+	}
+
+	positionBuffer = device->createStaticBuffer(sizeof(XMFLOAT3) * vertexCount, BUFFER_VERTEX, positions);
+	attributeBuffer = device->createStaticBuffer(sizeof(VertexType_Attributes) * vertexCount, BUFFER_VERTEX, attributes);
+
+	//big meshes keep their positions around, to be rasterized by the occlusion culler
+	if (OcclusionCuller::isOccluder(bounds, vertexCount / 3))
+		occluder.assign(positions, positions + vertexCount);
+
+	delete[] positions;
+	delete[] attributes;
+}
+
+void FBXMesh::keepSource(const void* source, unsigned int stride, const unsigned int* groups) {
+	sourcePositions.resize(vertexCount);
+	sourceNormals.resize(vertexCount);
+	sourceUVs.resize(vertexCount);
+	for (int i = 0; i < vertexCount; ++i) {
+		const VertexType_Tangent& vertex = *(const VertexType_Tangent*)((const char*)source + i * stride);
+		sourcePositions[i] = vertex.position;
+		sourceNormals[i] = vertex.normal;
+		sourceUVs[i] = vertex.texture;
+	}
+	//the whole vertex has to match for two to be merged, so seams, hard edges and skin weight changes stay where they are
+	LodBuilder::weld(source, stride, vertexCount, sourceWedges);
+	if (groups) sourceGroups.assign(groups, groups + vertexCount);
+	sourceIndices.assign(indices, indices + indexCount);
+}
+
+unsigned long long FBXMesh::instanceKey() {
+	if (sourcePositions.empty() || !InstanceFinder::frame(&sourcePositions[0], (unsigned int)sourcePositions.size(), sourceFrame)) return 0;
+	unsigned long long key = InstanceFinder::key(&sourcePositions[0], (unsigned int)sourcePositions.size(), sourceFrame);
+	//uvs don't move with the mesh, and copies have the same triangles
+	key = LodBuilder::hash(&sourceUVs[0], sizeof(XMFLOAT2) * sourceUVs.size(), key);
+	key = LodBuilder::hash(&sourceIndices[0], sizeof(unsigned long) * sourceIndices.size(), key);
+	return key ? key : 1;
+}
+
+bool FBXMesh::addInstance(FBXMesh* other) {
+	size_t count = sourcePositions.size();
+	if (other->sourcePositions.size() != count || other->sourceIndices.size() != sourceIndices.size()) return false;
+	if (memcmp(&other->sourceUVs[0], &sourceUVs[0], sizeof(XMFLOAT2) * count) != 0) return false;
+	if (memcmp(&other->sourceIndices[0], &sourceIndices[0], sizeof(unsigned long) * sourceIndices.size()) != 0) return false;
+
+	//drawn with this mesh's material and maps, so the copy's have to be the same; by name, as they might not be loaded yet
+	if (other->textureName != textureName || other->normalMapName != normalMapName || other->displacementMapName != displacementMapName) return false;
+	if ((material == nullptr) != (other->material == nullptr)) return false;
+	if (material && (memcmp(&material->colour, &other->material->colour, sizeof(XMFLOAT3)) != 0 ||
+		memcmp(&material->specularColour, &other->material->specularColour, sizeof(XMFLOAT3)) != 0 || material->specularPower != other->material->specularPower)) return false;
+
+	XMFLOAT4X4 transform;
+	if (!InstanceFinder::match(&sourcePositions[0], &sourceNormals[0], sourceFrame, &other->sourcePositions[0], &other->sourceNormals[0], other->sourceFrame, (unsigned int)count, transform))
+		return false;
+	instances.push_back(transform);
+	return true;
+}
+
+void FBXMesh::uploadInstances(RenderDevice* device) {
+	std::vector<XMFLOAT3>().swap(sourceNormals);
+	std::vector<XMFLOAT2>().swap(sourceUVs);
+
+	//draws cover runs of instances in a row, so neighbours should be next to each other in the stream too
+	if (instances.size() > 2) {
+		XMFLOAT3 low = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), high = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const XMFLOAT4X4& instance : instances) {
+			low = XMFLOAT3((std::min)(low.x, instance._41), (std::min)(low.y, instance._42), (std::min)(low.z, instance._43));
+			high = XMFLOAT3((std::max)(high.x, instance._41), (std::max)(high.y, instance._42), (std::max)(high.z, instance._43));
+		}
+		XMFLOAT3 spread = XMFLOAT3(high.x - low.x, high.y - low.y, high.z - low.z);
+		int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+		std::sort(instances.begin(), instances.end(), [axis](const XMFLOAT4X4& a, const XMFLOAT4X4& b) { return a.m[3][axis] < b.m[3][axis]; });
+	}
+
+	if (instanceBuffer) device->releaseBuffer(instanceBuffer);
+	instanceBuffer = device->createStaticBuffer(sizeof(XMFLOAT4X4) * (unsigned int)instances.size(), BUFFER_VERTEX, &instances[0]);
+}
+
+void FBXMesh::buildLods(const std::string& cacheFolder) {
+	if (sourceIndices.empty()) return;
+
+	//named after everything the levels are built from
+	unsigned long long key = LodBuilder::hash(&sourcePositions[0], sizeof(XMFLOAT3) * sourcePositions.size());
+	key = LodBuilder::hash(&sourceWedges[0], sizeof(unsigned int) * sourceWedges.size(), key);
+	if (!sourceGroups.empty()) key = LodBuilder::hash(&sourceGroups[0], sizeof(unsigned int) * sourceGroups.size(), key);
+	key = LodBuilder::hash(&sourceIndices[0], sizeof(unsigned long) * sourceIndices.size(), key);
+	key = LodBuilder::hash(&splitMeshlets, sizeof(splitMeshlets), key);
+	char name[32];
+	sprintf_s(name, "%016llx.mesh", key);
+	std::string filename = cacheFolder + name;
+	//the rest of the vertex goes into the attribute stream, and so into cell files (see cookKey())
+	contentKey = LodBuilder::hash(&sourceNormals[0], sizeof(XMFLOAT3) * sourceNormals.size(), key);
+	contentKey = LodBuilder::hash(&sourceUVs[0], sizeof(XMFLOAT2) * sourceUVs.size(), contentKey);
+	if (loadLods(filename)) return;
+
+	LodBuilder::build(&sourcePositions[0], sizeof(XMFLOAT3), &sourceWedges[0], sourceGroups.empty() ? nullptr : &sourceGroups[0], &sourceIndices[0], (unsigned int)sourceIndices.size(), lodIndices, lods);
+	echo("\t\t%d levels of detail", (int)lods.size());
+
+	//sorts each level's indices by meshlet, so each one is a range of the index buffer
+	meshlets.clear();
+	if (splitMeshlets) {
+		std::vector<Meshlet> levelMeshlets;
+		for (MeshLod& lod : lods) {
+			MeshletBuilder::build(&sourcePositions[0], sizeof(XMFLOAT3), (unsigned int)sourcePositions.size(), &lodIndices[lod.firstIndex], lod.indexCount, levelMeshlets);
+			lod.firstMeshlet = (unsigned int)meshlets.size();
+			lod.meshletCount = (unsigned int)levelMeshlets.size();
+			for (Meshlet& meshlet : levelMeshlets) {
+				meshlet.firstIndex += lod.firstIndex;
+				meshlets.push_back(meshlet);
+			}
+		}
+	}
+
+	saveLods(filename);
+}
+
+void FBXMesh::uploadLods(RenderDevice* device) {
+	if (lodIndices.empty()) return;
+	if (lodIndexBuffer) device->releaseBuffer(lodIndexBuffer);
+	lodIndexBuffer = device->createStaticBuffer(sizeof(unsigned long) * (unsigned int)lodIndices.size(), BUFFER_INDEX, &lodIndices[0]);
+	//indexCount stays the full mesh's, which is the first range
+
+	std::vector<XMFLOAT3>().swap(sourcePositions);
+	std::vector<unsigned int>().swap(sourceWedges);
+	std::vector<unsigned int>().swap(sourceGroups);
+	std::vector<unsigned long>().swap(sourceIndices);
+	std::vector<unsigned long>().swap(lodIndices);
+}
+
+bool FBXMesh::cook(CookedMesh& out, const XMMATRIX& world) {
+	if (getVertexBuffer(STREAM_SKIN) || lods.empty() || !positionBuffer || !attributeBuffer || !lodIndexBuffer) return false;
+	if ((texture && textureName.empty()) || (normalMap && normalMapName.empty()) || (displacementMap && displacementMapName.empty())) return false;
+
+	std::vector<unsigned char> positions, indices;
+	RenderDevice* device = GLOBALS.Backend;
+	if (!device->readBuffer(positionBuffer, positions) || !device->readBuffer(attributeBuffer, out.attributes) || !device->readBuffer(lodIndexBuffer, indices)) return false;
+	out.positions.resize(positions.size() / sizeof(XMFLOAT3));
+	memcpy(&out.positions[0], &positions[0], out.positions.size() * sizeof(XMFLOAT3));
+	out.indices.resize(indices.size() / sizeof(unsigned long));
+	memcpy(&out.indices[0], &indices[0], out.indices.size() * sizeof(unsigned long));
+
+	XMStoreFloat4x4(&out.world, world);
+	out.hasMaterial = material != nullptr;
+	if (material) out.material = *material;
+	out.texture = textureName;
+	out.normalMap = normalMapName;
+	out.displacementMap = displacementMapName;
+	out.bounds = bounds;
+	out.lods = lods;
+	out.meshlets = meshlets;
+	out.parts = parts;
+	out.instances = instances;
+	out.occluder = occluder;
+	return true;
+}
+
+static unsigned long long hashString(const std::string& value, unsigned long long key) {
+	unsigned int length = (unsigned int)value.size();
+	key = LodBuilder::hash(&length, sizeof(length), key);
+	return LodBuilder::hash(value.data(), value.size(), key);
+}
+
+unsigned long long FBXMesh::cookKey() {
+	unsigned long long key = LodBuilder::hash(&contentKey, sizeof(contentKey));
+	bool hasMaterial = material != nullptr;
+	key = LodBuilder::hash(&hasMaterial, sizeof(hasMaterial), key);
+	if (material) key = LodBuilder::hash(material, sizeof(Material), key);
+	key = hashString(textureName, key);
+	key = hashString(normalMapName, key);
+	key = hashString(displacementMapName, key);
+	key = LodBuilder::hash(&bounds, sizeof(bounds), key);
+	key = LodBuilder::hash(&instances[0], sizeof(XMFLOAT4X4) * instances.size(), key);
+	return key;
+}
+
+size_t CookedMesh::gpuBytes() const {
+	return positions.size() * sizeof(XMFLOAT3) + attributes.size() + indices.size() * sizeof(unsigned long) + instances.size() * sizeof(XMFLOAT4X4);
+}
+
+//arrays and strings go in as a count followed by their data
+template<typename T> static void writeArray(std::ostream& output, const std::vector<T>& values) {
+	unsigned int count = (unsigned int)values.size();
+	output.write((const char*)&count, sizeof(count));
+	if (count) output.write((const char*)&values[0], sizeof(T) * count);
+}
+template<typename T> static bool readArray(std::istream& input, std::vector<T>& values) {
+	unsigned int count = 0;
+	if (!input.read((char*)&count, sizeof(count))) return false;
+	values.resize(count);
+	return !count || input.read((char*)&values[0], sizeof(T) * count);
+}
+static void writeString(std::ostream& output, const std::string& value) {
+	writeArray(output, std::vector<char>(value.begin(), value.end()));
+}
+static bool readString(std::istream& input, std::string& value) {
+	std::vector<char> characters;
+	if (!readArray(input, characters)) return false;
+	value.assign(characters.begin(), characters.end());
+	return true;
+}
+
+void CookedMesh::write(std::ostream& output) const {
+	output.write((const char*)&world, sizeof(world));
+	output.write((const char*)&material, sizeof(material));
+	output.write((const char*)&hasMaterial, sizeof(hasMaterial));
+	writeString(output, texture);
+	writeString(output, normalMap);
+	writeString(output, displacementMap);
+	output.write((const char*)&bounds, sizeof(bounds));
+	writeArray(output, positions);
+	writeArray(output, attributes);
+	writeArray(output, indices);
+	writeArray(output, lods);
+	writeArray(output, meshlets);
+	unsigned int partCount = (unsigned int)parts.size();
+	output.write((const char*)&partCount, sizeof(partCount));
+	for (const MeshPart& part : parts) {
+		output.write((const char*)&part.bounds, sizeof(part.bounds));
+		writeArray(output, part.lods);
+	}
+	writeArray(output, instances);
+	writeArray(output, occluder);
+}
+
+bool CookedMesh::read(std::istream& input) {
+	if (!input.read((char*)&world, sizeof(world)) || !input.read((char*)&material, sizeof(material)) || !input.read((char*)&hasMaterial, sizeof(hasMaterial))) return false;
+	if (!readString(input, texture) || !readString(input, normalMap) || !readString(input, displacementMap)) return false;
+	if (!input.read((char*)&bounds, sizeof(bounds))) return false;
+	if (!readArray(input, positions) || !readArray(input, attributes) || !readArray(input, indices) || !readArray(input, lods) || !readArray(input, meshlets)) return false;
+	unsigned int partCount = 0;
+	if (!input.read((char*)&partCount, sizeof(partCount))) return false;
+	parts.resize(partCount);
+	for (MeshPart& part : parts)
+		if (!input.read((char*)&part.bounds, sizeof(part.bounds)) || !readArray(input, part.lods)) return false;
+	if (!readArray(input, instances) || !readArray(input, occluder)) return false;
+	//nothing to draw, or more than the buffers hold, means the file is broken
+	return !positions.empty() && attributes.size() == positions.size() * sizeof(VertexType_Attributes) && !lods.empty() && !indices.empty() && !instances.empty();
+}
+
+bool FBXMesh::loadLods(const std::string& filename) {
+	std::ifstream input(filename, std::ios::binary);
+	if (!input) return false;
+	unsigned int header[4];//version, levels, meshlets, indices
+	if (!input.read((char*)header, sizeof(header)) || header[0] != MESH_CACHE_VERSION || header[1] == 0 || header[1] > LOD_MAX_LEVELS) return false;
+	//no level has more indices than the full mesh, and no meshlet fewer than a triangle; anything past that isn't one of ours
+	unsigned long long maxIndices = (unsigned long long)indexCount * LOD_MAX_LEVELS;
+	if (header[3] > maxIndices || header[2] > header[3] / 3) return false;
+	lods.resize(header[1]);
+	meshlets.resize(header[2]);
+	lodIndices.resize(header[3]);
+	input.read((char*)&lods[0], sizeof(MeshLod) * lods.size());
+	if (!meshlets.empty()) input.read((char*)&meshlets[0], sizeof(Meshlet) * meshlets.size());
+	if (!lodIndices.empty()) input.read((char*)&lodIndices[0], sizeof(unsigned long) * lodIndices.size());
+	if (input && lods[0].indexCount == (unsigned int)indexCount && validLods()) return true;
+	printf("Error: %s is corrupt; rebuilding it.\n", filename.c_str());
+	lods.clear();
+	meshlets.clear();
+	lodIndices.clear();
+	return false;
+}
+
+bool FBXMesh::validLods() {
+	for (unsigned long index : lodIndices)
+		if (index >= sourcePositions.size()) return false;
+	for (MeshLod& lod : lods) {
+		if ((unsigned long long)lod.firstIndex + lod.indexCount > lodIndices.size()) return false;
+		if ((unsigned long long)lod.firstMeshlet + lod.meshletCount > meshlets.size()) return false;
+	}
+	for (Meshlet& meshlet : meshlets)
+		if ((unsigned long long)meshlet.firstIndex + meshlet.indexCount > lodIndices.size()) return false;
+	return true;
+}
+
+///writes to a file of this thread's own then renames it over filename, so meshes with the same cache file can save at once and loadLods() never sees half of one
+void FBXMesh::saveLods(const std::string& filename) {
+	char suffix[32];
+	sprintf_s(suffix, ".%lu.tmp", GetCurrentThreadId());
+	std::string temporary = filename + suffix;
+	{
+		std::ofstream output(temporary, std::ios::binary);
+		if (!output) {
+			printf("Error: could not write %s.\n", temporary.c_str());
+			return;
+		}
+		unsigned int header[4] = { MESH_CACHE_VERSION, (unsigned int)lods.size(), (unsigned int)meshlets.size(), (unsigned int)lodIndices.size() };
+		output.write((const char*)header, sizeof(header));
+		output.write((const char*)&lods[0], sizeof(MeshLod) * lods.size());
+		if (!meshlets.empty()) output.write((const char*)&meshlets[0], sizeof(Meshlet) * meshlets.size());
+		if (!lodIndices.empty()) output.write((const char*)&lodIndices[0], sizeof(unsigned long) * lodIndices.size());
+		if (!output) {
+			printf("Error: could not write %s.\n", temporary.c_str());
+			output.close();
+			DeleteFileA(temporary.c_str());
+			return;
+		}
+	}
+	if (!MoveFileExA(temporary.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		printf("Error: could not replace %s.\n", filename.c_str());
+		DeleteFileA(temporary.c_str());
+	}
+}
+
 ///passing in the index of a control point, this ***should*** fill in out_normal with the point's normal - otherwise, returns false.
 bool FBXMesh::getNormalForIndex(FbxMesh* fbxMesh, int index, XMFLOAT3& out_normal) {
 
@@ -406,25 +796,5 @@ bool FBXMesh::getUVForIndex(FbxMesh* fbxMesh, int index, int uvIndex, XMFLOAT2&
 	return true;
 }
 
-void FBXMesh::render(ID3D11DeviceContext* deviceContext, LitShader* shader, D3D_PRIMITIVE_TOPOLOGY top) {
-	//first setup the texture if we have one
-	shader->setMaterialParameters(deviceContext, texture, normalMap, displacementMap, material);
-	sendData(deviceContext, top);
-	shader->render(deviceContext, getIndexCount());
-}
-
-void FBXMesh::sendData(ID3D11DeviceContext* deviceContext, D3D_PRIMITIVE_TOPOLOGY top) {
-	unsigned int stride;
-	unsigned int offset;
-
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType_Tangent);
-	offset = 0;
-
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
-}
-
 #undef VERBOSE
 #undef echo
\ No newline at end of file
@@ -1,10 +1,49 @@
 #pragma once
 
 #include "DXF.h"
+#include <DirectXCollision.h>
 #include <fbxsdk.h>
 #include <string>
+#include <iostream>
 #include "LitShader.h"
 #include "FBXImportArgs.h"
+#include "OcclusionCuller.h"
+#include "MeshletBuilder.h"
+#include "LodBuilder.h"
+#include "InstanceFinder.h"
+#include "RenderDevice.h"
+
+#define MESH_CACHE_VERSION 1 //bump whenever LodBuilder or MeshletBuilder change what they output, so stale cache files get ignored
+#define CELL_CACHE_VERSION 1 //bump whenever CookedMesh::write() changes, or MESH_CACHE_VERSION does
+
+///one of the meshes merged into a batch (see FBXMeshBatch): its bounds, and its levels of detail as ranges of the batch's index buffer and meshlets
+struct MeshPart {
+	BoundingBox bounds;
+	std::vector<MeshLod> lods;
+};
+
+///a mesh as a cell file holds it, off the gpu: everything FBXMesh builds on import, ready to upload again (see FBXMesh::cook() and WorldStreamer)
+struct CookedMesh {
+	XMFLOAT4X4 world;//where the mesh was in its scene
+	Material material;
+	bool hasMaterial = false;
+	std::string texture, normalMap, displacementMap;//texture manager ids, which are also their file names; empty if there's none
+	BoundingBox bounds;
+	std::vector<XMFLOAT3> positions;
+	std::vector<unsigned char> attributes;//the attribute stream, as is
+	std::vector<unsigned long> indices;//every level
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshPart> parts;
+	std::vector<XMFLOAT4X4> instances;
+	std::vector<XMFLOAT3> occluder;
+
+	///what the mesh's buffers take up once uploaded
+	size_t gpuBytes() const;
+	void write(std::ostream& output) const;
+	///false if the data runs out before the mesh does
+	bool read(std::istream& input);
+};
 
 class FBXMesh : public BaseMesh {
 protected:
@@ -15,25 +54,85 @@ protected:
 		XMFLOAT3 normal;
 		XMFLOAT3 tangent;
 	};
+	///What goes in the attribute stream; position gets a stream of its own, so that depth-only passes can leave the rest alone
+	struct VertexType_Attributes {
+		XMFLOAT2 texture;
+		XMFLOAT3 normal;
+		XMFLOAT3 tangent;
+	};
 
 public:
 	FBXMesh();
+	///uploads a mesh read from a cell file, taking its data; textures that aren't loaded yet get loaded in the background
+	FBXMesh(CookedMesh& cooked, RenderDevice* device);
 	virtual ~FBXMesh();
 
-	///imports a mesh from an FbxMesh object
-	virtual void importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, ID3D11Device* device, ID3D11DeviceContext* deviceContext);
-
-	///renders the FBXMesh using the correct material setup
-	void render(ID3D11DeviceContext* deviceContext, LitShader* shader, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	///imports a mesh from an FbxMesh object; without a device, its buffers are left for uploadBuffers() to create, so that it can be imported on any thread
+	virtual void importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, RenderDevice* device);
 
-	virtual void sendData(ID3D11DeviceContext *deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) override;
+	///creates the buffers importMesh() left out for lack of a device; nothing if they're there already
+	void uploadBuffers(RenderDevice* device);
 
-	inline void setNormalMap(ID3D11ShaderResourceView* map) { normalMap = map; }
-	inline void setDisplacementMap(ID3D11ShaderResourceView* map) { displacementMap = map; }
+	///maps from files, for meshes whose material doesn't have them; flat and flush with the mesh until they're loaded
+	void setNormalMap(const std::string& filename);
+	void setDisplacementMap(const std::string& filename);
 	inline void setMaterialSpecular(float r, float g, float b) { material->specularColour = XMFLOAT3(r, g, b); }
 
+	///local space bounds of the mesh, computed on import
+	inline const BoundingBox& getBounds() { return bounds; }
+	///local space triangles (3 positions each) if the mesh is big enough to hide others behind it (see OcclusionCuller::isOccluder()), empty otherwise
+	inline const std::vector<XMFLOAT3>& getOccluder() { return occluder; }
+	///clusters of up to MESHLET_MAX_TRIANGLES triangles, each a range of the index buffer, for every level of detail; empty for skinned meshes, whose bounds move
+	inline const std::vector<Meshlet>& getMeshlets() { return meshlets; }
+	///the full mesh then coarser and coarser versions of it, back to back in the index buffer; just the full mesh until buildLods() and uploadLods()
+	inline const std::vector<MeshLod>& getLods() { return lods; }
+
+	///simplifies the mesh into levels of detail and splits each into meshlets, or reads them from cacheFolder if they were built from the same vertices before.
+	///Doesn't touch the device, so different meshes can build theirs on different threads
+	void buildLods(const std::string& cacheFolder);
+	///replaces the index buffer with one holding every level
+	void uploadLods(RenderDevice* device);
+
+	///where each copy of the mesh goes, from mesh space to scene space, for the instance stream; just the identity unless addInstance() found copies
+	inline const std::vector<XMFLOAT4X4>& getInstances() { return instances; }
+	///what copies of this mesh have in common: its vertices seen from a frame of their own (see InstanceFinder), uvs and indices. 0 if it can't have copies
+	unsigned long long instanceKey();
+	///takes other on as one more instance of this mesh if it's a copy of it (vertices, uvs, indices and material), after which other isn't needed anymore.
+	///Both need instanceKey() called first
+	bool addInstance(FBXMesh* other);
+	///creates the instance stream, with instances sorted along the scene so that the ones a pass sees tend to be next to each other
+	void uploadInstances(RenderDevice* device);
+
+	///the meshes this one was merged from, each to be culled and given a level of detail on its own; empty unless it's an FBXMeshBatch
+	inline const std::vector<MeshPart>& getParts() { return parts; }
+
+	///reads the mesh back off the gpu into out, placed at world, for a cell file; only once its levels are uploaded. False for skinned meshes,
+	///which are only ever drawn with their skeleton, and meshes with maps that didn't come from their material
+	bool cook(CookedMesh& out, const XMMATRIX& world);
+	///hashes everything cook() writes that can't be told from the mesh's place in the scene: material, map names, instances, and what buildLods() built the vertices
+	///and levels from; the cell index is only trusted while these match
+	unsigned long long cookKey();
+
+	///what RenderQueue binds to draw the mesh
+	inline GpuView* getTexture() { return texture; }
+	inline GpuView* getNormalMap() { return normalMap; }
+	inline GpuView* getDisplacementMap() { return displacementMap; }
+	inline Material* getMaterial() { return material; }
+	///one of the STREAM_ vertex streams, null if the mesh doesn't have it
+	inline virtual GpuBuffer* getVertexBuffer(int stream) { return stream == STREAM_POSITION ? positionBuffer : stream == STREAM_ATTRIBUTES ? attributeBuffer : stream == STREAM_INSTANCE ? instanceBuffer : nullptr; }
+	inline virtual unsigned int getVertexStride(int stream) { return stream == STREAM_POSITION ? sizeof(XMFLOAT3) : stream == STREAM_ATTRIBUTES ? sizeof(VertexType_Attributes) : stream == STREAM_INSTANCE ? sizeof(XMFLOAT4X4) : 0; }
+	inline GpuBuffer* getIndexBuffer() { return lodIndexBuffer; }
+
 protected:
+	///BaseMesh's, which only ever gets the D3D11 device; creates the buffers through GLOBALS.Backend instead
 	virtual void initBuffers(ID3D11Device* device) override;
+	///creates the streams and index buffer out of what importMesh() kept
+	virtual void createBuffers(RenderDevice* device);
+	///keeps what instanceKey(), addInstance() and buildLods() need out of the imported vertices (stride bytes each, starting out the same as a VertexType_Tangent)
+	///and indices; groups can be null
+	void keepSource(const void* source, unsigned int stride, const unsigned int* groups);
+	///splits source's vertices into the position stream and attribute stream; each vertex is stride bytes and starts out the same as a VertexType_Tangent
+	void initStreams(RenderDevice* device, const void* source, unsigned int stride);
 
 	//processes the FbxMesh data to get normal for specific index; returns whether it was successful
 	bool getNormalForIndex(FbxMesh* fbxMesh, int index, XMFLOAT3& out_normal);
@@ -47,15 +146,65 @@ protected:
 	///Imports material and texture data
 	void importMaterials(FbxSurfaceMaterial* material, std::string folderPath);
 
-	///the two following are initialized in importMesh and become nullptr almost immediately in initBuffer.
-	VertexType_Tangent* vertices;
-	unsigned long* indices;
+	///the two following are initialized in importMesh and become nullptr in createBuffers(), once there's a device to create the buffers with.
+	VertexType_Tangent* vertices = nullptr;
+	unsigned long* indices = nullptr;
+
+	///axis aligned bounds of the vertices, in mesh space
+	BoundingBox bounds;
+
+	///positions, then uv, normal and tangent in a stream of their own; BaseMesh's vertexBuffer and indexBuffer are never created
+	GpuBuffer* positionBuffer = nullptr;
+	GpuBuffer* attributeBuffer = nullptr;
+	///every level of detail, back to back
+	GpuBuffer* lodIndexBuffer = nullptr;
+
+	///one matrix per instance; the first is the mesh itself, where it was imported
+	std::vector<XMFLOAT4X4> instances;
+	GpuBuffer* instanceBuffer = nullptr;
+
+	///cpu copy of the positions, for occluders only
+	std::vector<XMFLOAT3> occluder;
+
+	///built by buildLods(), in mesh space
+	std::vector<Meshlet> meshlets;
+	std::vector<MeshLod> lods;
+	bool splitMeshlets = true;
+
+	///see getParts()
+	std::vector<MeshPart> parts;
+
+	//what instances are found from, emptied by uploadInstances()
+	std::vector<XMFLOAT3> sourceNormals;
+	std::vector<XMFLOAT2> sourceUVs;
+	XMFLOAT4X4 sourceFrame;
+
+	//what buildLods() works from, then what uploadLods() uploads; both emptied once uploaded
+	std::vector<XMFLOAT3> sourcePositions;
+	std::vector<unsigned int> sourceWedges, sourceGroups;
+	std::vector<unsigned long> sourceIndices;
+	std::vector<unsigned long> lodIndices;
+	///hash of the source vertices and indices, set by buildLods() (or by a batch, out of its parts'), for cookKey()
+	unsigned long long contentKey = 0;
+
+	///the cache file for this mesh's levels and meshlets; false if there isn't one or it's from another version
+	bool loadLods(const std::string& filename);
+	void saveLods(const std::string& filename);
+	///whether what loadLods() read only points inside itself and at vertices that exist
+	bool validLods();
 
 private:
+	//batches read the meshes they merge, buffers and all
+	friend class FBXMeshBatch;
+
 	///diffuse texture to apply to this mesh when rendering
-	ID3D11ShaderResourceView* texture = nullptr;
-	ID3D11ShaderResourceView* normalMap = nullptr;
-	ID3D11ShaderResourceView* displacementMap = nullptr;
+	GpuView* texture = nullptr;
+	GpuView* normalMap = nullptr;
+	GpuView* displacementMap = nullptr;
+	///which files the maps above were loaded from, for cook(), and to tell whether two meshes use the same ones before they're loaded
+	std::string textureName, normalMapName, displacementMapName;
+	///points slot at the texture in filename, through the asset loader if there's one, and keeps the name
+	void requestMap(const std::string& filename, GpuView** slot, std::string& out_name, int placeholder);
 	///Material to apply to this mesh when rendering
-	Material* material;
+	Material* material = nullptr;
 };
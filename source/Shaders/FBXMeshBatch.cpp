@@ -0,0 +1,124 @@
+#include "FBXMeshBatch.h"
+#include "AssetLoader.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+FBXMeshBatch::FBXMeshBatch(const std::vector<FBXMesh*>& meshes, RenderDevice* device) {
+	FBXMesh* first = meshes[0];
+	//asked for again rather than copied, in case they're still placeholders
+	requestMap(first->textureName, &texture, textureName, TEXTURE_PLACEHOLDER_WHITE);
+	requestMap(first->normalMapName, &normalMap, normalMapName, TEXTURE_PLACEHOLDER_NORMAL);
+	requestMap(first->displacementMapName, &displacementMap, displacementMapName, TEXTURE_PLACEHOLDER_BLACK);
+	material = first->material ? new Material(*first->material) : nullptr;
+	splitMeshlets = first->splitMeshlets;
+
+	//parts sorted along the batch, so that the ones a pass sees tend to be next to each other at every level
+	std::vector<FBXMesh*> sorted(meshes);
+	XMFLOAT3 low = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), high = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (FBXMesh* mesh : sorted) {
+		const XMFLOAT3& center = mesh->bounds.Center;
+		low = XMFLOAT3((std::min)(low.x, center.x), (std::min)(low.y, center.y), (std::min)(low.z, center.z));
+		high = XMFLOAT3((std::max)(high.x, center.x), (std::max)(high.y, center.y), (std::max)(high.z, center.z));
+	}
+	XMFLOAT3 spread = XMFLOAT3(high.x - low.x, high.y - low.y, high.z - low.z);
+	int axis = spread.x >= spread.y && spread.x >= spread.z ? 0 : spread.y >= spread.z ? 1 : 2;
+	std::sort(sorted.begin(), sorted.end(), [axis](FBXMesh* a, FBXMesh* b) { return (&a->bounds.Center.x)[axis] < (&b->bounds.Center.x)[axis]; });
+
+	//vertices: every mesh's streams one after the other, copied over on the gpu since only positions are still around on the cpu
+	std::vector<unsigned int> firstVertex;
+	vertexCount = 0;
+	for (FBXMesh* mesh : sorted) {
+		firstVertex.push_back(vertexCount);
+		vertexCount += mesh->vertexCount;
+	}
+	positionBuffer = device->createStaticBuffer(sizeof(XMFLOAT3) * vertexCount, BUFFER_VERTEX, nullptr);
+	attributeBuffer = device->createStaticBuffer(sizeof(VertexType_Attributes) * vertexCount, BUFFER_VERTEX, nullptr);
+	for (size_t m = 0; m < sorted.size(); ++m) {
+		device->copyBuffer(positionBuffer, sizeof(XMFLOAT3) * firstVertex[m], sorted[m]->positionBuffer, 0, sizeof(XMFLOAT3) * sorted[m]->vertexCount);
+		device->copyBuffer(attributeBuffer, sizeof(VertexType_Attributes) * firstVertex[m], sorted[m]->attributeBuffer, 0, sizeof(VertexType_Attributes) * sorted[m]->vertexCount);
+	}
+
+	//indices: level by level, each part's moved past the vertices of the parts before it, and its meshlets along with them
+	size_t levels = 0;
+	for (FBXMesh* mesh : sorted)
+		levels = (std::max)(levels, mesh->lods.size());
+	parts.resize(sorted.size());
+	for (size_t level = 0; level < levels; ++level) {
+		for (size_t m = 0; m < sorted.size(); ++m) {
+			FBXMesh* mesh = sorted[m];
+			if (level >= mesh->lods.size()) continue;
+			const MeshLod& lod = mesh->lods[level];
+			MeshLod moved = lod;
+			moved.firstIndex = (unsigned int)lodIndices.size();
+			moved.firstMeshlet = (unsigned int)meshlets.size();
+			for (unsigned int i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; ++i)
+				lodIndices.push_back(mesh->lodIndices[i] + firstVertex[m]);
+			for (unsigned int i = lod.firstMeshlet; i < lod.firstMeshlet + lod.meshletCount; ++i) {
+				Meshlet meshlet = mesh->meshlets[i];
+				meshlet.firstIndex += moved.firstIndex - lod.firstIndex;
+				meshlets.push_back(meshlet);
+			}
+			parts[m].lods.push_back(moved);
+		}
+	}
+
+	//as a whole, the batch is every part's full mesh, which is the first range
+	MeshLod whole = { 0, 0, 0, 0, 0 };
+	for (MeshPart& part : parts) {
+		whole.indexCount += part.lods[0].indexCount;
+		whole.meshletCount += part.lods[0].meshletCount;
+	}
+	lods.assign(1, whole);
+	indexCount = whole.indexCount;
+
+	bounds = sorted[0]->bounds;
+	for (size_t m = 0; m < sorted.size(); ++m) {
+		parts[m].bounds = sorted[m]->bounds;
+		BoundingBox::CreateMerged(bounds, bounds, sorted[m]->bounds);
+		occluder.insert(occluder.end(), sorted[m]->occluder.begin(), sorted[m]->occluder.end());
+		contentKey = LodBuilder::hash(&sorted[m]->contentKey, sizeof(contentKey), contentKey);
+	}
+
+	uploadLods(device);
+	uploadInstances(device);
+}
+
+bool FBXMeshBatch::canBatch(FBXMesh* mesh) {
+	return mesh->instances.size() == 1 && !mesh->lods.empty() && !mesh->lodIndices.empty() && mesh->positionBuffer && mesh->attributeBuffer;
+}
+
+void FBXMeshBatch::cellOf(FBXMesh* mesh, int out_cell[3]) {
+	const XMFLOAT3& center = mesh->bounds.Center;
+	out_cell[0] = (int)floorf(center.x / BATCH_CELL_SIZE);
+	out_cell[1] = (int)floorf(center.y / BATCH_CELL_SIZE);
+	out_cell[2] = (int)floorf(center.z / BATCH_CELL_SIZE);
+}
+
+unsigned long long FBXMeshBatch::batchKey(FBXMesh* mesh) {
+	int cell[3];
+	cellOf(mesh, cell);
+	unsigned long long key = LodBuilder::hash(cell, sizeof(cell));
+	for (const std::string* map : { &mesh->textureName, &mesh->normalMapName, &mesh->displacementMapName })
+		key = LodBuilder::hash(map->c_str(), map->size() + 1, key);
+	if (mesh->material) {
+		key = LodBuilder::hash(&mesh->material->colour, sizeof(XMFLOAT3), key);
+		key = LodBuilder::hash(&mesh->material->specularColour, sizeof(XMFLOAT3), key);
+		key = LodBuilder::hash(&mesh->material->specularPower, sizeof(float), key);
+	}
+	return key;
+}
+
+bool FBXMeshBatch::sameBatch(FBXMesh* a, FBXMesh* b) {
+	int cellA[3], cellB[3];
+	cellOf(a, cellA);
+	cellOf(b, cellB);
+	if (memcmp(cellA, cellB, sizeof(cellA)) != 0) return false;
+	if (a->textureName != b->textureName || a->normalMapName != b->normalMapName || a->displacementMapName != b->displacementMapName) return false;
+	if (a->splitMeshlets != b->splitMeshlets) return false;
+	if ((a->material == nullptr) != (b->material == nullptr)) return false;
+	return !a->material || (memcmp(&a->material->colour, &b->material->colour, sizeof(XMFLOAT3)) == 0 &&
+		memcmp(&a->material->specularColour, &b->material->specularColour, sizeof(XMFLOAT3)) == 0 && a->material->specularPower == b->material->specularPower);
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "FBXMesh.h"
+
+/// Static meshes that share a material and a patch of the scene, merged into one vertex buffer and one index buffer so they can be drawn together.
+/// Each mesh becomes a part of the batch, with its own bounds and levels of detail, for RenderQueue to cull and pick a level for one part at a time.
+/// The index buffer holds every part's full mesh back to back, then every part's first coarser level, and so on, with indices already past the
+/// vertices of the parts before; neighbouring parts drawn at the same level are then one range, and one draw.
+
+#define BATCH_CELL_SIZE 16.f //meshes only get batched with others centred in the same cube of this size, so that a batch stays small enough to be culled as a whole
+
+class FBXMeshBatch : public FBXMesh {
+
+public:
+	///merges meshes, which sameBatch() has to be true for, into this one; they need buildLods() done, but not uploadLods(), and can be deleted afterwards
+	FBXMeshBatch(const std::vector<FBXMesh*>& meshes, RenderDevice* device);
+
+	///whether mesh can be merged into a batch at all: a single instance, and levels built but not uploaded yet. Skinned meshes can't, which this doesn't check for
+	static bool canBatch(FBXMesh* mesh);
+	///the same for meshes that may end up in the same batch: material, maps and cell; sameBatch() tells for sure
+	static unsigned long long batchKey(FBXMesh* mesh);
+	///whether a and b can go in the same batch
+	static bool sameBatch(FBXMesh* a, FBXMesh* b);
+
+protected:
+	///which BATCH_CELL_SIZE cube the mesh's bounds are centred in
+	static void cellOf(FBXMesh* mesh, int out_cell[3]);
+
+};
@@ -2,8 +2,23 @@
 
 #include "Utils.h"
 #include "AppGlobals.h"
+#include "WorldStreamer.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 
 #define VERBOSE false //set to false to bypass printing additional info when importing fbx files
+#define MESH_CACHE_FOLDER "cache/" //levels of detail and meshlets, next to each fbx
+#define NO_INDIRECT_DRAW UINT_MAX //in indirectOffsets, for meshes the hi-z culler doesn't know about
+#define STREAM_CELL_SIZE 32.f //static meshes get split into cubes of this size for streaming, by where their bounds are centred
+#define STREAM_CELL_FOLDER "cells/" //under MESH_CACHE_FOLDER
 
 
 #if VERBOSE
@@ -14,8 +29,14 @@
 
 
 FbxManager* FBXScene::fbxManager = nullptr;
+std::mutex FBXScene::fbxLock;
 
-FBXScene::FBXScene(ID3D11Device* device, ID3D11DeviceContext* context, std::string filename, FBXImportArgs& args){
+FBXScene::FBXScene(RenderDevice* device, std::string filename, FBXImportArgs& args) : FBXScene(filename, args) {
+	upload(device);
+}
+
+///Everything up to the buffers; the fbx sdk is only ever used by one scene at a time, so that scenes can load side by side with the lod building of one overlapping the parsing of the next
+FBXScene::FBXScene(std::string filename, FBXImportArgs& args){
 	if (fbxManager == nullptr) {
 		//need to call Init() before reaching here
 		abort();
@@ -36,7 +57,7 @@ FBXScene::FBXScene(ID3D11Device* device, ID3D11DeviceContext* context, std::stri
 	printf("Loading FBX in folder %s\n", folderPath.c_str());
 #endif
 
-	deviceContext = context;
+	std::unique_lock<std::mutex> guard(fbxLock);
 
 	//load the fbx into an fbx scene
 	FbxImporter* importer = FbxImporter::Create(fbxManager, "");
@@ -48,32 +69,56 @@ FBXScene::FBXScene(ID3D11Device* device, ID3D11DeviceContext* context, std::stri
 	importer->Destroy();
 
 	//walk the fbx scene to import what we need (ie meshes)
-	importNode(scene->GetRootNode(), args, device, deviceContext);
+	root = new SceneNode;
+	nodes.push_back(root);
+	importNode(scene->GetRootNode(), root, args);//buffers are left for upload()
+	guard.unlock();
+	root->update();
+	findInstances();
+	buildLods();
 
 	//import any animations
+	guard.lock();
 	if (skeleton && importAnimations(scene)) {
 		this->scene = scene;
 	}
 	else {//if there are no animations in the scene, we don't need to keep it.
 		scene->Destroy();
 	}
+}
 
-	skeletonViewMesh = new SphereMesh(GLOBALS.Device, GLOBALS.DeviceContext, 2);
-	skeletonViewMaterial = new Material;
-	skeletonViewMaterial->colour = XMFLOAT3(1, 1, 1);
-
+void FBXScene::upload(RenderDevice* device) {
+	for (FBXMesh* mesh : meshes) {
+		mesh->uploadBuffers(device);
+		mesh->uploadInstances(device);
+	}
+	batchMeshes(device);
+	for (FBXMesh* mesh : meshes)
+		mesh->uploadLods(device);
+
+	//each mesh's node covers all of it, every instance and part
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const std::vector<XMFLOAT4X4>& instances = meshes[i]->getInstances();
+		BoundingBox bounds;
+		meshes[i]->getBounds().Transform(bounds, meshSpace() * XMLoadFloat4x4(&instances[0]));
+		for (size_t j = 1; j < instances.size(); ++j) {
+			BoundingBox box;
+			meshes[i]->getBounds().Transform(box, meshSpace() * XMLoadFloat4x4(&instances[j]));
+			BoundingBox::CreateMerged(bounds, bounds, box);
+		}
+		meshNodes[i]->setBounds(bounds);
+	}
+	root->update();
 }
 
 FBXScene::~FBXScene(){
 	for (FBXMesh* mesh : meshes) {
 		delete mesh;
 	}
+	for (SceneNode* node : nodes)
+		delete node;//which takes the root out of whatever it was hung under
 	if (skeleton != nullptr)
 		delete skeleton;
-	if (skeletonViewMesh != nullptr)
-		delete skeletonViewMesh;
-	if (skeletonViewMaterial != nullptr)
-		delete skeletonViewMaterial;
 	if (scene)
 		scene->Destroy();//destroy that scene now since we've kept it around for animation info
 	if (animator)
@@ -81,7 +126,7 @@ FBXScene::~FBXScene(){
 }
 
 ///Imports an fbx node and its children into the scene; only imports meshes and joints.
-void FBXScene::importNode(FbxNode* node, FBXImportArgs& args, ID3D11Device* device, ID3D11DeviceContext* deviceContext, FBXJoint* currentJoint) {
+void FBXScene::importNode(FbxNode* node, SceneNode* parent, FBXImportArgs& args, FBXJoint* currentJoint) {
 
 #if VERBOSE
 	printf("Importing %s\n", node->GetName());
@@ -110,6 +155,19 @@ void FBXScene::importNode(FbxNode* node, FBXImportArgs& args, ID3D11Device* devi
 		echo("\tWarning! Global scale of this node is non-unit: %f, %f, %f", globalScale[0], globalScale[1], globalScale[2]);
 	}
 
+	//the node's own transform, relative to its parent; mirrored along with the vertices if their z gets flipped
+	FbxAMatrix localTransform = node->EvaluateLocalTransform(FBXSDK_TIME_INFINITE);
+	const FbxVector4 localTranslation = localTransform.GetT();
+	const FbxQuaternion localRotation = localTransform.GetQ();
+	const FbxVector4 localScale = localTransform.GetS();
+	float flip = args.invertZScale ? -1.f : 1.f;
+	SceneNode* sceneNode = new SceneNode;
+	nodes.push_back(sceneNode);
+	parent->addChild(sceneNode);
+	sceneNode->setPosition(XMFLOAT3((float)localTranslation[0], (float)localTranslation[1], (float)localTranslation[2] * flip));
+	sceneNode->setRotation(XMFLOAT4((float)localRotation[0] * flip, (float)localRotation[1] * flip, (float)localRotation[2], (float)localRotation[3]));
+	sceneNode->setScale(XMFLOAT3((float)localScale[0], (float)localScale[1], (float)localScale[2]));
+
 	//get this node's attributes
 	for (int i = 0; i < node->GetNodeAttributeCount(); ++i) {
 		FbxNodeAttribute* attribute = node->GetNodeAttributeByIndex(i);
@@ -155,7 +213,11 @@ void FBXScene::importNode(FbxNode* node, FBXImportArgs& args, ID3D11Device* devi
 						else {//if there is a skeleton already loaded from that fbx file, push a skinned mesh instead of a mesh
 							meshes.push_back(new FBXSkinnedMesh(skeleton));
 						}
-						meshes.back()->importMesh(fbxMesh, material, folderPath, args, device, deviceContext);
+						meshes.back()->importMesh(fbxMesh, material, folderPath, args, nullptr);
+						//a node of its own, so that its bounds don't get mixed up with any other mesh's on the same fbx node
+						meshNodes.push_back(new SceneNode);
+						nodes.push_back(meshNodes.back());
+						(skeleton ? root : sceneNode)->addChild(meshNodes.back());
 					}
 				}
 				break;
@@ -168,7 +230,186 @@ void FBXScene::importNode(FbxNode* node, FBXImportArgs& args, ID3D11Device* devi
 
 	//recursively import children:
 	for (int i = 0; i < node->GetChildCount(); ++i)
-		importNode(node->GetChild(i), args, device, deviceContext, currentJoint);
+		importNode(node->GetChild(i), sceneNode, args, currentJoint);
+}
+
+///Groups meshes by instanceKey(), and checks each against the first ones of its group before keeping it as a mesh of its own
+void FBXScene::findInstances() {
+	if (!skeleton) {//skinned meshes are all different, and skinned shaders don't read instances
+		std::unordered_map<unsigned long long, std::vector<size_t>> shapes;
+		std::vector<FBXMesh*> kept;
+		std::vector<SceneNode*> keptNodes;
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			FBXMesh* mesh = meshes[m];
+			unsigned long long key = mesh->instanceKey();
+			bool copy = false;
+			if (key) {
+				std::vector<size_t>& firsts = shapes[key];
+				for (size_t i = 0; i < firsts.size() && !copy; ++i)
+					copy = samePlace(firsts[i], m) && meshes[firsts[i]]->addInstance(mesh);
+				if (!copy) firsts.push_back(m);
+			}
+			if (copy) delete mesh;//its buffers go with it; the one it's a copy of draws it from now on
+			else {
+				kept.push_back(mesh);
+				keptNodes.push_back(meshNodes[m]);
+			}
+		}
+		echo("%d meshes, %d once copies are instanced", (int)meshes.size(), (int)kept.size());
+		meshes.swap(kept);
+		meshNodes.swap(keptNodes);
+	}
+}
+
+bool FBXScene::samePlace(size_t a, size_t b) {
+	return memcmp(&meshNodes[a]->getWorld(), &meshNodes[b]->getWorld(), sizeof(XMFLOAT4X4)) == 0;
+}
+
+///Simplifies the meshes in parallel; the fbx sdk is done with by now, and uploading happens in upload()
+void FBXScene::buildLods() {
+	std::string cacheFolder = folderPath + MESH_CACHE_FOLDER;
+	CreateDirectoryA(cacheFolder.c_str(), nullptr);
+
+	std::atomic<size_t> next(0);
+	auto work = [this, &next, &cacheFolder]() {
+		for (size_t i = next++; i < meshes.size(); i = next++)
+			meshes[i]->buildLods(cacheFolder);
+	};
+	std::vector<std::thread> threads;
+	unsigned int workers = (std::min)((std::max)(std::thread::hardware_concurrency(), 1u), (unsigned int)meshes.size());
+	for (unsigned int i = 1; i < workers; ++i)
+		threads.push_back(std::thread(work));
+	work();
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+///Groups meshes by FBXMeshBatch::batchKey() then sameBatch(), the same way findInstances() does; groups of one are left as they are
+void FBXScene::batchMeshes(RenderDevice* device) {
+	if (skeleton) return;//skinned meshes each have their own bones
+	std::unordered_map<unsigned long long, std::vector<std::vector<size_t>>> groups;
+	std::vector<FBXMesh*> kept;
+	std::vector<SceneNode*> keptNodes;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		FBXMesh* mesh = meshes[m];
+		if (!FBXMeshBatch::canBatch(mesh)) {
+			kept.push_back(mesh);
+			keptNodes.push_back(meshNodes[m]);
+			continue;
+		}
+		std::vector<std::vector<size_t>>& candidates = groups[FBXMeshBatch::batchKey(mesh)];
+		bool added = false;
+		for (size_t i = 0; i < candidates.size() && !added; ++i) {
+			size_t first = candidates[i][0];
+			if (samePlace(first, m) && FBXMeshBatch::sameBatch(meshes[first], mesh)) {
+				candidates[i].push_back(m);
+				added = true;
+			}
+		}
+		if (!added) candidates.push_back(std::vector<size_t>(1, m));
+	}
+
+	int batches = 0;
+	for (auto& candidates : groups) {
+		for (std::vector<size_t>& group : candidates) {
+			keptNodes.push_back(meshNodes[group[0]]);
+			if (group.size() == 1) {
+				kept.push_back(meshes[group[0]]);
+				continue;
+			}
+			std::vector<FBXMesh*> members;
+			for (size_t m : group)
+				members.push_back(meshes[m]);
+			kept.push_back(new FBXMeshBatch(members, device));
+			for (FBXMesh* mesh : members)
+				delete mesh;//the batch has its own copy of everything
+			++batches;
+		}
+	}
+	echo("%d meshes, %d once batched into %d batches", (int)meshes.size(), (int)kept.size(), batches);
+	meshes.swap(kept);
+	meshNodes.swap(keptNodes);
+}
+
+///Hashes every mesh's place and FBXMesh::cookKey() into a key for the index, so that it only gets cooked again when the scene changes; cooking reads everything back off the gpu
+std::string FBXScene::cookCells() {
+	if (skeleton) return "";//skinned meshes need their bones
+	std::string folder = folderPath + MESH_CACHE_FOLDER STREAM_CELL_FOLDER;
+	std::string indexFile = folder + "index";
+	XMMATRIX toScene = XMMatrixInverse(nullptr, XMLoadFloat4x4(&root->getWorld()));
+
+	std::map<std::tuple<int, int, int>, std::vector<size_t>> cells;
+	float cellSize = STREAM_CELL_SIZE;
+	unsigned long long key = LodBuilder::hash(&cellSize, sizeof(cellSize));
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		if (!meshNodes[i]->hasBounds()) continue;
+		BoundingBox bounds;
+		meshNodes[i]->getWorldBounds().Transform(bounds, toScene);
+		cells[std::make_tuple((int)floorf(bounds.Center.x / STREAM_CELL_SIZE), (int)floorf(bounds.Center.y / STREAM_CELL_SIZE), (int)floorf(bounds.Center.z / STREAM_CELL_SIZE))].push_back(i);
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMLoadFloat4x4(&meshNodes[i]->getWorld()) * toScene);
+		unsigned long long meshKey = meshes[i]->cookKey();
+		key = LodBuilder::hash(&world, sizeof(world), key);
+		key = LodBuilder::hash(&meshKey, sizeof(meshKey), key);
+	}
+
+	{
+		std::ifstream input(indexFile, std::ios::binary);
+		unsigned int header[2];//version, cells
+		unsigned long long cachedKey = 0;
+		if (input.read((char*)header, sizeof(header)) && input.read((char*)&cachedKey, sizeof(cachedKey)) && header[0] == CELL_CACHE_VERSION && cachedKey == key)
+			return indexFile;
+	}
+
+	//every cell's file first, then the index, so that there's never an index pointing at cells that weren't written
+	CreateDirectoryA(folder.c_str(), nullptr);
+	std::vector<StreamCellEntry> entries;
+	BoundingBox sceneBounds;
+	for (auto& cell : cells) {
+		StreamCellEntry entry = { { std::get<0>(cell.first), std::get<1>(cell.first), std::get<2>(cell.first) }, BoundingBox(), 0 };
+		std::vector<CookedMesh> cooked;
+		for (size_t m : cell.second) {
+			cooked.push_back(CookedMesh());
+			if (!meshes[m]->cook(cooked.back(), XMLoadFloat4x4(&meshNodes[m]->getWorld()) * toScene)) {
+				cooked.pop_back();
+				continue;
+			}
+			BoundingBox bounds;
+			meshNodes[m]->getWorldBounds().Transform(bounds, toScene);
+			if (cooked.size() == 1) entry.bounds = bounds;
+			else BoundingBox::CreateMerged(entry.bounds, entry.bounds, bounds);
+			entry.gpuBytes += cooked.back().gpuBytes();
+		}
+		if (cooked.empty()) continue;
+
+		std::string name = WorldStreamer::cellFile(entry.coords);
+		std::ofstream output(folder + name, std::ios::binary);
+		unsigned int header[2] = { CELL_CACHE_VERSION, (unsigned int)cooked.size() };
+		output.write((const char*)header, sizeof(header));
+		for (const CookedMesh& mesh : cooked)
+			mesh.write(output);
+		if (!output) {
+			printf("Error: could not write cell %s.\n", (folder + name).c_str());
+			return "";
+		}
+		if (entries.empty()) sceneBounds = entry.bounds;
+		else BoundingBox::CreateMerged(sceneBounds, sceneBounds, entry.bounds);
+		entries.push_back(entry);
+	}
+	if (entries.empty()) return "";
+
+	std::ofstream index(indexFile, std::ios::binary);
+	unsigned int header[2] = { CELL_CACHE_VERSION, (unsigned int)entries.size() };
+	index.write((const char*)header, sizeof(header));
+	index.write((const char*)&key, sizeof(key));
+	index.write((const char*)&sceneBounds, sizeof(sceneBounds));
+	index.write((const char*)&entries[0], sizeof(StreamCellEntry) * entries.size());
+	if (!index) {
+		printf("Error: could not write cell index %s.\n", indexFile.c_str());
+		return "";
+	}
+	echo("%d meshes cooked into %d cells", (int)meshes.size(), (int)entries.size());
+	return indexFile;
 }
 
 ///Imports animation data in the fbx scene
@@ -237,28 +478,83 @@ void FBXScene::update(float dt) {
 	}
 }
 
-///Renders the meshes in this scene; also renders the skeleton if renderSkeleton evaluates to true
-void FBXScene::render(LitShader* shader, LineShader* lineShader, bool renderSkeleton, D3D_PRIMITIVE_TOPOLOGY top) {
-	
-	//render all meshes:
-	for (FBXMesh* mesh : meshes) {
-		//shader should be skinned shader if the fbx contains animated models
+///Adds the meshes in this scene to the queue; with a skeleton, shader should be a skinned shader
+void FBXScene::submit(RenderQueue* queue, LitShader* shader, int top, OcclusionCuller* culler, HiZCuller* hiZ) {
+	bool indirect = hiZ && hiZ->getArguments() && indirectOffsets.size() == meshes.size();
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		FBXMesh* mesh = meshes[i];
+		SceneNode* node = meshNodes[i];
+		//node bounds cover every instance and part, so this only leaves out what the queue would have culled one at a time anyway
+		if (culler && node->hasBounds() && !culler->isVisible(node->getWorldBounds())) continue;
+		XMMATRIX world = XMLoadFloat4x4(&node->getWorld());
 		if (skeleton) {
 			FBXSkinnedMesh* skinnedMesh = dynamic_cast<FBXSkinnedMesh*>(mesh);
-			SkinnedShader* skinnedShader = dynamic_cast<SkinnedShader*>(shader);//you better have given me the right type of shader here :)
-			skinnedMesh->sendAnimationData(skinnedShader);
+			queue->submit(shader, mesh, world, top, skinnedMesh->getBoneTransforms(), skinnedMesh->getNumBones());
 		}
-		mesh->render(deviceContext, shader, top);
+		else if (indirect && indirectOffsets[i] != NO_INDIRECT_DRAW)
+			queue->submit(shader, mesh, world, top, nullptr, 0, 0, hiZ->getArguments(), indirectOffsets[i]);
+		else
+			queue->submit(shader, mesh, world, top);
 	}
+}
 
-	if (renderSkeleton) {
-		//render skeleton as debug view
-		if (skeleton != nullptr) {
-			shader->setMaterialParameters(GLOBALS.DeviceContext, nullptr, nullptr, nullptr, skeletonViewMaterial);
-			skeleton->render(shader, lineShader, skeletonViewMesh);
+///Adds the occluder meshes' triangles to the culler, in world space
+void FBXScene::addOccluders(OcclusionCuller* culler) {
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		const std::vector<XMFLOAT3>& triangles = meshes[i]->getOccluder();
+		if (triangles.empty()) continue;
+		XMMATRIX world = XMLoadFloat4x4(&meshNodes[i]->getWorld());
+		for (const XMFLOAT4X4& instance : meshes[i]->getInstances())
+			culler->addOccluder(&triangles[0], (unsigned int)triangles.size(), meshSpace() * XMLoadFloat4x4(&instance) * world);
+	}
+}
+
+///Registers each mesh's world space bounds with the culler, keeping track of where its arguments end up
+void FBXScene::addIndirectDraws(HiZCuller* hiZ) {
+	if (skeleton) {
+		printf("Error: skinned meshes move around their bounds, so they can't be culled on the gpu.\n");
+		return;
+	}
+	indirectOffsets.clear();
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		FBXMesh* mesh = meshes[i];
+		//arguments only hold one instance, visible or not, and one range of indices
+		if (mesh->getInstances().size() > 1 || !mesh->getParts().empty()) {
+			indirectOffsets.push_back(NO_INDIRECT_DRAW);
+			continue;
 		}
+		indirectOffsets.push_back(hiZ->addDraw(meshNodes[i]->getWorldBounds(), mesh->getIndexCount()));
 	}
+}
 
+///Adds the skeleton to the debug view; drawn on the debug view's next flush
+void FBXScene::renderSkeleton(DebugDraw* debug) {
+	if (skeleton != nullptr)
+		skeleton->render(debug);
+}
+
+///Transforms each mesh's bounds into world space
+void FBXScene::getBounds(std::vector<BoundingBox>& out_bounds, float padding) {
+	auto add = [&out_bounds, padding](const BoundingBox& bounds, const XMMATRIX& transform) {
+		BoundingBox box;
+		bounds.Transform(box, transform);
+		box.Extents.x += padding;
+		box.Extents.y += padding;
+		box.Extents.z += padding;
+		out_bounds.push_back(box);
+	};
+	for (size_t i = 0; i < meshes.size(); ++i) {
+		FBXMesh* mesh = meshes[i];
+		XMMATRIX world = XMLoadFloat4x4(&meshNodes[i]->getWorld());
+		//a batch's parts can be far apart, with nothing in between
+		if (!mesh->getParts().empty()) {
+			for (const MeshPart& part : mesh->getParts())
+				add(part.bounds, world);
+			continue;
+		}
+		for (const XMFLOAT4X4& instance : mesh->getInstances())
+			add(mesh->getBounds(), meshSpace() * XMLoadFloat4x4(&instance) * world);
+	}
 }
 
 ///initialize what we'll need to load fbx's
@@ -274,6 +570,47 @@ void FBXScene::Release() {
 	fbxManager->Destroy();
 }
 
+///Loads an fbx only to get the positions out of it, the same way FBXMesh::importMesh() would
+void FBXScene::loadTriangles(std::string filename, FBXImportArgs& args, std::vector<std::vector<XMFLOAT3>>& out_meshes) {
+	if (fbxManager == nullptr) {
+		//need to call Init() before reaching here
+		abort();
+	}
+
+	FbxImporter* importer = FbxImporter::Create(fbxManager, "");
+	if (!importer->Initialize(filename.c_str(), -1, fbxManager->GetIOSettings())) {
+		printf("Error: could not load %s.\n", filename.c_str());
+		importer->Destroy();
+		return;
+	}
+	FbxScene* scene = FbxScene::Create(fbxManager, "mScene");
+	importer->Import(scene);
+	importer->Destroy();
+
+	collectTriangles(scene->GetRootNode(), args, out_meshes);
+	scene->Destroy();
+}
+
+void FBXScene::collectTriangles(FbxNode* node, FBXImportArgs& args, std::vector<std::vector<XMFLOAT3>>& out_meshes) {
+	FbxMesh* fbxMesh = node->GetMesh();
+	if (fbxMesh != nullptr) {
+		out_meshes.push_back(std::vector<XMFLOAT3>());
+		std::vector<XMFLOAT3>& triangles = out_meshes.back();
+		FbxVector4* controlPoints = fbxMesh->GetControlPoints();
+		for (int tri = 0; tri < fbxMesh->GetPolygonCount(); ++tri) {
+			for (int i = 0; i < 3; ++i) {
+				//same winding as the meshes themselves, for anything that cares which way triangles face
+				int corner = args.invertWindingOrder && i > 0 ? 3 - i : i;
+				FbxVector4 controlPoint = controlPoints[fbxMesh->GetPolygonVertex(tri, corner)];
+				triangles.push_back(XMFLOAT3(controlPoint[0], controlPoint[1], args.invertZScale ? -controlPoint[2] : controlPoint[2]));
+			}
+		}
+	}
+
+	for (int i = 0; i < node->GetChildCount(); ++i)
+		collectTriangles(node->GetChild(i), args, out_meshes);
+}
+
 ///Debug print info about this node and its children
 void FBXScene::printNode(FbxNode* node) {
 	printf("\n%s, %d, %d, %d:", node->GetName(), node->LclTranslation.Get()[0], node->LclTranslation.Get()[1], node->LclTranslation.Get()[2]);
@@ -7,20 +7,38 @@
 #include "DXF.h"
 #include <string>
 #include <vector>
+#include <mutex>
 #include "FBXSkinnedMesh.h"
+#include "FBXMeshBatch.h"
 #include "LitShader.h"
 #include "FBXSkeleton.h"
 #include "Animator.h"
 #include "SkinnedShader.h"
+#include "RenderQueue.h"
+#include "HiZCuller.h"
+#include "SceneNode.h"
 
 class FBXScene {
 
 public:
-	FBXScene(ID3D11Device* device, ID3D11DeviceContext* deviceContext, std::string filename, FBXImportArgs& args);
+	FBXScene(RenderDevice* device, std::string filename, FBXImportArgs& args);
+	///imports the scene without touching the device, so that it can be done on any thread; it can't be drawn or moved until upload() has been called, on the render thread
+	FBXScene(std::string filename, FBXImportArgs& args);
 	~FBXScene();
 
-	///render the scene
-	void render(LitShader* shader, LineShader* lineShader, bool renderSkeleton, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	///creates the buffers of a scene imported without a device, and merges its batches; only ever once
+	void upload(RenderDevice* device);
+
+	///adds every mesh in the scene to a render queue, to be drawn on its next flush, wherever its node was as of the last update(); with a culler, meshes it can't see are left out
+	///with a hi-z culler that addIndirectDraws() was called with, meshes get drawn through the arguments it writes on the gpu.
+	///Meshes with several instances, and the parts of batches, are left for the queue to cull one at a time, against its own culler (see RenderQueue::begin())
+	void submit(RenderQueue* queue, LitShader* shader, int top = TOPOLOGY_TRIANGLELIST, OcclusionCuller* culler = nullptr, HiZCuller* hiZ = nullptr);
+	///hands the meshes big enough to hide others to an occlusion culler, where they are now
+	void addOccluders(OcclusionCuller* culler);
+	///hands every mesh's bounds to a hi-z culler, where they are now; only for scenes that don't move, and aren't skinned. Meshes with several instances and batches are left out
+	void addIndirectDraws(HiZCuller* hiZ);
+	///adds the joints to the debug view, if there's a skeleton
+	void renderSkeleton(DebugDraw* debug);
 
 	///update the scene (play any animations)
 	void update(float dt);
@@ -32,20 +50,39 @@ public:
 	static void Init();
 	static void Release();
 
+	///reads the triangles (3 positions each) of every mesh in an fbx file, without a device or any textures; for headless benchmarks. Needs Init() too
+	static void loadTriangles(std::string filename, FBXImportArgs& args, std::vector<std::vector<XMFLOAT3>>& out_meshes);
+
 	///Accessors for individual meshes
 	inline int meshCount() { return meshes.size(); }
 	inline FBXMesh* getMesh(int id) { return meshes[id]; }
+	///the node the mesh is under; its world is the one submit() draws the mesh with
+	inline SceneNode* getMeshNode(int id) { return meshNodes[id]; }
+
+	///appends the world space bounds of each mesh (each instance of it, or each part of a batch) in the scene to out_bounds, grown by padding on all sides
+	void getBounds(std::vector<BoundingBox>& out_bounds, float padding = 0);
+
+	///where the whole scene goes, with a node under it for every fbx node and one for every mesh under those; move it, or hang it under another node,
+	///then update() whichever node is at the top before submitting. Skinned meshes are placed by their bones, so their nodes hang straight off the root
+	inline SceneNode* getRoot() { return root; }
+
+	///splits the static meshes into STREAM_CELL_SIZE cubes by where they are relative to the root, and writes each cube's meshes to a cell file in the cache for a WorldStreamer,
+	///along with an index of them; does nothing if the index was already written for the same meshes in the same places. Returns the index's path, or "" if there's nothing to stream
+	std::string cookCells();
 
 protected:
-	ID3D11DeviceContext* deviceContext;
-	
-	///the meshes in this scene
+	///the meshes in this scene; copies of the same mesh are instances of one of them, and static meshes close to others with the same material are parts of a batch
 	std::vector<FBXMesh*> meshes;
+	///where each mesh is, in the same order; instances and batches are wherever the first of the meshes they replaced was
+	std::vector<SceneNode*> meshNodes;
+	///every node in the scene, root first
+	std::vector<SceneNode*> nodes;
+	SceneNode* root;
+	///where each mesh's arguments are in the hi-z culler's buffer (NO_INDIRECT_DRAW for instanced ones and batches); empty unless addIndirectDraws() was called
+	std::vector<unsigned int> indirectOffsets;
 
 	///the skeleton for this scene; null if the scene has no skeleton
 	FBXSkeleton* skeleton = nullptr;
-	BaseMesh* skeletonViewMesh = nullptr;//to view joints in debug view
-	Material* skeletonViewMaterial = nullptr;//to view joints in debug view
 
 	///the pose for this scene; null if the scene has no pose
 	FbxPose* pose = nullptr;
@@ -62,14 +99,30 @@ protected:
 	///debug: print an fbx node to sdtout
 	void printNode(FbxNode* node);
 
-	///recursively import nodes into this fbx scene
-	void importNode(FbxNode* node, FBXImportArgs& args, ID3D11Device* device, ID3D11DeviceContext* deviceContext, FBXJoint* currentJoint = nullptr);
+	///recursively import nodes into this fbx scene, under parent
+	void importNode(FbxNode* node, SceneNode* parent, FBXImportArgs& args, FBXJoint* currentJoint = nullptr);
+
+	///replaces meshes that are copies of another one under a node in the same place with instances of it; instance streams are uploaded by upload()
+	void findInstances();
+	///builds every mesh's levels of detail, spread over every core; uploadLods() is left for after batchMeshes()
+	void buildLods();
+	///replaces static meshes that share a material, a BATCH_CELL_SIZE cube and a node in the same place with a batch of them, which uploads its own levels
+	void batchMeshes(RenderDevice* device);
+	///whether a and b are under nodes in the same place, as of the last update(), so that one can stand for the other
+	bool samePlace(size_t a, size_t b);
+	///from a mesh's vertices to the space its node's world takes them from; skinned meshes get their z flipped in the skinning shader
+	inline XMMATRIX meshSpace() { return skeleton ? XMMatrixScaling(1, 1, -1) : XMMatrixIdentity(); }
 
 	///import the animations stored within the fbx if any; returns false otherwise
 	bool importAnimations(FbxScene* fbxScene);
 
+	///loadTriangles() for a node and its children
+	static void collectTriangles(FbxNode* node, FBXImportArgs& args, std::vector<std::vector<XMFLOAT3>>& out_meshes);
+
 
 	//this is only needed for loading stuff; kept around as a single static instance, created via Init() and released via Release().
 	static FbxManager* fbxManager;
+	///held while a scene uses fbxManager, as scenes can be imported on different threads
+	static std::mutex fbxLock;
 };
 
@@ -29,10 +29,6 @@ FBXJoint::FBXJoint(XMFLOAT3 translation, XMFLOAT3 eulerAngles, FBXJoint* parentJ
 	XMMATRIX bindPosT = XMMatrixTranslation(position.x, position.y, position.z);
 	XMMATRIX bindPosR = getRotationMatrix(rotation);
 	inverseBindPoseMatrix = XMMatrixInverse(nullptr, bindPosR * bindPosT);
-
-	if(parent != nullptr)
-		line = new Line(GLOBALS.Device, parent->position, position);
-
 }
 
 FBXJoint::~FBXJoint() {
@@ -40,8 +36,6 @@ FBXJoint::~FBXJoint() {
 		delete *it;
 		it = children.erase(it);
 	}
-	if(line)
-		delete line;
 }
 
 ///Angles are expected in radians.
@@ -117,10 +111,6 @@ void FBXJoint::update(FbxTime& time0, FbxTime& time1, float weight, XMMATRIX** w
 	XMMATRIX rotMatrix = getRotationMatrix(rotation);
 	(*worldBoneTransform)[index] = inverseBindPoseMatrix * rotMatrix * posMatrix;
 
-	//update line position to match
-	if(line)
-		line->setLine(parent->position, position);
-
 	//update children positions
 	for (FBXJoint* child : children)
 		child->update(time0, time1, weight, worldBoneTransform);
@@ -128,30 +118,26 @@ void FBXJoint::update(FbxTime& time0, FbxTime& time1, float weight, XMMATRIX** w
 
 
 
-///Renders this bone and its children as debug view
-void FBXJoint::render(Shader* shader, LineShader* lineShader, BaseMesh* mesh, XMMATRIX global, int depth) {
-	XMMATRIX globalPos = XMMatrixTranslation(position.x, position.y, position.z);
-	XMMATRIX globalRot = XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	XMMATRIX localScale = XMMatrixScaling(BONE_SIZE, BONE_SIZE, BONE_SIZE);
-	XMMATRIX world = globalRot * globalPos * global;
-	
+///Adds this bone and its children to the debug view
+void FBXJoint::render(DebugDraw* debug, XMMATRIX global, int depth) {
+	XMFLOAT3 worldPosition;
+	XMStoreFloat3(&worldPosition, XMVector3TransformCoord(XMLoadFloat3(&position), global));
+
 #if RENDER_BONES_AS_SPHERES
-	mesh->sendData(GLOBALS.DeviceContext);
-	shader->setShaderParameters(GLOBALS.DeviceContext, localScale * world, GLOBALS.ViewMatrix, GLOBALS.Renderer->getProjectionMatrix());
-	shader->render(GLOBALS.DeviceContext, mesh->getIndexCount());
+	debug->sphere(worldPosition, BONE_SIZE, XMFLOAT4(1, 1, 1, 1));
 #endif
 
-	if (parent != nullptr && line != nullptr) {
-		line->sendData(GLOBALS.DeviceContext);			// Note: transform is only applied to sphere, not line, cos the line's vertices already match
-		lineShader->setShaderParameters(GLOBALS.DeviceContext, global, GLOBALS.ViewMatrix, GLOBALS.Renderer->getProjectionMatrix(), XMFLOAT3(0,0,0));//note: passing the default proj matrix rather than the modified one causes bones to not be rendered correctly when changing fov but whatever cos its just for debugging anyway
-		lineShader->render(GLOBALS.DeviceContext, line->getIndexCount());
+	if (parent != nullptr) {
+		XMFLOAT3 parentPosition;
+		XMStoreFloat3(&parentPosition, XMVector3TransformCoord(XMLoadFloat3(&parent->position), global));
+		debug->line(parentPosition, worldPosition, XMFLOAT4(1, 1, 1, 1));
 	}
 
 	--depth;
 
 	if (depth != 0) {
 		for (FBXJoint* joint : children)
-			joint->render(shader, lineShader, mesh, global, depth);
+			joint->render(debug, global, depth);
 	}
 }
 
@@ -222,19 +208,14 @@ void FBXSkeleton::update(FbxTime& time0, FbxTime& time1, float weight){
 
 }
 
-void FBXSkeleton::render(Shader* shader, LineShader* lineShader, BaseMesh* mesh) {
-
-	if (mesh == nullptr) {
-		echo("Cannot display skeleton: mesh is null.");
-		return;
-	}
+void FBXSkeleton::render(DebugDraw* debug) {
 
 	if (rootJoint == nullptr) {
 		echo("Cannot display skeleton: root joint is null.");
 		return;
 	}
 
-	rootJoint->render(shader, lineShader, mesh, SKELETON_OFFSET);
+	rootJoint->render(debug, SKELETON_OFFSET);
 }
 
 bool FBXSkeleton::assignClusterID(int id, FbxString & boneName){
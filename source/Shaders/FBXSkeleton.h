@@ -3,8 +3,7 @@
 #include "DXF.h"
 #include "LitShader.h"
 #include <vector>
-#include "LineShader.h"
-#include "Line.h"
+#include "DebugDraw.h"
 #include <fbxsdk.h>
 
 class FBXSkeleton;
@@ -22,14 +21,11 @@ protected:
 
 	FbxNode* node;//the fbx node that corresponds to this joint; to be able to update position based on time.
 
-	///Debug: to draw line between two bones
-	Line* line;
-
 	///Updates the joint's position based on animation
 	void update(FbxTime& time0, FbxTime& time1, float weight, XMMATRIX** worldBoneTransform);
 
 	///Debug: renders the joint
-	void render(Shader* shader, LineShader* lineShader, BaseMesh* mesh, XMMATRIX global, int depth = -1);//using depth > 0 means only that depth of bones will be rendered
+	void render(DebugDraw* debug, XMMATRIX global, int depth = -1);//using depth > 0 means only that depth of bones will be rendered
 
 	///Walks down the hierachy of bones to assign the specified cluster index to the bone with the name boneName.
 	bool assignClusterID(int id, FbxString& boneName);
@@ -62,7 +58,7 @@ public:
 	void update(FbxTime& time0, FbxTime& time1, float weight);
 
 	///Debug: renders the skeleton
-	void render(Shader* shader, LineShader* lineShader, BaseMesh* mesh);
+	void render(DebugDraw* debug);
 
 	///Assigns cluster index to particular bone; returns false if unsuccesful
 	bool assignClusterID(int id, FbxString& boneName);
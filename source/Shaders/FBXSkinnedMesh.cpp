@@ -12,14 +12,18 @@
 #endif
 
 FBXSkinnedMesh::FBXSkinnedMesh(FBXSkeleton* skeleton) : skeleton(skeleton) {
-
+	splitMeshlets = false;//meshlet bounds don't follow the bones
 }
 
 FBXSkinnedMesh::~FBXSkinnedMesh(){
+	if (skinVertices)
+		delete[] skinVertices;
+	if (skinBuffer && GLOBALS.Backend)
+		GLOBALS.Backend->releaseBuffer(skinBuffer);
 }
 
 ///Note: it is assumed that skeleton has been assigned before call to this function.
-void FBXSkinnedMesh::importMesh(FbxMesh * fbxMesh, FbxSurfaceMaterial * material, std::string folderPath, FBXImportArgs & args, ID3D11Device * device, ID3D11DeviceContext * deviceContext){
+void FBXSkinnedMesh::importMesh(FbxMesh * fbxMesh, FbxSurfaceMaterial * material, std::string folderPath, FBXImportArgs & args, RenderDevice * device){
 
 	echo("\tImporting skinned mesh %s", fbxMesh->GetName());
 
@@ -246,23 +250,46 @@ void FBXSkinnedMesh::importMesh(FbxMesh * fbxMesh, FbxSurfaceMaterial * material
 
 	delete[] weightData;
 
+	//bind pose bounds; animation will move things around a bit so pad these when using them
+	BoundingBox::CreateFromPoints(bounds, vertexCount, &skinVertices[0].position, sizeof(VertexType_Skin));
+
+	//simplification keeps vertices to the bone that moves them most, so nothing gets dragged across a joint
+	unsigned int* dominantBones = new unsigned int[vertexCount];
+	for (int i = 0; i < vertexCount; ++i) {
+		const VertexType_Skin& v = skinVertices[i];
+		float weights[8] = { v.boneWeights.x, v.boneWeights.y, v.boneWeights.z, v.boneWeights.w, v.boneWeights2.x, v.boneWeights2.y, v.boneWeights2.z, v.boneWeights2.w };
+		unsigned int ids[8] = { v.boneIds.x, v.boneIds.y, v.boneIds.z, v.boneIds.w, v.boneIds2.x, v.boneIds2.y, v.boneIds2.z, v.boneIds2.w };
+		int strongest = 0;
+		for (int j = 1; j < 8; ++j)
+			if (weights[j] > weights[strongest]) strongest = j;
+		dominantBones[i] = ids[strongest];
+	}
+	keepSource(skinVertices, sizeof(VertexType_Skin), dominantBones);
+	delete[] dominantBones;
+
 	importMaterials(material, folderPath);
 
-	//initialize directx buffers
-	initBuffers(device);
+	//create the gpu buffers, unless that's for later
+	if (device) createBuffers(device);
 }
 
-void FBXSkinnedMesh::initBuffers(ID3D11Device* device) {
+void FBXSkinnedMesh::createBuffers(RenderDevice* device) {
 
-	//setup vertex buffer
-	D3D11_BUFFER_DESC vertexBufferDesc = { sizeof(VertexType_Skin) * vertexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_VERTEX_BUFFER, 0, 0, 0 };
-	D3D11_SUBRESOURCE_DATA vertexData = { skinVertices, 0 , 0 };
-	device->CreateBuffer(&vertexBufferDesc, &vertexData, &vertexBuffer);
+	//setup position and attribute streams, then the skin stream
+	initStreams(device, skinVertices, sizeof(VertexType_Skin));
+
+	VertexType_SkinData* skinData = new VertexType_SkinData[vertexCount];
+	for (int i = 0; i < vertexCount; ++i) {
+		skinData[i].boneIds = skinVertices[i].boneIds;
+		skinData[i].boneIds2 = skinVertices[i].boneIds2;
+		skinData[i].boneWeights = skinVertices[i].boneWeights;
+		skinData[i].boneWeights2 = skinVertices[i].boneWeights2;
+	}
+	skinBuffer = device->createStaticBuffer(sizeof(VertexType_SkinData) * vertexCount, BUFFER_VERTEX, skinData);
+	delete[] skinData;
 
 	//setup index buffer
-	D3D11_BUFFER_DESC indexBufferDesc = { sizeof(unsigned long) * indexCount, D3D11_USAGE_DEFAULT, D3D11_BIND_INDEX_BUFFER, 0, 0, 0 };
-	D3D11_SUBRESOURCE_DATA indexData = { indices, 0, 0 };
-	device->CreateBuffer(&indexBufferDesc, &indexData, &indexBuffer);
+	lodIndexBuffer = device->createStaticBuffer(sizeof(unsigned long) * indexCount, BUFFER_INDEX, indices);
 
 	//get rid of temporary buffers
 	delete[] skinVertices;
@@ -271,20 +298,6 @@ void FBXSkinnedMesh::initBuffers(ID3D11Device* device) {
 	indices = nullptr;
 }
 
-void FBXSkinnedMesh::sendData(ID3D11DeviceContext * deviceContext, D3D_PRIMITIVE_TOPOLOGY top) {
-
-	unsigned int stride;
-	unsigned int offset;
-
-	// Set vertex buffer stride and offset.
-	stride = sizeof(VertexType_Skin);
-	offset = 0;
-
-	deviceContext->IASetVertexBuffers(0, 1, &vertexBuffer, &stride, &offset);
-	deviceContext->IASetIndexBuffer(indexBuffer, DXGI_FORMAT_R32_UINT, 0);
-	deviceContext->IASetPrimitiveTopology(top);
-}
-
 void FBXSkinnedMesh::sendAnimationData(SkinnedShader * shader){
-	shader->setBones(skeleton->getWorldBoneTransforms(), numBones);
+	shader->setBones(GLOBALS.Backend, skeleton->getWorldBoneTransforms(), numBones);
 }
@@ -19,28 +19,43 @@ protected:
 		XMFLOAT4 boneWeights;//weights 0 1 2 3
 		XMFLOAT4 boneWeights2;//weights 4 5 6 7
 	};
+	///What goes in the skin stream
+	struct VertexType_SkinData {
+		XMUINT4 boneIds;
+		XMUINT4 boneIds2;
+		XMFLOAT4 boneWeights;
+		XMFLOAT4 boneWeights2;
+	};
 
 public:
 	FBXSkinnedMesh(FBXSkeleton*);
 	~FBXSkinnedMesh();
 
 	///Overriden to import bone influences as well
-	void importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, ID3D11Device* device, ID3D11DeviceContext* deviceContext) override;
-
-	void sendData(ID3D11DeviceContext *deviceContext, D3D_PRIMITIVE_TOPOLOGY top = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST) override;
+	void importMesh(FbxMesh* fbxMesh, FbxSurfaceMaterial* material, std::string folderPath, FBXImportArgs& args, RenderDevice* device) override;
 
 	///Call this before rendering to send animation data to skinning shader
 	void sendAnimationData(SkinnedShader* shader);
 
+	///same as what sendAnimationData() sends, for submitting to a RenderQueue instead
+	inline XMMATRIX** getBoneTransforms() { return skeleton->getWorldBoneTransforms(); }
+	inline int getNumBones() { return numBones; }
+
+	inline GpuBuffer* getVertexBuffer(int stream) override { return stream == STREAM_SKIN ? skinBuffer : FBXMesh::getVertexBuffer(stream); }
+	inline unsigned int getVertexStride(int stream) override { return stream == STREAM_SKIN ? sizeof(VertexType_SkinData) : FBXMesh::getVertexStride(stream); }
+
 protected:
-	//similar to vertices in FBXMesh, this will be destroyed in initBuffers, almost immediately when importing.
-	VertexType_Skin* skinVertices;
+	//similar to vertices in FBXMesh, this will be destroyed in createBuffers(), once there's a device.
+	VertexType_Skin* skinVertices = nullptr;
+
+	///bone ids and weights, next to FBXMesh's position and attribute streams
+	GpuBuffer* skinBuffer = nullptr;
 
 	int numBones = 0;//the number of bones / skin clusters
 
 	FBXSkeleton* skeleton = nullptr;
 
-	void initBuffers(ID3D11Device* device) override;
+	void createBuffers(RenderDevice* device) override;
 
 };
 
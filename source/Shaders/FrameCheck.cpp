@@ -0,0 +1,308 @@
+#include "FrameCheck.h"
+
+#include "RenderQueue.h"
+#include "PassRecorder.h"
+#include "FBXScene.h"
+#include "FBXSkinnedMesh.h"
+#include "OcclusionCuller.h"
+#include "DefaultShader.h"
+#include "DepthShader.h"
+#include "NullRenderDevice.h"
+#include "AssetLoader.h"
+#include "AppGlobals.h"
+#include <chrono>
+#include <map>
+#include <set>
+#include <thread>
+
+///binds among commands[from..] that set what the previous bind of the same slot already had; state before from counts as unknown, as it does for flush()
+static unsigned int countRedundantBinds(const std::vector<RecordedCommand>& commands, size_t from) {
+	std::map<std::pair<int, unsigned int>, RecordedCommand> bound;//by type, and stage or input slot
+	unsigned int redundant = 0;
+	for (size_t i = from; i < commands.size(); ++i) {
+		const RecordedCommand& command = commands[i];
+		unsigned int slot;
+		switch (command.type) {
+		case COMMAND_SET_LAYOUT: case COMMAND_SET_INDEX_BUFFER: case COMMAND_SET_TOPOLOGY: slot = 0; break;
+		case COMMAND_SET_SHADER: slot = command.a; break;//stage
+		case COMMAND_SET_VERTEX_BUFFER: slot = command.c; break;//input slot; a and b are the stride and offset
+		default: continue;
+		}
+		auto previous = bound.find(std::make_pair(command.type, slot));
+		if (previous != bound.end() && previous->second.object == command.object && previous->second.a == command.a && previous->second.b == command.b && previous->second.c == command.c)
+			++redundant;
+		bound[std::make_pair(command.type, slot)] = command;
+	}
+	return redundant;
+}
+
+///whether two recordings of the same view are the same; constant writes land wherever the transient ring was up to, so only their order has to match
+static bool sameCommands(const std::vector<RecordedCommand>& a, const std::vector<RecordedCommand>& b) {
+	if (a.size() != b.size()) return false;
+	for (size_t i = 0; i < a.size(); ++i) {
+		if (a[i].type != b[i].type) return false;
+		if (a[i].type == COMMAND_MAP || a[i].type == COMMAND_SET_CONSTANTS || a[i].type == COMMAND_CREATE_BUFFER) continue;
+		if (a[i].object != b[i].object || a[i].a != b[i].a || a[i].b != b[i].b || a[i].c != b[i].c) return false;
+	}
+	return true;
+}
+
+///a scene loaded onto a null device, along with the device and its transient buffers, all in GLOBALS too
+struct NullScene {
+	NullRenderDevice* backend;
+	TransientBuffer* constants;
+	TransientBuffer* vertices;
+	FBXScene* scene;
+};
+
+///no D3D11 device at all: everything gets created on, and drawn to, the null one. Same page sizes as the app's.
+///The scene and its textures are all in by the time this returns, so that every frame after sees the same ones
+static NullScene loadScene(const std::string& sceneFile, bool record) {
+	GLOBALS.Device = nullptr;
+	GLOBALS.DeviceContext = nullptr;
+	GLOBALS.Hwnd = nullptr;
+	NullScene loaded;
+	loaded.backend = new NullRenderDevice(record);
+	loaded.constants = new TransientBuffer(loaded.backend, BUFFER_CONSTANT, 256 * 1024, 64);
+	loaded.vertices = new TransientBuffer(loaded.backend, BUFFER_VERTEX, 64 * 1024, 16);
+	loaded.backend->setTransientBuffers(loaded.constants, loaded.vertices);
+	GLOBALS.Backend = loaded.backend;
+	GLOBALS.TransientConstants = loaded.constants;
+	GLOBALS.TransientVertices = loaded.vertices;
+	GLOBALS.Assets = new AssetLoader(loaded.backend, (int)std::thread::hardware_concurrency() - 1);
+
+	FBXScene::Init();
+	FBXImportArgs fbxArgs;//same as the app's scene
+	loaded.scene = new FBXScene(sceneFile, fbxArgs);
+	loaded.scene->upload(loaded.backend);
+	return loaded;
+}
+
+///lets the loader finish whatever was asked of it since loadScene() (shaders' bytecode, textures), then places the scene
+static void finishLoading(NullScene& loaded) {
+	while (!GLOBALS.Assets->isIdle()) {
+		GLOBALS.Assets->pump();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	loaded.scene->getRoot()->update();
+}
+
+///shaders have to be gone first, since they release through GLOBALS.Backend
+static void unloadScene(NullScene& loaded) {
+	delete loaded.scene;
+	FBXScene::Release();
+	delete GLOBALS.Assets;
+	GLOBALS.Assets = nullptr;
+	delete loaded.constants;
+	delete loaded.vertices;
+	delete loaded.backend;
+	GLOBALS.Backend = nullptr;
+	GLOBALS.TransientConstants = GLOBALS.TransientVertices = nullptr;
+}
+
+int FrameCheck::validate(const std::string& sceneFile) {
+	//the second run has to see the very same textures as the first
+	NullScene loaded = loadScene(sceneFile, true);
+	NullRenderDevice* backend = loaded.backend;
+	TransientBuffer* constants = loaded.constants;
+	TransientBuffer* vertices = loaded.vertices;
+	FBXScene* scene = loaded.scene;
+	DefaultShader* shader = new DefaultShader;
+	DepthShader* depthShader = new DepthShader;
+	finishLoading(loaded);
+	OcclusionCuller culler(1);
+	scene->addOccluders(&culler);
+
+	//same walk as OcclusionCuller::benchmark()
+	std::vector<XMVECTOR> positions;
+	std::vector<XMMATRIX> views;
+	for (int stop = 0; stop < 8; ++stop) {
+		for (int direction = 0; direction < 4; ++direction) {
+			float yaw = direction * XM_PIDIV2;
+			positions.push_back(XMVectorSet(-20.f + stop * 8.f, 4, 0, 1));
+			views.push_back(XMMatrixLookToLH(positions.back(), XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		}
+	}
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3, 16.f / 9.f, 0.1f, 200.f);
+
+	RenderQueue queue;
+	queue.setLevelOfDetail(1080.f, 1.f);
+	std::vector<std::vector<RecordedCommand>> firstRun(views.size());
+	RenderQueueStats totals;
+	unsigned int redundant = 0, mismatches = 0, differentViews = 0;
+	std::set<size_t> failedViews;
+	float total = 0;
+	for (int run = 0; run < 2; ++run) {
+		for (size_t i = 0; i < views.size(); ++i) {
+			XMFLOAT3 cameraPosition;
+			XMStoreFloat3(&cameraPosition, positions[i]);
+			backend->reset();
+			queue.resetStats();
+			auto start = std::chrono::high_resolution_clock::now();
+
+			//as App::render() does it: depth, then the lit pass over a depth pre-pass of its own, all culled against the occluders
+			culler.render(views[i], projection);
+			queue.begin(views[i], projection, cameraPosition, &culler);
+			scene->submit(&queue, depthShader, TOPOLOGY_TRIANGLELIST, &culler);
+			size_t from = backend->getCommands().size();
+			queue.flush(backend);
+			unsigned int rebound = countRedundantBinds(backend->getCommands(), from);
+			queue.begin(views[i], projection, cameraPosition, &culler);
+			scene->submit(&queue, shader, TOPOLOGY_TRIANGLELIST, &culler);
+			from = backend->getCommands().size();
+			queue.flush(backend, true);
+			rebound += countRedundantBinds(backend->getCommands(), from);
+			from = backend->getCommands().size();
+			queue.flush(backend);
+			rebound += countRedundantBinds(backend->getCommands(), from);
+			redundant += rebound;
+			constants->endFrame(backend);
+			vertices->endFrame(backend);
+
+			float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			const RenderQueueStats& stats = queue.getStats();
+			unsigned int stages = backend->getCount(COMMAND_SET_LAYOUT) + backend->getCount(COMMAND_SET_SHADER);
+			unsigned int inputs = backend->getCount(COMMAND_SET_VERTEX_BUFFER) + backend->getCount(COMMAND_SET_INDEX_BUFFER) + backend->getCount(COMMAND_SET_TOPOLOGY);
+			unsigned int draws = backend->getCount(COMMAND_DRAW_INDEXED) + backend->getCount(COMMAND_DRAW_INSTANCED) + backend->getCount(COMMAND_DRAW_INDIRECT);
+			unsigned int indirect = backend->getCount(COMMAND_DRAW_INDIRECT);
+			bool mismatch = stages != stats.shaderStages || inputs != stats.inputBinds || draws != stats.deviceDraws || indirect != stats.indirectDraws;
+			if (mismatch && mismatches++ == 0)
+				printf("Error: view %d made %u stage binds, %u input binds, %u draw calls and %u indirect ones on the device, where the queue counted %u, %u, %u and %u.\n",
+					(int)i, stages, inputs, draws, indirect, stats.shaderStages, stats.inputBinds, stats.deviceDraws, stats.indirectDraws);
+			bool failed = mismatch || rebound > 0;
+
+			if (run == 0)
+				firstRun[i] = backend->getCommands();
+			else {
+				if (!sameCommands(firstRun[i], backend->getCommands())) {
+					++differentViews;
+					failed = true;
+				}
+				total += time;
+				totals += stats;
+			}
+			if (failed) failedViews.insert(i);
+		}
+	}
+
+	int count = (int)views.size();
+	printf("Frame check: %d views of %s, %.3fms per view on average (occlusion, sorting and recording a depth and a lit pass).\n", count, sceneFile.c_str(), total / count);
+	printf("Per view: %u draws (%u draw calls), %u stage binds (%u skipped), %u input binds (%u skipped), %u constant writes (%u skipped), %u texture binds (%u skipped).\n", totals.draws / count, totals.deviceDraws / count,
+		totals.shaderStages / count, totals.shaderStagesSkipped / count, totals.inputBinds / count, totals.inputBindsSkipped / count,
+		totals.bufferUpdates / count, totals.bufferUpdatesSkipped / count, totals.textureBinds / count, totals.textureBindsSkipped / count);
+	if (mismatches > 0)
+		printf("Error: %u views didn't make the binds and draws the queue counted.\n", mismatches);
+	if (redundant > 0)
+		printf("Error: %u binds were of what was already bound.\n", redundant);
+	if (differentViews > 0)
+		printf("Error: %d views recorded different commands the second time.\n", differentViews);
+	if (mismatches == 0 && redundant == 0 && differentViews == 0)
+		printf("Every view made exactly the binds and draw calls the queue counted, none twice, and recorded the same commands both times.\n");
+
+	delete shader;
+	delete depthShader;
+	unloadScene(loaded);
+	return (int)failedViews.size();
+}
+
+void FrameCheck::benchmarkPasses(const std::string& sceneFile, int passes, int tiles, int maxWorkers, int frames) {
+	NullScene loaded = loadScene(sceneFile, false);//only counting, so nothing grows from one frame to the next
+	NullRenderDevice* backend = loaded.backend;
+	FBXScene* scene = loaded.scene;
+	DepthShader* shader = new DepthShader;//what the app's shadow passes use
+	finishLoading(loaded);
+
+	//copies of the scene side by side on a tiles x tiles grid, each as far from the next as the scene is wide
+	std::vector<BoundingBox> meshBounds;
+	scene->getBounds(meshBounds);
+	if (meshBounds.empty()) {
+		printf("Error: %s has no meshes to draw.\n", sceneFile.c_str());
+		delete shader;
+		unloadScene(loaded);
+		return;
+	}
+	BoundingBox bounds = meshBounds[0];
+	for (const BoundingBox& box : meshBounds)
+		BoundingBox::CreateMerged(bounds, bounds, box);
+	float spacingX = bounds.Extents.x * 2, spacingZ = bounds.Extents.z * 2;
+	std::vector<XMFLOAT4X4> offsets;
+	for (int x = 0; x < tiles; ++x) {
+		for (int z = 0; z < tiles; ++z) {
+			XMFLOAT4X4 offset;
+			XMStoreFloat4x4(&offset, XMMatrixTranslation((x - (tiles - 1) * 0.5f) * spacingX, 0, (z - (tiles - 1) * 0.5f) * spacingZ));
+			offsets.push_back(offset);
+		}
+	}
+	float radius = sqrtf(spacingX * spacingX + spacingZ * spacingZ) * tiles * 0.5f + bounds.Extents.y;
+
+	//each pass is a shadow pass as App::render() records it, from a light circling above the grid with an ortho frustum over all of it:
+	//every tile's meshes submitted to the pass' own queue, as FBXScene::submit() does, then flushed
+	std::vector<RenderQueue> queues(passes);
+	auto pass = [&](RenderDevice* recorder, int index) {
+		float angle = index * XM_2PI / passes;
+		XMVECTOR centre = XMLoadFloat3(&bounds.Center);
+		XMVECTOR position = XMVectorAdd(centre, XMVectorSet(cosf(angle) * radius, radius, sinf(angle) * radius, 0));
+		XMMATRIX view = XMMatrixLookAtLH(position, centre, XMVectorSet(0, 1, 0, 0));
+		XMMATRIX projection = XMMatrixOrthographicLH(radius * 2, radius * 2, 0.1f, radius * 4);
+		XMFLOAT3 cameraPosition;
+		XMStoreFloat3(&cameraPosition, position);
+		RenderQueue& queue = queues[index];
+		queue.setLevelOfDetail(2048.f, 4.f);//same as LOD_SHADOW_PIXEL_ERROR, at the app's largest shadowmaps
+		queue.begin(view, projection, cameraPosition);
+		for (const XMFLOAT4X4& offset : offsets) {
+			XMMATRIX tile = XMLoadFloat4x4(&offset);
+			for (int i = 0; i < scene->meshCount(); ++i) {
+				FBXMesh* mesh = scene->getMesh(i);
+				if (dynamic_cast<FBXSkinnedMesh*>(mesh)) continue;//placed by their bones, which this doesn't animate
+				queue.submit(shader, mesh, XMLoadFloat4x4(&scene->getMeshNode(i)->getWorld()) * tile, TOPOLOGY_TRIANGLELIST);
+			}
+		}
+		queue.flush(recorder);
+	};
+
+	PassRecorder recorder(backend, 64 * 1024, 64 * 1024, 64);
+	printf("Recording %d shadow passes of %s, tiled %dx%d, %d frames per worker count.\n", passes, sceneFile.c_str(), tiles, tiles, frames);
+	float serial = 0;
+	for (int count = 0; count <= maxWorkers && count <= PASS_RECORDER_MAX_WORKERS; ++count) {
+		recorder.setWorkers(count);
+		if (recorder.getWorkers() != count) break;
+
+		float total = 0, worst = 0, recording = 0;
+		unsigned int draws = 0, deviceDraws = 0, mismatches = 0;
+		for (int frame = -1; frame < frames; ++frame) {//first frame warms up the pages
+			backend->reset();
+			for (RenderQueue& queue : queues) queue.resetStats();
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < passes; ++i)
+				recorder.add([&pass, i](RenderDevice* target) { pass(target, i); });
+			recorder.run();
+			loaded.constants->endFrame(backend);
+			loaded.vertices->endFrame(backend);
+			float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			RenderQueueStats stats;
+			for (RenderQueue& queue : queues) stats += queue.getStats();
+			unsigned int made = backend->getCount(COMMAND_DRAW_INDEXED) + backend->getCount(COMMAND_DRAW_INSTANCED) + backend->getCount(COMMAND_DRAW_INDIRECT);
+			if (made != stats.deviceDraws && mismatches++ == 0)
+				printf("Error: %u draw calls made it to the device, where the queues made %u.\n", made, stats.deviceDraws);
+			if (frame < 0) continue;
+			total += time;
+			recording += recorder.getRecordTime();
+			if (time > worst) worst = time;
+			draws = stats.draws;
+			deviceDraws = stats.deviceDraws;
+		}
+
+		float average = total / frames;
+		if (count == 0) {
+			serial = average;
+			printf("%u draws per frame (%u per pass), in %u draw calls.\n", draws, draws / passes, deviceDraws);
+		}
+		printf("%d workers: %.3fms per frame (%.3fms recording), %.3fms at worst, %.2fx %s\n", count, average, recording / frames, worst, serial / average, count == 0 ? "(no command lists)" : "");
+		if (mismatches > 0)
+			printf("Error: %u frames didn't make the draw calls the queues counted.\n", mismatches);
+	}
+
+	delete shader;
+	unloadScene(loaded);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/// Headless runs of a real scene through the render queue onto a NullRenderDevice: a check of a whole frame's draws, and a benchmark of recording shadow passes in parallel.
+/// Everything, shaders, meshes and textures included, is created on the null device, so no window, gpu or D3D11 device is needed.
+/// Kept out of RenderQueue and PassRecorder so that the app doesn't carry any of it.
+
+#include <string>
+
+class FrameCheck {
+
+public:
+	///the scene seen from a walk down the street, occlusion culled, then drawn as a depth pass and a lit pass, twice. Checks that every view makes exactly the
+	///stage binds, input binds and draw calls the queue's stats count, that nothing already bound gets bound again and that both runs record the same commands;
+	///prints cpu time per view. Returns the number of views that failed any of those
+	static int validate(const std::string& sceneFile);
+	///records frames of passes shadow passes over tiles x tiles copies of the scene (thousands of draws each, from the scene's own meshes, instances and batches),
+	///with every worker count up to maxWorkers, and prints cpu time per frame for each; checks the device got exactly the draw calls the queues counted
+	static void benchmarkPasses(const std::string& sceneFile, int passes, int tiles, int maxWorkers, int frames);
+
+};
@@ -11,7 +11,7 @@ GaussianBlurShader::GaussianBlurShader(bool load){
 }
 
 GaussianBlurShader::~GaussianBlurShader(){
-	gaussianBuffer->Release();
+	GLOBALS.Backend->releaseBuffer(gaussianBuffer);
 }
 
 void GaussianBlurShader::initBuffers() {
@@ -20,16 +20,14 @@ void GaussianBlurShader::initBuffers() {
 	SETUP_SHADER_BUFFER(GaussianBlurType, gaussianBuffer);
 }
 
-void GaussianBlurShader::setBlur(){
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void GaussianBlurShader::setBlur(RenderDevice* device){
 
 	//Send blur data
-	GaussianBlurType* gbPtr;
-	GLOBALS.DeviceContext->Map(gaussianBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	gbPtr = (GaussianBlurType*)mappedResource.pData;
+	GaussianBlurType* gbPtr = (GaussianBlurType*)device->map(gaussianBuffer, false);
+	if (!gbPtr) return;
 	gbPtr->direction = horizontal ? 0 : 1;
 	gbPtr->neighbours = distance;
-	gbPtr->oneOverScreenSize = XMFLOAT2(1.0f / GLOBALS.ScreenWidth, 1.0f / GLOBALS.ScreenHeight);
+	gbPtr->oneOverScreenSize = texelSize.x > 0 ? texelSize : XMFLOAT2(1.0f / GLOBALS.ScreenWidth, 1.0f / GLOBALS.ScreenHeight);
 	float totalWeight = 0;
 	int i = 0;
 	for (; i < int(gbPtr->neighbours); ++i) {
@@ -46,8 +44,8 @@ void GaussianBlurShader::setBlur(){
 	for (int i = 0; i < int(gbPtr->neighbours); ++i) {
 		gbPtr->weights[i] /= totalWeight;
 	}
-	GLOBALS.DeviceContext->Unmap(gaussianBuffer, 0);
-	GLOBALS.DeviceContext->PSSetConstantBuffers(0, 1, &gaussianBuffer);
+	device->unmap(gaussianBuffer);
+	device->setConstantBuffer(STAGE_PS, 0, gaussianBuffer);
 
 }
 
@@ -16,16 +16,17 @@ public:
 	GaussianBlurShader(bool load = true);
 	virtual ~GaussianBlurShader();
 
-	void setBlur();
+	void setBlur(RenderDevice* device);
 
 	bool horizontal = true;
 	float distance = 5.0f;
+	XMFLOAT2 texelSize = XMFLOAT2(0, 0);//size of a texel in the source texture; left at 0, uses the screen's
 
 protected:
 	virtual void initBuffers() override;
 
 private:
-	ID3D11Buffer* gaussianBuffer;
+	GpuBuffer* gaussianBuffer = nullptr;
 
 	float gaussian(float x, int width);
 };
@@ -0,0 +1,312 @@
+#include "HiZCuller.h"
+
+#include "AppGlobals.h"
+#include "Shader.h"//for SHADER_PATH and readBytecode()
+#include <algorithm>
+#include <cmath>
+
+///Same as Shader::loadStage(), for a compute shader; null if it can't be loaded
+static GpuShader* loadComputeShader(const wchar_t* filename) {
+	std::vector<char> bytes;
+	if (!Shader::readBytecode(filename, bytes, "compute")) return nullptr;
+	std::wstring wfilename(filename);
+	GpuShader* shader = GLOBALS.Backend->createShader(STAGE_CS, bytes.data(), bytes.size());
+	if (!shader)
+		printf("Error: could not load compiled compute shader %s...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
+	return shader;
+}
+
+HiZCuller::HiZCuller() {
+	memset(levelViews, 0, sizeof(levelViews));
+	memset(levelTargets, 0, sizeof(levelTargets));
+	XMStoreFloat4x4(&previousViewProjection, XMMatrixIdentity());
+	cullBlock.init(GLOBALS.Backend);
+	buildShader = loadComputeShader(L"" SHADER_PATH "hiz_cs.cso");
+	cullShader = loadComputeShader(L"" SHADER_PATH "hizcull_cs.cso");
+}
+
+HiZCuller::~HiZCuller() {
+	releasePyramid();
+	GLOBALS.Backend->releaseView(drawView);
+	GLOBALS.Backend->releaseBuffer(drawBuffer);
+	GLOBALS.Backend->releaseView(argumentsView);
+	GLOBALS.Backend->releaseBuffer(arguments);
+	GLOBALS.Backend->releaseShader(buildShader);
+	GLOBALS.Backend->releaseShader(cullShader);
+}
+
+unsigned int HiZCuller::addDraw(const BoundingBox& bounds, unsigned int indexCount) {
+	if (arguments) {
+		printf("Error: draws can't be added to the hi-z culler once it has started culling.\n");
+		return 0;
+	}
+	HiZDraw draw;
+	draw.center = bounds.Center;
+	draw.extents = bounds.Extents;
+	draw.indexCount = indexCount;
+	draw.padding = 0;
+	draws.push_back(draw);
+	return (unsigned int)(draws.size() - 1) * INDIRECT_ARGS_SIZE;
+}
+
+bool HiZCuller::createBuffers(RenderDevice* device) {
+	drawBuffer = device->createShaderBuffer((unsigned int)draws.size(), sizeof(HiZDraw), FORMAT_UNKNOWN, &drawView);
+	if (!drawBuffer) return false;
+	void* mapped = device->map(drawBuffer, false);
+	if (!mapped) return false;
+	memcpy(mapped, &draws[0], draws.size() * sizeof(HiZDraw));
+	device->unmap(drawBuffer);
+
+	//everything starts out visible, in case a draw comes before the first cull
+	std::vector<unsigned int> initial(draws.size() * INDIRECT_ARGS_COUNT, 0);
+	for (size_t i = 0; i < draws.size(); ++i) {
+		initial[i * INDIRECT_ARGS_COUNT] = draws[i].indexCount;
+		initial[i * INDIRECT_ARGS_COUNT + 1] = 1;
+	}
+	arguments = device->createIndirectBuffer((unsigned int)initial.size(), &initial[0], &argumentsView);
+	return arguments != nullptr;
+}
+
+bool HiZCuller::createPyramid(int width, int height) {
+	releasePyramid();
+	int levelWidth, levelHeight;
+	HiZPyramid::levelSize(width, height, 0, levelWidth, levelHeight);
+
+	D3D11_TEXTURE2D_DESC desc;
+	ZeroMemory(&desc, sizeof(desc));
+	desc.Width = levelWidth;
+	desc.Height = levelHeight;
+	desc.MipLevels = HiZPyramid::levelCount(width, height);
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R32_FLOAT;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+	if (GLOBALS.Device->CreateTexture2D(&desc, NULL, &pyramid) != S_OK) {
+		printf("Error: could not create %dx%d hi-z pyramid.\n", levelWidth, levelHeight);
+		return false;
+	}
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	ZeroMemory(&srvDesc, sizeof(srvDesc));
+	srvDesc.Format = desc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = desc.MipLevels;
+	GLOBALS.Device->CreateShaderResourceView(pyramid, &srvDesc, &pyramidView);
+
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc;
+	ZeroMemory(&uavDesc, sizeof(uavDesc));
+	uavDesc.Format = desc.Format;
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D;
+	for (int level = 0; level < (int)desc.MipLevels; ++level) {
+		srvDesc.Texture2D.MostDetailedMip = level;
+		srvDesc.Texture2D.MipLevels = 1;
+		GLOBALS.Device->CreateShaderResourceView(pyramid, &srvDesc, &levelViews[level]);
+		uavDesc.Texture2D.MipSlice = level;
+		GLOBALS.Device->CreateUnorderedAccessView(pyramid, &uavDesc, &levelTargets[level]);
+	}
+
+	levels = desc.MipLevels;
+	depthWidth = width;
+	depthHeight = height;
+	return true;
+}
+
+void HiZCuller::releasePyramid() {
+	for (int level = 0; level < HIZ_MAX_LEVELS; ++level) {
+		if (levelViews[level]) levelViews[level]->Release();
+		if (levelTargets[level]) levelTargets[level]->Release();
+		levelViews[level] = nullptr;
+		levelTargets[level] = nullptr;
+	}
+	if (pyramidView) pyramidView->Release();
+	if (pyramid) pyramid->Release();
+	pyramidView = nullptr;
+	pyramid = nullptr;
+	levels = depthWidth = depthHeight = 0;
+	pyramidReady = false;
+}
+
+void HiZCuller::cull(RenderDevice* device, const XMMATRIX& viewProjection) {
+	if (draws.empty() || !cullShader) return;
+	if (!arguments && !createBuffers(device)) return;
+
+	CullConstants constants;
+	memset(&constants, 0, sizeof(constants));
+	XMStoreFloat4x4(&constants.viewProjection, XMMatrixTranspose(viewProjection));
+	XMStoreFloat4x4(&constants.previousViewProjection, XMMatrixTranspose(XMLoadFloat4x4(&previousViewProjection)));
+	constants.depthSize = XMFLOAT2((float)depthWidth, (float)depthHeight);
+	constants.drawCount = (unsigned int)draws.size();
+	constants.levels = pyramidReady ? levels : 0;
+	cullBlock.update(device, constants);
+
+	device->setShader(STAGE_CS, cullShader);
+	cullBlock.bind(device, STAGE_CS, 0);
+	GpuView* views[2] = { drawView, pyramidReady ? D3D11RenderDevice::handle(pyramidView) : nullptr };
+	device->setShaderResources(STAGE_CS, 0, 2, views);
+	device->setUnorderedViews(0, 1, &argumentsView);
+	device->dispatch(((unsigned int)draws.size() + HIZ_CULL_GROUP - 1) / HIZ_CULL_GROUP);
+
+	//unbind everything, so the arguments can be drawn with and the pyramid rebuilt
+	GpuView* noViews[2] = { nullptr, nullptr };
+	GpuUnorderedView* noTarget = nullptr;
+	device->setShaderResources(STAGE_CS, 0, 2, noViews);
+	device->setUnorderedViews(0, 1, &noTarget);
+	device->setShader(STAGE_CS, nullptr);
+
+	if (validating)
+		validateCull(viewProjection, constants.levels > 0);
+	pyramidReady = false;
+}
+
+void HiZCuller::build(RenderDevice* device, GpuView* depth, const XMMATRIX& viewProjection) {
+	if (!depth || !buildShader) return;
+	ID3D11Resource* resource = nullptr;
+	D3D11RenderDevice::get(depth)->GetResource(&resource);
+	ID3D11Texture2D* depthTexture = static_cast<ID3D11Texture2D*>(resource);
+	D3D11_TEXTURE2D_DESC desc;
+	depthTexture->GetDesc(&desc);
+	if (((int)desc.Width != depthWidth || (int)desc.Height != depthHeight) && !createPyramid(desc.Width, desc.Height)) {
+		resource->Release();
+		return;
+	}
+
+	//the depth buffer can't be read while it's bound
+	Viewport viewport = { 0, 0, (float)desc.Width, (float)desc.Height, 0, 1 };
+	device->setRenderTarget(nullptr, nullptr, viewport);
+
+	device->setShader(STAGE_CS, buildShader);
+	GpuView* noView = nullptr;
+	GpuUnorderedView* noTarget = nullptr;
+	for (int level = 0; level < levels; ++level) {
+		int width, height;
+		HiZPyramid::levelSize(depthWidth, depthHeight, level, width, height);
+		GpuView* source = level == 0 ? depth : D3D11RenderDevice::handle(levelViews[level - 1]);
+		GpuUnorderedView* target = D3D11RenderDevice::handle(levelTargets[level]);
+		device->setShaderResources(STAGE_CS, 0, 1, &source);
+		device->setUnorderedViews(0, 1, &target);
+		device->dispatch((width + HIZ_BUILD_GROUP - 1) / HIZ_BUILD_GROUP, (height + HIZ_BUILD_GROUP - 1) / HIZ_BUILD_GROUP);
+		//this level gets read next, so it can't stay bound for writing
+		device->setUnorderedViews(0, 1, &noTarget);
+		device->setShaderResources(STAGE_CS, 0, 1, &noView);
+	}
+	device->setShader(STAGE_CS, nullptr);
+
+	XMStoreFloat4x4(&previousViewProjection, viewProjection);
+	pyramidReady = true;
+
+	if (validatingBuild)
+		validateBuild(depthTexture);
+	resource->Release();
+}
+
+
+// ** validation: read backs go straight through the immediate context, since they have to wait for the gpu anyway ** //
+
+///every mip of a texture, as floats; depth textures (R24G8) get their 24 bits of depth turned into [0, 1]
+static bool readTexture(ID3D11Texture2D* texture, std::vector<std::vector<float>>& out_levels) {
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+	bool depth24 = desc.Format == DXGI_FORMAT_R24G8_TYPELESS;
+	if (!depth24 && desc.Format != DXGI_FORMAT_R32_FLOAT) {
+		printf("Error: can't read back textures of format %d.\n", (int)desc.Format);
+		return false;
+	}
+	desc.Usage = D3D11_USAGE_STAGING;
+	desc.BindFlags = 0;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+	desc.MiscFlags = 0;
+	ID3D11Texture2D* staging = nullptr;
+	if (GLOBALS.Device->CreateTexture2D(&desc, NULL, &staging) != S_OK) {
+		printf("Error: could not create staging texture.\n");
+		return false;
+	}
+	GLOBALS.DeviceContext->CopyResource(staging, texture);
+
+	out_levels.resize(desc.MipLevels);
+	for (UINT level = 0; level < desc.MipLevels; ++level) {
+		UINT width = (std::max)(desc.Width >> level, 1u), height = (std::max)(desc.Height >> level, 1u);
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		if (GLOBALS.DeviceContext->Map(staging, level, D3D11_MAP_READ, 0, &mapped) != S_OK) {
+			printf("Error: could not map staging texture.\n");
+			staging->Release();
+			return false;
+		}
+		out_levels[level].resize(width * height);
+		for (UINT y = 0; y < height; ++y) {
+			const unsigned char* row = (const unsigned char*)mapped.pData + y * mapped.RowPitch;
+			for (UINT x = 0; x < width; ++x)
+				out_levels[level][y * width + x] = depth24 ? (((const unsigned int*)row)[x] & 0xFFFFFF) / 16777215.f : ((const float*)row)[x];
+		}
+		GLOBALS.DeviceContext->Unmap(staging, level);
+	}
+	staging->Release();
+	return true;
+}
+
+static bool readBuffer(GpuBuffer* buffer, std::vector<unsigned int>& out_values) {
+	std::vector<unsigned char> bytes;
+	if (!GLOBALS.Backend->readBuffer(buffer, bytes)) return false;
+	out_values.resize(bytes.size() / sizeof(unsigned int));
+	memcpy(&out_values[0], &bytes[0], out_values.size() * sizeof(unsigned int));
+	return true;
+}
+
+void HiZCuller::validateCull(const XMMATRIX& viewProjection, bool occlusion) {
+	validating = false;
+	std::vector<unsigned int> args;
+	std::vector<std::vector<float>> levelData;
+	if (!readBuffer(arguments, args) || (occlusion && !readTexture(pyramid, levelData))) {
+		validation = "Hi-Z validation failed: could not read back the gpu's results.";
+		return;
+	}
+
+	//the same test, against the very same pyramid
+	HiZPyramid reference;
+	if (occlusion)
+		reference.setLevels(levelData, depthWidth, depthHeight);
+	XMMATRIX previous = XMLoadFloat4x4(&previousViewProjection);
+	unsigned int visibleGpu = 0, visibleCpu = 0, differ = 0;
+	for (size_t i = 0; i < draws.size(); ++i) {
+		BoundingBox box(draws[i].center, draws[i].extents);
+		bool expected = HiZPyramid::isVisible(occlusion ? &reference : nullptr, box, viewProjection, previous);
+		const unsigned int* drawArgs = &args[i * INDIRECT_ARGS_COUNT];
+		bool visible = drawArgs[1] > 0;
+		if (visible) ++visibleGpu;
+		if (expected) ++visibleCpu;
+		if (visible != expected || drawArgs[0] != draws[i].indexCount) ++differ;
+	}
+
+	char text[256];
+	sprintf_s(text, "Hi-Z cull (%s): %u of %u draws visible on the gpu, %u on the cpu, %u differ.", occlusion ? "frustum and pyramid" : "frustum only", visibleGpu, (unsigned int)draws.size(), visibleCpu, differ);
+	validation = text;
+	printf("%s\n", text);
+	validatingBuild = true;
+}
+
+void HiZCuller::validateBuild(ID3D11Texture2D* depth) {
+	validatingBuild = false;
+	std::vector<std::vector<float>> depthData, levelData;
+	if (!readTexture(depth, depthData) || !readTexture(pyramid, levelData)) {
+		validation += "\nHi-Z build validation failed: could not read back the gpu's results.";
+		return;
+	}
+
+	HiZPyramid reference;
+	reference.build(&depthData[0][0], depthWidth, depthHeight);
+	unsigned int texels = 0, differ = 0;
+	for (int level = 0; level < levels && level < reference.getLevels(); ++level) {
+		const std::vector<float>& expected = reference.getLevel(level);
+		for (size_t i = 0; i < expected.size() && i < levelData[level].size(); ++i) {
+			++texels;
+			if (fabsf(expected[i] - levelData[level][i]) > 1e-6f) ++differ;//depth gets turned into floats slightly differently
+		}
+	}
+
+	char text[256];
+	sprintf_s(text, "Hi-Z build: %d levels from %dx%d, %u of %u texels differ.", levels, depthWidth, depthHeight, differ, texels);
+	validation += "\n";
+	validation += text;
+	printf("%s\n", text);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+/// Hierarchical-z occlusion culling on the gpu, for the scene's static meshes. At the end of the main pass, hiz_cs.hlsl turns its depth buffer into a pyramid
+/// (see HiZPyramid); early the next frame, hizcull_cs.hlsl tests every static mesh's bounds against the frustum and that pyramid, and writes each one's
+/// indirect draw arguments, with no instances when it's hidden. The cpu never waits to find out what got culled; the draws are all submitted either way.
+/// The pyramid is a frame old: whatever moved in front of the camera since (the robot) can hide what's behind it for a frame.
+/// Like RenderTarget, the pyramid's texture and per level views are still made on the D3D11 device, and handed to the backend as handles.
+
+#include "D3D11RenderDevice.h"
+#include "ConstantBlock.h"
+#include "HiZPyramid.h"
+#include <string>
+
+class HiZCuller {
+
+protected:
+	///hizcull_cs.hlsl's constants
+	struct CullConstants {
+		XMFLOAT4X4 viewProjection;//transposed, like every matrix the shaders get
+		XMFLOAT4X4 previousViewProjection;
+		XMFLOAT2 depthSize;
+		unsigned int drawCount;
+		unsigned int levels;
+	};
+
+public:
+	HiZCuller();
+	~HiZCuller();
+
+	///adds a static mesh, with world space bounds; returns where its arguments will be in getArguments(), in bytes. Only before the first cull()
+	unsigned int addDraw(const BoundingBox& bounds, unsigned int indexCount);
+
+	///writes this frame's arguments for every draw: the frustum is viewProjection's, occlusion comes from last frame's build(), if there was one
+	void cull(RenderDevice* device, const XMMATRIX& viewProjection);
+	///rebuilds the pyramid from a depth buffer (a RenderTarget's, as seen through viewProjection), for the next cull() to test against.
+	///Unbinds the render target so the depth buffer can be read
+	void build(RenderDevice* device, GpuView* depth, const XMMATRIX& viewProjection);
+
+	///draw arguments, INDIRECT_ARGS_SIZE bytes each; null until the first cull()
+	inline GpuBuffer* getArguments() { return arguments; }
+	inline unsigned int getDrawCount() { return (unsigned int)draws.size(); }
+
+	///reads back what the next cull() and build() read and write on the gpu, redoes them on the cpu with HiZPyramid, and keeps the differences
+	///for getValidation(). Stalls, so only for checking the shaders against their reference
+	inline void validateNextFrame() { validating = true; }
+	inline const std::string& getValidation() { return validation; }
+
+protected:
+	std::vector<HiZDraw> draws;
+	GpuBuffer* drawBuffer = nullptr;
+	GpuView* drawView = nullptr;
+	GpuBuffer* arguments = nullptr;
+	GpuUnorderedView* argumentsView = nullptr;
+
+	GpuShader* buildShader = nullptr;
+	GpuShader* cullShader = nullptr;
+	ConstantBlock<CullConstants> cullBlock;
+
+	//the pyramid, with a view of every level for cull(), and one per level for build() to read and write
+	ID3D11Texture2D* pyramid = nullptr;
+	ID3D11ShaderResourceView* pyramidView = nullptr;
+	ID3D11ShaderResourceView* levelViews[HIZ_MAX_LEVELS];
+	ID3D11UnorderedAccessView* levelTargets[HIZ_MAX_LEVELS];
+	int levels = 0;
+	int depthWidth = 0, depthHeight = 0;
+	XMFLOAT4X4 previousViewProjection;//what the pyramid was built with
+	bool pyramidReady = false;//built since the last cull()
+
+	bool validating = false;
+	bool validatingBuild = false;//cull() checked out, build() is next
+	std::string validation;
+
+	///creates the draw and argument buffers, once every draw has been added
+	bool createBuffers(RenderDevice* device);
+	///(re)creates the pyramid for a depth buffer of this size
+	bool createPyramid(int width, int height);
+	void releasePyramid();
+
+	///compares the arguments cull() just wrote with what HiZPyramid makes of the same inputs
+	void validateCull(const XMMATRIX& viewProjection, bool occlusion);
+	///compares the pyramid build() just made with what HiZPyramid makes of the same depth buffer
+	void validateBuild(ID3D11Texture2D* depth);
+
+};
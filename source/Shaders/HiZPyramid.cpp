@@ -0,0 +1,206 @@
+#include "HiZPyramid.h"
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cfloat>
+
+int HiZPyramid::levelCount(int depthWidth, int depthHeight) {
+	if (depthWidth <= 0 || depthHeight <= 0) return 0;
+	int width, height, count = 1;
+	levelSize(depthWidth, depthHeight, 0, width, height);
+	while ((width > 1 || height > 1) && count < HIZ_MAX_LEVELS) {
+		width = (std::max)(width / 2, 1);
+		height = (std::max)(height / 2, 1);
+		++count;
+	}
+	return count;
+}
+
+void HiZPyramid::levelSize(int depthWidth, int depthHeight, int level, int& out_width, int& out_height) {
+	out_width = depthWidth;
+	out_height = depthHeight;
+	for (int i = 0; i <= level; ++i) {
+		out_width = (std::max)(out_width / 2, 1);
+		out_height = (std::max)(out_height / 2, 1);
+	}
+}
+
+void HiZPyramid::downsample(const float* source, int sourceWidth, int sourceHeight, float* out, int width, int height) {
+	for (int y = 0; y < height; ++y) {
+		//the last row and column also take whatever an odd size leaves over
+		int endY = y == height - 1 ? sourceHeight : y * 2 + 2;
+		for (int x = 0; x < width; ++x) {
+			int endX = x == width - 1 ? sourceWidth : x * 2 + 2;
+			float farthest = 0;
+			for (int sy = y * 2; sy < endY; ++sy)
+				for (int sx = x * 2; sx < endX; ++sx)
+					farthest = (std::max)(farthest, source[sy * sourceWidth + sx]);
+			out[y * width + x] = farthest;
+		}
+	}
+}
+
+void HiZPyramid::build(const float* depth, int width, int height) {
+	depthWidth = width;
+	depthHeight = height;
+	levels.resize(levelCount(width, height));
+	const float* source = depth;
+	int sourceWidth = width, sourceHeight = height;
+	for (int level = 0; level < (int)levels.size(); ++level) {
+		int levelWidth, levelHeight;
+		levelSize(width, height, level, levelWidth, levelHeight);
+		levels[level].resize(levelWidth * levelHeight);
+		downsample(source, sourceWidth, sourceHeight, &levels[level][0], levelWidth, levelHeight);
+		source = &levels[level][0];
+		sourceWidth = levelWidth;
+		sourceHeight = levelHeight;
+	}
+}
+
+void HiZPyramid::setLevels(const std::vector<std::vector<float>>& newLevels, int width, int height) {
+	levels = newLevels;
+	depthWidth = width;
+	depthHeight = height;
+}
+
+///false if every corner of box is past the same plane of viewProjection's frustum
+static bool inFrustum(const BoundingBox& box, const XMMATRIX& viewProjection) {
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	int outside[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < (int)BoundingBox::CORNER_COUNT; ++i) {
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), viewProjection));
+		if (clip.x < -clip.w) ++outside[0];
+		if (clip.x > clip.w) ++outside[1];
+		if (clip.y < -clip.w) ++outside[2];
+		if (clip.y > clip.w) ++outside[3];
+		if (clip.z < 0) ++outside[4];
+		if (clip.z > clip.w) ++outside[5];
+	}
+	for (int i = 0; i < 6; ++i)
+		if (outside[i] == BoundingBox::CORNER_COUNT) return false;
+	return true;
+}
+
+///box's rect on a width x height screen, in pixels (min x, min y, max x, max y), and its nearest depth; false if there's no telling, since it crossed the near plane or the screen's edges
+static bool screenRect(const BoundingBox& box, const XMMATRIX& viewProjection, int width, int height, float out_rect[4], float& out_nearest) {
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	out_rect[0] = out_rect[1] = FLT_MAX;
+	out_rect[2] = out_rect[3] = -FLT_MAX;
+	out_nearest = FLT_MAX;
+	for (int i = 0; i < (int)BoundingBox::CORNER_COUNT; ++i) {
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corners[i]), viewProjection));
+		if (clip.w <= 0 || clip.z < 0) return false;
+		float x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+		float y = (0.5f - clip.y / clip.w * 0.5f) * height;
+		out_rect[0] = (std::min)(out_rect[0], x);
+		out_rect[1] = (std::min)(out_rect[1], y);
+		out_rect[2] = (std::max)(out_rect[2], x);
+		out_rect[3] = (std::max)(out_rect[3], y);
+		out_nearest = (std::min)(out_nearest, clip.z / clip.w);
+	}
+	return out_rect[0] >= 0 && out_rect[1] >= 0 && out_rect[2] <= width && out_rect[3] <= height;
+}
+
+bool HiZPyramid::isVisible(const HiZPyramid* pyramid, const BoundingBox& box, const XMMATRIX& viewProjection, const XMMATRIX& previousViewProjection) {
+	if (!inFrustum(box, viewProjection)) return false;
+	if (!pyramid || pyramid->levels.empty()) return true;
+
+	float rect[4], nearest;
+	if (!screenRect(box, previousViewProjection, pyramid->depthWidth, pyramid->depthHeight, rect, nearest)) return true;
+
+	//the first level whose texels are at least as big as the rect, so it spans 2x2 of them at most
+	float extent = (std::max)(rect[2] - rect[0], rect[3] - rect[1]);
+	int levelCount = (int)pyramid->levels.size();
+	int level = 0;
+	while (level < levelCount - 1 && (float)(2 << level) < extent)
+		++level;
+	int width, height;
+	levelSize(pyramid->depthWidth, pyramid->depthHeight, level, width, height);
+	int x0 = texel(rect[0], level, width), x1 = texel(rect[2], level, width);
+	int y0 = texel(rect[1], level, height), y1 = texel(rect[3], level, height);
+
+	const std::vector<float>& texels = pyramid->levels[level];
+	float farthest = (std::max)((std::max)(texels[y0 * width + x0], texels[y0 * width + x1]), (std::max)(texels[y1 * width + x0], texels[y1 * width + x1]));
+	return nearest <= farthest;
+}
+
+void HiZPyramid::toDeviceDepth(const float* inverseDepth, unsigned int count, float nearPlane, float farPlane, float* out) {
+	//a perspective projection's depth is far / (far - near) * (1 - near / z)
+	float scale = farPlane / (farPlane - nearPlane);
+	for (unsigned int i = 0; i < count; ++i)
+		out[i] = (std::min)(scale - scale * nearPlane * inverseDepth[i], 1.f);
+}
+
+///the same test as isVisible(), against every pixel the box covers instead of the pyramid
+static bool isVisibleExact(const std::vector<float>& depth, int width, int height, const BoundingBox& box, const XMMATRIX& viewProjection) {
+	if (!inFrustum(box, viewProjection)) return false;
+	float rect[4], nearest;
+	if (!screenRect(box, viewProjection, width, height, rect, nearest)) return true;
+	int x1 = (std::min)((int)rect[2], width - 1), y1 = (std::min)((int)rect[3], height - 1);
+	for (int y = (int)rect[1]; y <= y1; ++y)
+		for (int x = (int)rect[0]; x <= x1; ++x)
+			if (nearest <= depth[y * width + x]) return true;
+	return false;
+}
+
+void HiZPyramid::validate(const std::vector<std::vector<XMFLOAT3>>& meshes, int frames) {
+	OcclusionCuller culler(1);
+	std::vector<BoundingBox> bounds;
+	for (const std::vector<XMFLOAT3>& mesh : meshes) {
+		if (mesh.empty()) continue;
+		BoundingBox box;
+		BoundingBox::CreateFromPoints(box, mesh.size(), &mesh[0], sizeof(XMFLOAT3));
+		bounds.push_back(box);
+		if (OcclusionCuller::isOccluder(box, (unsigned int)mesh.size() / 3))
+			culler.addOccluder(&mesh[0], (unsigned int)mesh.size(), XMMatrixIdentity());
+	}
+
+	//same walk as OcclusionCuller::benchmark(), with the occluders standing in for last frame's depth buffer
+	const float nearPlane = 0.1f, farPlane = 200.f;
+	std::vector<XMMATRIX> views;
+	for (int stop = 0; stop < 8; ++stop) {
+		for (int direction = 0; direction < 4; ++direction) {
+			float yaw = direction * XM_PIDIV2;
+			views.push_back(XMMatrixLookToLH(XMVectorSet(-20.f + stop * 8.f, 4, 0, 1), XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		}
+	}
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3, 16.f / 9.f, nearPlane, farPlane);
+
+	HiZPyramid pyramid;
+	std::vector<float> depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT);
+	unsigned int tested = 0, culled = 0, culledExact = 0, wrong = 0;
+	for (const XMMATRIX& view : views) {
+		culler.render(view, projection);
+		toDeviceDepth(culler.getDepth(), (unsigned int)depth.size(), nearPlane, farPlane, &depth[0]);
+		pyramid.build(&depth[0], OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+		XMMATRIX viewProjection = view * projection;
+		for (const BoundingBox& box : bounds) {
+			bool visible = isVisible(&pyramid, box, viewProjection, viewProjection);
+			bool visibleExact = isVisibleExact(depth, OCCLUSION_WIDTH, OCCLUSION_HEIGHT, box, viewProjection);
+			++tested;
+			if (!visible) ++culled;
+			if (!visibleExact) ++culledExact;
+			if (visibleExact && !visible) ++wrong;
+		}
+	}
+	if (tested == 0) return;
+	printf("Over %d views: the pyramid culls %.1f%% of meshes, testing every pixel culls %.1f%%.\n", (int)views.size(), 100.f * culled / tested, 100.f * culledExact / tested);
+	if (wrong > 0)
+		printf("Error: the pyramid culled %u meshes that were visible.\n", wrong);
+	else
+		printf("The pyramid never culled anything visible.\n");
+
+	float total = 0;
+	for (int i = 0; i < frames; ++i) {
+		auto start = std::chrono::high_resolution_clock::now();
+		pyramid.build(&depth[0], OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+		total += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	printf("%.3fms per build on average (%d builds, %d levels from %dx%d).\n", total / frames, frames, pyramid.getLevels(), OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+}
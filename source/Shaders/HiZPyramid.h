@@ -0,0 +1,67 @@
+#pragma once
+
+/// Hierarchical depth: a mip chain where each texel holds the farthest depth of everything it covers in the depth buffer, so a box can be tested against
+/// any part of the screen with at most 4 reads, by picking the level where its screen rect spans no more than 2x2 texels.
+/// This is the cpu version of hiz_cs.hlsl and hizcull_cs.hlsl, texel for texel: HiZCuller checks the gpu's results against it, and validate() checks
+/// it against a brute force test of every pixel, without a window or a device.
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+#define HIZ_MAX_LEVELS 16
+#define HIZ_BUILD_GROUP 8 //hiz_cs.hlsl's threads per group, on each side
+#define HIZ_CULL_GROUP 64 //hizcull_cs.hlsl's threads per group
+#define INDIRECT_ARGS_COUNT 5 //index count, instance count, start index, base vertex, start instance
+#define INDIRECT_ARGS_SIZE (INDIRECT_ARGS_COUNT * 4)
+
+using namespace DirectX;
+
+///one static draw, as hizcull_cs.hlsl reads it
+struct HiZDraw {
+	XMFLOAT3 center;//world space bounds
+	unsigned int indexCount;
+	XMFLOAT3 extents;
+	unsigned int padding;
+};
+
+class HiZPyramid {
+
+public:
+	///level 0 is half the depth buffer's size, rounding down like any mip chain; every next level halves the previous one, down to 1x1
+	static int levelCount(int depthWidth, int depthHeight);
+	static void levelSize(int depthWidth, int depthHeight, int level, int& out_width, int& out_height);
+	///one level from the one before it (or from the depth buffer): the farthest of the 2x2 texels each one covers, 3 wide or tall along odd edges
+	static void downsample(const float* source, int sourceWidth, int sourceHeight, float* out, int width, int height);
+
+	///every level, from a depthWidth x depthHeight depth buffer (0 near, 1 far)
+	void build(const float* depth, int depthWidth, int depthHeight);
+	///takes levels as they are (read back from the gpu, say) rather than building them
+	void setLevels(const std::vector<std::vector<float>>& levels, int depthWidth, int depthHeight);
+
+	///false if box (world space) is outside viewProjection's frustum, or was hidden in the depth buffer this was built from, as seen through previousViewProjection.
+	///Whatever was off screen or crossed the near plane back then counts as visible. A null pyramid only tests the frustum
+	static bool isVisible(const HiZPyramid* pyramid, const BoundingBox& box, const XMMATRIX& viewProjection, const XMMATRIX& previousViewProjection);
+
+	inline int getLevels() { return (int)levels.size(); }
+	inline const std::vector<float>& getLevel(int level) { return levels[level]; }
+	inline int getDepthWidth() { return depthWidth; }
+	inline int getDepthHeight() { return depthHeight; }
+
+	///turns OcclusionCuller's depths (1 / view depth, 0 where there's nothing) into what a depth buffer would hold through a projection with these planes
+	static void toDeviceDepth(const float* inverseDepth, unsigned int count, float nearPlane, float farPlane, float* out);
+	///loads meshes (triangle lists) from a scene, renders their occluders from a few spots along the street with an OcclusionCuller, and tests every mesh
+	///against a pyramid built from that, checking that it never hides anything a test of every pixel would draw; prints the cull rates and build times
+	static void validate(const std::vector<std::vector<XMFLOAT3>>& meshes, int frames);
+
+protected:
+	std::vector<std::vector<float>> levels;
+	int depthWidth = 0, depthHeight = 0;
+
+	///the texel covering depth buffer pixel x at level
+	static inline int texel(float x, int level, int size) {
+		int t = (int)(x / (float)(2 << level));
+		return t < 0 ? 0 : (t >= size ? size - 1 : t);
+	}
+
+};
@@ -0,0 +1,140 @@
+#include "InstanceFinder.h"
+
+#include "LodBuilder.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <unordered_map>
+
+#define FRAME_MIN_DISTANCE 0.25f //vertices picked for the frame's axes have to be at least this far from the centroid, as a fraction of the mesh's size
+#define FRAME_MIN_SINE 0.25f //and the second one this far out of line with the first
+#define REPORT_SHAPES 5 //shapes with the most copies that report() lists
+
+bool InstanceFinder::frame(const XMFLOAT3* positions, unsigned int count, XMFLOAT4X4& out_frame) {
+	if (count < 3) return false;
+	XMVECTOR centroid = XMVectorZero();
+	for (unsigned int i = 0; i < count; ++i)
+		centroid += XMLoadFloat3(&positions[i]);
+	centroid /= (float)count;
+	float size = 0;
+	for (unsigned int i = 0; i < count; ++i)
+		size = (std::max)(size, XMVectorGetX(XMVector3Length(XMLoadFloat3(&positions[i]) - centroid)));
+	if (size <= 0) return false;
+
+	//copies have their vertices in the same order, so they pick the same ones here, and their axes turn with them
+	unsigned int first = count;
+	XMVECTOR x = XMVectorZero(), z = XMVectorZero();
+	for (unsigned int i = 0; i < count; ++i) {
+		XMVECTOR offset = XMLoadFloat3(&positions[i]) - centroid;
+		if (XMVectorGetX(XMVector3Length(offset)) <= size * FRAME_MIN_DISTANCE) continue;
+		if (first == count) {
+			x = XMVector3Normalize(offset);
+			first = i;
+			continue;
+		}
+		XMVECTOR side = XMVector3Cross(x, XMVector3Normalize(offset));
+		if (XMVectorGetX(XMVector3Length(side)) > FRAME_MIN_SINE) {
+			z = XMVector3Normalize(side);
+			break;
+		}
+	}
+	if (XMVectorGetX(XMVector3LengthSq(z)) == 0) return false;
+	XMVECTOR y = XMVector3Cross(z, x);
+
+	XMMATRIX frame;
+	frame.r[0] = x * size;
+	frame.r[1] = y * size;
+	frame.r[2] = z * size;
+	frame.r[3] = XMVectorSetW(centroid, 1);
+	XMStoreFloat4x4(&out_frame, frame);
+	return true;
+}
+
+unsigned long long InstanceFinder::key(const XMFLOAT3* positions, unsigned int count, const XMFLOAT4X4& frame) {
+	XMMATRIX toFrame = XMMatrixInverse(nullptr, XMLoadFloat4x4(&frame));
+	XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < count; ++i) {
+		XMVECTOR local = XMVector3Transform(XMLoadFloat3(&positions[i]), toFrame);
+		low = XMVectorMin(low, local);
+		high = XMVectorMax(high, local);
+	}
+	XMFLOAT3 lowBounds, highBounds;
+	XMStoreFloat3(&lowBounds, low);
+	XMStoreFloat3(&highBounds, high);
+	int bounds[6] = {
+		(int)lroundf(lowBounds.x * INSTANCE_GRID), (int)lroundf(lowBounds.y * INSTANCE_GRID), (int)lroundf(lowBounds.z * INSTANCE_GRID),
+		(int)lroundf(highBounds.x * INSTANCE_GRID), (int)lroundf(highBounds.y * INSTANCE_GRID), (int)lroundf(highBounds.z * INSTANCE_GRID)
+	};
+	unsigned long long hash = LodBuilder::hash(&count, sizeof(count));
+	return LodBuilder::hash(bounds, sizeof(bounds), hash);
+}
+
+bool InstanceFinder::match(const XMFLOAT3* positionsA, const XMFLOAT3* normalsA, const XMFLOAT4X4& frameA, const XMFLOAT3* positionsB, const XMFLOAT3* normalsB, const XMFLOAT4X4& frameB,
+	unsigned int count, XMFLOAT4X4& out_transform) {
+
+	//into a's frame, where both meshes look the same, then out of b's
+	XMMATRIX b = XMLoadFloat4x4(&frameB);
+	XMMATRIX transform = XMMatrixInverse(nullptr, XMLoadFloat4x4(&frameA)) * b;
+	float tolerance = XMVectorGetX(XMVector3Length(b.r[0])) * INSTANCE_POSITION_TOLERANCE;
+
+	for (unsigned int i = 0; i < count; ++i) {
+		XMVECTOR moved = XMVector3Transform(XMLoadFloat3(&positionsA[i]), transform);
+		if (XMVectorGetX(XMVector3Length(moved - XMLoadFloat3(&positionsB[i]))) > tolerance) return false;
+	}
+	if (normalsA && normalsB) {
+		for (unsigned int i = 0; i < count; ++i) {
+			XMVECTOR normalA = XMVector3TransformNormal(XMLoadFloat3(&normalsA[i]), transform);
+			XMVECTOR normalB = XMLoadFloat3(&normalsB[i]);
+			bool missingA = XMVectorGetX(XMVector3LengthSq(normalA)) == 0, missingB = XMVectorGetX(XMVector3LengthSq(normalB)) == 0;
+			if (missingA || missingB) {
+				if (missingA != missingB) return false;
+				continue;
+			}
+			if (XMVectorGetX(XMVector3Dot(XMVector3Normalize(normalA), XMVector3Normalize(normalB))) < 1 - INSTANCE_NORMAL_TOLERANCE) return false;
+		}
+	}
+
+	XMStoreFloat4x4(&out_transform, transform);
+	return true;
+}
+
+void InstanceFinder::report(const std::vector<std::vector<XMFLOAT3>>& meshes) {
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<XMFLOAT4X4> frames(meshes.size());
+	std::vector<unsigned int> copiesOf(meshes.size(), 0);
+	std::unordered_map<unsigned long long, std::vector<unsigned int>> shapes;//key to the first mesh of each shape with that key
+	unsigned int copies = 0, copiedTriangles = 0;
+	for (unsigned int m = 0; m < (unsigned int)meshes.size(); ++m) {
+		unsigned int count = (unsigned int)meshes[m].size();
+		if (count == 0 || !frame(&meshes[m][0], count, frames[m])) continue;
+		std::vector<unsigned int>& firsts = shapes[key(&meshes[m][0], count, frames[m])];
+		bool copy = false;
+		for (unsigned int first : firsts) {
+			XMFLOAT4X4 transform;
+			if (meshes[first].size() == count && match(&meshes[first][0], nullptr, frames[first], &meshes[m][0], nullptr, frames[m], count, transform)) {
+				++copiesOf[first];
+				++copies;
+				copiedTriangles += count / 3;
+				copy = true;
+				break;
+			}
+		}
+		if (!copy) firsts.push_back(m);
+	}
+	float time = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::vector<unsigned int> shared;
+	for (unsigned int m = 0; m < (unsigned int)meshes.size(); ++m)
+		if (copiesOf[m] > 0) shared.push_back(m);
+	printf("%u meshes, %u of them copies of %u others (%.3fms to find them).\n", (unsigned int)meshes.size(), copies, (unsigned int)shared.size(), time);
+	if (copies == 0) return;
+	//as imported: three vertices (position and attribute streams) and three indices per triangle
+	float kilobytes = copiedTriangles * 3.f * (sizeof(XMFLOAT3) + 8 * sizeof(float) + sizeof(unsigned long)) / 1024.f;
+	printf("Instancing them saves %u draws per pass, and %u triangles' worth of vertices and indices (%.1fKB).\n", copies, copiedTriangles, kilobytes);
+	std::sort(shared.begin(), shared.end(), [&copiesOf](unsigned int a, unsigned int b) { return copiesOf[a] > copiesOf[b]; });
+	for (size_t i = 0; i < shared.size() && i < REPORT_SHAPES; ++i)
+		printf("\t%u copies of mesh %u (%u triangles).\n", copiesOf[shared[i]] + 1, shared[i], (unsigned int)meshes[shared[i]].size() / 3);
+	printf("Positions only; the app also wants uvs and normals to agree, so it may find fewer.\n");
+}
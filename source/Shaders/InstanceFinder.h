@@ -0,0 +1,35 @@
+#pragma once
+
+/// Spots meshes that are copies of one another: the same vertices in the same order, moved, rotated and uniformly scaled somewhere else.
+/// Scenes come out of the modelling package with every transform frozen into the vertices, so copies can't be told apart by their data as is;
+/// each mesh gets a frame of its own worked out from its vertices instead, and copies' vertices look the same from their own frames.
+/// Hashing only keeps the coarse part of that (see key()), since rounding rotated vertices is never exact; match() then checks every vertex.
+/// Only relies on DirectXMath and the standard library, so it can be run and timed without a window or a device (see report()).
+
+#include <DirectXMath.h>
+#include <vector>
+
+#define INSTANCE_GRID 64.f //bounds in a mesh's own frame get rounded to this many steps per unit of size before hashing
+#define INSTANCE_POSITION_TOLERANCE 0.001f //how far two copies' vertices may be, as a fraction of the mesh's size
+#define INSTANCE_NORMAL_TOLERANCE 0.001f //how far from 1 the cosine between two copies' normals may be
+
+using namespace DirectX;
+
+class InstanceFinder {
+
+public:
+	///the frame a mesh's vertices are compared in: origin on their centroid, scaled to the furthest vertex from it, x towards the first vertex well
+	///away from it, and z square to x and the next vertex well out of line with it. False if the vertices are all in a line (or a point)
+	static bool frame(const XMFLOAT3* positions, unsigned int count, XMFLOAT4X4& out_frame);
+	///hash of the vertex count and the bounds of the vertices seen from frame; the same for copies, except for the odd one that rounds the other way.
+	///Whatever has to match bit for bit (uvs, indices) can be hashed on top with LodBuilder::hash()
+	static unsigned long long key(const XMFLOAT3* positions, unsigned int count, const XMFLOAT4X4& frame);
+	///true if the b vertices are the a ones moved by some transform, which goes to out_transform (mesh space to mesh space, for row vectors).
+	///Normals can be null, otherwise they get checked too; frames are what frame() gave for each
+	static bool match(const XMFLOAT3* positionsA, const XMFLOAT3* normalsA, const XMFLOAT4X4& frameA, const XMFLOAT3* positionsB, const XMFLOAT3* normalsB, const XMFLOAT4X4& frameB,
+		unsigned int count, XMFLOAT4X4& out_transform);
+
+	///finds copies among meshes (triangle lists, positions only), and prints how many there are and what instancing them would save; doesn't need a window or a device
+	static void report(const std::vector<std::vector<XMFLOAT3>>& meshes);
+
+};
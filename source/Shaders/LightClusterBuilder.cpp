@@ -0,0 +1,180 @@
+#include "LightClusterBuilder.h"
+
+#include <chrono>
+#include <cfloat>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+LightClusterBuilder::LightClusterBuilder(int tilesX, int tilesY, int slices) : tilesX(tilesX), tilesY(tilesY), slices(slices) {
+	memset(&lastProjection, 0, sizeof(XMFLOAT4X4));//so that the first build sets the planes up
+}
+
+LightClusterBuilder::~LightClusterBuilder() {
+}
+
+///Planes through the camera between each column (and row) of tiles
+void LightClusterBuilder::setupPlanes(const XMMATRIX& projection) {
+	XMFLOAT4X4 proj;
+	XMStoreFloat4x4(&proj, projection);
+	if (memcmp(&proj, &lastProjection, sizeof(XMFLOAT4X4)) == 0) return;//still good
+	lastProjection = proj;
+
+	float tanHalfX = 1.0f / proj._11;
+	float tanHalfY = 1.0f / proj._22;
+	int columns = (tilesX + 1 + 3) & ~3;
+	int rows = (tilesY + 1 + 3) & ~3;
+	columnA.assign(columns, 0);
+	columnB.assign(columns, 0);
+	rowA.assign(rows, 0);
+	rowB.assign(rows, 0);
+	distances.resize(columns > rows ? columns : rows);
+
+	//columns go left to right; positive distances are to the right of the boundary
+	for (int i = 0; i <= tilesX; ++i) {
+		float x = (-1 + 2.0f * i / tilesX) * tanHalfX;//boundary's x at view depth 1
+		float length = sqrtf(1 + x * x);
+		columnA[i] = 1 / length;
+		columnB[i] = -x / length;
+	}
+	//rows go top to bottom (same as pixels); positive distances are below the boundary
+	for (int i = 0; i <= tilesY; ++i) {
+		float y = (1 - 2.0f * i / tilesY) * tanHalfY;
+		float length = sqrtf(1 + y * y);
+		rowA[i] = -1 / length;
+		rowB[i] = y / length;
+	}
+}
+
+bool LightClusterBuilder::tileRange(const std::vector<float>& a, const std::vector<float>& b, int tiles, float u, float z, float radius, unsigned char& out_first, unsigned char& out_last) {
+	//distance from the sphere's centre to each tile boundary, 4 boundaries at a time
+	XMVECTOR vu = XMVectorReplicate(u);
+	XMVECTOR vz = XMVectorReplicate(z);
+	for (size_t i = 0; i < a.size(); i += 4) {
+		XMVECTOR d = XMVectorMultiplyAdd(XMLoadFloat4((const XMFLOAT4*)&a[i]), vu, XMVectorMultiply(XMLoadFloat4((const XMFLOAT4*)&b[i]), vz));
+		XMStoreFloat4((XMFLOAT4*)&distances[i], d);
+	}
+
+	//the sphere touches a tile if it reaches past the tile's first boundary without lying entirely past its second one
+	int first = -1, last = -1;
+	for (int t = 0; t < tiles; ++t) {
+		if (distances[t] > -radius && distances[t + 1] < radius) {
+			if (first < 0) first = t;
+			last = t;
+		}
+	}
+	if (first < 0) return false;
+	out_first = (unsigned char)first;
+	out_last = (unsigned char)last;
+	return true;
+}
+
+void LightClusterBuilder::build(const std::vector<ClusteredLight>& lights, const XMMATRIX& view, const XMMATRIX& projection, float nearPlane, float farPlane) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	setupPlanes(projection);
+	float logDepthRange = logf(farPlane / nearPlane);
+	sliceScale = slices / logDepthRange;
+	sliceBias = -slices * logf(nearPlane) / logDepthRange;
+
+	//all light positions to view space in one go
+	int numLights = (int)lights.size();
+	viewPositions.resize(numLights);
+	ranges.resize(numLights);
+	if (numLights > 0)
+		XMVector3TransformCoordStream(&viewPositions[0], sizeof(XMFLOAT3), &lights[0].position, sizeof(ClusteredLight), numLights, view);
+
+	//find the block of clusters each light reaches, counting lights per cluster along the way
+	int numClusters = tilesX * tilesY * slices;
+	clusters.assign(numClusters, XMUINT2(0, 0));
+	for (int i = 0; i < numLights; ++i) {
+		ClusterRange& range = ranges[i];
+		const XMFLOAT3& centre = viewPositions[i];
+		float radius = lights[i].range;
+		range.visible = false;
+
+		if (radius >= FLT_MAX) {//reaches everywhere
+			range.x0 = range.y0 = range.z0 = 0;
+			range.x1 = tilesX - 1;
+			range.y1 = tilesY - 1;
+			range.z1 = slices - 1;
+		}
+		else {
+			if (centre.z + radius <= 0) continue;//behind the camera
+			if (!tileRange(columnA, columnB, tilesX, centre.x, centre.z, radius, range.x0, range.x1)) continue;
+			if (!tileRange(rowA, rowB, tilesY, centre.y, centre.z, radius, range.y0, range.y1)) continue;
+			float zMin = centre.z - radius, zMax = centre.z + radius;
+			int z0 = zMin <= nearPlane ? 0 : int(logf(zMin) * sliceScale + sliceBias);
+			int z1 = zMax <= nearPlane ? 0 : int(logf(zMax) * sliceScale + sliceBias);
+			range.z0 = z0 < slices ? z0 : slices - 1;
+			range.z1 = z1 < slices ? z1 : slices - 1;
+		}
+		range.visible = true;
+
+		for (int z = range.z0; z <= range.z1; ++z)
+			for (int y = range.y0; y <= range.y1; ++y)
+				for (int x = range.x0; x <= range.x1; ++x)
+					++clusters[(z * tilesY + y) * tilesX + x].y;
+	}
+
+	//turn counts into offsets
+	unsigned int total = 0;
+	maxLightsPerCluster = 0;
+	for (XMUINT2& cluster : clusters) {
+		cluster.x = total;
+		total += cluster.y;
+		if (cluster.y > maxLightsPerCluster) maxLightsPerCluster = cluster.y;
+		cluster.y = 0;//counted back up while filling in
+	}
+
+	//fill in the index lists, in light order so shadowed lights come first
+	indices.resize(total);
+	for (int i = 0; i < numLights; ++i) {
+		const ClusterRange& range = ranges[i];
+		if (!range.visible) continue;
+		for (int z = range.z0; z <= range.z1; ++z) {
+			for (int y = range.y0; y <= range.y1; ++y) {
+				for (int x = range.x0; x <= range.x1; ++x) {
+					XMUINT2& cluster = clusters[(z * tilesY + y) * tilesX + x];
+					indices[cluster.x + cluster.y++] = i;
+				}
+			}
+		}
+	}
+
+	buildTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+///rng between two floats (same as Utils::random, without pulling in the rest of Utils)
+static float randomRange(float min, float max) {
+	return float(rand() % 1000) / 1000.f * (max - min) + min;
+}
+
+void LightClusterBuilder::benchmark(int numLights, int iterations) {
+	//a street's worth of small lights spread out in front of the camera
+	std::vector<ClusteredLight> lights(numLights);
+	for (ClusteredLight& light : lights) {
+		light.position = XMFLOAT3(randomRange(-50, 50), randomRange(-5, 20), randomRange(-20, 150));
+		light.type = 1;
+		light.direction = XMFLOAT3(0, -1, 0);
+		light.shadowSlot = -1;
+		light.colour = XMFLOAT3(1, 1, 1);
+		light.range = randomRange(2, 10);
+		light.attenuation = XMFLOAT3(1, 0, 255.f / (light.range * light.range));
+		light.padding = 0;
+	}
+	XMMATRIX view = XMMatrixIdentity();
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3, 16.f / 9.f, 0.1f, 200.f);
+
+	LightClusterBuilder builder;
+	builder.build(lights, view, projection, 1, 200);//warm up
+	float total = 0, worst = 0;
+	for (int i = 0; i < iterations; ++i) {
+		builder.build(lights, view, projection, 1, 200);
+		total += builder.getBuildTime();
+		if (builder.getBuildTime() > worst) worst = builder.getBuildTime();
+	}
+
+	printf("Clustered %d lights into %dx%dx%d clusters: %.3fms per build on average, %.3fms at worst (%d builds).\n", numLights, builder.getTilesX(), builder.getTilesY(), builder.getSlices(), total / iterations, worst, iterations);
+	printf("%.2f lights per cluster on average, %u at most, %u indices.\n", builder.getAverageLightsPerCluster(), builder.getMaxLightsPerCluster(), (unsigned int)builder.getIndices().size());
+}
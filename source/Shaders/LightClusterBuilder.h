@@ -0,0 +1,87 @@
+#pragma once
+
+/// Assigns lights to a froxel grid (screen tiles x exponential depth slices), so that the fragment shader only loops over the lights that can reach each pixel.
+/// Only relies on DirectXMath, so it can be run and timed without a window or a device (see benchmark()); LightGrid uploads the results.
+
+#include <DirectXMath.h>
+#include <vector>
+
+#define CLUSTER_TILES_X 16 //must fit in the ClusterRange bytes below
+#define CLUSTER_TILES_Y 9
+#define CLUSTER_SLICES 24
+
+using namespace DirectX;
+
+///One light as the fragment shader sees it; layout must match the Light struct in default_fs
+struct ClusteredLight {
+	XMFLOAT3 position;
+	float type;//see ExtendedLight.h
+	XMFLOAT3 direction;//normalized
+	int shadowSlot;//index of the light's shadowmap (and matrices), or -1 for no shadows
+	XMFLOAT3 colour;
+	float range;//distance past which the light is too dim to matter; FLT_MAX if it reaches everywhere (directional lights)
+	XMFLOAT3 attenuation;//constant, linear, quadratic
+	float padding;
+};
+
+class LightClusterBuilder {
+
+protected:
+	///the block of clusters a light touches, inclusive
+	struct ClusterRange {
+		unsigned char x0, x1, y0, y1, z0, z1;
+		bool visible;
+	};
+
+public:
+	LightClusterBuilder(int tilesX = CLUSTER_TILES_X, int tilesY = CLUSTER_TILES_Y, int slices = CLUSTER_SLICES);
+	~LightClusterBuilder();
+
+	///Fills in the light list for each cluster of the camera described by view and projection (any perspective projection).
+	///nearPlane is where depth slicing starts, anything closer lands in the first slice; anything past farPlane lands in the last one.
+	void build(const std::vector<ClusteredLight>& lights, const XMMATRIX& view, const XMMATRIX& projection, float nearPlane, float farPlane);
+
+	///x: offset into the index list, y: number of lights; clusters are laid out x first, then y, then depth
+	inline const std::vector<XMUINT2>& getClusters() { return clusters; }
+	///indices into the light list passed to build()
+	inline const std::vector<unsigned int>& getIndices() { return indices; }
+
+	inline int getTilesX() { return tilesX; }
+	inline int getTilesY() { return tilesY; }
+	inline int getSlices() { return slices; }
+	///depth slice = log(view depth) * sliceScale + sliceBias
+	inline float getSliceScale() { return sliceScale; }
+	inline float getSliceBias() { return sliceBias; }
+
+	///Stats for the last build
+	inline float getBuildTime() { return buildTime; }//milliseconds
+	inline unsigned int getMaxLightsPerCluster() { return maxLightsPerCluster; }
+	inline float getAverageLightsPerCluster() { return clusters.size() > 0 ? float(indices.size()) / clusters.size() : 0; }
+
+	///Times build() with numLights random lights in front of the camera and prints the results; doesn't need a window or a device
+	static void benchmark(int numLights, int iterations);
+
+protected:
+	int tilesX, tilesY, slices;
+	float sliceScale = 0, sliceBias = 0;
+
+	//tile boundary planes through the camera, as d = a * x + b * (y or z); padded to a multiple of 4 for SIMD
+	std::vector<float> columnA, columnB;
+	std::vector<float> rowA, rowB;
+	std::vector<float> distances;//scratch space for plane distances
+	XMFLOAT4X4 lastProjection;
+
+	std::vector<XMFLOAT3> viewPositions;
+	std::vector<ClusterRange> ranges;
+	std::vector<XMUINT2> clusters;
+	std::vector<unsigned int> indices;
+
+	float buildTime = 0;
+	unsigned int maxLightsPerCluster = 0;
+
+	///recomputes the tile planes when the projection changes
+	void setupPlanes(const XMMATRIX& projection);
+	///finds the first and last tiles (along one axis) a sphere overlaps; false if it misses all of them
+	bool tileRange(const std::vector<float>& a, const std::vector<float>& b, int tiles, float u, float z, float radius, unsigned char& out_first, unsigned char& out_last);
+
+};
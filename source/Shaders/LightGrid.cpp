@@ -0,0 +1,115 @@
+#include "LightGrid.h"
+
+#include "AppGlobals.h"
+#include "Utils.h"
+
+#define CLUSTER_NEAR 1.f //depth slicing starts here; slices are exponential so starting at the camera's near plane would spend most of them right in front of it
+#define INITIAL_LIGHTS 256 //buffers grow from there as needed
+#define INITIAL_INDICES (CLUSTER_TILES_X * CLUSTER_TILES_Y * CLUSTER_SLICES * 8)
+
+LightGrid::LightGrid() {
+	clusterBlock.init(GLOBALS.Backend);
+
+	createBuffer(lightList, lightListView, INITIAL_LIGHTS, sizeof(ClusteredLight), FORMAT_UNKNOWN);
+	lightsCapacity = INITIAL_LIGHTS;
+	createBuffer(clusterList, clusterListView, builder.getTilesX() * builder.getTilesY() * builder.getSlices(), sizeof(XMUINT2), FORMAT_R32G32_UINT);
+	createBuffer(indexList, indexListView, INITIAL_INDICES, sizeof(unsigned int), FORMAT_R32_UINT);
+	indicesCapacity = INITIAL_INDICES;
+}
+
+LightGrid::~LightGrid() {
+	GLOBALS.Backend->releaseView(lightListView);
+	GLOBALS.Backend->releaseBuffer(lightList);
+	GLOBALS.Backend->releaseView(clusterListView);
+	GLOBALS.Backend->releaseBuffer(clusterList);
+	GLOBALS.Backend->releaseView(indexListView);
+	GLOBALS.Backend->releaseBuffer(indexList);
+}
+
+void LightGrid::createBuffer(GpuBuffer*& buffer, GpuView*& view, unsigned int count, unsigned int stride, int format) {
+	GLOBALS.Backend->releaseView(view);
+	GLOBALS.Backend->releaseBuffer(buffer);
+	buffer = GLOBALS.Backend->createShaderBuffer(count, stride, format, &view);
+	if (!buffer)
+		printf("Error: could not create light grid buffer of %u elements.\n", count);
+}
+
+void LightGrid::upload(RenderDevice* device, GpuBuffer* buffer, const void* data, size_t size) {
+	if (!buffer || size == 0) return;
+	void* mapped = device->map(buffer, false);
+	if (!mapped) return;
+	memcpy(mapped, data, size);
+	device->unmap(buffer);
+}
+
+void LightGrid::update(RenderDevice* device, ExtendedLight* lights, int numLights, const std::vector<ClusteredLight>& extraLights, const XMMATRIX& view, const XMMATRIX& projection, float farPlane) {
+
+	//Gather lights; shadowed ones first so that their index doubles as their shadowmap slot
+	frameLights.clear();
+	for (int i = 0; i < numLights; ++i) {
+		ExtendedLight& light = lights[i];
+		if (light.getType() == INACTIVE_LIGHT) continue;
+		ClusteredLight l;
+		l.position = light.getPosition();
+		l.type = light.getType();
+		XMFLOAT4 direction = light.getFormattedDirection();
+		l.direction = XMFLOAT3(direction.x, direction.y, direction.z);
+		l.shadowSlot = light.shouldBypassShadows() ? -1 : i;
+		XMFLOAT4 colour = light.getDiffuseColour();
+		l.colour = XMFLOAT3(colour.x, colour.y, colour.z);
+		XMFLOAT4 attenuation = light.getAttenuation();
+		l.attenuation = XMFLOAT3(attenuation.x, attenuation.y, attenuation.z);
+		l.range = light.getType() == DIRECTIONAL_LIGHT ? FLT_MAX : Utils::attenuationRange(attenuation, LIGHT_ATTENUATION_CUTOFF);
+		l.padding = 0;
+		frameLights.push_back(l);
+	}
+	frameLights.insert(frameLights.end(), extraLights.begin(), extraLights.end());
+
+	builder.build(frameLights, view, projection, CLUSTER_NEAR, farPlane);
+
+	//Grow buffers if needed
+	if (frameLights.size() > lightsCapacity) {
+		lightsCapacity = (std::max)((unsigned int)frameLights.size(), lightsCapacity * 2);
+		createBuffer(lightList, lightListView, lightsCapacity, sizeof(ClusteredLight), FORMAT_UNKNOWN);
+	}
+	const std::vector<unsigned int>& clusterIndices = builder.getIndices();
+	if (clusterIndices.size() > indicesCapacity) {
+		indicesCapacity = (std::max)((unsigned int)clusterIndices.size(), indicesCapacity * 2);
+		createBuffer(indexList, indexListView, indicesCapacity, sizeof(unsigned int), FORMAT_R32_UINT);
+	}
+
+	//Upload
+	if (!frameLights.empty())
+		upload(device, lightList, &frameLights[0], frameLights.size() * sizeof(ClusteredLight));
+	const std::vector<XMUINT2>& clusterRanges = builder.getClusters();
+	upload(device, clusterList, &clusterRanges[0], clusterRanges.size() * sizeof(XMUINT2));
+	if (!clusterIndices.empty())
+		upload(device, indexList, &clusterIndices[0], clusterIndices.size() * sizeof(unsigned int));
+
+	ClusterBufferType cluster;
+	ZeroMemory(&cluster, sizeof(cluster));
+	cluster.viewProjection = XMMatrixTranspose(view * projection);
+	cluster.grid = XMFLOAT3((float)builder.getTilesX(), (float)builder.getTilesY(), (float)builder.getSlices());
+	cluster.sliceScale = builder.getSliceScale();
+	cluster.sliceBias = builder.getSliceBias();
+	clusterBlock.update(device, cluster);//only changes when the camera moves
+}
+
+void LightGrid::bind(RenderDevice* device) {
+	GpuView* views[3] = { lightListView, clusterListView, indexListView };
+	clusterBlock.bind(device, STAGE_PS, 2);
+	device->setShaderResources(STAGE_PS, 10, 3, views);
+}
+
+ClusteredLight LightGrid::pointLight(XMFLOAT3 position, XMFLOAT3 colour, float range) {
+	ClusteredLight light;
+	light.position = position;
+	light.type = POINT_LIGHT;
+	light.direction = XMFLOAT3(0, -1, 0);
+	light.shadowSlot = -1;
+	light.colour = colour;
+	light.range = range;
+	light.attenuation = XMFLOAT3(1, 0, (LIGHT_ATTENUATION_CUTOFF - 1) / (range * range));//reaches the cutoff right at range
+	light.padding = 0;
+	return light;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/// Clustered forward lighting: gathers every active light (shadowed ones and any number of extra ones), has LightClusterBuilder sort them into clusters,
+/// and uploads the light list, per-cluster offsets and index lists for default_fs to walk through.
+
+#include "DXF.h"
+#include <vector>
+#include "ExtendedLight.h"
+#include "LightClusterBuilder.h"
+#include "ConstantBlock.h"
+
+#define LIGHT_ATTENUATION_CUTOFF 256.f //a light is considered out of reach once attenuation divides it by this much (under 1/255 of its colour)
+
+class LightGrid {
+
+protected:
+	///passes cluster layout to FS; must match ClusterBuffer in default_fs
+	struct ClusterBufferType {
+		XMMATRIX viewProjection;//same camera the clusters were built for
+		XMFLOAT3 grid;//tiles x, tiles y, depth slices
+		float sliceScale;
+		float sliceBias;
+		XMFLOAT3 padding;
+	};
+
+public:
+	LightGrid();
+	~LightGrid();
+
+	///Builds and uploads clusters for this frame. Shadowed lights keep their index as shadowmap slot; inactive lights are skipped.
+	void update(RenderDevice* device, ExtendedLight* lights, int numLights, const std::vector<ClusteredLight>& extraLights, const XMMATRIX& view, const XMMATRIX& projection, float farPlane);
+	///binds everything to PS b2 and t10-t12, where default_fs expects it; stays bound until something else takes those slots
+	void bind(RenderDevice* device);
+
+	inline LightClusterBuilder& getBuilder() { return builder; }
+	inline int getLightCount() { return (int)frameLights.size(); }
+	inline const std::vector<ClusteredLight>& getLights() { return frameLights; }//as of the last update()
+
+	///makes a point light that fades out at the given range
+	static ClusteredLight pointLight(XMFLOAT3 position, XMFLOAT3 colour, float range);
+
+private:
+	LightClusterBuilder builder;
+	std::vector<ClusteredLight> frameLights;
+
+	ConstantBlock<ClusterBufferType> clusterBlock;//PS b2
+	GpuBuffer* lightList = nullptr;//PS t10
+	GpuView* lightListView = nullptr;
+	GpuBuffer* clusterList = nullptr;//PS t11
+	GpuView* clusterListView = nullptr;
+	GpuBuffer* indexList = nullptr;//PS t12
+	GpuView* indexListView = nullptr;
+	unsigned int lightsCapacity = 0;
+	unsigned int indicesCapacity = 0;
+
+	///(re)creates a dynamic shader resource buffer able to hold count elements; structured if format is FORMAT_UNKNOWN
+	void createBuffer(GpuBuffer*& buffer, GpuView*& view, unsigned int count, unsigned int stride, int format);
+	///copies data into a dynamic buffer
+	void upload(RenderDevice* device, GpuBuffer* buffer, const void* data, size_t size);
+
+};
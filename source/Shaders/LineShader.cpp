@@ -1,10 +0,0 @@
-#include "LineShader.h"
-
-
-
-LineShader::LineShader() {
-	SETUP_SHADER(line_vs, line_fs);
-}
-
-LineShader::~LineShader(){
-}
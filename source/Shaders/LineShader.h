@@ -1,10 +0,0 @@
-#pragma once
-#include "Shader.h"
-class LineShader : public Shader{
-public:
-	LineShader();
-	~LineShader();
-
-protected:
-	inline void initBuffers() override {}
-};
@@ -6,18 +6,19 @@ LitShader::LitShader() {
 }
 
 LitShader::~LitShader(){
-	cameraBuffer->Release();
-	lightBuffer->Release();
-	materialBuffer->Release();
+	GLOBALS.Backend->releaseBuffer(materialBuffer);
+	GLOBALS.Backend->releaseBuffer(displacementBuffer);
+	GLOBALS.Backend->releaseSampler(shadowSampleState);
+	GLOBALS.Backend->releaseSampler(vsmSampleState);
 }
 
 void LitShader::initBuffers() {
 
 	//Setup camera buffer
-	SETUP_SHADER_BUFFER(CameraBufferType, cameraBuffer);
+	cameraBlock.init(GLOBALS.Backend);
 
 	//Setup light buffer
-	SETUP_SHADER_BUFFER(LightBufferType, lightBuffer);
+	lightBlock.init(GLOBALS.Backend);
 
 	//Setup material buffer
 	SETUP_SHADER_BUFFER(MaterialBufferType, materialBuffer);
@@ -26,137 +27,127 @@ void LitShader::initBuffers() {
 	SETUP_SHADER_BUFFER(DisplacementBufferType, displacementBuffer);
 
 	//Setup shadowmap matrix buffer
-	SETUP_SHADER_BUFFER(ShadowmapMatrixBufferType, shadowmapMatrixBuffer);
+	shadowmapMatrixBlock.init(GLOBALS.Backend);
 
 	// Create sampler state
-	D3D11_SAMPLER_DESC samplerDesc;
-	samplerDesc.Filter = D3D11_FILTER_ANISOTROPIC;
-	samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
-	samplerDesc.MipLODBias = 0.0f;
-	samplerDesc.MaxAnisotropy = 1;
-	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
-	samplerDesc.MinLOD = 0;
-	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
-	renderer->CreateSamplerState(&samplerDesc, &sampleState);
+	sampler = GLOBALS.Backend->createSampler(FILTER_ANISOTROPIC, ADDRESS_WRAP);
+
+	// Create shadowmap comparison sampler; bilinear filtering of the comparison results gives us 2x2 PCF per tap for free
+	shadowSampleState = GLOBALS.Backend->createSampler(FILTER_COMPARISON_LINEAR_MIP_POINT, ADDRESS_CLAMP, COMPARE_GREATER);//lit when the fragment's (inverted) depth is greater than the stored one
+
+	// Create variance shadowmap sampler; plain trilinear, the moments are prefiltered so one fetch does all the filtering
+	vsmSampleState = GLOBALS.Backend->createSampler(FILTER_LINEAR, ADDRESS_CLAMP);
 }
 
-void LitShader::setLightParameters(ID3D11DeviceContext* deviceContext, XMFLOAT3 cameraPosition, ExtendedLight** lights, ID3D11ShaderResourceView** shadowmaps, bool sendShadowmaps, int numLights){
+void LitShader::setLightParameters(RenderDevice* device, XMFLOAT3 cameraPosition, ExtendedLight** lights, GpuView** shadowmaps, bool sendShadowmaps, int numLights, float farPlane){
 
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	//Each block is built on the cpu and only uploaded if it differs from what this shader sent last time; they're still bound every time, since other shaders use the same slots
 
 	// Send camera data to vertex shader
-	CameraBufferType* cameraPtr;
-	deviceContext->Map(cameraBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	cameraPtr = (CameraBufferType*)mappedResource.pData;
-	cameraPtr->cameraPosition = cameraPosition;
-	cameraPtr->farPlane = FAR_PLANE;
-	deviceContext->Unmap(cameraBuffer, 0);
-	if(domainShader)//send to domain shader
-		deviceContext->DSSetConstantBuffers(1, 1, &cameraBuffer);
+	CameraBufferType camera;
+	ZeroMemory(&camera, sizeof(camera));
+	camera.cameraPosition = cameraPosition;
+	camera.farPlane = farPlane > 0 ? farPlane : FAR_PLANE;
+	cameraBlock.update(device, camera);
+	if(stages.domainShader)//send to domain shader
+		cameraBlock.bind(device, STAGE_DS, 1);
 	else//send to vertex shader instead
-		deviceContext->VSSetConstantBuffers(1, 1, &cameraBuffer);
+		cameraBlock.bind(device, STAGE_VS, 1);
 
 	// Send light data to pixel shader
-	LightBufferType* lightPtr;
-	deviceContext->Map(lightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	lightPtr = (LightBufferType*)mappedResource.pData;
+	LightBufferType light;
+	ZeroMemory(&light, sizeof(light));
 	//ambient is the first light's Ambient component only.
 	if (numLights > 0)
-		lightPtr->ambient = (*lights)[0].getAmbientColour();
+		light.ambient = (*lights)[0].getAmbientColour();
 	else
-		lightPtr->ambient = XMFLOAT4(1, 1, 1, 1);
-	//add all the lights:
-	for (int light = 0; light < NUM_LIGHTS; ++light) {
-		if (light < numLights) {
-			lightPtr->diffuse[light] = (*lights)[light].getDiffuseColour();
-			lightPtr->position[light] = XMFLOAT4((*lights)[light].getPosition().x, (*lights)[light].getPosition().y, (*lights)[light].getPosition().z, (*lights)[light].getType());
-			lightPtr->direction[light] = (*lights)[light].getFormattedDirection();
-			lightPtr->attenuation[light] = (*lights)[light].getAttenuation();
-			lightPtr->attenuation[light].w = (*lights)[light].shouldBypassShadows() || !sendShadowmaps ? 0 : 1;//w of attenuation is whether we want shadows from this light
+		light.ambient = XMFLOAT4(1, 1, 1, 1);
+	//shadowmap parameters for each shadowed light (the lights themselves are sent by LightGrid):
+	for (int i = 0; i < NUM_LIGHTS; ++i) {
+		if (i < numLights && sendShadowmaps && shadowmaps[i] && !(*lights)[i].shouldBypassShadows()) {
+			float perspectiveTexel, orthographicTexel;
+			(*lights)[i].getShadowTexelSize(perspectiveTexel, orthographicTexel);
+			light.shadowParams[i] = XMFLOAT4(1.0f / (*lights)[i].getShadowmapFar(), (float)(*lights)[i].getShadowFilter(), perspectiveTexel, orthographicTexel);
 		}
 		else {
-			lightPtr->position[light] = XMFLOAT4(UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, INACTIVE_LIGHT);//w component is 0 meaning light is inactive.
+			light.shadowParams[i] = XMFLOAT4(1, 0, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM);//mode 0 means no shadows from this slot
 		}
 	}
-	lightPtr->oneOverFarPlane = 1.0f / FAR_PLANE;
-	lightPtr->shadowmapBias = GLOBALS.ShadowmapBias;
-	lightPtr->showShadowmapErrors = GLOBALS.ShadowmapSeeErrors ? 1 : 0;
-	lightPtr->oneOverShadowmapSize = numLights > 0 ? 1.0f / lights[0]->getShadowmapRes() : 1;
-	deviceContext->Unmap(lightBuffer, 0);
-	deviceContext->PSSetConstantBuffers(0, 1, &lightBuffer);
+	light.oneOverFarPlane = 1.0f / FAR_PLANE;
+	light.shadowmapBias = GLOBALS.ShadowmapBias;
+	light.showShadowmapErrors = GLOBALS.ShadowmapSeeErrors ? 1 : 0;
+	light.oneOverShadowmapSize = numLights > 0 ? 1.0f / lights[0]->getShadowmapRes() : 1;
+	lightBlock.update(device, light);
+	lightBlock.bind(device, STAGE_PS, 0);
 
 	// Send shadowmap data to vertex or domain shader
-	ShadowmapMatrixBufferType* smbPtr;
-	deviceContext->Map(shadowmapMatrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	smbPtr = (ShadowmapMatrixBufferType*)mappedResource.pData;
-	for (int light = 0; light < NUM_LIGHTS; ++light) {
-		if (light < numLights && !(*lights)[light].shouldBypassShadows()) {//pass this light's matrices
-			smbPtr->shadowmapMode[light] = XMFLOAT4(1, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM);
-			smbPtr->lightView[light] = XMMatrixTranspose((*lights)[light].getView());// transpose matrices to prepare for mul in shaders
-			smbPtr->lightProjection[light] = XMMatrixTranspose((*lights)[light].getProjection());
+	ShadowmapMatrixBufferType shadowmapMatrices;
+	ZeroMemory(&shadowmapMatrices, sizeof(shadowmapMatrices));//unused slots stay zeroed so that they compare equal from one call to the next
+	for (int i = 0; i < NUM_LIGHTS; ++i) {
+		if (i < numLights && !(*lights)[i].shouldBypassShadows()) {//pass this light's matrices
+			shadowmapMatrices.shadowmapMode[i] = XMFLOAT4(1, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM);
+			shadowmapMatrices.lightView[i] = XMMatrixTranspose((*lights)[i].getShadowmapView());// transpose matrices to prepare for mul in shaders
+			shadowmapMatrices.lightProjection[i] = XMMatrixTranspose((*lights)[i].getShadowmapProjection());
 		}
 		else {//ignore this light for shadowmaps
-			smbPtr->shadowmapMode[light] = XMFLOAT4(0, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM);
+			shadowmapMatrices.shadowmapMode[i] = XMFLOAT4(0, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM, UNUSED_SHADER_PARAM);
 		}
 	}
-	deviceContext->Unmap(shadowmapMatrixBuffer, 0);
-	if (domainShader)//send to domain
-		deviceContext->DSSetConstantBuffers(3, 1, &shadowmapMatrixBuffer);
+	shadowmapMatrixBlock.update(device, shadowmapMatrices);
+	if (stages.domainShader)//send to domain
+		shadowmapMatrixBlock.bind(device, STAGE_DS, 3);
 	else//send to vertex
-		deviceContext->VSSetConstantBuffers(3, 1, &shadowmapMatrixBuffer);
+		shadowmapMatrixBlock.bind(device, STAGE_VS, 3);
 
 	// Send shadowmaps to fragment
-	if(sendShadowmaps)
-		deviceContext->PSSetShaderResources(2, numLights, shadowmaps);
+	if (sendShadowmaps) {
+		device->setShaderResources(STAGE_PS, 2, numLights, shadowmaps);
+		device->setSamplers(STAGE_PS, 1, 1, &shadowSampleState);
+		device->setSamplers(STAGE_PS, 2, 1, &vsmSampleState);
+	}
 }
 
-void LitShader::setMaterialParameters(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* normalMap, ID3D11ShaderResourceView* displacementMap, Material* material) {
-
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void LitShader::setMaterialParameters(RenderDevice* device, GpuView* texture, GpuView* normalMap, GpuView* displacementMap, Material* material) {
 
 	// Send material data to pixel shader
 	if (material != nullptr) {//if it's null, just keep the previous one; allows for optimization if we're drawing multiple meshes with the same mat
-		MaterialBufferType* materialPtr;
-		deviceContext->Map(materialBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-		materialPtr = (MaterialBufferType*)mappedResource.pData;
-		if (texture)
-			materialPtr->mode = normalMap && GLOBALS.normalMapping ? DIFFUSE_AND_NORMAL_MAP : DIFFUSE_TEXTURE;
-		else
-			materialPtr->mode = normalMap && GLOBALS.normalMapping ? NORMAL_MAP : COLOUR;
-		materialPtr->colour = material->colour;
-		materialPtr->specularColour = material->specularColour;
-		materialPtr->specularPower = material->specularPower;
-		deviceContext->Unmap(materialBuffer, 0);
-		deviceContext->PSSetConstantBuffers(1, 1, &materialBuffer);
+		MaterialBufferType* materialPtr = (MaterialBufferType*)device->getTransientConstants()->map(device, sizeof(MaterialBufferType), materialBuffer);
+		if (materialPtr) {
+			if (texture)
+				materialPtr->mode = normalMap && GLOBALS.normalMapping ? DIFFUSE_AND_NORMAL_MAP : DIFFUSE_TEXTURE;
+			else
+				materialPtr->mode = normalMap && GLOBALS.normalMapping ? NORMAL_MAP : COLOUR;
+			materialPtr->colour = material->colour;
+			materialPtr->specularColour = material->specularColour;
+			materialPtr->specularPower = material->specularPower;
+		}
+		device->getTransientConstants()->unmapConstants(device, STAGE_PS, 1);
 	}
 
 	// Set shader texture resources in the pixel shader.
 	if (texture)
-		deviceContext->PSSetShaderResources(0, 1, &texture);
+		device->setShaderResources(STAGE_PS, 0, 1, &texture);
 	if (normalMap)
-		deviceContext->PSSetShaderResources(1, 1, &normalMap);
+		device->setShaderResources(STAGE_PS, 1, 1, &normalMap);
 
 	//Set displacement map resources in domain shader
-	if (domainShader) {
+	if (stages.domainShader) {
 
 		//send displacement buffer:
-		DisplacementBufferType* dispPtr;
-		deviceContext->Map(displacementBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-		dispPtr = (DisplacementBufferType*)mappedResource.pData;
-		if (displacementMap)
-			dispPtr->mode = DISPLACEMENT;
-		else
-			dispPtr->mode = NO_DISPLACEMENT;
-		dispPtr->scale = GLOBALS.DisplacementScale;
-		dispPtr->bias = -GLOBALS.DisplacementScale/2.0f;
-		dispPtr->mapSize = 1024;
-		deviceContext->Unmap(displacementBuffer, 0);
-		deviceContext->DSSetConstantBuffers(2, 1, &displacementBuffer);
+		DisplacementBufferType* dispPtr = (DisplacementBufferType*)device->getTransientConstants()->map(device, sizeof(DisplacementBufferType), displacementBuffer);
+		if (dispPtr) {
+			if (displacementMap)
+				dispPtr->mode = DISPLACEMENT;
+			else
+				dispPtr->mode = NO_DISPLACEMENT;
+			dispPtr->scale = GLOBALS.DisplacementScale;
+			dispPtr->bias = -GLOBALS.DisplacementScale/2.0f;
+			dispPtr->mapSize = 1024;
+		}
+		device->getTransientConstants()->unmapConstants(device, STAGE_DS, 2);
 
 		if (displacementMap) {
-			deviceContext->DSSetShaderResources(0, 1, &displacementMap);
+			device->setShaderResources(STAGE_DS, 0, 1, &displacementMap);
 		}
 	}
 }
\ No newline at end of file
@@ -1,9 +1,10 @@
 #pragma once
 #include "Shader.h"
+#include "ConstantBlock.h"
 
 ///Base shader for any lit piece of geometry
 
-#define NUM_LIGHTS 8 //must be same as in fragment, vertex and domain shaders AND needs to be divisible by 4
+#define NUM_LIGHTS 8 //number of shadowmap slots (shadowed lights); must be same as in fragment, vertex and domain shaders AND needs to be divisible by 4. Any number of unshadowed lights can be added through LightGrid
 
 //modes
 #define COLOUR 0
@@ -24,13 +25,10 @@ protected:
 		float farPlane;//the far plane's distance from camera
 	};
 
-	///passes light information to FS; should only require one gpu write per frame
+	///passes light information to FS; should only require one gpu write per frame. The lights themselves go through LightGrid
 	struct LightBufferType {
 		XMFLOAT4 ambient;
-		XMFLOAT4 diffuse[NUM_LIGHTS];
-		XMFLOAT4 position[NUM_LIGHTS];//w is type (see ExtendedLight.h)
-		XMFLOAT4 direction[NUM_LIGHTS];
-		XMFLOAT4 attenuation[NUM_LIGHTS];//w is whether to generate shadows for this light (0 or 1)
+		XMFLOAT4 shadowParams[NUM_LIGHTS];//per shadowmap slot: 1 / the distance covered by the shadowmap, filtering mode (0 for no shadows, else SHADOWMAP_PCF or SHADOWMAP_VSM), texel size (see ExtendedLight::getShadowTexelSize)
 		float oneOverFarPlane;
 		float shadowmapBias;
 		float showShadowmapErrors;
@@ -64,19 +62,21 @@ public:
 	LitShader();
 	virtual ~LitShader();
 	
-	///should be called only once per frame
-	void setLightParameters(ID3D11DeviceContext* deviceContext, XMFLOAT3 cameraPosition, ExtendedLight** lights, ID3D11ShaderResourceView** shadowmaps, bool sendShadowmaps, int numLights);
+	///only uploads what changed since this shader's last call; farPlane overrides the distance depths are normalized against (0 to use FAR_PLANE)
+	void setLightParameters(RenderDevice* device, XMFLOAT3 cameraPosition, ExtendedLight** lights, GpuView** shadowmaps, bool sendShadowmaps, int numLights, float farPlane = 0);
 	///setup material parameters for any shader (colour, texture, etc)
-	void setMaterialParameters(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* normalMap, ID3D11ShaderResourceView* displacementMap, Material* material);
+	void setMaterialParameters(RenderDevice* device, GpuView* texture, GpuView* normalMap, GpuView* displacementMap, Material* material);
 
 protected:
 	virtual void initBuffers() override;
 
 private:
-	ID3D11Buffer* cameraBuffer;			//VS b1 or DS b1
-	ID3D11Buffer* lightBuffer;			//PS b0
-	ID3D11Buffer* materialBuffer;		//PS b1
-	ID3D11Buffer* displacementBuffer;	//DS b2
-	ID3D11Buffer* shadowmapMatrixBuffer;//VS b3 or DS b3
+	ConstantBlock<CameraBufferType> cameraBlock;					//VS b1 or DS b1
+	ConstantBlock<LightBufferType> lightBlock;					//PS b0
+	GpuBuffer* materialBuffer = nullptr;						//PS b1
+	GpuBuffer* displacementBuffer = nullptr;					//DS b2
+	ConstantBlock<ShadowmapMatrixBufferType> shadowmapMatrixBlock;	//VS b3 or DS b3
+	GpuSampler* shadowSampleState = nullptr;//PS s1
+	GpuSampler* vsmSampleState = nullptr;	//PS s2
 };
 
@@ -0,0 +1,318 @@
+#include "LodBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+///sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+struct Quadric {
+	double xx = 0, xy = 0, xz = 0, xw = 0, yy = 0, yz = 0, yw = 0, zz = 0, zw = 0, ww = 0;
+
+	inline void addPlane(double a, double b, double c, double d) {
+		xx += a * a; xy += a * b; xz += a * c; xw += a * d;
+		yy += b * b; yz += b * c; yw += b * d;
+		zz += c * c; zw += c * d;
+		ww += d * d;
+	}
+	inline Quadric& operator+=(const Quadric& o) {
+		xx += o.xx; xy += o.xy; xz += o.xz; xw += o.xw;
+		yy += o.yy; yz += o.yz; yw += o.yw;
+		zz += o.zz; zw += o.zw;
+		ww += o.ww;
+		return *this;
+	}
+	inline double evaluate(const XMFLOAT3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double result = xx * x * x + 2 * xy * x * y + 2 * xz * x * z + 2 * xw * x
+			+ yy * y * y + 2 * yz * y * z + 2 * yw * y
+			+ zz * z * z + 2 * zw * z
+			+ ww;
+		return result > 0 ? result : 0;//rounding can take it just under
+	}
+};
+
+///moving one vertex onto another
+struct Collapse {
+	double cost;
+	unsigned int from, to;
+	unsigned int fromVersion, toVersion;
+	inline bool operator<(const Collapse& other) const { return cost > other.cost; }//cheapest on top
+};
+
+static inline const XMFLOAT3& positionAt(const XMFLOAT3* positions, unsigned int stride, unsigned long index) {
+	return *(const XMFLOAT3*)((const char*)positions + (size_t)stride * index);
+}
+
+static inline XMVECTOR triangleNormal(const XMFLOAT3& a, const XMFLOAT3& b, const XMFLOAT3& c) {
+	XMVECTOR pa = XMLoadFloat3(&a);
+	return XMVector3Cross(XMLoadFloat3(&b) - pa, XMLoadFloat3(&c) - pa);
+}
+
+unsigned long long LodBuilder::hash(const void* data, size_t size, unsigned long long hash) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void LodBuilder::weld(const void* vertices, unsigned int stride, unsigned int vertexCount, std::vector<unsigned int>& out_wedges) {
+	out_wedges.resize(vertexCount);
+	std::unordered_map<unsigned long long, unsigned int> firsts;
+	firsts.reserve(vertexCount);
+	const char* bytes = (const char*)vertices;
+	for (unsigned int v = 0; v < vertexCount; ++v) {
+		const char* vertex = bytes + (size_t)stride * v;
+		//different vertices with the same hash move on to the next one
+		unsigned long long key = hash(vertex, stride);
+		while (true) {
+			auto it = firsts.find(key);
+			if (it == firsts.end()) {
+				firsts[key] = v;
+				out_wedges[v] = v;
+				break;
+			}
+			if (memcmp(bytes + (size_t)stride * it->second, vertex, stride) == 0) {
+				out_wedges[v] = it->second;
+				break;
+			}
+			++key;
+		}
+	}
+}
+
+void LodBuilder::build(const XMFLOAT3* positions, unsigned int stride, const unsigned int* wedges, const unsigned int* groups, const unsigned long* indices, unsigned int indexCount,
+	std::vector<unsigned long>& out_indices, std::vector<MeshLod>& out_lods) {
+
+	unsigned int triangleCount = indexCount / 3;
+	out_indices.assign(indices, indices + triangleCount * 3);
+	out_lods.clear();
+	MeshLod full = { 0, triangleCount * 3, 0, 0, 0 };
+	out_lods.push_back(full);
+	if (triangleCount < LOD_MIN_TRIANGLES) return;
+
+	//corners refer to wedges; wedges are welded again by position into the vertices that actually collapse
+	unsigned int vertexCount = 0;
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		vertexCount = (std::max)(vertexCount, (unsigned int)indices[i] + 1);
+	std::vector<unsigned int> corners(triangleCount * 3);
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		corners[i] = wedges[indices[i]];
+
+	std::vector<unsigned int> positionOf(vertexCount, UINT_MAX);//per wedge
+	std::vector<unsigned int> wedgeOf;//per position: the first wedge seen there
+	std::vector<unsigned int> groupOf;
+	std::vector<bool> locked;
+	{
+		std::unordered_map<unsigned long long, unsigned int> ids;
+		for (unsigned int corner : corners) {
+			if (positionOf[corner] != UINT_MAX) continue;
+			const XMFLOAT3& p = positionAt(positions, stride, corner);
+			unsigned long long key = hash(&p, sizeof(XMFLOAT3));
+			unsigned int id;
+			while (true) {
+				auto it = ids.find(key);
+				if (it == ids.end()) {
+					id = (unsigned int)wedgeOf.size();
+					ids[key] = id;
+					wedgeOf.push_back(corner);
+					groupOf.push_back(groups ? groups[corner] : 0);
+					locked.push_back(false);
+					break;
+				}
+				if (memcmp(&positionAt(positions, stride, wedgeOf[it->second]), &p, sizeof(XMFLOAT3)) == 0) {
+					id = it->second;
+					//a second wedge in the same spot: attributes split here, so it stays put
+					if (wedgeOf[id] != corner) locked[id] = true;
+					break;
+				}
+				++key;
+			}
+			positionOf[corner] = id;
+		}
+	}
+	unsigned int pointCount = (unsigned int)wedgeOf.size();
+	std::vector<XMFLOAT3> points(pointCount);
+	for (unsigned int w = 0; w < vertexCount; ++w)
+		if (positionOf[w] != UINT_MAX) points[positionOf[w]] = positionAt(positions, stride, w);
+
+	//borders (and anything non manifold) stay put too, or the mesh would shrink away from its outline
+	{
+		std::unordered_map<unsigned long long, unsigned int> edges;
+		for (unsigned int t = 0; t < triangleCount; ++t) {
+			for (int i = 0; i < 3; ++i) {
+				unsigned long long a = positionOf[corners[t * 3 + i]], b = positionOf[corners[t * 3 + (i + 1) % 3]];
+				++edges[a < b ? (a << 32) | b : (b << 32) | a];
+			}
+		}
+		for (const auto& edge : edges) {
+			if (edge.second == 2) continue;
+			locked[(unsigned int)(edge.first >> 32)] = true;
+			locked[(unsigned int)(edge.first & 0xFFFFFFFF)] = true;
+		}
+	}
+
+	//each vertex's quadric holds the planes of the triangles around it
+	std::vector<Quadric> quadrics(pointCount);
+	std::vector<std::vector<unsigned int>> around(pointCount);
+	std::vector<bool> alive(triangleCount, true);
+	unsigned int liveTriangles = triangleCount;
+	for (unsigned int t = 0; t < triangleCount; ++t) {
+		unsigned int p[3] = { positionOf[corners[t * 3]], positionOf[corners[t * 3 + 1]], positionOf[corners[t * 3 + 2]] };
+		if (p[0] == p[1] || p[1] == p[2] || p[0] == p[2]) {
+			alive[t] = false;
+			--liveTriangles;
+			continue;
+		}
+		XMVECTOR normal = triangleNormal(points[p[0]], points[p[1]], points[p[2]]);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) > 0) {
+			XMFLOAT3 n;
+			XMStoreFloat3(&n, XMVector3Normalize(normal));
+			double d = -(n.x * points[p[0]].x + n.y * points[p[0]].y + n.z * points[p[0]].z);
+			for (int i = 0; i < 3; ++i)
+				quadrics[p[i]].addPlane(n.x, n.y, n.z, d);
+		}
+		for (int i = 0; i < 3; ++i)
+			around[p[i]].push_back(t);
+	}
+
+	std::vector<unsigned int> versions(pointCount, 0);
+	std::vector<bool> removed(pointCount, false);
+	std::priority_queue<Collapse> collapses;
+	auto push = [&](unsigned int from, unsigned int to) {
+		if (locked[from] || removed[from] || removed[to] || groupOf[from] != groupOf[to]) return;
+		Quadric sum = quadrics[from];
+		sum += quadrics[to];
+		Collapse collapse = { sum.evaluate(points[to]), from, to, versions[from], versions[to] };
+		collapses.push(collapse);
+	};
+	auto pushAround = [&](unsigned int from) {
+		for (unsigned int t : around[from]) {
+			if (!alive[t]) continue;
+			for (int i = 0; i < 3; ++i) {
+				unsigned int to = positionOf[corners[t * 3 + i]];
+				if (to != from) push(from, to);
+			}
+		}
+	};
+	for (unsigned int p = 0; p < pointCount; ++p)
+		pushAround(p);
+
+	double maxCost = 0;
+	unsigned int target = (unsigned int)(triangleCount * LOD_RATIO);
+	unsigned int previous = triangleCount;
+	while ((int)out_lods.size() < LOD_MAX_LEVELS) {
+		while (liveTriangles > target && !collapses.empty()) {
+			Collapse collapse = collapses.top();
+			collapses.pop();
+			unsigned int a = collapse.from, b = collapse.to;
+			if (removed[a] || removed[b] || versions[a] != collapse.fromVersion || versions[b] != collapse.toVersion) continue;
+
+			//b's wedge on the other side of the edge is where a's corners go; a has only the one wedge, or it'd be locked
+			unsigned int wedge = UINT_MAX;
+			bool flips = false;
+			for (unsigned int t : around[a]) {
+				if (!alive[t]) continue;
+				int ia = -1, ib = -1;
+				for (int i = 0; i < 3; ++i) {
+					unsigned int p = positionOf[corners[t * 3 + i]];
+					if (p == a) ia = i;
+					else if (p == b) ib = i;
+				}
+				if (ib >= 0) {
+					wedge = corners[t * 3 + ib];
+					continue;
+				}
+				//the triangles that stay can't turn over
+				XMFLOAT3 moved[3];
+				for (int i = 0; i < 3; ++i)
+					moved[i] = i == ia ? points[b] : points[positionOf[corners[t * 3 + i]]];
+				XMVECTOR before = triangleNormal(points[positionOf[corners[t * 3]]], points[positionOf[corners[t * 3 + 1]]], points[positionOf[corners[t * 3 + 2]]]);
+				XMVECTOR after = triangleNormal(moved[0], moved[1], moved[2]);
+				if (XMVectorGetX(XMVector3Dot(before, after)) <= 0) {
+					flips = true;
+					break;
+				}
+			}
+			if (flips || wedge == UINT_MAX) continue;
+
+			for (unsigned int t : around[a]) {
+				if (!alive[t]) continue;
+				bool hasB = false;
+				for (int i = 0; i < 3; ++i)
+					hasB |= positionOf[corners[t * 3 + i]] == b;
+				if (hasB) {
+					alive[t] = false;
+					--liveTriangles;
+					continue;
+				}
+				for (int i = 0; i < 3; ++i)
+					if (positionOf[corners[t * 3 + i]] == a) corners[t * 3 + i] = wedge;
+				around[b].push_back(t);
+			}
+			around[a].clear();
+			removed[a] = true;
+			quadrics[b] += quadrics[a];
+			++versions[b];
+			maxCost = (std::max)(maxCost, collapse.cost);
+
+			//everything touching b has new costs
+			pushAround(b);
+			for (unsigned int t : around[b]) {
+				if (!alive[t]) continue;
+				for (int i = 0; i < 3; ++i) {
+					unsigned int p = positionOf[corners[t * 3 + i]];
+					if (p != b) push(p, b);
+				}
+			}
+		}
+
+		if (liveTriangles > previous * LOD_MIN_REDUCTION) break;
+		MeshLod lod = { (unsigned int)out_indices.size(), liveTriangles * 3, (float)sqrt(maxCost), 0, 0 };
+		for (unsigned int t = 0; t < triangleCount; ++t) {
+			if (!alive[t]) continue;
+			for (int i = 0; i < 3; ++i)
+				out_indices.push_back(corners[t * 3 + i]);
+		}
+		out_lods.push_back(lod);
+		previous = liveTriangles;
+		target = (unsigned int)(liveTriangles * LOD_RATIO);
+		if (liveTriangles < LOD_MIN_TRIANGLES) break;
+	}
+}
+
+void LodBuilder::report(const std::vector<std::vector<XMFLOAT3>>& meshes) {
+	unsigned int triangles[LOD_MAX_LEVELS] = {};
+	float maxError[LOD_MAX_LEVELS] = {};
+	unsigned int simplified = 0;
+	float time = 0;
+	for (const std::vector<XMFLOAT3>& mesh : meshes) {
+		if (mesh.empty()) continue;
+		std::vector<unsigned long> indices(mesh.size());
+		for (unsigned int i = 0; i < (unsigned int)indices.size(); ++i) indices[i] = i;
+		std::vector<unsigned int> wedges;
+		std::vector<unsigned long> lodIndices;
+		std::vector<MeshLod> lods;
+		auto start = std::chrono::high_resolution_clock::now();
+		weld(&mesh[0], sizeof(XMFLOAT3), (unsigned int)mesh.size(), wedges);
+		build(&mesh[0], sizeof(XMFLOAT3), &wedges[0], nullptr, &indices[0], (unsigned int)indices.size(), lodIndices, lods);
+		time += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (lods.size() > 1) ++simplified;
+		//meshes with fewer levels draw their coarsest one for the rest
+		for (int level = 0; level < LOD_MAX_LEVELS; ++level) {
+			const MeshLod& lod = lods[(std::min)(level, (int)lods.size() - 1)];
+			triangles[level] += lod.indexCount / 3;
+			maxError[level] = (std::max)(maxError[level], lod.error);
+		}
+	}
+	printf("%u of %u meshes simplified, in %.1fms.\n", simplified, (unsigned int)meshes.size(), time);
+	for (int level = 0; level < LOD_MAX_LEVELS; ++level)
+		printf("Level %d: %u triangles (%.1f%%), error up to %.4f.\n", level, triangles[level], triangles[0] ? 100.f * triangles[level] / triangles[0] : 0.f, maxError[level]);
+}
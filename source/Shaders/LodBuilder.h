@@ -0,0 +1,44 @@
+#pragma once
+
+/// Builds a mesh's levels of detail by quadric error edge collapse (Garland & Heckbert): vertices keep collapsing into the neighbour that moves the
+/// surface least, until each level has about half the triangles of the one before. Collapses only ever move a vertex onto another existing one,
+/// so every level indexes into the very same vertex buffer, and they can all share one index buffer back to back.
+/// Vertices where attributes split (uv seams, skin weights, hard normals) and mesh borders never move, and nothing collapses across bones.
+/// Only relies on DirectXMath and the standard library, so it can be run and timed without a window or a device (see report()).
+
+#include <DirectXMath.h>
+#include <vector>
+
+#define LOD_MAX_LEVELS 4 //including the full mesh
+#define LOD_RATIO 0.5f //each level aims for this fraction of the previous one's triangles
+#define LOD_MIN_REDUCTION 0.8f //a level that can't get under this fraction of the previous one's triangles isn't worth it, and ends the chain
+#define LOD_MIN_TRIANGLES 64 //meshes this small don't get simplified
+
+using namespace DirectX;
+
+///one level of a mesh, as a range of its index buffer
+struct MeshLod {
+	unsigned int firstIndex;
+	unsigned int indexCount;
+	float error;//how far the surface may have moved since the full mesh, in mesh space units
+	unsigned int firstMeshlet, meshletCount;//filled in by the mesh, if it splits each level into meshlets
+};
+
+class LodBuilder {
+
+public:
+	///out_wedges[v] is the first vertex whose stride bytes are all the same as v's (position and every attribute): the vertices simplification can merge freely
+	static void weld(const void* vertices, unsigned int stride, unsigned int vertexCount, std::vector<unsigned int>& out_wedges);
+
+	///simplifies a triangle list, writing the full mesh's indices and then every coarser level's to out_indices; positions are stride bytes apart.
+	///wedges is what weld() gave for the same vertices. Vertices with different groups (dominant bone, say) never collapse into each other; groups can be null
+	static void build(const XMFLOAT3* positions, unsigned int stride, const unsigned int* wedges, const unsigned int* groups, const unsigned long* indices, unsigned int indexCount,
+		std::vector<unsigned long>& out_indices, std::vector<MeshLod>& out_lods);
+
+	///FNV-1a, for welding, and for naming cached levels after what they were built from
+	static unsigned long long hash(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull);
+
+	///simplifies meshes (triangle lists) from a scene and prints the triangles and error of each level, and how long it took; doesn't need a window or a device
+	static void report(const std::vector<std::vector<XMFLOAT3>>& meshes);
+
+};
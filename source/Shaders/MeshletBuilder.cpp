@@ -0,0 +1,257 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <climits>
+#include <unordered_map>
+
+///bit pattern of a position, so that vertices imported separately but in the same spot count as the same one
+struct PositionKey {
+	unsigned int bits[3];
+	inline bool operator==(const PositionKey& other) const { return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2]; }
+};
+struct PositionKeyHash {
+	inline size_t operator()(const PositionKey& key) const { return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u); }
+};
+
+static inline const XMFLOAT3& positionAt(const XMFLOAT3* positions, unsigned int stride, unsigned long index) {
+	return *(const XMFLOAT3*)((const char*)positions + (size_t)stride * index);
+}
+
+///bounding sphere and normal cone of triangles (3 indices each)
+static void bound(const XMFLOAT3* positions, unsigned int stride, const unsigned long* indices, unsigned int triangleCount, Meshlet& out_meshlet) {
+	XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+	for (unsigned int i = 0; i < triangleCount * 3; ++i) {
+		XMVECTOR p = XMLoadFloat3(&positionAt(positions, stride, indices[i]));
+		low = XMVectorMin(low, p);
+		high = XMVectorMax(high, p);
+	}
+	XMVECTOR center = (low + high) * 0.5f;
+	float radius = 0;
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		radius = (std::max)(radius, XMVectorGetX(XMVector3Length(XMLoadFloat3(&positionAt(positions, stride, indices[i])) - center)));
+	XMStoreFloat3(&out_meshlet.center, center);
+	out_meshlet.radius = radius;
+
+	//front faces are clockwise, so (b - a) x (c - a) points out of them
+	std::vector<XMVECTOR> normals;
+	normals.reserve(triangleCount);
+	XMVECTOR axis = XMVectorZero();
+	for (unsigned int t = 0; t < triangleCount; ++t) {
+		XMVECTOR a = XMLoadFloat3(&positionAt(positions, stride, indices[t * 3]));
+		XMVECTOR b = XMLoadFloat3(&positionAt(positions, stride, indices[t * 3 + 1]));
+		XMVECTOR c = XMLoadFloat3(&positionAt(positions, stride, indices[t * 3 + 2]));
+		XMVECTOR normal = XMVector3Cross(b - a, c - a);
+		if (XMVectorGetX(XMVector3LengthSq(normal)) <= 0) continue;//degenerate, never drawn either way
+		normal = XMVector3Normalize(normal);
+		normals.push_back(normal);
+		axis += normal;
+	}
+	out_meshlet.coneCutoff = 1;
+	out_meshlet.coneAxis = XMFLOAT3(0, 0, 0);
+	if (normals.empty() || XMVectorGetX(XMVector3LengthSq(axis)) <= 0) return;
+	axis = XMVector3Normalize(axis);
+	XMStoreFloat3(&out_meshlet.coneAxis, axis);
+
+	//the cone has to hold the normal furthest from the axis; past 90 degrees, some triangle faces every way the meshlet can be seen from
+	float minDot = 1;
+	for (const XMVECTOR& normal : normals)
+		minDot = (std::min)(minDot, XMVectorGetX(XMVector3Dot(axis, normal)));
+	out_meshlet.coneCutoff = minDot <= 0 ? 1 : sqrtf(1 - minDot * minDot);
+}
+
+void MeshletBuilder::build(const XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, unsigned long* indices, unsigned int indexCount, std::vector<Meshlet>& out_meshlets) {
+	out_meshlets.clear();
+	unsigned int triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	//weld by position
+	std::unordered_map<PositionKey, unsigned int, PositionKeyHash> welded;
+	welded.reserve(vertexCount);
+	std::vector<unsigned int> weldedIds(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; ++v) {
+		PositionKey key;
+		memcpy(key.bits, &positionAt(positions, stride, v), sizeof(key.bits));
+		weldedIds[v] = welded.insert(std::make_pair(key, (unsigned int)welded.size())).first->second;
+	}
+	unsigned int weldedCount = (unsigned int)welded.size();
+	std::vector<unsigned int> corners(triangleCount * 3);
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		corners[i] = weldedIds[indices[i]];
+
+	//triangles around each welded vertex
+	std::vector<unsigned int> adjacencyStart(weldedCount + 1, 0);
+	for (unsigned int corner : corners)
+		++adjacencyStart[corner + 1];
+	for (unsigned int v = 0; v < weldedCount; ++v)
+		adjacencyStart[v + 1] += adjacencyStart[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned int i = 0; i < triangleCount * 3; ++i)
+		adjacency[fill[corners[i]]++] = i / 3;
+
+	//grow each meshlet from the first triangle left, always adding the neighbouring triangle that brings the fewest new vertices,
+	//until none fit or there are none left around it
+	std::vector<unsigned long> sorted;
+	sorted.reserve(triangleCount * 3);
+	std::vector<bool> used(triangleCount, false);
+	std::vector<unsigned int> owner(weldedCount, UINT_MAX);//which meshlet each vertex was last added to
+	std::vector<unsigned int> meshletVertices;
+	unsigned int seed = 0;
+	while (true) {
+		while (seed < triangleCount && used[seed]) ++seed;
+		if (seed == triangleCount) break;
+
+		unsigned int id = (unsigned int)out_meshlets.size();
+		Meshlet meshlet;
+		meshlet.firstIndex = (unsigned int)sorted.size();
+		meshletVertices.clear();
+		unsigned int triangles = 0;
+		unsigned int next = seed;
+		while (true) {
+			used[next] = true;
+			for (int i = 0; i < 3; ++i) {
+				sorted.push_back(indices[next * 3 + i]);
+				unsigned int corner = corners[next * 3 + i];
+				if (owner[corner] != id) {
+					owner[corner] = id;
+					meshletVertices.push_back(corner);
+				}
+			}
+			if (++triangles == MESHLET_MAX_TRIANGLES) break;
+
+			unsigned int best = UINT_MAX;
+			int bestNew = 4;
+			for (unsigned int vertex : meshletVertices) {
+				for (unsigned int a = adjacencyStart[vertex]; a < adjacencyStart[vertex + 1] && bestNew > 0; ++a) {
+					unsigned int candidate = adjacency[a];
+					if (used[candidate]) continue;
+					int added = 0;
+					for (int i = 0; i < 3; ++i)
+						added += owner[corners[candidate * 3 + i]] != id;
+					if (added < bestNew && meshletVertices.size() + added <= MESHLET_MAX_VERTICES) {
+						best = candidate;
+						bestNew = added;
+					}
+				}
+				if (bestNew == 0) break;
+			}
+			if (best == UINT_MAX) break;
+			next = best;
+		}
+		meshlet.indexCount = triangles * 3;
+		bound(positions, stride, &sorted[meshlet.firstIndex], triangles, meshlet);
+		out_meshlets.push_back(meshlet);
+	}
+
+	memcpy(indices, &sorted[0], sizeof(unsigned long) * triangleCount * 3);
+}
+
+void MeshletBuilder::makeView(const XMMATRIX& view, const XMMATRIX& projection, MeshletView& out_view) {
+	//planes straight out of the view projection matrix's columns, for a 0 to w depth range
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, view * projection);
+	XMVECTOR x = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR y = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR z = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR w = XMVectorSet(m._14, m._24, m._34, m._44);
+	XMVECTOR planes[6] = { w + x, w - x, w + y, w - y, z, w - z };
+	for (int i = 0; i < 6; ++i)
+		XMStoreFloat4(&out_view.planes[i], XMPlaneNormalize(planes[i]));
+
+	XMMATRIX inverseView = XMMatrixInverse(nullptr, view);
+	XMStoreFloat3(&out_view.position, inverseView.r[3]);
+	XMStoreFloat3(&out_view.direction, XMVector3Normalize(inverseView.r[2]));
+	XMFLOAT4X4 p;
+	XMStoreFloat4x4(&p, projection);
+	out_view.orthographic = p._34 == 0;//perspective projections put view depth in w
+}
+
+int MeshletBuilder::test(const Meshlet& meshlet, const XMMATRIX& world, const MeshletView& view) {
+	XMVECTOR center = XMVector3Transform(XMLoadFloat3(&meshlet.center), world);
+	float scale = sqrtf((std::max)((std::max)(XMVectorGetX(XMVector3LengthSq(world.r[0])), XMVectorGetX(XMVector3LengthSq(world.r[1]))), XMVectorGetX(XMVector3LengthSq(world.r[2]))));
+	float radius = meshlet.radius * scale;
+	for (int i = 0; i < 6; ++i)
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&view.planes[i]), center)) < -radius) return MESHLET_OFFSCREEN;
+
+	if (meshlet.coneCutoff >= 1) return MESHLET_VISIBLE;
+	XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&meshlet.coneAxis), world));
+	if (view.orthographic) {
+		//every ray comes in the same direction
+		if (XMVectorGetX(XMVector3Dot(XMLoadFloat3(&view.direction), axis)) > meshlet.coneCutoff) return MESHLET_BACKFACING;
+	}
+	else {
+		//rays from the camera to anywhere in the sphere all have to be within the cone's back side
+		XMVECTOR toCenter = center - XMLoadFloat3(&view.position);
+		if (XMVectorGetX(XMVector3Dot(toCenter, axis)) > meshlet.coneCutoff * XMVectorGetX(XMVector3Length(toCenter)) + radius) return MESHLET_BACKFACING;
+	}
+	return MESHLET_VISIBLE;
+}
+
+void MeshletBuilder::report(const std::vector<std::vector<XMFLOAT3>>& meshes) {
+	std::vector<std::vector<Meshlet>> meshlets(meshes.size());
+	unsigned int triangles = 0, meshletCount = 0, vertices = 0, full = 0, coned = 0;
+	float time = 0;
+	for (size_t m = 0; m < meshes.size(); ++m) {
+		if (meshes[m].empty()) continue;
+		std::vector<unsigned long> indices(meshes[m].size());
+		for (unsigned int i = 0; i < (unsigned int)indices.size(); ++i) indices[i] = i;
+		auto start = std::chrono::high_resolution_clock::now();
+		build(&meshes[m][0], sizeof(XMFLOAT3), (unsigned int)meshes[m].size(), &indices[0], (unsigned int)indices.size(), meshlets[m]);
+		time += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		triangles += (unsigned int)indices.size() / 3;
+		for (const Meshlet& meshlet : meshlets[m]) {
+			++meshletCount;
+			if (meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES) ++full;
+			if (meshlet.coneCutoff < 1) ++coned;
+			std::unordered_map<PositionKey, bool, PositionKeyHash> unique;
+			for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; ++i) {
+				PositionKey key;
+				memcpy(key.bits, &meshes[m][indices[i]], sizeof(key.bits));
+				unique[key] = true;
+			}
+			vertices += (unsigned int)unique.size();
+		}
+	}
+	if (meshletCount == 0) return;
+	printf("%u triangles in %u meshes make %u meshlets (%.3fms to build them all).\n", triangles, (unsigned int)meshes.size(), meshletCount, time);
+	printf("%.1f triangles and %.1f vertices per meshlet on average; %.1f%% are full, %.1f%% have a cone narrow enough to cull with.\n",
+		(float)triangles / meshletCount, (float)vertices / meshletCount, 100.f * full / meshletCount, 100.f * coned / meshletCount);
+
+	//same walk as OcclusionCuller::benchmark(), then a directional light's view from above, like the shadow passes
+	std::vector<XMMATRIX> views;
+	for (int stop = 0; stop < 8; ++stop) {
+		for (int direction = 0; direction < 4; ++direction) {
+			float yaw = direction * XM_PIDIV2;
+			views.push_back(XMMatrixLookToLH(XMVectorSet(-20.f + stop * 8.f, 4, 0, 1), XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		}
+	}
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3, 16.f / 9.f, 0.1f, 200.f);
+	XMMATRIX lightView = XMMatrixLookToLH(XMVectorSet(0, 50, -30, 1), XMVector3Normalize(XMVectorSet(0.2f, -1, 0.6f, 0)), XMVectorSet(0, 0, 1, 0));
+	XMMATRIX lightProjection = XMMatrixOrthographicLH(100, 100, 0.1f, 200.f);
+
+	const char* names[2] = { "camera", "light" };
+	for (int pass = 0; pass < 2; ++pass) {
+		unsigned int tested = 0, offscreen = 0, backfacing = 0;
+		unsigned int viewCount = pass == 0 ? (unsigned int)views.size() : 1;
+		for (unsigned int v = 0; v < viewCount; ++v) {
+			MeshletView view;
+			if (pass == 0) makeView(views[v], projection, view);
+			else makeView(lightView, lightProjection, view);
+			for (const std::vector<Meshlet>& mesh : meshlets) {
+				for (const Meshlet& meshlet : mesh) {
+					int result = test(meshlet, XMMatrixIdentity(), view);
+					++tested;
+					if (result == MESHLET_OFFSCREEN) ++offscreen;
+					else if (result == MESHLET_BACKFACING) ++backfacing;
+				}
+			}
+		}
+		printf("From the %s (%u views): %.1f%% of meshlets off screen, %.1f%% back facing, %.1f%% of those on screen.\n", names[pass], viewCount,
+			100.f * offscreen / tested, 100.f * backfacing / tested, tested > offscreen ? 100.f * backfacing / (tested - offscreen) : 0.f);
+	}
+}
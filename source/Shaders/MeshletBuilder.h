@@ -0,0 +1,54 @@
+#pragma once
+
+/// Splits a mesh into meshlets: small clusters of neighbouring triangles, each with a bounding sphere and a cone holding all of its normals,
+/// so that a pass can skip the ones that are off screen, or that face away from it entirely, and only draw the index ranges left.
+/// Triangles get grown into meshlets through the vertices they share, welded by position since imported meshes don't share any.
+/// Only relies on DirectXMath, so it can be run and timed without a window or a device (see report()).
+
+#include <DirectXMath.h>
+#include <vector>
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+//what test() makes of a meshlet
+#define MESHLET_VISIBLE 0
+#define MESHLET_OFFSCREEN 1
+#define MESHLET_BACKFACING 2
+
+using namespace DirectX;
+
+struct Meshlet {
+	unsigned int firstIndex;//into the mesh's indices, which build() sorts by meshlet
+	unsigned int indexCount;
+	XMFLOAT3 center;//bounding sphere, mesh space
+	float radius;
+	XMFLOAT3 coneAxis;//average facing, mesh space
+	float coneCutoff;//sine of the angle between the axis and the normal furthest from it; 1 if the cone is too wide to cull anything
+};
+
+///what a pass sees meshlets from
+struct MeshletView {
+	XMFLOAT4 planes[6];//world space frustum, pointing in
+	XMFLOAT3 position;//of the camera or light
+	XMFLOAT3 direction;//where it's looking, for orthographic projections
+	bool orthographic;
+};
+
+class MeshletBuilder {
+
+public:
+	///reorders indices (a triangle list, indexCount / 3 triangles into positions, stride bytes apart) so each meshlet's triangles are next to each other, and fills in out_meshlets
+	static void build(const XMFLOAT3* positions, unsigned int stride, unsigned int vertexCount, unsigned long* indices, unsigned int indexCount, std::vector<Meshlet>& out_meshlets);
+
+	///the frustum and viewpoint of a pass, with any perspective or orthographic projection
+	static void makeView(const XMMATRIX& view, const XMMATRIX& projection, MeshletView& out_view);
+	///MESHLET_VISIBLE, MESHLET_OFFSCREEN or MESHLET_BACKFACING (every triangle in it faces away, so back face culling would throw them all out anyway).
+	///world shouldn't mirror anything, or the cone would point the wrong way
+	static int test(const Meshlet& meshlet, const XMMATRIX& world, const MeshletView& view);
+
+	///splits meshes (triangle lists) into meshlets, and tests them from a few spots along the street and from a directional light above it,
+	///printing how many there are and how many get culled; doesn't need a window or a device
+	static void report(const std::vector<std::vector<XMFLOAT3>>& meshes);
+
+};
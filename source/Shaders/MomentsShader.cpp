@@ -0,0 +1,11 @@
+#include "MomentsShader.h"
+
+
+
+MomentsShader::MomentsShader(){
+	SETUP_SHADER_POSITION(depth_vs, moments_fs);
+}
+
+
+MomentsShader::~MomentsShader(){
+}
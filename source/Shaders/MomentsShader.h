@@ -0,0 +1,10 @@
+#pragma once
+#include "LitShader.h"
+
+///Renders depth moments from a light's point of view, for variance shadow maps
+class MomentsShader : public LitShader{
+public:
+	MomentsShader();
+	~MomentsShader();
+};
+
@@ -0,0 +1,206 @@
+#include "NullRenderDevice.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+NullRenderDevice::NullRenderDevice(bool record) : root(this), record(record), bufferCount(0), objectCount(0) {
+	memset(counts, 0, sizeof(counts));
+	memset(blocks, 0, sizeof(blocks));
+}
+
+NullRenderDevice::NullRenderDevice(NullRenderDevice* root, int slot) : root(root), record(root->record), bufferCount(0), objectCount(0) {
+	this->slot = slot;
+	memset(counts, 0, sizeof(counts));
+	memset(blocks, 0, sizeof(blocks));
+}
+
+NullRenderDevice::~NullRenderDevice() {
+	for (int i = 0; i < NULL_BUFFER_BLOCKS; ++i)
+		if (blocks[i]) delete[] blocks[i];
+}
+
+void NullRenderDevice::add(int type, const void* object, unsigned int a, unsigned int b, unsigned int c) {
+	++counts[type];
+	if (record)
+		commands.push_back({ type, object, a, b, c });
+}
+
+std::vector<unsigned char>* NullRenderDevice::storage(GpuBuffer* buffer) {
+	uintptr_t index = (uintptr_t)buffer;
+	if (index == 0 || index > bufferCount) return nullptr;
+	--index;
+	return &blocks[index / NULL_BUFFER_BLOCK][index % NULL_BUFFER_BLOCK];
+}
+
+GpuBuffer* NullRenderDevice::createBuffer(unsigned int size, int type) {
+	unsigned int index;
+	{
+		std::lock_guard<std::mutex> lock(root->buffersLock);
+		if (!root->freeBuffers.empty()) {
+			index = root->freeBuffers.back();
+			root->freeBuffers.pop_back();
+		}
+		else {
+			index = root->bufferCount;
+			if (index >= NULL_BUFFER_BLOCK * NULL_BUFFER_BLOCKS) {
+				printf("Error: the null device can't hold more than %d buffers.\n", NULL_BUFFER_BLOCK * NULL_BUFFER_BLOCKS);
+				return nullptr;
+			}
+			if (!root->blocks[index / NULL_BUFFER_BLOCK])
+				root->blocks[index / NULL_BUFFER_BLOCK] = new std::vector<unsigned char>[NULL_BUFFER_BLOCK];
+		}
+		root->blocks[index / NULL_BUFFER_BLOCK][index % NULL_BUFFER_BLOCK].resize(size);
+		if (index == root->bufferCount)
+			++root->bufferCount;//only now can other threads look it up
+	}
+	GpuBuffer* buffer = (GpuBuffer*)(uintptr_t)(index + 1);
+	add(COMMAND_CREATE_BUFFER, buffer, size, type);
+	return buffer;
+}
+
+GpuBuffer* NullRenderDevice::createStaticBuffer(unsigned int size, int type, const void* data) {
+	GpuBuffer* buffer = createBuffer(size, type);
+	std::vector<unsigned char>* storage = root->storage(buffer);
+	if (storage && data && size > 0)
+		memcpy(&(*storage)[0], data, size);
+	return buffer;
+}
+
+void NullRenderDevice::releaseBuffer(GpuBuffer* buffer) {
+	std::lock_guard<std::mutex> lock(root->buffersLock);
+	std::vector<unsigned char>* data = root->storage(buffer);
+	if (!data) return;
+	std::vector<unsigned char>().swap(*data);
+	root->freeBuffers.push_back((unsigned int)((uintptr_t)buffer - 1));
+}
+
+GpuBuffer* NullRenderDevice::createShaderBuffer(unsigned int count, unsigned int stride, int format, GpuView** out_view) {
+	GpuBuffer* buffer = createBuffer(count * stride, BUFFER_VERTEX);
+	*out_view = (GpuView*)buffer;//just as meaningless, but tells views apart in the command list
+	return buffer;
+}
+
+GpuBuffer* NullRenderDevice::createIndirectBuffer(unsigned int count, const unsigned int* initial, GpuUnorderedView** out_view) {
+	GpuBuffer* buffer = createBuffer(count * sizeof(unsigned int), BUFFER_VERTEX);
+	std::vector<unsigned char>* data = root->storage(buffer);
+	if (data && initial)
+		memcpy(&(*data)[0], initial, count * sizeof(unsigned int));
+	*out_view = (GpuUnorderedView*)buffer;
+	return buffer;
+}
+
+void* NullRenderDevice::map(GpuBuffer* buffer, bool noOverwrite) {
+	std::vector<unsigned char>* data = root->storage(buffer);
+	if (!data || data->empty()) {
+		printf("Error: mapping a buffer the null device doesn't know about.\n");
+		return nullptr;
+	}
+	add(COMMAND_MAP, buffer, (unsigned int)data->size(), noOverwrite);
+	bytesMapped += data->size();
+	return &(*data)[0];
+}
+
+void NullRenderDevice::copyBuffer(GpuBuffer* destination, unsigned int destinationOffset, GpuBuffer* source, unsigned int sourceOffset, unsigned int size) {
+	std::vector<unsigned char>* to = root->storage(destination);
+	std::vector<unsigned char>* from = root->storage(source);
+	if (!to || !from || destinationOffset + size > to->size() || sourceOffset + size > from->size()) {
+		printf("Error: copying between buffers the null device doesn't know about, or past their end.\n");
+		return;
+	}
+	add(COMMAND_COPY_BUFFER, destination, destinationOffset, size);
+	if (size > 0)
+		memcpy(&(*to)[destinationOffset], &(*from)[sourceOffset], size);
+}
+
+bool NullRenderDevice::readBuffer(GpuBuffer* buffer, std::vector<unsigned char>& out_bytes) {
+	std::vector<unsigned char>* data = root->storage(buffer);
+	if (!data) return false;
+	out_bytes = *data;
+	return true;
+}
+
+void NullRenderDevice::setShaderResources(int stage, unsigned int slot, unsigned int count, GpuView* const* views) {
+	for (unsigned int i = 0; i < count; ++i)
+		add(COMMAND_SET_RESOURCES, views[i], stage, slot + i);
+}
+
+void NullRenderDevice::setSamplers(int stage, unsigned int slot, unsigned int count, GpuSampler* const* samplers) {
+	for (unsigned int i = 0; i < count; ++i)
+		add(COMMAND_SET_SAMPLERS, samplers[i], stage, slot + i);
+}
+
+void NullRenderDevice::setUnorderedViews(unsigned int slot, unsigned int count, GpuUnorderedView* const* views) {
+	for (unsigned int i = 0; i < count; ++i)
+		add(COMMAND_SET_UNORDERED, views[i], slot + i);
+}
+
+void NullRenderDevice::draw(unsigned int vertexCount, unsigned int startVertex) {
+	add(COMMAND_DRAW, nullptr, vertexCount, startVertex);
+	verticesDrawn += vertexCount;
+}
+
+void NullRenderDevice::drawIndexed(unsigned int indexCount, unsigned int startIndex, int baseVertex) {
+	add(COMMAND_DRAW_INDEXED, nullptr, indexCount, startIndex, (unsigned int)baseVertex);
+	verticesDrawn += indexCount;
+}
+
+void NullRenderDevice::drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex, int baseVertex, unsigned int startInstance) {
+	add(COMMAND_DRAW_INSTANCED, nullptr, indexCount, instanceCount, startInstance);
+	verticesDrawn += (unsigned long long)indexCount * instanceCount;
+}
+
+void NullRenderDevice::drawIndexedIndirect(GpuBuffer* args, unsigned int offset) {
+	add(COMMAND_DRAW_INDIRECT, args, offset);
+	std::vector<unsigned char>* data = root->storage(args);
+	if (!data || offset + 2 * sizeof(unsigned int) > data->size()) return;
+	const unsigned int* values = (const unsigned int*)&(*data)[offset];
+	verticesDrawn += (unsigned long long)values[0] * values[1];//indices per instance, instances
+}
+
+RenderDevice* NullRenderDevice::createRecorder() {
+	if (isRecorder()) {
+		printf("Error: recorders can't make recorders of their own.\n");
+		return nullptr;
+	}
+	int recorderSlot = nextSlot();
+	if (recorderSlot < 0) {
+		printf("Error: no more than %d recorders per device.\n", MAX_RENDER_DEVICES - 1);
+		return nullptr;
+	}
+	return new NullRenderDevice(root, recorderSlot);
+}
+
+GpuCommandList* NullRenderDevice::finishRecording() {
+	if (!isRecorder()) {
+		printf("Error: only recorders can finish a command list.\n");
+		return nullptr;
+	}
+	CommandList* list = new CommandList();
+	list->commands.swap(commands);
+	memcpy(list->counts, counts, sizeof(counts));
+	list->verticesDrawn = verticesDrawn;
+	list->bytesMapped = bytesMapped;
+	reset();
+	return (GpuCommandList*)list;
+}
+
+void NullRenderDevice::execute(GpuCommandList* list) {
+	if (!list) return;
+	CommandList* recorded = (CommandList*)list;
+	add(COMMAND_EXECUTE, list, (unsigned int)recorded->commands.size());
+	if (record)
+		commands.insert(commands.end(), recorded->commands.begin(), recorded->commands.end());
+	for (int i = 0; i < COMMAND_TYPES; ++i)
+		counts[i] += recorded->counts[i];
+	verticesDrawn += recorded->verticesDrawn;
+	bytesMapped += recorded->bytesMapped;
+	delete recorded;
+}
+
+void NullRenderDevice::reset() {
+	commands.clear();
+	memset(counts, 0, sizeof(counts));
+	verticesDrawn = 0;
+	bytesMapped = 0;
+}
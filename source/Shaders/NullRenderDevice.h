@@ -0,0 +1,160 @@
+#pragma once
+
+/// RenderDevice without a gpu: buffers are plain cpu memory, shaders and textures are bare handles, fences are always reached, and every bind and draw gets counted (and optionally recorded),
+/// so that a frame's culling, sorting and constant packing can be benchmarked, or its command stream compared against a known good one, headless.
+/// Recorders keep their own commands and counts, and hand them over in one go when their list gets executed; buffers all live in the device they came from, behind a lock.
+
+#include "RenderDevice.h"
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+//command types, for RecordedCommand::type and getCount()
+#define COMMAND_CREATE_BUFFER 0
+#define COMMAND_MAP 1
+#define COMMAND_SET_LAYOUT 2
+#define COMMAND_SET_SHADER 3
+#define COMMAND_SET_CONSTANTS 4
+#define COMMAND_SET_RESOURCES 5
+#define COMMAND_SET_SAMPLERS 6
+#define COMMAND_SET_VERTEX_BUFFER 7
+#define COMMAND_SET_INDEX_BUFFER 8
+#define COMMAND_SET_TOPOLOGY 9
+#define COMMAND_DRAW 10
+#define COMMAND_DRAW_INDEXED 11
+#define COMMAND_SET_TARGET 12
+#define COMMAND_CLEAR 13
+#define COMMAND_EXECUTE 14
+#define COMMAND_SET_DEPTH_STATE 15
+#define COMMAND_QUERY 16 //a is 0 for begin, 1 for end
+#define COMMAND_SET_UNORDERED 17
+#define COMMAND_DRAW_INDIRECT 18
+#define COMMAND_DISPATCH 19
+#define COMMAND_DRAW_INSTANCED 20 //a is the index count, b the instance count, c the start instance
+#define COMMAND_COPY_BUFFER 21 //object is the destination, a its offset, b the size
+#define COMMAND_TYPES 22
+
+#define NULL_BUFFER_BLOCK 256 //buffers are stored in blocks of this many, which never move once allocated
+#define NULL_BUFFER_BLOCKS 256 //so there can be up to 65536 of them
+#define NULL_FIRST_OBJECT (NULL_BUFFER_BLOCK * NULL_BUFFER_BLOCKS + 1) //handles of shaders, layouts, samplers and textures start past the buffers'
+
+///one call, as recorded; what a, b and c hold depends on the type (stage/slot/offset for binds, counts for draws, size for maps...)
+struct RecordedCommand {
+	int type;
+	const void* object;//buffer, shader or view the call was about
+	unsigned int a, b, c;
+};
+
+class NullRenderDevice : public RenderDevice {
+
+public:
+	///if record is false, calls are only counted; enough for benchmarks, and nothing grows
+	NullRenderDevice(bool record = true);
+	~NullRenderDevice();
+
+	GpuBuffer* createBuffer(unsigned int size, int type) override;
+	///same as a dynamic one; nothing stops the cpu from writing to it here
+	GpuBuffer* createStaticBuffer(unsigned int size, int type, const void* data) override;
+	void releaseBuffer(GpuBuffer* buffer) override;
+	void* map(GpuBuffer* buffer, bool noOverwrite) override;
+	inline void unmap(GpuBuffer* buffer) override {}
+	void copyBuffer(GpuBuffer* destination, unsigned int destinationOffset, GpuBuffer* source, unsigned int sourceOffset, unsigned int size) override;
+	bool readBuffer(GpuBuffer* buffer, std::vector<unsigned char>& out_bytes) override;
+	GpuBuffer* createShaderBuffer(unsigned int count, unsigned int stride, int format, GpuView** out_view) override;
+	inline void releaseView(GpuView* view) override {}
+	GpuBuffer* createIndirectBuffer(unsigned int count, const unsigned int* initial, GpuUnorderedView** out_view) override;
+	inline void releaseView(GpuUnorderedView* view) override {}
+	inline bool supportsConstantOffsets() override { return true; }
+
+	//shaders, layouts, samplers and textures are nothing but a handle no other object has
+	inline GpuView* createTexture(unsigned int width, unsigned int height, const unsigned char* pixels, bool mips) override { return (GpuView*)newObject(); }
+	inline GpuShader* createShader(int stage, const void* bytecode, size_t size) override { return (GpuShader*)newObject(); }
+	inline void releaseShader(GpuShader* shader) override {}
+	inline GpuLayout* createLayout(const VertexElement* elements, unsigned int count, const void* bytecode, size_t size) override { return (GpuLayout*)newObject(); }
+	inline void releaseLayout(GpuLayout* layout) override {}
+	inline GpuSampler* createSampler(int filter, int address, int comparison = COMPARE_ALWAYS) override { return (GpuSampler*)newObject(); }
+	inline void releaseSampler(GpuSampler* sampler) override {}
+
+	//there's nothing to wait for
+	inline GpuQuery* createFence() override { return (GpuQuery*)this; }
+	inline void releaseFence(GpuQuery* fence) override {}
+	inline void signalFence(GpuQuery* fence) override {}
+	inline bool fenceReached(GpuQuery* fence, bool wait) override { return true; }
+	//nor anything to count; every query comes back straight away, with nothing having passed
+	inline GpuQuery* createOcclusionQuery() override { return (GpuQuery*)this; }
+	inline void releaseQuery(GpuQuery* query) override {}
+	inline void beginQuery(GpuQuery* query) override { add(COMMAND_QUERY, query, 0); }
+	inline void endQuery(GpuQuery* query) override { add(COMMAND_QUERY, query, 1); }
+	inline bool getQueryResult(GpuQuery* query, unsigned long long& out_samples) override { out_samples = 0; return true; }
+
+	inline void setInputLayout(GpuLayout* layout) override { add(COMMAND_SET_LAYOUT, layout); }
+	inline void setShader(int stage, GpuShader* shader) override { add(COMMAND_SET_SHADER, shader, stage); }
+	inline void setConstantBuffer(int stage, unsigned int slot, GpuBuffer* buffer, unsigned int offset = 0, unsigned int size = 0) override { add(COMMAND_SET_CONSTANTS, buffer, stage, slot, offset); }
+	void setShaderResources(int stage, unsigned int slot, unsigned int count, GpuView* const* views) override;
+	void setSamplers(int stage, unsigned int slot, unsigned int count, GpuSampler* const* samplers) override;
+	void setUnorderedViews(unsigned int slot, unsigned int count, GpuUnorderedView* const* views) override;
+	///states are just their description, packed into a handle that's never null
+	inline GpuDepthState* createDepthState(int test, bool write) override { return (GpuDepthState*)(uintptr_t)(test << 1 | (write ? 1 : 0)); }
+	inline void releaseDepthState(GpuDepthState* state) override {}
+	inline void setDepthState(GpuDepthState* state) override { add(COMMAND_SET_DEPTH_STATE, state); }
+
+	inline void setVertexBuffer(GpuBuffer* buffer, unsigned int stride, unsigned int offset = 0, unsigned int slot = 0) override { add(COMMAND_SET_VERTEX_BUFFER, buffer, stride, offset, slot); }
+	inline void setIndexBuffer(GpuBuffer* buffer) override { add(COMMAND_SET_INDEX_BUFFER, buffer); }
+	inline void setTopology(int topology) override { add(COMMAND_SET_TOPOLOGY, nullptr, topology); }
+
+	void draw(unsigned int vertexCount, unsigned int startVertex = 0) override;
+	void drawIndexed(unsigned int indexCount, unsigned int startIndex = 0, int baseVertex = 0) override;
+	void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex = 0, int baseVertex = 0, unsigned int startInstance = 0) override;
+	///nothing ever runs a compute shader here, so the arguments are whatever they were created with
+	void drawIndexedIndirect(GpuBuffer* args, unsigned int offset) override;
+	inline void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1) override { add(COMMAND_DISPATCH, nullptr, groupsX, groupsY, groupsZ); }
+
+	inline void setRenderTarget(GpuTarget* target, GpuDepthTarget* depth, const Viewport& viewport) override { add(COMMAND_SET_TARGET, target, (unsigned int)viewport.width, (unsigned int)viewport.height); }
+	inline void clear(GpuTarget* target, const float colour[4], GpuDepthTarget* depth) override { add(COMMAND_CLEAR, target, depth != nullptr); }
+
+	RenderDevice* createRecorder() override;
+	GpuCommandList* finishRecording() override;
+	void execute(GpuCommandList* list) override;
+	inline bool isRecorder() override { return root != this; }
+
+	///what happened since the last reset()
+	inline const std::vector<RecordedCommand>& getCommands() { return commands; }
+	inline unsigned int getCount(int type) { return counts[type]; }
+	inline unsigned long long getVerticesDrawn() { return verticesDrawn; }//indices for indexed draws
+	inline unsigned long long getBytesMapped() { return bytesMapped; }
+	///forgets recorded commands and counts; buffers stay
+	void reset();
+
+protected:
+	///what a recorder had, between finishRecording() and execute()
+	struct CommandList {
+		std::vector<RecordedCommand> commands;
+		unsigned int counts[COMMAND_TYPES];
+		unsigned long long verticesDrawn, bytesMapped;
+	};
+
+	NullRenderDevice(NullRenderDevice* root, int slot);
+
+	NullRenderDevice* root;//owns the buffers; this, unless this is a recorder
+	bool record;
+	std::vector<RecordedCommand> commands;
+	unsigned int counts[COMMAND_TYPES];
+	unsigned long long verticesDrawn = 0;
+	unsigned long long bytesMapped = 0;
+
+	//buffer handles are their index in here + 1, so they're never null and never point to anything. Only used on the root; creating and releasing
+	//takes the lock, but looking a buffer up doesn't need to, since blocks never move and a buffer isn't supposed to be mapped while it's being released
+	std::vector<unsigned char>* blocks[NULL_BUFFER_BLOCKS];
+	std::atomic<unsigned int> bufferCount;
+	std::vector<unsigned int> freeBuffers;
+	std::mutex buffersLock;
+	std::atomic<uintptr_t> objectCount;//shaders, layouts, samplers and textures handed out; root only
+
+	void add(int type, const void* object, unsigned int a = 0, unsigned int b = 0, unsigned int c = 0);
+	///the storage behind a handle, or null if it isn't one of ours; root only
+	std::vector<unsigned char>* storage(GpuBuffer* buffer);
+	///a handle for anything that isn't a buffer, different from every other one so far
+	inline void* newObject() { return (void*)(NULL_FIRST_OBJECT + root->objectCount++); }
+
+};
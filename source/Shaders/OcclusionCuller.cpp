@@ -0,0 +1,270 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cfloat>
+
+OcclusionCuller::OcclusionCuller(int workers) : nextBand(0) {
+	depth.assign(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 0.f);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+	setWorkers(workers);
+}
+
+OcclusionCuller::~OcclusionCuller() {
+}
+
+bool OcclusionCuller::isOccluder(const BoundingBox& bounds, unsigned int triangles) {
+	if (triangles == 0 || triangles > OCCLUDER_MAX_TRIANGLES) return false;
+	//a wall or a floor has two long sides, a lamp post only has one
+	float sides[3] = { bounds.Extents.x * 2, bounds.Extents.y * 2, bounds.Extents.z * 2 };
+	std::sort(sides, sides + 3);
+	return sides[1] >= OCCLUDER_MIN_SIZE;
+}
+
+void OcclusionCuller::clearOccluders() {
+	vertices.clear();
+}
+
+void OcclusionCuller::addOccluder(const XMFLOAT3* positions, unsigned int count, const XMMATRIX& world) {
+	size_t first = vertices.size();
+	vertices.resize(first + count / 3 * 3);
+	XMVector3TransformCoordStream(&vertices[first], sizeof(XMFLOAT3), positions, sizeof(XMFLOAT3), count / 3 * 3, world);
+}
+
+void OcclusionCuller::setWorkers(int count) {
+	if (count > OCCLUSION_MAX_WORKERS) count = OCCLUSION_MAX_WORKERS;
+	threads.setWorkers(count);
+}
+
+void OcclusionCuller::render(const XMMATRIX& view, const XMMATRIX& projection) {
+	auto start = std::chrono::high_resolution_clock::now();
+
+	XMMATRIX matrix = view * projection;
+	XMStoreFloat4x4(&viewProjection, matrix);
+	tested = offscreen = occluded = 0;
+
+	//clip space, then pixels; only what ends up on screen gets kept
+	triangles.clear();
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+		XMVECTOR clip[3] = {
+			XMVector3Transform(XMLoadFloat3(&vertices[i]), matrix),
+			XMVector3Transform(XMLoadFloat3(&vertices[i + 1]), matrix),
+			XMVector3Transform(XMLoadFloat3(&vertices[i + 2]), matrix)
+		};
+		addTriangle(clip);
+	}
+
+	std::fill(depth.begin(), depth.end(), 0.f);
+	nextBand = 0;
+	threads.run([this](int index) { rasterizeBands(); });
+
+	renderTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void OcclusionCuller::addTriangle(const XMVECTOR clip[3]) {
+	//clip against the near plane (z >= 0), which leaves up to 4 vertices
+	XMVECTOR polygon[4];
+	int count = 0;
+	for (int i = 0; i < 3; ++i) {
+		XMVECTOR a = clip[i], b = clip[(i + 1) % 3];
+		float za = XMVectorGetZ(a), zb = XMVectorGetZ(b);
+		if (za >= 0) polygon[count++] = a;
+		if ((za >= 0) != (zb >= 0))
+			polygon[count++] = XMVectorLerp(a, b, za / (za - zb));
+	}
+	if (count < 3) return;
+
+	//to pixels, fanning out from the first vertex
+	XMFLOAT3 screen[4];
+	for (int i = 0; i < count; ++i) {
+		XMFLOAT4 v;
+		XMStoreFloat4(&v, polygon[i]);
+		float invW = 1.f / v.w;
+		screen[i] = XMFLOAT3((v.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH, (0.5f - v.y * invW * 0.5f) * OCCLUSION_HEIGHT, invW);
+	}
+	for (int i = 1; i + 1 < count; ++i) {
+		ScreenTriangle triangle;
+		triangle.v[0] = screen[0];
+		triangle.v[1] = screen[i];
+		triangle.v[2] = screen[i + 1];
+		float minX = (std::min)((std::min)(triangle.v[0].x, triangle.v[1].x), triangle.v[2].x);
+		float maxX = (std::max)((std::max)(triangle.v[0].x, triangle.v[1].x), triangle.v[2].x);
+		triangle.minY = (std::min)((std::min)(triangle.v[0].y, triangle.v[1].y), triangle.v[2].y);
+		triangle.maxY = (std::max)((std::max)(triangle.v[0].y, triangle.v[1].y), triangle.v[2].y);
+		if (maxX < 0 || minX > OCCLUSION_WIDTH || triangle.maxY < 0 || triangle.minY > OCCLUSION_HEIGHT) continue;
+		triangles.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterizeBands() {
+	const int rows = (OCCLUSION_HEIGHT + OCCLUSION_BANDS - 1) / OCCLUSION_BANDS;
+	int band;
+	while ((band = nextBand++) < OCCLUSION_BANDS)
+		rasterizeBand(band * rows, (std::min)((band + 1) * rows, OCCLUSION_HEIGHT));
+}
+
+void OcclusionCuller::rasterizeBand(int y0, int y1) {
+	const XMVECTOR laneOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);//pixel centres
+	for (const ScreenTriangle& triangle : triangles) {
+		if (triangle.maxY < y0 || triangle.minY > y1) continue;
+
+		//counter clockwise on screen, so that the inside of every edge is positive
+		XMFLOAT3 a = triangle.v[0], b = triangle.v[1], c = triangle.v[2];
+		float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+		if (area == 0) continue;
+		if (area < 0) {
+			std::swap(b, c);
+			area = -area;
+		}
+
+		//edge functions, e = A * x + B * y + C, for the edges facing a, b and c. Each edge is worked out from the same end whichever triangle it belongs to,
+		//so that neighbours get exactly opposite values along it and no pixel falls through the crack between them
+		float edgeA[3], edgeB[3], edgeC[3];
+		const XMFLOAT3* ends[3][2] = { { &b, &c }, { &c, &a }, { &a, &b } };
+		for (int e = 0; e < 3; ++e) {
+			const XMFLOAT3* p = ends[e][0];
+			const XMFLOAT3* q = ends[e][1];
+			bool flip = p->x > q->x || (p->x == q->x && p->y > q->y);
+			if (flip) std::swap(p, q);
+			float sign = flip ? -1.f : 1.f;
+			edgeA[e] = sign * (p->y - q->y);
+			edgeB[e] = sign * (q->x - p->x);
+			edgeC[e] = sign * (p->x * q->y - p->y * q->x);
+		}
+		//the edge facing a vertex is its barycentric weight (times area), so depth is a plane too
+		float depthA = (a.z * edgeA[0] + b.z * edgeA[1] + c.z * edgeA[2]) / area;
+		float depthB = (a.z * edgeB[0] + b.z * edgeB[1] + c.z * edgeB[2]) / area;
+		float depthC = (a.z * edgeC[0] + b.z * edgeC[1] + c.z * edgeC[2]) / area;
+
+		//pixels whose centre could be inside, in groups of 4
+		float minX = (std::min)((std::min)(a.x, b.x), c.x), maxX = (std::max)((std::max)(a.x, b.x), c.x);
+		int x0 = (std::max)((int)ceilf(minX - 0.5f), 0) & ~3;
+		int x1 = (std::min)((int)floorf(maxX - 0.5f), OCCLUSION_WIDTH - 1);
+		int rowStart = (std::max)((int)ceilf(triangle.minY - 0.5f), y0);
+		int rowEnd = (std::min)((int)floorf(triangle.maxY - 0.5f), y1 - 1);
+
+		XMVECTOR vA[3], vDepthA = XMVectorReplicate(depthA);
+		for (int e = 0; e < 3; ++e)
+			vA[e] = XMVectorReplicate(edgeA[e]);
+		for (int y = rowStart; y <= rowEnd; ++y) {
+			float centreY = y + 0.5f;
+			XMVECTOR rowEdge[3];
+			for (int e = 0; e < 3; ++e)
+				rowEdge[e] = XMVectorReplicate(edgeB[e] * centreY + edgeC[e]);
+			XMVECTOR rowDepth = XMVectorReplicate(depthB * centreY + depthC);
+			float* row = &depth[y * OCCLUSION_WIDTH];
+			for (int px = x0; px <= x1; px += 4) {
+				//evaluated from scratch rather than stepped, for the same values on both sides of a shared edge
+				XMVECTOR x = XMVectorAdd(XMVectorReplicate((float)px), laneOffsets);
+				XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(
+					XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA[0], x, rowEdge[0]), XMVectorZero()),
+					XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA[1], x, rowEdge[1]), XMVectorZero())),
+					XMVectorGreaterOrEqual(XMVectorMultiplyAdd(vA[2], x, rowEdge[2]), XMVectorZero()));
+				XMVECTOR z = XMVectorMultiplyAdd(vDepthA, x, rowDepth);
+				XMVECTOR current = XMLoadFloat4((const XMFLOAT4*)&row[px]);
+				XMStoreFloat4((XMFLOAT4*)&row[px], XMVectorSelect(current, XMVectorMax(current, z), inside));//nearer is bigger
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const BoundingBox& box) {
+	++tested;
+
+	//the box's footprint on screen, and its nearest point
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+	XMMATRIX matrix = XMLoadFloat4x4(&viewProjection);
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = 0;
+	int behindCamera = 0;
+	for (const XMFLOAT3& corner : corners) {
+		XMFLOAT4 v;
+		XMStoreFloat4(&v, XMVector3Transform(XMLoadFloat3(&corner), matrix));
+		if (v.z < 0) {//behind the near plane
+			++behindCamera;
+			continue;
+		}
+		float invW = 1.f / v.w;
+		float x = (v.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH, y = (0.5f - v.y * invW * 0.5f) * OCCLUSION_HEIGHT;
+		minX = (std::min)(minX, x); maxX = (std::max)(maxX, x);
+		minY = (std::min)(minY, y); maxY = (std::max)(maxY, y);
+		nearest = (std::max)(nearest, invW);
+	}
+	if (behindCamera > 0 && behindCamera < (int)BoundingBox::CORNER_COUNT) return true;//crosses the near plane, so it's right in front of the camera
+	if (behindCamera == (int)BoundingBox::CORNER_COUNT || maxX < 0 || minX > OCCLUSION_WIDTH || maxY < 0 || minY > OCCLUSION_HEIGHT) {
+		++offscreen;
+		return false;
+	}
+
+	//visible if any pixel it covers has nothing in front of it
+	int x0 = (std::max)((int)floorf(minX), 0), x1 = (std::min)((int)floorf(maxX), OCCLUSION_WIDTH - 1);
+	int y0 = (std::max)((int)floorf(minY), 0), y1 = (std::min)((int)floorf(maxY), OCCLUSION_HEIGHT - 1);
+	XMVECTOR boxDepth = XMVectorReplicate(nearest * (1 + OCCLUSION_DEPTH_BIAS));
+	XMVECTOR first = XMVectorReplicate((float)x0), last = XMVectorReplicate((float)x1);
+	for (int y = y0; y <= y1; ++y) {
+		const float* row = &depth[y * OCCLUSION_WIDTH];
+		for (int px = x0 & ~3; px <= x1; px += 4) {
+			XMVECTOR x = XMVectorAdd(XMVectorReplicate((float)px), XMVectorSet(0, 1, 2, 3));
+			XMVECTOR covered = XMVectorAndInt(XMVectorGreaterOrEqual(x, first), XMVectorLessOrEqual(x, last));
+			XMVECTOR behind = XMVectorLess(XMLoadFloat4((const XMFLOAT4*)&row[px]), boxDepth);
+			if (XMVector4NotEqualInt(XMVectorAndInt(covered, behind), XMVectorZero())) return true;
+		}
+	}
+	++occluded;
+	return false;
+}
+
+void OcclusionCuller::benchmark(const std::vector<std::vector<XMFLOAT3>>& meshes, int maxWorkers, int frames) {
+	OcclusionCuller culler(1);
+	std::vector<BoundingBox> bounds;
+	int occluders = 0;
+	for (const std::vector<XMFLOAT3>& mesh : meshes) {
+		if (mesh.empty()) continue;
+		BoundingBox box;
+		BoundingBox::CreateFromPoints(box, mesh.size(), &mesh[0], sizeof(XMFLOAT3));
+		bounds.push_back(box);
+		if (isOccluder(box, (unsigned int)mesh.size() / 3)) {
+			culler.addOccluder(&mesh[0], (unsigned int)mesh.size(), XMMatrixIdentity());
+			++occluders;
+		}
+	}
+	printf("%d meshes, %d of them occluders (%u triangles).\n", (int)bounds.size(), occluders, culler.getOccluderTriangles());
+
+	//a walk down the street from where the camera starts, looking four ways at every stop
+	std::vector<XMMATRIX> views;
+	for (int stop = 0; stop < 8; ++stop) {
+		for (int direction = 0; direction < 4; ++direction) {
+			float yaw = direction * XM_PIDIV2;
+			views.push_back(XMMatrixLookToLH(XMVectorSet(-20.f + stop * 8.f, 4, 0, 1), XMVectorSet(sinf(yaw), 0, cosf(yaw), 0), XMVectorSet(0, 1, 0, 0)));
+		}
+	}
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(XM_PI / 3, 16.f / 9.f, 0.1f, 200.f);
+
+	unsigned int tested = 0, offscreen = 0, occluded = 0;
+	float testTime = 0;
+	for (const XMMATRIX& view : views) {
+		culler.render(view, projection);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const BoundingBox& box : bounds)
+			culler.isVisible(box);
+		testTime += std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		tested += culler.getTested();
+		offscreen += culler.getOffscreen();
+		occluded += culler.getOccluded();
+	}
+	if (tested == 0) return;
+	printf("Over %d views: %.1f%% of meshes off screen, %.1f%% hidden behind occluders, %.1f%% drawn; %.3fms to test them all on average.\n", (int)views.size(),
+		100.f * offscreen / tested, 100.f * occluded / tested, 100.f * (tested - offscreen - occluded) / tested, testTime / views.size());
+
+	for (int count = 1; count <= maxWorkers && count <= OCCLUSION_MAX_WORKERS; ++count) {
+		culler.setWorkers(count);
+		float total = 0, worst = 0;
+		for (int i = 0; i < frames; ++i) {
+			culler.render(views[i % views.size()], projection);
+			total += culler.getRenderTime();
+			if (culler.getRenderTime() > worst) worst = culler.getRenderTime();
+		}
+		printf("%d workers: %.3fms per render on average, %.3fms at worst (%d renders, %dx%d).\n", count, total / frames, worst, frames, OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/// Software occlusion culling: a handful of big meshes (building fronts, walls, the road) get rasterized into a small depth buffer on the cpu,
+/// then mesh bounds are tested against it before submission, so that whatever is hidden behind them (or off screen) never reaches the gpu.
+/// The buffer is split into horizontal bands, rasterized in parallel 4 pixels at a time; it holds 1 / view depth, which interpolates linearly across the screen.
+/// Only relies on DirectXMath and std::thread, so it can be run and timed without a window or a device (see benchmark()).
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+#include <atomic>
+#include "WorkerPool.h"
+
+#define OCCLUSION_WIDTH 320 //must be a multiple of 4
+#define OCCLUSION_HEIGHT 180
+#define OCCLUSION_BANDS 12 //rasterized in parallel, OCCLUSION_HEIGHT / OCCLUSION_BANDS rows each
+#define OCCLUSION_MAX_WORKERS 8 //calling thread included
+#define OCCLUSION_DEPTH_BIAS 0.01f //bounds get tested as if they were this much (relatively) closer, so occluders don't hide themselves
+#define OCCLUDER_MIN_SIZE 5.f //meshes need two sides at least this long to be used as occluders...
+#define OCCLUDER_MAX_TRIANGLES 4096 //...and few enough triangles to be worth rasterizing
+
+using namespace DirectX;
+
+class OcclusionCuller {
+
+protected:
+	///an occluder triangle after clipping, in pixels, with 1 / view depth in z
+	struct ScreenTriangle {
+		XMFLOAT3 v[3];
+		float minY, maxY;
+	};
+
+public:
+	OcclusionCuller(int workers = 4);
+	~OcclusionCuller();
+
+	///whether a mesh is big enough, and light enough, to be worth rasterizing as an occluder
+	static bool isOccluder(const BoundingBox& bounds, unsigned int triangles);
+
+	///forgets every occluder
+	void clearOccluders();
+	///adds count / 3 triangles (a plain triangle list), transformed by world. Winding doesn't matter
+	void addOccluder(const XMFLOAT3* positions, unsigned int count, const XMMATRIX& world);
+
+	///rasterizes the occluders as seen through view and projection (any perspective projection), and resets the test stats
+	void render(const XMMATRIX& view, const XMMATRIX& projection);
+	///false if box (world space) is off screen or hidden behind the occluders, as of the last render()
+	bool isVisible(const BoundingBox& box);
+
+	///how many threads rasterize bands, calling thread included
+	void setWorkers(int count);
+	inline int getWorkers() { return threads.getWorkers(); }
+
+	///stats for the last render() and the tests since
+	inline float getRenderTime() { return renderTime; }//milliseconds
+	inline unsigned int getOccluderTriangles() { return (unsigned int)vertices.size() / 3; }
+	inline unsigned int getRasterizedTriangles() { return (unsigned int)triangles.size(); }//after clipping and dropping whatever is off screen
+	inline unsigned int getTested() { return tested; }
+	inline unsigned int getOffscreen() { return offscreen; }
+	inline unsigned int getOccluded() { return occluded; }
+	///OCCLUSION_WIDTH x OCCLUSION_HEIGHT, 1 / view depth; 0 where there are no occluders
+	inline const float* getDepth() { return depth.data(); }
+
+	///loads meshes (triangle lists) from a scene, picks occluders among them with isOccluder(), and tests every mesh from a few spots along the street,
+	///printing the cull rates and how long rendering takes with each worker count up to maxWorkers; doesn't need a window or a device
+	static void benchmark(const std::vector<std::vector<XMFLOAT3>>& meshes, int maxWorkers, int frames);
+
+protected:
+	std::vector<XMFLOAT3> vertices;//occluders, world space, 3 per triangle
+	std::vector<ScreenTriangle> triangles;
+	std::vector<float> depth;
+	XMFLOAT4X4 viewProjection;
+
+	float renderTime = 0;
+	unsigned int tested = 0, offscreen = 0, occluded = 0;
+
+	//every worker, the calling thread included, takes bands until there are none left
+	WorkerPool threads;
+	std::atomic<int> nextBand;
+
+	///takes bands until there are none left
+	void rasterizeBands();
+	///rasterizes every triangle overlapping rows [y0, y1)
+	void rasterizeBand(int y0, int y1);
+	///clips a clip space triangle against the near plane and adds what is left to triangles
+	void addTriangle(const XMVECTOR clip[3]);
+
+};
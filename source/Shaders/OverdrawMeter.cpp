@@ -0,0 +1,42 @@
+#include "OverdrawMeter.h"
+
+OverdrawMeter::OverdrawMeter(RenderDevice* device) : device(device) {
+	for (Query& query : queries) {
+		query.query = device->createOcclusionQuery();
+		query.pending = false;
+	}
+}
+
+OverdrawMeter::~OverdrawMeter() {
+	for (Query& query : queries)
+		device->releaseQuery(query.query);
+}
+
+void OverdrawMeter::begin() {
+	//if the gpu is running that far behind, skip a frame rather than wait for it
+	Query& query = queries[next];
+	if (query.pending || !query.query) return;
+	device->beginQuery(query.query);
+	measuring = true;
+}
+
+void OverdrawMeter::end(unsigned int pixels) {
+	if (!measuring) return;
+	Query& query = queries[next];
+	device->endQuery(query.query);
+	query.pixels = pixels;
+	query.pending = true;
+	next = (next + 1) % OVERDRAW_QUERIES;
+	measuring = false;
+}
+
+void OverdrawMeter::update() {
+	for (Query& query : queries) {
+		unsigned long long samples;
+		if (!query.pending || !device->getQueryResult(query.query, samples)) continue;
+		query.pending = false;
+		if (query.pixels == 0) continue;
+		float frame = (float)samples / query.pixels;
+		overdraw = overdraw == 0 ? frame : overdraw + (frame - overdraw) * OVERDRAW_SMOOTHING;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+/// Measures how many fragments per pixel make it past the depth test in the pass that first fills a depth buffer, through occlusion queries.
+/// Without a depth pre-pass, that's how many times the lit pixel shader runs per pixel; with one, it's how many times it would have run,
+/// so the same measure tells whether a pre-pass is worth its extra vertex (and tessellation) work either way.
+
+#include "RenderDevice.h"
+
+#define OVERDRAW_QUERIES 4 //results come back a few frames late, so one query per frame in flight
+#define OVERDRAW_SMOOTHING 0.1f //weight of each new frame in the running average
+#define PREPASS_ENABLE_OVERDRAW 1.6f //above this many shaded fragments per pixel, a pre-pass pays for the geometry it draws twice
+#define PREPASS_DISABLE_OVERDRAW 1.3f //below this, it doesn't anymore; the gap keeps it from flickering on and off
+
+class OverdrawMeter {
+
+public:
+	OverdrawMeter(RenderDevice* device);
+	~OverdrawMeter();
+
+	///around the draws to measure; they need a depth buffer that was just cleared, and a depth test that lets closer fragments through
+	void begin();
+	void end(unsigned int pixels);
+	///picks up whichever results have come back; call once per frame
+	void update();
+
+	///samples that passed the depth test per pixel, averaged over the last few frames; 0 until the first result comes back
+	inline float getOverdraw() { return overdraw; }
+	///whether a pre-pass should be drawn, given whether it currently is
+	inline bool prepassPaysOff(bool enabled) { return overdraw > (enabled ? PREPASS_DISABLE_OVERDRAW : PREPASS_ENABLE_OVERDRAW); }
+
+protected:
+	struct Query {
+		GpuQuery* query;
+		unsigned int pixels;
+		bool pending;
+	};
+
+	RenderDevice* device;
+	Query queries[OVERDRAW_QUERIES];
+	int next = 0;
+	bool measuring = false;//between begin() and end()
+	float overdraw = 0;
+
+};
@@ -9,7 +9,7 @@ ParticlesShader::ParticlesShader(){
 
 
 ParticlesShader::~ParticlesShader(){
-	delete particleBuffer;
+	GLOBALS.Backend->releaseBuffer(particleBuffer);
 }
 
 void ParticlesShader::step(float dt) {
@@ -20,18 +20,17 @@ void ParticlesShader::initBuffers(){
 	SETUP_SHADER_BUFFER(ParticleBufferType, particleBuffer);
 }
 
-void ParticlesShader::sendParticlesData() {
+void ParticlesShader::sendParticlesData(RenderDevice* device) {
 
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	ParticleBufferType* pbPtr;
-	GLOBALS.DeviceContext->Map(particleBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	pbPtr = (ParticleBufferType*)mappedResource.pData;
-	pbPtr->quadSize = size;
-	pbPtr->time = time;
-	pbPtr->maxSpeed = maxSpeed;
-	GLOBALS.DeviceContext->Unmap(particleBuffer, 0);
-	GLOBALS.DeviceContext->VSSetConstantBuffers(1, 1, &particleBuffer);
+	ParticleBufferType* pbPtr = (ParticleBufferType*)device->map(particleBuffer, false);
+	if (pbPtr) {
+		pbPtr->quadSize = size;
+		pbPtr->time = time;
+		pbPtr->maxSpeed = maxSpeed;
+		device->unmap(particleBuffer);
+	}
+	device->setConstantBuffer(STAGE_VS, 1, particleBuffer);
 
-	GLOBALS.DeviceContext->PSSetShaderResources(0, 1, &texture);
+	device->setShaderResources(STAGE_PS, 0, 1, &texture);
 
 }
\ No newline at end of file
@@ -13,7 +13,7 @@ public:
 	ParticlesShader();
 	~ParticlesShader();
 
-	void sendParticlesData();
+	void sendParticlesData(RenderDevice* device);
 
 	//updates particle simulation
 	void step(float dt);
@@ -21,7 +21,7 @@ public:
 	//params:
 	float size = 1;
 	float maxSpeed = 35;
-	ID3D11ShaderResourceView* texture;
+	GpuView* texture = nullptr;
 
 protected:
 	void initBuffers() override;
@@ -29,6 +29,6 @@ protected:
 	float time = 0;//increases each frame by dt
 
 private:
-	ID3D11Buffer* particleBuffer;
+	GpuBuffer* particleBuffer = nullptr;
 };
 
@@ -0,0 +1,86 @@
+#include "PassRecorder.h"
+
+#include "TransientBuffer.h"
+#include <chrono>
+#include <cstdio>
+
+PassRecorder::PassRecorder(RenderDevice* device, unsigned int constantsPage, unsigned int verticesPage, unsigned int maxPages) :
+	device(device), constantsPage(constantsPage), verticesPage(verticesPage), maxPages(maxPages), nextPass(0) {
+}
+
+PassRecorder::~PassRecorder() {
+	threads.setWorkers(1);//before the recorders they use go
+	for (Worker& worker : pool) {
+		delete worker.constants;
+		delete worker.vertices;
+		delete worker.recorder;
+	}
+}
+
+void PassRecorder::setWorkers(int count) {
+	if (count < 0) count = 0;
+	if (count > PASS_RECORDER_MAX_WORKERS) count = PASS_RECORDER_MAX_WORKERS;
+	if (count == workers) return;
+
+	//every worker needs a recorder, with transient buffers of its own
+	while ((int)pool.size() < count) {
+		Worker worker;
+		worker.recorder = device->createRecorder();
+		if (!worker.recorder) {
+			printf("Error: could only get %d recorders, recording passes with that many workers.\n", (int)pool.size());
+			break;
+		}
+		worker.constants = new TransientBuffer(worker.recorder, BUFFER_CONSTANT, constantsPage, maxPages);
+		worker.vertices = new TransientBuffer(worker.recorder, BUFFER_VERTEX, verticesPage, maxPages);
+		worker.recorder->setTransientBuffers(worker.constants, worker.vertices);
+		pool.push_back(worker);
+	}
+	workers = count < (int)pool.size() ? count : (int)pool.size();
+	threads.setWorkers(workers);
+}
+
+void PassRecorder::add(const std::function<void(RenderDevice*)>& pass) {
+	passes.push_back(pass);
+}
+
+void PassRecorder::run() {
+	lastPassCount = (int)passes.size();
+	recordTime = executeTime = 0;
+	if (passes.empty()) return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (workers == 0) {
+		for (auto& pass : passes)
+			pass(device);
+		recordTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		passes.clear();
+		return;
+	}
+
+	//record: every worker, the calling thread included, takes passes until there are none left
+	lists.assign(passes.size(), nullptr);
+	nextPass = 0;
+	threads.run([this](int index) { record(index); });
+	auto recorded = std::chrono::high_resolution_clock::now();
+
+	//play back in the order the passes were added, whoever recorded them
+	for (GpuCommandList* list : lists)
+		device->execute(list);
+
+	recordTime = std::chrono::duration<float, std::milli>(recorded - start).count();
+	executeTime = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - recorded).count();
+	passes.clear();
+}
+
+void PassRecorder::record(int index) {
+	Worker& worker = pool[index];
+	int pass;
+	while ((pass = nextPass++) < (int)passes.size()) {
+		passes[pass](worker.recorder);
+		lists[pass] = worker.recorder->finishRecording();
+		//the next list starts by discarding every page, so they're all free again
+		worker.constants->endFrame(worker.recorder);
+		worker.vertices->endFrame(worker.recorder);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+/// Records render passes on worker threads, each pass into its own command list, then plays the lists back on the device in the order the passes were added.
+/// Passes get added in dependency order (anything a pass reads was written by an earlier pass, or before run()), so that order is all playback has to keep;
+/// while recording, passes may only read shared state (lights, meshes, shaders), and only write through the recorder they're handed.
+/// With no workers, passes go straight to the device on the calling thread, the way they always used to.
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include "RenderDevice.h"
+#include "WorkerPool.h"
+
+#define PASS_RECORDER_MAX_WORKERS 8 //calling thread included; each one takes a recorder slot on the device
+
+class PassRecorder {
+
+protected:
+	///a thread, and what it records into
+	struct Worker {
+		RenderDevice* recorder;
+		TransientBuffer* constants;
+		TransientBuffer* vertices;
+	};
+
+public:
+	///page sizes and counts are for each worker's own transient buffers
+	PassRecorder(RenderDevice* device, unsigned int constantsPage, unsigned int verticesPage, unsigned int maxPages);
+	~PassRecorder();
+
+	///how many threads record passes, calling thread included; 0 doesn't record at all, and sends passes straight to the device instead
+	void setWorkers(int count);
+	inline int getWorkers() { return workers; }
+
+	///queues a pass for the next run(); it gets called with the device to send everything to
+	void add(const std::function<void(RenderDevice*)>& pass);
+	///records every pass added since the last run(), then executes them on the device in the order they were added
+	void run();
+
+	///what the last run() took, in milliseconds
+	inline float getRecordTime() { return recordTime; }
+	inline float getExecuteTime() { return executeTime; }
+	inline int getLastPassCount() { return lastPassCount; }
+
+protected:
+	RenderDevice* device;
+	unsigned int constantsPage, verticesPage, maxPages;
+	std::vector<Worker> pool;//recorders are kept when there are fewer workers, since their slots can't be given back
+	WorkerPool threads;//the calling thread records too
+	int workers = 0;
+
+	std::vector<std::function<void(RenderDevice*)>> passes;
+	std::vector<GpuCommandList*> lists;//one per pass, in the same order
+	std::atomic<int> nextPass;
+
+	float recordTime = 0, executeTime = 0;
+	int lastPassCount = 0;
+
+	///takes passes until there are none left, recording them with the index'th worker
+	void record(int index);
+
+};
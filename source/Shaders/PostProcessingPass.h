@@ -1,5 +1,7 @@
 #pragma once
 
+/// A post processing shader and the screen filling quad it gets drawn on; what it reads from and renders into is up to the render graph.
+
 #include "DXF.h"
 #include "PostProcessingShader.h"
 
@@ -9,27 +11,17 @@ public:
 	~PostProcessingPass();
 
 	///Initializes the post processing pass with a post processing shader
-	void Setup(ID3D11Device* device, ID3D11DeviceContext* deviceContext, int width, int height, PostProcessingShader* shader);
-	///Sets up the pass; render the scene after this call
-	void Begin(D3D* renderer, ID3D11DeviceContext* deviceContext, XMFLOAT3 clearColour = XMFLOAT3(1.0f, 1.0f, 1.0f));
-	void Begin();
-	///Ends the pass; all render code should have been done
-	void End(D3D* renderer);
-	void End();
-	///Renders the results onto an ortho quad filling the screen
-	void Render(D3D* renderer, ID3D11DeviceContext* deviceContext, XMMATRIX orthoViewMatrix);
-	void Render(XMMATRIX orthoViewMatrix);
-
-	bool enabled = true;//if turned to false, will simply stop doing its thing
+	void Setup(ID3D11Device* device, ID3D11DeviceContext* deviceContext, PostProcessingShader* shader);
+	///Renders texture through the shader onto an ortho quad filling the current render target
+	void Render(D3D* renderer, ID3D11DeviceContext* deviceContext, XMMATRIX orthoViewMatrix, GpuView* texture);
+	void Render(XMMATRIX orthoViewMatrix, GpuView* texture);
 
-	void setSize(int width, int height);
+	bool enabled = true;//if turned to false, the pass won't be added to the graph
 
 	inline OrthoMesh* getOrthoMesh() { return orthoMesh; }
-	inline RenderTexture* getRenderTexture() { return renderTexture; }
 
 private:
 	PostProcessingShader* shader;
-	RenderTexture* renderTexture = nullptr;
 	OrthoMesh* orthoMesh = nullptr;
 
 };
\ No newline at end of file
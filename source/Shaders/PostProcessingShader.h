@@ -8,7 +8,7 @@ public:
 	virtual ~PostProcessingShader();
 
 	///Sends texture data (result from previous rendering pass)
-	void setTextureData(ID3D11DeviceContext* deviceContext, ID3D11ShaderResourceView* texture);
+	void setTextureData(RenderDevice* device, GpuView* texture);
 
 protected:
 	virtual void initBuffers() override;
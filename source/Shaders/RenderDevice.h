@@ -0,0 +1,218 @@
+#pragma once
+
+/// Everything the per-frame code does to the gpu (buffers, textures, shaders, state, binds, draws) goes through this rather than straight to D3D11,
+/// so that a frame can just as well be recorded by NullRenderDevice, without a window or a gpu, as be sent to D3D11RenderDevice.
+/// Resources are opaque handles that only the backend which created them knows what to do with; nothing else ever dereferences one.
+/// Doesn't need any platform header, so this and the null backend build anywhere (see tests/CMakeLists.txt).
+/// A device can hand out recorders: devices that another thread fills with a pass's commands, which the device then executes in whatever order the passes depend on each other.
+
+#include <cstddef>
+#include <vector>
+
+//handles; never defined, each backend casts its own objects to and from them
+struct GpuBuffer;
+struct GpuView;//anything shaders read: textures, shader buffers, render targets' contents
+struct GpuUnorderedView;//what compute shaders write to
+struct GpuQuery;//fences and occlusion queries
+struct GpuShader;//any stage
+struct GpuLayout;//vertex input layout
+struct GpuSampler;
+struct GpuDepthState;
+struct GpuTarget;
+struct GpuDepthTarget;
+struct GpuCommandList;
+
+//shader stages, for binding shaders, constants, resources and samplers
+#define STAGE_VS 0
+#define STAGE_HS 1
+#define STAGE_DS 2
+#define STAGE_GS 3
+#define STAGE_PS 4
+#define STAGE_CS 5
+#define STAGE_COUNT 6
+
+//what a buffer is for, for createBuffer() and createStaticBuffer()
+#define BUFFER_VERTEX 0
+#define BUFFER_INDEX 1
+#define BUFFER_CONSTANT 2
+
+//primitive topologies, for setTopology(); same values as D3D11's
+#define TOPOLOGY_UNDEFINED 0
+#define TOPOLOGY_POINTLIST 1
+#define TOPOLOGY_LINELIST 2
+#define TOPOLOGY_TRIANGLELIST 4
+#define TOPOLOGY_PATCHLIST_3 35 //triangles with 3 control points, for the tessellation stages
+
+//comparisons, for depth states and comparison samplers; same values as D3D11's
+#define COMPARE_NEVER 1
+#define COMPARE_LESS 2
+#define COMPARE_EQUAL 3
+#define COMPARE_LESS_EQUAL 4
+#define COMPARE_GREATER 5
+#define COMPARE_ALWAYS 8
+
+//element formats, for shader buffers and vertex layouts; same values as DXGI's
+#define FORMAT_UNKNOWN 0 //structured shader buffers
+#define FORMAT_R32G32B32A32_FLOAT 2
+#define FORMAT_R32G32B32A32_UINT 3
+#define FORMAT_R32G32B32_FLOAT 6
+#define FORMAT_R32G32_FLOAT 16
+#define FORMAT_R32G32_UINT 17
+#define FORMAT_R32_UINT 42
+
+//sampler filters, for createSampler(); same values as D3D11's
+#define FILTER_LINEAR 0x15
+#define FILTER_LINEAR_MIP_POINT 0x14
+#define FILTER_ANISOTROPIC 0x55
+#define FILTER_COMPARISON_LINEAR 0x95
+#define FILTER_COMPARISON_LINEAR_MIP_POINT 0x94
+
+//sampler addressing, for createSampler(); same values as D3D11's
+#define ADDRESS_WRAP 1
+#define ADDRESS_CLAMP 3
+
+#define VERTEX_APPEND 0xffffffff //VertexElement offset that goes right after the previous element in the same slot
+
+#define MAX_RENDER_DEVICES 16 //a device and all of its recorders; each gets a slot, for anything that keeps per device state (see ConstantBlock)
+
+class TransientBuffer;
+
+///one attribute of a vertex input layout, for createLayout()
+struct VertexElement {
+	const char* semantic;
+	unsigned int index;
+	int format;
+	unsigned int slot;//input slot, see RenderDevice::setVertexBuffer()
+	unsigned int offset;//in bytes, or VERTEX_APPEND
+	bool perInstance;//advances once per instance rather than once per vertex
+};
+
+///same layout as D3D11's, so it can be handed over as is
+struct Viewport {
+	float x, y;
+	float width, height;
+	float minDepth, maxDepth;
+};
+
+class RenderDevice {
+
+public:
+	virtual ~RenderDevice() {}
+
+	///Buffers
+	///creates a dynamic (cpu writeable) buffer; returns null on failure
+	virtual GpuBuffer* createBuffer(unsigned int size, int type) = 0;
+	///creates a buffer only the gpu writes to (through copyBuffer()), starting out as data, or zeroes if data is null; for meshes
+	virtual GpuBuffer* createStaticBuffer(unsigned int size, int type, const void* data) = 0;
+	virtual void releaseBuffer(GpuBuffer* buffer) = 0;
+	///noOverwrite promises not to touch anything the gpu might still be reading; otherwise the previous contents are discarded. Returns null on failure
+	virtual void* map(GpuBuffer* buffer, bool noOverwrite) = 0;
+	virtual void unmap(GpuBuffer* buffer) = 0;
+	///copies size bytes between two static buffers, on the gpu
+	virtual void copyBuffer(GpuBuffer* destination, unsigned int destinationOffset, GpuBuffer* source, unsigned int sourceOffset, unsigned int size) = 0;
+	///reads a whole buffer back, waiting for the gpu to get there; slow, so only for cooking. Devices only, not recorders
+	virtual bool readBuffer(GpuBuffer* buffer, std::vector<unsigned char>& out_bytes) = 0;
+	///dynamic buffer shaders can read count elements of stride bytes from through out_view; structured if format is FORMAT_UNKNOWN
+	virtual GpuBuffer* createShaderBuffer(unsigned int count, unsigned int stride, int format, GpuView** out_view) = 0;
+	virtual void releaseView(GpuView* view) = 0;
+	///gpu writeable buffer of count 32 bit values, starting out as initial, that can hold the arguments of indirect draws; compute shaders write it through out_view
+	virtual GpuBuffer* createIndirectBuffer(unsigned int count, const unsigned int* initial, GpuUnorderedView** out_view) = 0;
+	virtual void releaseView(GpuUnorderedView* view) = 0;
+	///whether setConstantBuffer() can take an offset, and constant buffers can be mapped with noOverwrite
+	virtual bool supportsConstantOffsets() = 0;
+
+	///Textures
+	///32 bit rgba, width * height * 4 bytes of pixels; mips get generated from them. Released with releaseView(). Devices only, not recorders
+	virtual GpuView* createTexture(unsigned int width, unsigned int height, const unsigned char* pixels, bool mips) = 0;
+
+	///Shaders: compiled bytecode in, null (with an error printed) if the device won't take it
+	virtual GpuShader* createShader(int stage, const void* bytecode, size_t size) = 0;
+	virtual void releaseShader(GpuShader* shader) = 0;
+	///bytecode is the vertex shader the layout is for
+	virtual GpuLayout* createLayout(const VertexElement* elements, unsigned int count, const void* bytecode, size_t size) = 0;
+	virtual void releaseLayout(GpuLayout* layout) = 0;
+	///comparison is COMPARE_ALWAYS unless the filter is a comparison one
+	virtual GpuSampler* createSampler(int filter, int address, int comparison = COMPARE_ALWAYS) = 0;
+	virtual void releaseSampler(GpuSampler* sampler) = 0;
+
+	///Fences: tell when the gpu is done with everything submitted before signalFence()
+	virtual GpuQuery* createFence() = 0;
+	virtual void releaseFence(GpuQuery* fence) = 0;
+	virtual void signalFence(GpuQuery* fence) = 0;
+	///if wait is set, blocks until the fence is reached, without holding on to the cpu for longer than a few polls
+	virtual bool fenceReached(GpuQuery* fence, bool wait) = 0;
+
+	///Occlusion queries: count the samples that pass the depth test between beginQuery() and endQuery()
+	virtual GpuQuery* createOcclusionQuery() = 0;
+	virtual void releaseQuery(GpuQuery* query) = 0;
+	virtual void beginQuery(GpuQuery* query) = 0;
+	virtual void endQuery(GpuQuery* query) = 0;
+	///false until the gpu has got through endQuery(); never blocks, and only works on a device (not on recorders)
+	virtual bool getQueryResult(GpuQuery* query, unsigned long long& out_samples) = 0;
+
+	///Pipeline state; null unbinds
+	virtual void setInputLayout(GpuLayout* layout) = 0;
+	virtual void setShader(int stage, GpuShader* shader) = 0;
+	///offset and size are in bytes, multiples of 256; size 0 binds the whole buffer
+	virtual void setConstantBuffer(int stage, unsigned int slot, GpuBuffer* buffer, unsigned int offset = 0, unsigned int size = 0) = 0;
+	virtual void setShaderResources(int stage, unsigned int slot, unsigned int count, GpuView* const* views) = 0;
+	virtual void setSamplers(int stage, unsigned int slot, unsigned int count, GpuSampler* const* samplers) = 0;
+	///compute shader only; null views unbind
+	virtual void setUnorderedViews(unsigned int slot, unsigned int count, GpuUnorderedView* const* views) = 0;
+	///depth test (one of the COMPARE_ values) and writes, stencil off; D3D's setZBuffer() puts its own state back
+	virtual GpuDepthState* createDepthState(int test, bool write) = 0;
+	virtual void releaseDepthState(GpuDepthState* state) = 0;
+	virtual void setDepthState(GpuDepthState* state) = 0;
+
+	///Input assembler
+	///slot is the input slot, for meshes split into several vertex streams
+	virtual void setVertexBuffer(GpuBuffer* buffer, unsigned int stride, unsigned int offset = 0, unsigned int slot = 0) = 0;
+	///indices are always 32 bit
+	virtual void setIndexBuffer(GpuBuffer* buffer) = 0;
+	///one of the TOPOLOGY_ values
+	virtual void setTopology(int topology) = 0;
+
+	///Draws
+	virtual void draw(unsigned int vertexCount, unsigned int startVertex = 0) = 0;
+	virtual void drawIndexed(unsigned int indexCount, unsigned int startIndex = 0, int baseVertex = 0) = 0;
+	///instanceCount copies, reading per instance streams from startInstance on
+	virtual void drawIndexedInstanced(unsigned int indexCount, unsigned int instanceCount, unsigned int startIndex = 0, int baseVertex = 0, unsigned int startInstance = 0) = 0;
+	///takes index count, instance count, start index, base vertex and start instance from args, offset bytes in (see createIndirectBuffer())
+	virtual void drawIndexedIndirect(GpuBuffer* args, unsigned int offset) = 0;
+	virtual void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1) = 0;
+
+	///Render targets; depth can be null
+	virtual void setRenderTarget(GpuTarget* target, GpuDepthTarget* depth, const Viewport& viewport) = 0;
+	virtual void clear(GpuTarget* target, const float colour[4], GpuDepthTarget* depth) = 0;
+
+	///Recording
+	///a new device that records everything sent to it, for this one to execute later. Each recorder belongs to one thread at a time, and starts from the default pipeline state
+	///(not whatever this device has bound). Creating and releasing buffers through it is the same as doing so through this device. Returns null if there can't be any more
+	virtual RenderDevice* createRecorder() = 0;
+	///on a recorder: closes what was recorded since the last call into a command list
+	virtual GpuCommandList* finishRecording() = 0;
+	///plays a finished command list back on this device and releases it; state bound on this device is left as it was
+	virtual void execute(GpuCommandList* list) = 0;
+	///true for recorders; their first map of any buffer in each command list has to discard it
+	virtual bool isRecorder() = 0;
+
+	///0 for a device, 1 to MAX_RENDER_DEVICES - 1 for its recorders
+	inline int getSlot() { return slot; }
+	///where per-draw constants and vertices go; each recorder needs its own, or threads would be writing into the same pages
+	inline TransientBuffer* getTransientConstants() { return transientConstants; }
+	inline TransientBuffer* getTransientVertices() { return transientVertices; }
+	inline void setTransientBuffers(TransientBuffer* constants, TransientBuffer* vertices) { transientConstants = constants; transientVertices = vertices; }
+
+protected:
+	int slot = 0;
+	int recorders = 0;//handed out so far, for their slots
+	TransientBuffer* transientConstants = nullptr;
+	TransientBuffer* transientVertices = nullptr;
+
+	///next free recorder slot, or -1 if they're all taken
+	inline int nextSlot() {
+		if (recorders >= MAX_RENDER_DEVICES - 1) return -1;
+		return ++recorders;
+	}
+
+};
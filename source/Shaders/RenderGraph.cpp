@@ -0,0 +1,151 @@
+#include "RenderGraph.h"
+
+#include "AppGlobals.h"
+
+RenderGraph::RenderGraph(RenderTargetPool* pool) : pool(pool) {
+	reset();
+}
+
+RenderGraph::~RenderGraph() {
+	for (Texture& texture : textures)
+		pool->release(texture.target);
+}
+
+void RenderGraph::reset() {
+	resources.clear();
+	passes.clear();
+	import("back buffer", nullptr);
+}
+
+int RenderGraph::create(const char* name, int width, int height, DXGI_FORMAT format, bool depth) {
+	Resource resource;
+	resource.name = name;
+	resource.width = width;
+	resource.height = height;
+	resource.format = format;
+	resource.depth = depth;
+	resource.imported = false;
+	resource.target = nullptr;
+	resource.firstPass = resource.lastPass = -1;
+	resources.push_back(resource);
+	return (int)resources.size() - 1;
+}
+
+int RenderGraph::import(const char* name, RenderTarget* target) {
+	int index = create(name, target ? target->getWidth() : GLOBALS.ScreenWidth, target ? target->getHeight() : GLOBALS.ScreenHeight, target ? target->getFormat() : DXGI_FORMAT_UNKNOWN);
+	resources[index].imported = true;
+	resources[index].target = target;
+	return index;
+}
+
+int RenderGraph::addPass(const char* name, const std::function<void(RenderGraph&)>& run) {
+	Pass pass;
+	pass.name = name;
+	pass.run = run;
+	pass.kept = false;
+	passes.push_back(pass);
+	return (int)passes.size() - 1;
+}
+
+void RenderGraph::read(int pass, int resource) {
+	passes[pass].reads.push_back(resource);
+}
+
+void RenderGraph::write(int pass, int resource) {
+	passes[pass].writes.push_back(resource);
+}
+
+void RenderGraph::compile() {
+	//culling: walking backwards, a pass is needed if it writes to something outside the frame, or to something a needed pass reads
+	std::vector<bool> needed(resources.size(), false);
+	for (int p = (int)passes.size() - 1; p >= 0; --p) {
+		Pass& pass = passes[p];
+		pass.kept = false;
+		for (int resource : pass.writes)
+			if (resources[resource].imported || needed[resource]) pass.kept = true;
+		if (!pass.kept) continue;
+		for (int resource : pass.reads)
+			needed[resource] = true;
+	}
+
+	//lifetimes, from the kept passes only
+	for (int p = 0; p < (int)passes.size(); ++p) {
+		if (!passes[p].kept) continue;
+		for (int list = 0; list < 2; ++list) {
+			for (int index : list == 0 ? passes[p].reads : passes[p].writes) {
+				Resource& resource = resources[index];
+				if (resource.firstPass < 0) {
+					resource.firstPass = p;
+					if (list == 0 && !resource.imported)
+						printf("Error: %s reads %s before anything has written to it.\n", passes[p].name, resource.name);
+				}
+				resource.lastPass = p;
+			}
+		}
+	}
+
+	//aliasing: in the order they're first used, each transient gets the first free texture that fits it
+	//last frame's textures go back to the pool first, so a graph that hasn't changed gets the very same ones back
+	for (Texture& texture : textures)
+		pool->release(texture.target);
+	textures.clear();
+	transientCount = 0;
+	transientBytes = 0;
+	for (int p = 0; p < (int)passes.size(); ++p) {
+		for (Resource& resource : resources) {
+			if (resource.imported || resource.firstPass != p) continue;
+			assign(resource);
+			++transientCount;
+			transientBytes += RenderTarget::sizeOf(resource.width, resource.height, resource.format, resource.depth);
+		}
+	}
+
+	textureBytes = 0;
+	for (Texture& texture : textures)
+		textureBytes += RenderTarget::sizeOf(texture.target->getWidth(), texture.target->getHeight(), texture.target->getFormat(), texture.depth);
+}
+
+void RenderGraph::assign(Resource& resource) {
+	//exact matches first; failing that, a texture with a depth buffer can stand in for one without
+	Texture* best = nullptr;
+	for (Texture& texture : textures) {
+		RenderTarget* target = texture.target;
+		if (texture.busyUntil >= resource.firstPass || target->getWidth() != resource.width || target->getHeight() != resource.height || target->getFormat() != resource.format) continue;
+		if (texture.depth == resource.depth) {
+			best = &texture;
+			break;
+		}
+		if (texture.depth && !best) best = &texture;
+	}
+
+	if (!best) {
+		Texture texture;
+		texture.target = pool->acquire(resource.width, resource.height, resource.format, resource.depth);
+		texture.depth = resource.depth;
+		textures.push_back(texture);
+		best = &textures.back();
+	}
+
+	best->busyUntil = resource.lastPass;
+	resource.target = best->target;
+}
+
+void RenderGraph::execute() {
+	for (Pass& pass : passes)
+		if (pass.kept) pass.run(*this);
+
+	GLOBALS.Renderer->setBackBufferRenderTarget();
+	GLOBALS.Renderer->resetViewport();
+}
+
+void RenderGraph::setRenderTarget(int resource, bool clear, XMFLOAT4 colour) {
+	RenderTarget* target = resources[resource].target;
+	if (!target) {//back buffer
+		GLOBALS.Renderer->setBackBufferRenderTarget();
+		GLOBALS.Renderer->resetViewport();
+		if (clear) GLOBALS.Renderer->beginScene(colour.x, colour.y, colour.z, colour.w);
+		return;
+	}
+	target->setRenderTarget(GLOBALS.Backend);
+	if (clear) target->clear(GLOBALS.Backend, colour.x, colour.y, colour.z, colour.w);
+}
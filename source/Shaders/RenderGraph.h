@@ -0,0 +1,91 @@
+#pragma once
+
+/// A frame's passes, declared along with the targets they read and write before any of them runs.
+/// compile() culls passes that nothing on screen depends on, works out the first and last pass that uses each transient target,
+/// and hands transient targets whose lifetimes don't overlap the same texture (eg. the bloom blur can draw into the scene's target once colour grading has read it).
+/// Textures come from a RenderTargetPool and go back to it on the next compile(), so building the graph again every frame, following whatever's switched on, costs next to nothing.
+/// Imported targets (the back buffer, shadowmaps) outlive the frame: they never get aliased, and passes writing to them are never culled.
+
+#include <vector>
+#include <functional>
+#include "RenderTargetPool.h"
+
+#define GRAPH_BACK_BUFFER 0 //every graph starts out with the back buffer imported as its first resource
+
+class RenderGraph {
+
+protected:
+	///a target, as the passes see it
+	struct Resource {
+		const char* name;
+		int width, height;
+		DXGI_FORMAT format;
+		bool depth;
+		bool imported;
+		RenderTarget* target;//imported target, or the texture compile() picked; null for the back buffer
+		int firstPass, lastPass;//kept passes using it, -1 if none
+	};
+	///a pass, and what it uses
+	struct Pass {
+		const char* name;
+		std::function<void(RenderGraph&)> run;
+		std::vector<int> reads, writes;
+		bool kept;
+	};
+	///a texture behind one or more transient resources
+	struct Texture {
+		RenderTarget* target;
+		bool depth;
+		int busyUntil;//last pass of the resource currently using it
+	};
+
+public:
+	RenderGraph(RenderTargetPool* pool);
+	~RenderGraph();
+
+	///forgets the last frame's passes and resources; their textures go back to the pool on the next compile()
+	void reset();
+	///a target that only has to live through this frame; only passes that render geometry need a depth buffer
+	int create(const char* name, int width, int height, DXGI_FORMAT format, bool depth = false);
+	///a target that outlives the frame
+	int import(const char* name, RenderTarget* target);
+	///passes run in the order they were added, if they're run at all; returns the pass to hand read() and write()
+	int addPass(const char* name, const std::function<void(RenderGraph&)>& run);
+	void read(int pass, int resource);
+	void write(int pass, int resource);
+
+	///culls passes, works out lifetimes and picks textures; call once every pass has been added
+	void compile();
+	///runs every pass that wasn't culled, then leaves the back buffer bound
+	void execute();
+
+	///the texture behind a resource, from compile() until the next reset(); null for the back buffer
+	inline RenderTarget* getTarget(int resource) { return resources[resource].target; }
+	inline GpuView* getTexture(int resource) { return resources[resource].target ? resources[resource].target->getShaderResourceView() : nullptr; }
+	///the depth buffer of a resource created with one, to read from in a later pass
+	inline GpuView* getDepthTexture(int resource) { return resources[resource].target ? resources[resource].target->getDepthResourceView() : nullptr; }
+	///binds a resource (back buffer included) as render target and viewport, clearing it first if asked to
+	void setRenderTarget(int resource, bool clear = false, XMFLOAT4 colour = XMFLOAT4(0, 0, 0, 1));
+
+	///stats for the last compile()
+	inline int getPassCount() { return (int)passes.size(); }
+	inline const char* getPassName(int pass) { return passes[pass].name; }
+	inline bool isKept(int pass) { return passes[pass].kept; }
+	inline int getTransientCount() { return transientCount; }//transient resources kept passes use
+	inline int getTextureCount() { return (int)textures.size(); }//textures behind them
+	inline unsigned int getTransientBytes() { return transientBytes; }//what transients would take with a texture each, depth buffers and all
+	inline unsigned int getTextureBytes() { return textureBytes; }//what the textures actually take
+
+protected:
+	RenderTargetPool* pool;
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<Texture> textures;//this frame's
+
+	int transientCount = 0;
+	unsigned int transientBytes = 0, textureBytes = 0;
+
+	///finds a free texture the resource fits in (or gets one from the pool), and keeps it busy until the resource's last pass
+	void assign(Resource& resource);
+
+};
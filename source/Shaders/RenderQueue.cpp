@@ -0,0 +1,418 @@
+#include "RenderQueue.h"
+
+#include "FBXMesh.h"
+#include "OcclusionCuller.h"
+#include <algorithm>
+
+#define SORT_DEPTH_RANGE 200.f //view depths past this all sort as furthest (same as SCREEN_DEPTH)
+
+///FNV-1a, used to spot identical materials on different meshes
+static unsigned long long hashBytes(const void* data, size_t size, unsigned long long hash = 14695981039346656037ull) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+///returns the id for ptr, handing out a new one if it's never been seen; 0 is kept for null. Ids wrap past what the key can hold, which only makes sorting less effective
+template<typename T> static unsigned int idFor(std::unordered_map<T, unsigned int>& ids, T value, int bits) {
+	auto it = ids.find(value);
+	if (it == ids.end())
+		it = ids.insert(std::make_pair(value, (unsigned int)ids.size() + 1)).first;
+	return it->second & ((1u << bits) - 1);
+}
+
+static bool sameMaterial(const Material* a, const Material* b) {
+	if (a == b) return true;
+	if (!a || !b) return false;
+	return a->colour.x == b->colour.x && a->colour.y == b->colour.y && a->colour.z == b->colour.z &&
+		a->specularColour.x == b->specularColour.x && a->specularColour.y == b->specularColour.y && a->specularColour.z == b->specularColour.z &&
+		a->specularPower == b->specularPower;
+}
+
+RenderQueue::RenderQueue() {
+	view = XMMatrixIdentity();
+	projection = XMMatrixIdentity();
+	cameraPosition = XMFLOAT3(0, 0, 0);
+}
+
+RenderQueue::~RenderQueue() {
+}
+
+void RenderQueue::begin(const XMMATRIX& view, const XMMATRIX& projection, XMFLOAT3 cameraPosition, OcclusionCuller* culler) {
+	this->view = view;
+	this->projection = projection;
+	this->cameraPosition = cameraPosition;
+	occlusion = culler;
+	MeshletBuilder::makeView(view, projection, meshletView);
+	XMFLOAT4X4 p;
+	XMStoreFloat4x4(&p, projection);
+	lodScale = p._22 * 0.5f * lodHeight / lodPixelError;
+	items.clear();
+	entries.clear();
+	ranges.clear();
+	instanceRanges.clear();
+}
+
+unsigned long long RenderQueue::makeKey(unsigned int pass, LitShader* shader, FBXMesh* mesh, const XMMATRIX& world) {
+	//materials with the same values and maps share an id, whichever mesh they belong to
+	struct {
+		float values[7];
+		const void* normalMap;
+		const void* displacementMap;
+	} materialKey;
+	memset(&materialKey, 0, sizeof(materialKey));//padding gets hashed too
+	Material* material = mesh->getMaterial();
+	if (material) {
+		materialKey.values[0] = material->colour.x; materialKey.values[1] = material->colour.y; materialKey.values[2] = material->colour.z;
+		materialKey.values[3] = material->specularColour.x; materialKey.values[4] = material->specularColour.y; materialKey.values[5] = material->specularColour.z;
+		materialKey.values[6] = material->specularPower;
+	}
+	materialKey.normalMap = mesh->getNormalMap();
+	materialKey.displacementMap = mesh->getDisplacementMap();
+
+	unsigned long long shaderId = idFor<const void*>(shaderIds, shader, KEY_SHADER_BITS);
+	unsigned long long materialId = idFor<unsigned long long>(materialIds, hashBytes(&materialKey, sizeof(materialKey)), KEY_MATERIAL_BITS);
+	unsigned long long textureId = idFor<const void*>(textureIds, mesh->getTexture(), KEY_TEXTURE_BITS);
+
+	//front to back within the same state, to make the most of early depth rejection
+	BoundingBox bounds;
+	mesh->getBounds().Transform(bounds, world * view);
+	float depth = fminf(fmaxf(bounds.Center.z / SORT_DEPTH_RANGE, 0), 1);
+	unsigned long long depthBits = (unsigned long long)(depth * ((1u << KEY_DEPTH_BITS) - 1));
+
+	unsigned long long key = pass & ((1u << KEY_PASS_BITS) - 1);
+	key = (key << KEY_SHADER_BITS) | shaderId;
+	key = (key << KEY_MATERIAL_BITS) | materialId;
+	key = (key << KEY_TEXTURE_BITS) | textureId;
+	key = (key << KEY_DEPTH_BITS) | depthBits;
+	return key;
+}
+
+void RenderQueue::submit(LitShader* shader, FBXMesh* mesh, const XMMATRIX& world, int top, XMMATRIX** bones, int numBones, unsigned int pass, GpuBuffer* arguments, unsigned int argumentsOffset) {
+	if (!shader || !mesh) return;
+
+	DrawItem item;
+	item.shader = shader;
+	item.skinnedShader = bones ? dynamic_cast<SkinnedShader*>(shader) : nullptr;
+	if (bones && !item.skinnedShader) {
+		printf("Error: skinned mesh submitted to the render queue without a skinned shader.\n");
+		return;
+	}
+	item.mesh = mesh;
+	XMStoreFloat4x4(&item.world, world);
+	item.bones = bones;
+	item.numBones = numBones;
+	item.topology = top;
+	item.arguments = arguments;
+	item.argumentsOffset = argumentsOffset;
+	item.firstIndex = 0;
+	item.indexCount = mesh->getIndexCount();
+	item.firstRange = (unsigned int)ranges.size();
+	item.rangeCount = 0;
+	item.firstInstanceRange = (unsigned int)instanceRanges.size();
+	item.instanceRangeCount = 0;
+
+	const std::vector<MeshLod>& lods = mesh->getLods();
+	bool instanced = !bones && mesh->getInstances().size() > 1;
+	bool meshlets = meshletCulling && !bones && !shader->getStages().domainShader;
+	if (!bones && !mesh->getParts().empty()) {
+		item.arguments = nullptr;//the gpu's arguments hold one range each, so batches are culled here instead
+		if (!cullParts(item, world, meshlets)) return;
+	}
+	else {
+		unsigned int level = 0;
+		if (instanced) {
+			item.arguments = nullptr;//the gpu only culls meshes with a single instance
+			if (!cullInstances(item, world, level)) return;
+		}
+		else level = selectLod(mesh->getBounds(), lods, world);
+		if (!lods.empty()) {
+			item.firstIndex = lods[level].firstIndex;
+			item.indexCount = lods[level].indexCount;
+			//the gpu's arguments are for the full mesh; coarser levels are cheap enough to go without occlusion culling
+			if (level > 0) item.arguments = nullptr;
+		}
+		if (meshlets && !instanced && !item.arguments && !lods.empty() && lods[level].meshletCount > 0)
+			if (!cullMeshlets(item, lods[level], world)) return;
+		++stats.lodDraws[level];
+	}
+
+	SortEntry entry;
+	entry.key = makeKey(pass, shader, mesh, world);
+	entry.item = (unsigned int)items.size();
+	entries.push_back(entry);
+	items.push_back(item);
+}
+
+unsigned int RenderQueue::selectLod(const BoundingBox& bounds, const std::vector<MeshLod>& lods, const XMMATRIX& world) {
+	if (lods.size() < 2 || lodScale <= 0) return 0;
+
+	//errors are in mesh space, and the nearest the mesh's bounding sphere gets to the camera is where they look biggest
+	float scale = sqrtf((std::max)((std::max)(XMVectorGetX(XMVector3LengthSq(world.r[0])), XMVectorGetX(XMVector3LengthSq(world.r[1]))), XMVectorGetX(XMVector3LengthSq(world.r[2]))));
+	float distance = 1;
+	if (!meshletView.orthographic) {
+		XMVECTOR center = XMVector3Transform(XMLoadFloat3(&bounds.Center), world);
+		float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents))) * scale;
+		distance = XMVectorGetX(XMVector3Length(center - XMLoadFloat3(&meshletView.position))) - radius;
+		if (distance <= 0) return 0;
+	}
+	for (unsigned int level = (unsigned int)lods.size() - 1; level > 0; --level)
+		if (lods[level].error * scale * lodScale <= distance) return level;
+	return 0;
+}
+
+bool RenderQueue::isVisible(const BoundingBox& box) {
+	//bounding sphere against the same planes meshlets are tested against, so it works for orthographic passes too
+	XMVECTOR center = XMLoadFloat3(&box.Center);
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&box.Extents)));
+	for (int plane = 0; plane < 6; ++plane)
+		if (XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&meshletView.planes[plane]), center)) < -radius) return false;
+	return !occlusion || occlusion->isVisible(box);
+}
+
+void RenderQueue::addRange(DrawItem& item, unsigned int start, unsigned int count) {
+	if (item.rangeCount > 0 && ranges.back().start + ranges.back().count == start)
+		ranges.back().count += count;
+	else {
+		ranges.push_back({ start, count });
+		++item.rangeCount;
+	}
+}
+
+bool RenderQueue::cullMeshlets(DrawItem& item, const MeshLod& lod, const XMMATRIX& world) {
+	const std::vector<Meshlet>& meshlets = item.mesh->getMeshlets();
+	for (unsigned int i = lod.firstMeshlet; i < lod.firstMeshlet + lod.meshletCount; ++i) {
+		const Meshlet& meshlet = meshlets[i];
+		int result = MeshletBuilder::test(meshlet, world, meshletView);
+		++stats.meshlets;
+		if (result == MESHLET_OFFSCREEN) ++stats.meshletsOffscreen;
+		else if (result == MESHLET_BACKFACING) ++stats.meshletsBackfacing;
+		if (result != MESHLET_VISIBLE) continue;
+
+		//neighbouring meshlets go in the same range, so a mesh that's entirely visible is still one draw
+		addRange(item, meshlet.firstIndex, meshlet.indexCount);
+	}
+	return item.rangeCount > 0;
+}
+
+bool RenderQueue::cullInstances(DrawItem& item, const XMMATRIX& world, unsigned int& out_level) {
+	const std::vector<XMFLOAT4X4>& instances = item.mesh->getInstances();
+	out_level = LOD_MAX_LEVELS;
+	for (unsigned int i = 0; i < (unsigned int)instances.size(); ++i) {
+		XMMATRIX instanceWorld = XMLoadFloat4x4(&instances[i]) * world;
+		BoundingBox box;
+		item.mesh->getBounds().Transform(box, instanceWorld);
+		if (!isVisible(box)) {
+			++stats.instancesCulled;
+			continue;
+		}
+		++stats.instances;
+
+		//one level for the whole draw: whatever the nearest instance needs
+		out_level = (std::min)(out_level, selectLod(item.mesh->getBounds(), item.mesh->getLods(), instanceWorld));
+		if (item.instanceRangeCount > 0 && instanceRanges.back().start + instanceRanges.back().count == i)
+			++instanceRanges.back().count;
+		else {
+			instanceRanges.push_back({ i, 1 });
+			++item.instanceRangeCount;
+		}
+	}
+	return item.instanceRangeCount > 0;
+}
+
+bool RenderQueue::cullParts(DrawItem& item, const XMMATRIX& world, bool splitMeshlets) {
+	for (const MeshPart& part : item.mesh->getParts()) {
+		BoundingBox box;
+		part.bounds.Transform(box, world);
+		if (!isVisible(box)) {
+			++stats.partsCulled;
+			continue;
+		}
+		++stats.parts;
+
+		//parts' levels are laid out level by level, so neighbours at the same one carry on the same range
+		unsigned int level = selectLod(part.bounds, part.lods, world);
+		++stats.lodDraws[level];
+		const MeshLod& lod = part.lods[level];
+		if (splitMeshlets && lod.meshletCount > 0)
+			cullMeshlets(item, lod, world);
+		else
+			addRange(item, lod.firstIndex, lod.indexCount);
+	}
+	return item.rangeCount > 0;
+}
+
+void RenderQueue::radixSort() {
+	if (entries.size() < 2) return;
+	scratch.resize(entries.size());
+	unsigned int counts[256];
+	for (int shift = 0; shift < 64; shift += 8) {
+		memset(counts, 0, sizeof(counts));
+		for (const SortEntry& entry : entries)
+			++counts[(entry.key >> shift) & 0xFF];
+		if (counts[(entries[0].key >> shift) & 0xFF] == entries.size()) continue;//everyone has the same byte here, nothing to reorder
+
+		unsigned int offset = 0;
+		for (int i = 0; i < 256; ++i) {
+			unsigned int count = counts[i];
+			counts[i] = offset;
+			offset += count;
+		}
+		for (const SortEntry& entry : entries)
+			scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+		entries.swap(scratch);
+	}
+}
+
+void RenderQueue::bindStages(RenderDevice* device, const Shader::ShaderStages& stages) {
+	//sets one stage if it differs; unused stages are cleared too since the previous shader might have had them
+#define BIND_STAGE(member, call) do{\
+		if (!bound.stagesKnown || stages.member != bound.stages.member) { call; ++stats.shaderStages; }\
+		else if (stages.member) ++stats.shaderStagesSkipped;\
+	}while(false)
+
+	BIND_STAGE(layout, device->setInputLayout(stages.layout));
+	BIND_STAGE(vertexShader, device->setShader(STAGE_VS, stages.vertexShader));
+	BIND_STAGE(hullShader, device->setShader(STAGE_HS, stages.hullShader));
+	BIND_STAGE(domainShader, device->setShader(STAGE_DS, stages.domainShader));
+	BIND_STAGE(geometryShader, device->setShader(STAGE_GS, stages.geometryShader));
+	BIND_STAGE(pixelShader, device->setShader(STAGE_PS, stages.pixelShader));
+
+#undef BIND_STAGE
+	bound.stages = stages;
+	bound.stagesKnown = true;
+}
+
+void RenderQueue::bindInput(RenderDevice* device, FBXMesh* mesh, unsigned int streams, int topology) {
+	//streams the shader doesn't read can stay whatever they were; its layout won't fetch from them
+	for (int stream = 0; stream < STREAM_COUNT; ++stream) {
+		if (!(streams & STREAM_BIT(stream))) continue;
+		GpuBuffer* vertexBuffer = mesh->getVertexBuffer(stream);
+		unsigned int stride = mesh->getVertexStride(stream);
+		if (vertexBuffer != bound.vertexBuffers[stream] || stride != bound.strides[stream]) {
+			device->setVertexBuffer(vertexBuffer, stride, 0, stream);
+			bound.vertexBuffers[stream] = vertexBuffer;
+			bound.strides[stream] = stride;
+			++stats.inputBinds;
+		}
+		else ++stats.inputBindsSkipped;
+	}
+
+	GpuBuffer* indexBuffer = mesh->getIndexBuffer();
+	if (indexBuffer != bound.indexBuffer) {
+		device->setIndexBuffer(indexBuffer);
+		bound.indexBuffer = indexBuffer;
+		++stats.inputBinds;
+	}
+	else ++stats.inputBindsSkipped;
+
+	if (topology != bound.topology) {
+		device->setTopology(topology);
+		bound.topology = topology;
+		++stats.inputBinds;
+	}
+	else ++stats.inputBindsSkipped;
+}
+
+void RenderQueue::bindMaterial(RenderDevice* device, LitShader* shader, bool shaderChanged, const Shader::ShaderStages& stages, FBXMesh* mesh) {
+	Material* material = mesh->getMaterial();
+	GpuView* texture = mesh->getTexture();
+	GpuView* normalMap = mesh->getNormalMap();
+	GpuView* displacementMap = mesh->getDisplacementMap();
+
+	//the material buffer belongs to the shader, and its mode depends on which maps are there
+	bool materialChanged = shaderChanged || !sameMaterial(material, bound.material) || (texture != nullptr) != bound.textured || (normalMap != nullptr) != bound.normalMapped;
+	if (material) {
+		if (materialChanged) ++stats.bufferUpdates;
+		else ++stats.bufferUpdatesSkipped;
+	}
+
+	//null textures aren't bound by setMaterialParameters; they're only needed for the material mode, in which case they're passed regardless
+	bool sendTexture = texture && (materialChanged || texture != bound.texture);
+	bool sendNormalMap = normalMap && (materialChanged || normalMap != bound.normalMap);
+	stats.textureBinds += sendTexture + sendNormalMap;
+	stats.textureBindsSkipped += (texture && !sendTexture) + (normalMap && !sendNormalMap);
+
+	//the displacement buffer gets rewritten on every call if there's a domain shader
+	bool displacementChanged = stages.domainShader && (shaderChanged || displacementMap != bound.displacementMap);
+
+	if (materialChanged || sendTexture || sendNormalMap || displacementChanged) {
+		shader->setMaterialParameters(device, sendTexture ? texture : nullptr, sendNormalMap ? normalMap : nullptr, displacementMap, materialChanged ? material : nullptr);
+		if (materialChanged) {
+			bound.material = material;
+			bound.textured = texture != nullptr;
+			bound.normalMapped = normalMap != nullptr;
+		}
+		if (texture) bound.texture = texture;
+		if (normalMap) bound.normalMap = normalMap;
+		bound.displacementMap = displacementMap;
+	}
+}
+
+void RenderQueue::flush(RenderDevice* device, bool depthOnly) {
+	radixSort();
+
+	//we don't know what got bound since the last flush
+	memset(&bound, 0, sizeof(bound));
+	bound.topology = TOPOLOGY_UNDEFINED;
+
+	for (const SortEntry& entry : entries) {
+		DrawItem& item = items[entry.item];
+		Shader::ShaderStages stages = item.shader->getStages();
+		if (depthOnly) stages.pixelShader = nullptr;
+		bindStages(device, stages);
+
+		//constant buffers are per shader, so they all have to be sent again when it changes
+		bool shaderChanged = item.shader != bound.shader;
+		if (shaderChanged || memcmp(&item.world, &bound.world, sizeof(XMFLOAT4X4)) != 0) {
+			item.shader->setShaderParameters(device, XMLoadFloat4x4(&item.world), view, projection, cameraPosition);
+			bound.world = item.world;
+			++stats.bufferUpdates;
+		}
+		else ++stats.bufferUpdatesSkipped;
+
+		if (item.skinnedShader) {
+			if (shaderChanged || item.bones != bound.bones) {
+				item.skinnedShader->setBones(device, item.bones, item.numBones);
+				bound.bones = item.bones;
+				++stats.bufferUpdates;
+			}
+			else ++stats.bufferUpdatesSkipped;
+		}
+
+		bindMaterial(device, item.shader, shaderChanged, stages, item.mesh);
+		bound.shader = item.shader;
+
+		bindInput(device, item.mesh, item.shader->getStreams(), item.topology);
+
+		if (item.arguments) {
+			device->drawIndexedIndirect(item.arguments, item.argumentsOffset);
+			++stats.indirectDraws;
+			++stats.deviceDraws;
+		}
+		else if (item.instanceRangeCount > 0) {
+			for (unsigned int i = item.firstInstanceRange; i < item.firstInstanceRange + item.instanceRangeCount; ++i)
+				device->drawIndexedInstanced(item.indexCount, instanceRanges[i].count, item.firstIndex, 0, instanceRanges[i].start);
+			stats.deviceDraws += item.instanceRangeCount;
+		}
+		else if (item.rangeCount > 0) {
+			for (unsigned int i = item.firstRange; i < item.firstRange + item.rangeCount; ++i)
+				device->drawIndexed(ranges[i].count, ranges[i].start);
+			stats.deviceDraws += item.rangeCount;
+		}
+		else {
+			device->drawIndexed(item.indexCount, item.firstIndex);
+			++stats.deviceDraws;
+		}
+		++stats.draws;
+	}
+
+	if (depthOnly) return;
+	items.clear();
+	entries.clear();
+	ranges.clear();
+	instanceRanges.clear();
+}
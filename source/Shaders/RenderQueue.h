@@ -0,0 +1,179 @@
+#pragma once
+
+/// Collects the draws of a pass, sorts them by state using packed 64 bit keys (pass, shader, material, texture, depth), then submits them
+/// while skipping any binding (shader stages, vertex/index buffers, constant buffers, textures) that is already in place.
+/// Meshes split into meshlets only get the index ranges of the meshlets their pass can see drawn (see MeshletBuilder).
+/// Meshes with levels of detail get the coarsest one whose error stays under a pixel budget from wherever the pass looks at them from (see LodBuilder).
+/// Meshes with several instances get each instance culled on its own, and one instanced draw per run of visible ones in a row.
+/// Batches get each part culled and given a level on its own, and one draw per run of visible parts whose ranges are in a row (see FBXMeshBatch).
+
+#include "DXF.h"
+#include <vector>
+#include <unordered_map>
+#include "LitShader.h"
+#include "SkinnedShader.h"
+#include "MeshletBuilder.h"
+#include "LodBuilder.h"
+
+class FBXMesh;
+class OcclusionCuller;
+
+//sort key layout, from most to least significant bits; adds up to 64
+#define KEY_PASS_BITS 4
+#define KEY_SHADER_BITS 8
+#define KEY_MATERIAL_BITS 12
+#define KEY_TEXTURE_BITS 16
+#define KEY_DEPTH_BITS 24
+
+///Bindings made vs skipped, summed over every flush since the last resetStats()
+struct RenderQueueStats {
+	unsigned int draws = 0;
+	unsigned int indirectDraws = 0;//of those, the ones whose arguments came from the gpu
+	unsigned int deviceDraws = 0;//draw calls they took: one per index range or run of instances
+	unsigned int shaderStages = 0, shaderStagesSkipped = 0;//input layout, VS, HS, DS, GS, PS
+	unsigned int inputBinds = 0, inputBindsSkipped = 0;//vertex streams, index buffer, topology
+	unsigned int bufferUpdates = 0, bufferUpdatesSkipped = 0;//constant buffer writes: matrices, bones, material
+	unsigned int textureBinds = 0, textureBindsSkipped = 0;//diffuse and normal maps
+	unsigned int meshlets = 0, meshletsOffscreen = 0, meshletsBackfacing = 0;//tested, and culled
+	unsigned int lodDraws[LOD_MAX_LEVELS] = {};//draws (or parts of batches) at each level of detail
+	unsigned int instances = 0, instancesCulled = 0;//of meshes with several instances: drawn, and culled
+	unsigned int parts = 0, partsCulled = 0;//of batches: drawn, and culled
+
+	///for totals over several queues
+	inline RenderQueueStats& operator+=(const RenderQueueStats& other) {
+		draws += other.draws;
+		indirectDraws += other.indirectDraws;
+		deviceDraws += other.deviceDraws;
+		shaderStages += other.shaderStages; shaderStagesSkipped += other.shaderStagesSkipped;
+		inputBinds += other.inputBinds; inputBindsSkipped += other.inputBindsSkipped;
+		bufferUpdates += other.bufferUpdates; bufferUpdatesSkipped += other.bufferUpdatesSkipped;
+		textureBinds += other.textureBinds; textureBindsSkipped += other.textureBindsSkipped;
+		meshlets += other.meshlets; meshletsOffscreen += other.meshletsOffscreen; meshletsBackfacing += other.meshletsBackfacing;
+		for (int i = 0; i < LOD_MAX_LEVELS; ++i) lodDraws[i] += other.lodDraws[i];
+		instances += other.instances; instancesCulled += other.instancesCulled;
+		parts += other.parts; partsCulled += other.partsCulled;
+		return *this;
+	}
+};
+
+class RenderQueue {
+
+protected:
+	///one draw, as submitted
+	struct DrawItem {
+		LitShader* shader;
+		SkinnedShader* skinnedShader;//same as shader for skinned meshes, null otherwise
+		FBXMesh* mesh;
+		XMFLOAT4X4 world;
+		XMMATRIX** bones;
+		int numBones;
+		int topology;
+		GpuBuffer* arguments;//indirect draws only
+		unsigned int argumentsOffset;
+		unsigned int firstIndex, indexCount;//the level of detail being drawn
+		unsigned int firstRange, rangeCount;//into ranges; no ranges draws the whole level (batches always have some)
+		unsigned int firstInstanceRange, instanceRangeCount;//into instanceRanges; none draws the mesh's only instance
+	};
+
+	///indices (or instances) left to draw, after culling meshlets (or instances)
+	struct IndexRange {
+		unsigned int start, count;
+	};
+
+	struct SortEntry {
+		unsigned long long key;
+		unsigned int item;
+	};
+
+	///what the queue last bound during the current flush; anything else may have bound whatever it wanted in between flushes
+	struct BoundState {
+		bool stagesKnown;
+		Shader::ShaderStages stages;
+		LitShader* shader;//whose constant buffers are bound
+		XMFLOAT4X4 world;
+		XMMATRIX** bones;
+		Material* material;
+		bool textured, normalMapped;//what the material buffer's mode was worked out from
+		GpuView* texture;//PS t0
+		GpuView* normalMap;//PS t1
+		GpuView* displacementMap;
+		GpuBuffer* vertexBuffers[STREAM_COUNT];
+		unsigned int strides[STREAM_COUNT];
+		GpuBuffer* indexBuffer;
+		int topology;
+	};
+
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	///starts collecting draws seen from the given camera; anything submitted but not flushed is dropped.
+	///Instances of meshes with several, and parts of batches, are culled against the camera's frustum, and against culler if there is one
+	void begin(const XMMATRIX& view, const XMMATRIX& projection, XMFLOAT3 cameraPosition, OcclusionCuller* culler = nullptr);
+	///adds a mesh to the queue; bones are only needed for skinned meshes (and shader must then be a SkinnedShader). Lower passes are drawn first regardless of state
+	///with arguments, the mesh is drawn indirectly with whatever index and instance counts the gpu left at argumentsOffset (see HiZCuller), unless it's far enough for a coarser level
+	void submit(LitShader* shader, FBXMesh* mesh, const XMMATRIX& world, int top, XMMATRIX** bones = nullptr, int numBones = 0, unsigned int pass = 0, GpuBuffer* arguments = nullptr, unsigned int argumentsOffset = 0);
+	///sorts everything submitted since begin() and draws it
+	///depthOnly draws it all without a pixel shader and keeps it queued, for a depth pre-pass; flush again to draw it for real, through the very same
+	///vertex, hull and domain shaders so that depths match exactly
+	void flush(RenderDevice* device, bool depthOnly = false);
+
+	///whether to cull meshlets; meshes drawn indirectly, skinned or through a domain shader are always drawn whole
+	inline void setMeshletCulling(bool enabled) { meshletCulling = enabled; }
+	///picks levels of detail whose error covers no more than pixelError pixels of a screenHeight pixels tall target; 0 height always draws the full meshes.
+	///Takes effect from the next begin()
+	inline void setLevelOfDetail(float screenHeight, float pixelError) { lodHeight = screenHeight; lodPixelError = pixelError; }
+
+	inline const RenderQueueStats& getStats() { return stats; }
+	///call once per frame
+	inline void resetStats() { stats = RenderQueueStats(); }
+
+protected:
+	std::vector<DrawItem> items;
+	std::vector<SortEntry> entries;
+	std::vector<SortEntry> scratch;//radix sort ping-pong buffer
+	std::vector<IndexRange> ranges;
+	std::vector<IndexRange> instanceRanges;
+
+	XMMATRIX view, projection;
+	XMFLOAT3 cameraPosition;
+	MeshletView meshletView;
+	OcclusionCuller* occlusion = nullptr;
+	bool meshletCulling = true;
+	float lodHeight = 0, lodPixelError = 1;
+	float lodScale = 0;//pixels per unit of error, one unit away (any distance away for orthographic projections)
+
+	//small ids for the sort key, handed out the first time each shader, material or texture is seen
+	std::unordered_map<const void*, unsigned int> shaderIds;
+	std::unordered_map<unsigned long long, unsigned int> materialIds;
+	std::unordered_map<const void*, unsigned int> textureIds;
+
+	BoundState bound;
+	RenderQueueStats stats;
+
+	///sorts entries by key; least significant byte first, skipping bytes that are the same for every entry
+	void radixSort();
+	///sets whichever stages differ from the bound ones
+	void bindStages(RenderDevice* device, const Shader::ShaderStages& stages);
+	///sets the vertex streams the shader reads, index buffer and topology if they differ from the bound ones
+	void bindInput(RenderDevice* device, FBXMesh* mesh, unsigned int streams, int topology);
+	///writes material constants and binds textures, as far as they differ from the bound ones
+	void bindMaterial(RenderDevice* device, LitShader* shader, bool shaderChanged, const Shader::ShaderStages& stages, FBXMesh* mesh);
+
+	///the coarsest of the levels whose error, seen from this pass, is within budget; bounds are what the levels were built from, in mesh space
+	unsigned int selectLod(const BoundingBox& bounds, const std::vector<MeshLod>& lods, const XMMATRIX& world);
+	///whether a world space box is in this pass's frustum, and not hidden behind the culler's occluders if there is one
+	bool isVisible(const BoundingBox& box);
+	///adds a range of indices to item's, growing the last one instead if they're in a row
+	void addRange(DrawItem& item, unsigned int start, unsigned int count);
+	///tests the meshlets of item's level and adds the ranges left to draw; false if there are none
+	bool cullMeshlets(DrawItem& item, const MeshLod& lod, const XMMATRIX& world);
+	///tests each instance of item's mesh and adds the runs left to draw, at the finest level any of them needs; false if there are none
+	bool cullInstances(DrawItem& item, const XMMATRIX& world, unsigned int& out_level);
+	///tests each part of item's batch and adds the ranges left to draw, each part at its own level and split into meshlets if splitMeshlets; false if there are none
+	bool cullParts(DrawItem& item, const XMMATRIX& world, bool splitMeshlets);
+
+	///builds the key for a draw
+	unsigned long long makeKey(unsigned int pass, LitShader* shader, FBXMesh* mesh, const XMMATRIX& world);
+
+};
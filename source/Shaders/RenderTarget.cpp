@@ -0,0 +1,107 @@
+#include "RenderTarget.h"
+
+RenderTarget::RenderTarget(ID3D11Device* device, int width, int height, DXGI_FORMAT format, bool depth, bool mips) : width(width), height(height), format(format), mips(mips) {
+
+	//Colour texture
+	D3D11_TEXTURE2D_DESC textureDesc;
+	ZeroMemory(&textureDesc, sizeof(textureDesc));
+	textureDesc.Width = width;
+	textureDesc.Height = height;
+	textureDesc.MipLevels = mips ? 0 : 1;//0 means the whole chain
+	textureDesc.ArraySize = 1;
+	textureDesc.Format = format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+	textureDesc.MiscFlags = mips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+	HRESULT result = device->CreateTexture2D(&textureDesc, NULL, &texture);
+	if (result != S_OK) {
+		printf("Error: could not create %dx%d render target texture.\n", width, height);
+		return;
+	}
+
+	//Views
+	D3D11_RENDER_TARGET_VIEW_DESC rtvDesc;
+	rtvDesc.Format = format;
+	rtvDesc.ViewDimension = D3D11_RTV_DIMENSION_TEXTURE2D;
+	rtvDesc.Texture2D.MipSlice = 0;
+	device->CreateRenderTargetView(texture, &rtvDesc, &renderTargetView);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = -1;//all of them
+	device->CreateShaderResourceView(texture, &srvDesc, &shaderResourceView);
+
+	//Depth buffer
+	if (depth) {
+		D3D11_TEXTURE2D_DESC depthDesc = textureDesc;
+		depthDesc.MipLevels = 1;
+		depthDesc.Format = DXGI_FORMAT_R24G8_TYPELESS;//typeless so it can be read back as well
+		depthDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE;
+		depthDesc.MiscFlags = 0;
+		device->CreateTexture2D(&depthDesc, NULL, &depthTexture);
+
+		D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
+		ZeroMemory(&dsvDesc, sizeof(dsvDesc));
+		dsvDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+		dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2D;
+		device->CreateDepthStencilView(depthTexture, &dsvDesc, &depthStencilView);
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC depthSrvDesc;
+		ZeroMemory(&depthSrvDesc, sizeof(depthSrvDesc));
+		depthSrvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+		depthSrvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		depthSrvDesc.Texture2D.MipLevels = 1;
+		device->CreateShaderResourceView(depthTexture, &depthSrvDesc, &depthResourceView);
+	}
+
+	viewport.width = (float)width;
+	viewport.height = (float)height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+}
+
+RenderTarget::~RenderTarget() {
+	if (depthResourceView)
+		depthResourceView->Release();
+	if (depthStencilView)
+		depthStencilView->Release();
+	if (depthTexture)
+		depthTexture->Release();
+	if (shaderResourceView)
+		shaderResourceView->Release();
+	if (renderTargetView)
+		renderTargetView->Release();
+	if (texture)
+		texture->Release();
+}
+
+void RenderTarget::setRenderTarget(RenderDevice* device) {
+	device->setRenderTarget(D3D11RenderDevice::handle(renderTargetView), D3D11RenderDevice::handle(depthStencilView), viewport);
+}
+
+void RenderTarget::clear(RenderDevice* device, float r, float g, float b, float a) {
+	float colour[4] = { r, g, b, a };
+	device->clear(D3D11RenderDevice::handle(renderTargetView), colour, D3D11RenderDevice::handle(depthStencilView));
+}
+
+void RenderTarget::generateMips(ID3D11DeviceContext* deviceContext) {
+	if (mips)
+		deviceContext->GenerateMips(shaderResourceView);
+}
+
+unsigned int RenderTarget::sizeOf(int width, int height, DXGI_FORMAT format, bool depth, bool mips) {
+	unsigned int bytesPerPixel;
+	switch (format) {
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: bytesPerPixel = 16; break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: case DXGI_FORMAT_R32G32_FLOAT: bytesPerPixel = 8; break;
+	default: bytesPerPixel = 4; break;//R32_FLOAT, R16G16_FLOAT, R8G8B8A8_UNORM...
+	}
+	unsigned int colour = width * height * bytesPerPixel;
+	if (mips) colour += colour / 3;
+	return colour + (depth ? width * height * 4 : 0);//D24S8
+}
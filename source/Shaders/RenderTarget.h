@@ -0,0 +1,46 @@
+#pragma once
+
+/// Same idea as DXFramework's RenderTexture, but we get to pick the format (eg. single channel shadowmaps) and can ask for a mip chain.
+/// Still made straight on the D3D11 device; everything else only ever sees its views as RenderDevice handles.
+
+#include "DXF.h"
+#include "D3D11RenderDevice.h"
+
+class RenderTarget {
+
+public:
+	RenderTarget(ID3D11Device* device, int width, int height, DXGI_FORMAT format, bool depth = true, bool mips = false);
+	~RenderTarget();
+
+	///Sets this as the render target (and viewport) for everything rendered after this call
+	void setRenderTarget(RenderDevice* device);
+	///Clears colour (and depth if there is a depth buffer)
+	void clear(RenderDevice* device, float r, float g, float b, float a);
+	///Fills in mips from the top level; does nothing if the target was created without mips
+	void generateMips(ID3D11DeviceContext* deviceContext);
+
+	inline GpuView* getShaderResourceView() { return D3D11RenderDevice::handle(shaderResourceView); }
+	///hardware depth in r, null if the target was created without a depth buffer; can't be read while the target is bound
+	inline GpuView* getDepthResourceView() { return D3D11RenderDevice::handle(depthResourceView); }
+	inline int getWidth() { return width; }
+	inline int getHeight() { return height; }
+	inline DXGI_FORMAT getFormat() { return format; }
+	inline bool hasMips() { return mips; }
+
+	///roughly what a target takes in video memory: colour, mips and depth
+	static unsigned int sizeOf(int width, int height, DXGI_FORMAT format, bool depth, bool mips = false);
+
+private:
+	int width, height;
+	DXGI_FORMAT format;
+	bool mips;
+
+	ID3D11Texture2D* texture = nullptr;
+	ID3D11RenderTargetView* renderTargetView = nullptr;
+	ID3D11ShaderResourceView* shaderResourceView = nullptr;
+	ID3D11Texture2D* depthTexture = nullptr;
+	ID3D11DepthStencilView* depthStencilView = nullptr;
+	ID3D11ShaderResourceView* depthResourceView = nullptr;
+	Viewport viewport;
+
+};
@@ -0,0 +1,75 @@
+#include "RenderTargetPool.h"
+
+RenderTargetPool::RenderTargetPool(ID3D11Device* device) : device(device) {
+}
+
+RenderTargetPool::~RenderTargetPool() {
+	for (Entry& entry : entries)
+		delete entry.target;
+}
+
+RenderTarget* RenderTargetPool::acquire(int width, int height, DXGI_FORMAT format, bool depth, bool mips) {
+	//of the matching targets, the one released last; its contents are the likeliest to still be in cache, if anything is
+	Entry* match = nullptr;
+	for (Entry& entry : entries) {
+		if (entry.inUse || entry.depth != depth || entry.mips != mips) continue;
+		RenderTarget* target = entry.target;
+		if (target->getWidth() != width || target->getHeight() != height || target->getFormat() != format) continue;
+		if (!match || entry.lastUsed > match->lastUsed) match = &entry;
+	}
+
+	if (!match) {
+		Entry entry;
+		entry.target = new RenderTarget(device, width, height, format, depth, mips);
+		entry.depth = depth;
+		entry.mips = mips;
+		entry.inUse = false;
+		entries.push_back(entry);
+		match = &entries.back();
+		bytes += sizeOf(*match);
+		++allocations;
+	}
+
+	match->inUse = true;
+	match->lastUsed = frame;
+	++inUse;
+	bytesInUse += sizeOf(*match);
+	return match->target;
+}
+
+void RenderTargetPool::release(RenderTarget* target) {
+	for (Entry& entry : entries) {
+		if (entry.target != target) continue;
+		if (!entry.inUse) {
+			printf("Error: render target released twice.\n");
+			return;
+		}
+		entry.inUse = false;
+		entry.lastUsed = frame;
+		--inUse;
+		bytesInUse -= sizeOf(entry);
+		return;
+	}
+	printf("Error: released a render target that didn't come from the pool.\n");
+}
+
+void RenderTargetPool::endFrame() {
+	++frame;
+	for (int freed = 0; freed < POOL_FREES_PER_FRAME; ++freed) {
+		//the target that's gone unused the longest, if it's been too long, or if idle targets are over budget
+		int oldest = -1;
+		for (int i = 0; i < (int)entries.size(); ++i)
+			if (!entries[i].inUse && (oldest < 0 || entries[i].lastUsed < entries[oldest].lastUsed)) oldest = i;
+		if (oldest < 0) break;
+		Entry& entry = entries[oldest];
+		if (frame - entry.lastUsed <= POOL_IDLE_FRAMES && getIdleBytes() <= POOL_MAX_IDLE_BYTES) break;
+		bytes -= sizeOf(entry);
+		delete entry.target;
+		entries.erase(entries.begin() + oldest);
+	}
+}
+
+unsigned int RenderTargetPool::sizeOf(Entry& entry) {
+	RenderTarget* target = entry.target;
+	return RenderTarget::sizeOf(target->getWidth(), target->getHeight(), target->getFormat(), entry.depth, entry.mips);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+/// Keeps render targets around once they've been released, so whoever next asks for the same format, size and flags gets one back instead of a new texture.
+/// Changing a shadowmap resolution or the screen size only ever allocates the size class being switched to (and nothing at all when switching back soon enough),
+/// while targets of the old size wait in the pool until they've gone unused for a while, or until idle targets take up more than POOL_MAX_IDLE_BYTES,
+/// and are then freed a few at a time, longest unused first.
+
+#include <vector>
+#include "RenderTarget.h"
+
+#define POOL_IDLE_FRAMES 300 //frames a released target waits to be reused before it's freed
+#define POOL_MAX_IDLE_BYTES (64u << 20) //past this, released targets get freed without waiting POOL_IDLE_FRAMES, so a superseded size class doesn't double memory
+#define POOL_FREES_PER_FRAME 1 //so freeing a whole size class doesn't all land on one frame either
+
+class RenderTargetPool {
+
+protected:
+	struct Entry {
+		RenderTarget* target;
+		bool depth, mips;
+		bool inUse;
+		unsigned long long lastUsed;//frame it was last acquired or released in
+	};
+
+public:
+	RenderTargetPool(ID3D11Device* device);
+	~RenderTargetPool();
+
+	///a target nobody else is using; recycled if one with the same format, size and flags has been released, new otherwise
+	RenderTarget* acquire(int width, int height, DXGI_FORMAT format, bool depth = true, bool mips = false);
+	///hands a target back for acquire() to recycle; it must have come from acquire()
+	void release(RenderTarget* target);
+	///call once per frame; frees targets that have been sitting in the pool for too long, or while there's too much sitting in it
+	void endFrame();
+
+	//occupancy
+	inline int getTargetCount() { return (int)entries.size(); }
+	inline int getTargetsInUse() { return inUse; }
+	inline unsigned int getBytes() { return bytes; }
+	inline unsigned int getBytesInUse() { return bytesInUse; }
+	inline unsigned int getIdleBytes() { return bytes - bytesInUse; }
+	inline unsigned int getAllocations() { return allocations; }//targets created since startup; stays put while nothing's being resized
+
+protected:
+	ID3D11Device* device;
+	std::vector<Entry> entries;
+	unsigned long long frame = 0;
+
+	int inUse = 0;
+	unsigned int bytes = 0, bytesInUse = 0;
+	unsigned int allocations = 0;
+
+	static unsigned int sizeOf(Entry& entry);
+
+};
@@ -0,0 +1,64 @@
+#include "RingAllocator.h"
+
+RingAllocator::RingAllocator(unsigned int pageSize, unsigned int maxPages) : pageSize(pageSize), maxPages(maxPages) {
+}
+
+RingAllocator::~RingAllocator() {
+}
+
+bool RingAllocator::allocate(unsigned int size, unsigned int alignment, unsigned int& out_page, unsigned int& out_offset, bool& out_fresh) {
+	if (size == 0 || size > pageSize) return false;
+
+	//keep going in the current page if there's room
+	if (current >= 0) {
+		unsigned int offset = (head + alignment - 1) / alignment * alignment;
+		if (offset + size <= pageSize) {
+			bytesWasted += offset - head;
+			bytesAllocated += size;
+			head = offset + size;
+			pages[current].lastFrame = frame;
+			out_page = current;
+			out_offset = offset;
+			out_fresh = false;
+			return true;
+		}
+	}
+
+	//otherwise move on to the next page the gpu is done with, looking from the current one onwards so pages get used in turn
+	int count = (int)pages.size();
+	int next = -1;
+	for (int i = 1; i <= count; ++i) {
+		int page = (current + i) % count;
+		if (page != current && pages[page].lastFrame <= retired) {
+			next = page;
+			break;
+		}
+	}
+	if (next < 0) {
+		if (pages.size() >= maxPages) return false;
+		Page page;
+		page.lastFrame = 0;
+		pages.push_back(page);
+		next = count;
+	}
+
+	if (current >= 0) bytesWasted += pageSize - head;
+	current = next;
+	head = size;
+	bytesAllocated += size;
+	pages[current].lastFrame = frame;
+	out_page = current;
+	out_offset = 0;
+	out_fresh = true;
+	return true;
+}
+
+unsigned long long RingAllocator::endFrame() {
+	bytesAllocated = 0;
+	bytesWasted = 0;
+	return frame++;
+}
+
+void RingAllocator::retire(unsigned long long fence) {
+	if (fence > retired) retired = fence;
+}
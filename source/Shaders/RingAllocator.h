@@ -0,0 +1,53 @@
+#pragma once
+
+/// Hands out aligned ranges from fixed size pages, linearly within a page; once a page is full the next free one is used, or a new one gets added.
+/// A page only becomes free again once every frame that used it has been retired (ie. its fence has passed on the gpu), so nothing still in flight ever gets written over.
+/// Knows nothing about D3D (TransientBuffer owns the actual buffers and fences), so it can be driven by a mock device or a plain loop (tests/TransientBufferTests.cpp does both).
+
+#include <vector>
+
+class RingAllocator {
+
+protected:
+	struct Page {
+		unsigned long long lastFrame;//the last frame that allocated from this page
+	};
+
+public:
+	///pageSize must be a multiple of any alignment asked for later
+	RingAllocator(unsigned int pageSize, unsigned int maxPages);
+	~RingAllocator();
+
+	///finds room for size bytes at a multiple of alignment. out_fresh is set when the range starts a page that nothing in flight uses, ie. a new page or one that was reclaimed.
+	///Returns false if size doesn't fit in a page, or if every page is in use and there can't be more.
+	bool allocate(unsigned int size, unsigned int alignment, unsigned int& out_page, unsigned int& out_offset, bool& out_fresh);
+
+	///closes the frame being recorded and returns its fence; pages it used stay busy until retire() is called with that fence (or a later one)
+	unsigned long long endFrame();
+	///the gpu is done with every frame up to and including this fence
+	void retire(unsigned long long fence);
+
+	inline unsigned int getPageSize() { return pageSize; }
+	inline unsigned int getPageCount() { return (unsigned int)pages.size(); }
+	///oldest frame the gpu might still be using, for the caller to wait on when allocate() fails
+	inline unsigned long long getOldestPendingFrame() { return retired + 1; }
+	inline unsigned long long getCurrentFrame() { return frame; }
+
+	///stats for the frame being recorded
+	inline unsigned int getBytesAllocated() { return bytesAllocated; }
+	inline unsigned int getBytesWasted() { return bytesWasted; }//alignment padding and page ends left empty
+
+protected:
+	unsigned int pageSize;
+	unsigned int maxPages;
+	std::vector<Page> pages;
+	int current = -1;//page being filled, -1 until the first allocation
+	unsigned int head = 0;//first unused byte in the current page
+
+	unsigned long long frame = 1;//fence of the frame being recorded
+	unsigned long long retired = 0;//every frame up to this one is done
+
+	unsigned int bytesAllocated = 0;
+	unsigned int bytesWasted = 0;
+
+};
@@ -0,0 +1,103 @@
+#include "SceneNode.h"
+
+#include <algorithm>
+
+SceneNode::SceneNode() {
+	XMStoreFloat4x4(&world, XMMatrixIdentity());
+}
+
+SceneNode::~SceneNode() {
+	if (parent) parent->removeChild(this);
+	for (SceneNode* child : children) {
+		child->parent = nullptr;
+		child->markDirty();//it's a root now
+	}
+}
+
+void SceneNode::setPosition(const XMFLOAT3& position) {
+	this->position = position;
+	markDirty();
+}
+
+void SceneNode::setRotation(const XMFLOAT4& rotation) {
+	this->rotation = rotation;
+	markDirty();
+}
+
+void SceneNode::setScale(const XMFLOAT3& scale) {
+	this->scale = scale;
+	markDirty();
+}
+
+XMMATRIX SceneNode::getLocal() {
+	return XMMatrixScalingFromVector(XMLoadFloat3(&scale)) * XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)) * XMMatrixTranslationFromVector(XMLoadFloat3(&position));
+}
+
+void SceneNode::addChild(SceneNode* child) {
+	if (child->parent) child->parent->removeChild(child);
+	children.push_back(child);
+	child->parent = this;
+	//the child's world now comes from here; it's already flagged dirty if it was before, but its new ancestors don't know about it
+	child->dirty = false;
+	child->markDirty();
+}
+
+void SceneNode::removeChild(SceneNode* child) {
+	auto it = std::find(children.begin(), children.end(), child);
+	if (it == children.end()) return;
+	children.erase(it);
+	child->parent = nullptr;
+	child->markDirty();
+	//the subtree's bounds may have shrunk
+	dirty = false;
+	markDirty();
+}
+
+void SceneNode::setBounds(const BoundingBox& bounds) {
+	this->bounds = bounds;
+	bounded = true;
+	markDirty();
+}
+
+void SceneNode::markDirty() {
+	if (dirty) return;//ancestors were told already
+	dirty = true;
+	for (SceneNode* ancestor = parent; ancestor && !ancestor->childDirty; ancestor = ancestor->parent)
+		ancestor->childDirty = true;
+}
+
+unsigned int SceneNode::update() {
+	unsigned int updated = 0;
+	update(parent ? XMLoadFloat4x4(&parent->world) : XMMatrixIdentity(), false, updated);
+	return updated;
+}
+
+bool SceneNode::update(const XMMATRIX& parentWorld, bool parentMoved, unsigned int& out_updated) {
+	bool moved = dirty || parentMoved;
+	if (!moved && !childDirty) return false;//nothing changed down here
+
+	XMMATRIX nodeWorld;
+	if (moved) {
+		nodeWorld = getLocal() * parentWorld;
+		XMStoreFloat4x4(&world, nodeWorld);
+		if (bounded) bounds.Transform(worldBounds, nodeWorld);
+		++out_updated;
+	}
+	else nodeWorld = XMLoadFloat4x4(&world);
+
+	bool childrenChanged = false;
+	for (SceneNode* child : children)
+		childrenChanged |= child->update(nodeWorld, moved, out_updated);
+	dirty = childDirty = false;
+	if (!moved && !childrenChanged) return false;
+
+	subtreeBounded = bounded;
+	if (bounded) subtreeBounds = worldBounds;
+	for (SceneNode* child : children) {
+		if (!child->subtreeBounded) continue;
+		if (subtreeBounded) BoundingBox::CreateMerged(subtreeBounds, subtreeBounds, child->subtreeBounds);
+		else subtreeBounds = child->subtreeBounds;
+		subtreeBounded = true;
+	}
+	return true;
+}
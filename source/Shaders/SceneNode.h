@@ -0,0 +1,73 @@
+#pragma once
+
+/// One node of a transform hierarchy: a local position, rotation and scale, and a world matrix cached from its parent's.
+/// Changing a node only marks it dirty, and its ancestors as having something dirty below them; update() then only walks down
+/// those paths, recomputing the worlds of dirty nodes and everything under them, and leaves every other subtree alone.
+/// Nodes can have local bounds (whatever is attached to them), kept in world space along with the bounds of their whole subtree,
+/// which are only merged again on the paths update() walked.
+/// Nodes don't own their children; deleting one detaches it from its parent and leaves its children without one.
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <vector>
+
+using namespace DirectX;
+
+class SceneNode {
+
+public:
+	SceneNode();
+	~SceneNode();
+
+	///local transform, relative to the parent; rotation is a quaternion
+	void setPosition(const XMFLOAT3& position);
+	void setRotation(const XMFLOAT4& rotation);
+	void setScale(const XMFLOAT3& scale);
+	inline const XMFLOAT3& getPosition() { return position; }
+	inline const XMFLOAT4& getRotation() { return rotation; }
+	inline const XMFLOAT3& getScale() { return scale; }
+	///scale, then rotation, then translation
+	XMMATRIX getLocal();
+
+	///moves child under this node, out of whatever parent it had
+	void addChild(SceneNode* child);
+	void removeChild(SceneNode* child);
+	inline SceneNode* getParent() { return parent; }
+	inline const std::vector<SceneNode*>& getChildren() { return children; }
+
+	///bounds of what's attached to this node, in its own space
+	void setBounds(const BoundingBox& bounds);
+	///as of the last update(): the node's bounds in world space, and those merged with every node's below it. False if there are none
+	inline bool hasBounds() { return bounded; }
+	inline bool hasSubtreeBounds() { return subtreeBounded; }
+	inline const BoundingBox& getWorldBounds() { return worldBounds; }
+	inline const BoundingBox& getSubtreeBounds() { return subtreeBounds; }
+
+	///as of the last update()
+	inline const XMFLOAT4X4& getWorld() { return world; }
+
+	///brings the worlds and bounds of this node and everything under it up to date, taking the parent's world as it was last updated;
+	///call it on the root, once everything has moved for the frame. Returns how many worlds were recomputed
+	unsigned int update();
+
+protected:
+	XMFLOAT3 position = XMFLOAT3(0, 0, 0);
+	XMFLOAT4 rotation = XMFLOAT4(0, 0, 0, 1);
+	XMFLOAT3 scale = XMFLOAT3(1, 1, 1);
+	XMFLOAT4X4 world;
+
+	SceneNode* parent = nullptr;
+	std::vector<SceneNode*> children;
+
+	BoundingBox bounds, worldBounds, subtreeBounds;
+	bool bounded = false, subtreeBounded = false;
+
+	bool dirty = true;//the local transform or bounds changed, so this node's world and everything below it needs redoing
+	bool childDirty = false;//something below this node is dirty
+
+	///flags this node dirty, and its ancestors as having something dirty below
+	void markDirty();
+	///update() for a node whose parent's world is parentWorld, and moved if parentMoved; true if the subtree's bounds changed
+	bool update(const XMMATRIX& parentWorld, bool parentMoved, unsigned int& out_updated);
+
+};
@@ -1,141 +1,169 @@
 #include "Shader.h"
 
 #include "AppGlobals.h"
+#include "AssetLoader.h"
 
 Shader::Shader() : BaseShader(GLOBALS.Device, GLOBALS.Hwnd) {
 }
 
 Shader::~Shader(){
-
-	if (sampleState)
-		sampleState->Release();
-
-	if (matrixBuffer)
-		matrixBuffer->Release();
-
-	if (layout)
-		layout->Release();
+	RenderDevice* device = GLOBALS.Backend;
+	device->releaseLayout(stages.layout);
+	device->releaseShader(stages.vertexShader);
+	device->releaseShader(stages.hullShader);
+	device->releaseShader(stages.domainShader);
+	device->releaseShader(stages.geometryShader);
+	device->releaseShader(stages.pixelShader);
+	device->releaseSampler(sampler);
+	device->releaseBuffer(matrixConstants);
+	device->releaseBuffer(dynamicTessellationBuffer);
 }
 
 ///Reference: https://docs.microsoft.com/en-us/windows/uwp/gaming/load-a-game-asset
-void Shader::loadSkinVertexShader(WCHAR * filename) {
-	if (vertexShader) {
+void Shader::loadLayoutVertexShader(WCHAR* filename, const VertexElement* elements, unsigned int count, const char* kind) {
+	if (stages.vertexShader) {
 		printf("Error: vertex shader has already been loaded prior!\n");
 		return;
 	}
 	
 	/// Load shader -----------------------------------------------------------------------------------------------------------------------
 
-	std::ifstream input(filename, std::ios::binary);
-	std::vector<char> bytes((std::istreambuf_iterator<char>(input)), (std::istreambuf_iterator<char>()));
+	std::vector<char> bytes;
+	if (!readBytecode(filename, bytes, "vertex")) return;
 
-	if (bytes.size() <= 0) {
+	stages.vertexShader = GLOBALS.Backend->createShader(STAGE_VS, bytes.data(), bytes.size());
+	if (!stages.vertexShader) {
 		std::wstring wfilename(filename);
-		printf("Error: vertex shader file %s does not exist...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		return;
-	}
-
-	HRESULT result = GLOBALS.Device->CreateVertexShader(bytes.data(), bytes.size(), nullptr, &vertexShader);
-	if (result != S_OK) {
-		std::wstring wfilename(filename);
-		printf("Error: could not load compiled skinning vertex shader %s...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		printError(result);
+		printf("Error: could not load compiled %s vertex shader %s...\n", kind, std::string(wfilename.begin(), wfilename.end()).c_str());
 		return;
 	}
 
 	/// Create input layout -----------------------------------------------------------------------------------------------------------------------
 
-	const D3D11_INPUT_ELEMENT_DESC layoutDesc[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float3 Position
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float2 Texcoord0
-		{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float3 Normal
-		{ "TANGENT",  0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float3 Tangent
-		{ "BLENDINDICES", 0, DXGI_FORMAT_R32G32B32A32_UINT,     0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Uint4 BlendIndices0
-		{ "BLENDINDICES", 1, DXGI_FORMAT_R32G32B32A32_UINT,     0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Uint4 BlendIndices1
-		{ "BLENDWEIGHT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float4 BlendWeight0
-		{ "BLENDWEIGHT",  1, DXGI_FORMAT_R32G32B32A32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float4 BlendWeight1
-	};
-
-	result = GLOBALS.Device->CreateInputLayout(layoutDesc, ARRAYSIZE(layoutDesc), bytes.data(), bytes.size(), &layout);
-	if (result != S_OK) {
+	stages.layout = GLOBALS.Backend->createLayout(elements, count, bytes.data(), bytes.size());
+	if (!stages.layout) {
 		std::wstring wfilename(filename);
-		printf("Error: could not create input layout for skinning vertex shader %s...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		printError(result);
+		printf("Error: could not create input layout for %s vertex shader %s...\n", kind, std::string(wfilename.begin(), wfilename.end()).c_str());
 		return;
 	}
 
 	//Success! :D
 }
 
-void Shader::loadTangentVertexShader(WCHAR * filename) {
-	if (vertexShader) {
-		printf("Error: vertex shader has already been loaded prior!\n");
-		return;
+bool Shader::readBytecode(const wchar_t* filename, std::vector<char>& out_bytes, const char* kind) {
+	std::wstring wfilename(filename);
+	std::string name(wfilename.begin(), wfilename.end());
+	if (GLOBALS.Assets) GLOBALS.Assets->takeFile(name, out_bytes);
+	else {
+		std::ifstream input(filename, std::ios::binary);
+		out_bytes.assign((std::istreambuf_iterator<char>(input)), (std::istreambuf_iterator<char>()));
 	}
-
-	/// Load shader -----------------------------------------------------------------------------------------------------------------------
-
-	std::ifstream input(filename, std::ios::binary);
-	std::vector<char> bytes((std::istreambuf_iterator<char>(input)), (std::istreambuf_iterator<char>()));
-
-	if (bytes.size() <= 0) {
-		std::wstring wfilename(filename);
-		printf("Error: vertex shader file %s does not exist...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		return;
+	if (out_bytes.empty()) {
+		printf("Error: %s shader file %s does not exist...\n", kind, name.c_str());
+		return false;
 	}
+	return true;
+}
 
-	HRESULT result = GLOBALS.Device->CreateVertexShader(bytes.data(), bytes.size(), nullptr, &vertexShader);
-	if (result != S_OK) {
+///The other stages don't have a layout to create, so they're all the same apart from the stage
+void Shader::loadStage(WCHAR* filename, int stage, GpuShader*& out_shader, const char* kind) {
+	std::vector<char> bytes;
+	if (!readBytecode(filename, bytes, kind)) return;
+	out_shader = GLOBALS.Backend->createShader(stage, bytes.data(), bytes.size());
+	if (!out_shader) {
 		std::wstring wfilename(filename);
-		printf("Error: could not load compiled tangent vertex shader %s...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		printError(result);
-		return;
+		printf("Error: could not load compiled %s shader %s...\n", kind, std::string(wfilename.begin(), wfilename.end()).c_str());
 	}
+}
 
-	/// Create input layout -----------------------------------------------------------------------------------------------------------------------
+void Shader::loadPixelShader(WCHAR* filename) {
+	loadStage(filename, STAGE_PS, stages.pixelShader, "pixel");
+}
 
-	const D3D11_INPUT_ELEMENT_DESC layoutDesc[] = {
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float3 Position
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float2 Texcoord0
-		{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 }, // Float3 Normal
-		{ "TANGENT",  0, DXGI_FORMAT_R32G32B32_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 } // Float3 Tangent
+void Shader::loadHullShader(WCHAR* filename) {
+	loadStage(filename, STAGE_HS, stages.hullShader, "hull");
+}
+
+void Shader::loadDomainShader(WCHAR* filename) {
+	loadStage(filename, STAGE_DS, stages.domainShader, "domain");
+}
+
+void Shader::loadGeometryShader(WCHAR* filename) {
+	loadStage(filename, STAGE_GS, stages.geometryShader, "geometry");
+}
+
+//each stream has its own input slot, see STREAM_POSITION etc.
+#define POSITION_ELEMENT \
+		{ "POSITION", 0, FORMAT_R32G32B32_FLOAT, STREAM_POSITION, 0, false } // Float3 Position
+#define ATTRIBUTE_ELEMENTS \
+		{ "TEXCOORD", 0, FORMAT_R32G32_FLOAT,    STREAM_ATTRIBUTES, 0, false }, /* Float2 Texcoord0 */\
+		{ "NORMAL",   0, FORMAT_R32G32B32_FLOAT, STREAM_ATTRIBUTES, VERTEX_APPEND, false }, /* Float3 Normal */\
+		{ "TANGENT",  0, FORMAT_R32G32B32_FLOAT, STREAM_ATTRIBUTES, VERTEX_APPEND, false } /* Float3 Tangent */
+#define SKIN_ELEMENTS \
+		{ "BLENDINDICES", 0, FORMAT_R32G32B32A32_UINT,  STREAM_SKIN, 0, false }, /* Uint4 BlendIndices0 */\
+		{ "BLENDINDICES", 1, FORMAT_R32G32B32A32_UINT,  STREAM_SKIN, VERTEX_APPEND, false }, /* Uint4 BlendIndices1 */\
+		{ "BLENDWEIGHT",  0, FORMAT_R32G32B32A32_FLOAT, STREAM_SKIN, VERTEX_APPEND, false }, /* Float4 BlendWeight0 */\
+		{ "BLENDWEIGHT",  1, FORMAT_R32G32B32A32_FLOAT, STREAM_SKIN, VERTEX_APPEND, false } /* Float4 BlendWeight1 */
+#define INSTANCE_ELEMENTS \
+		{ "INSTANCE", 0, FORMAT_R32G32B32A32_FLOAT, STREAM_INSTANCE, 0, true }, /* row_major float4x4 Instance, one row each */\
+		{ "INSTANCE", 1, FORMAT_R32G32B32A32_FLOAT, STREAM_INSTANCE, VERTEX_APPEND, true },\
+		{ "INSTANCE", 2, FORMAT_R32G32B32A32_FLOAT, STREAM_INSTANCE, VERTEX_APPEND, true },\
+		{ "INSTANCE", 3, FORMAT_R32G32B32A32_FLOAT, STREAM_INSTANCE, VERTEX_APPEND, true }
+
+//DXFramework's meshes (OrthoMesh and the like) keep everything in one stream
+void Shader::loadVertexShader(WCHAR* filename) {
+	const VertexElement elements[] = {
+		{ "POSITION", 0, FORMAT_R32G32B32_FLOAT, 0, 0, false },
+		{ "TEXCOORD", 0, FORMAT_R32G32_FLOAT,    0, VERTEX_APPEND, false },
+		{ "NORMAL",   0, FORMAT_R32G32B32_FLOAT, 0, VERTEX_APPEND, false }
 	};
+	loadLayoutVertexShader(filename, elements, ARRAYSIZE(elements), "default");
+}
 
-	result = GLOBALS.Device->CreateInputLayout(layoutDesc, ARRAYSIZE(layoutDesc), bytes.data(), bytes.size(), &layout);
-	if (result != S_OK) {
-		std::wstring wfilename(filename);
-		printf("Error: could not create input layout for tangent vertex shader %s...\n", std::string(wfilename.begin(), wfilename.end()).c_str());
-		printError(result);
-		return;
-	}
+void Shader::loadColourVertexShader(WCHAR* filename) {
+	const VertexElement elements[] = {
+		{ "POSITION", 0, FORMAT_R32G32B32_FLOAT,    0, 0, false },
+		{ "COLOR",    0, FORMAT_R32G32B32A32_FLOAT, 0, VERTEX_APPEND, false }
+	};
+	loadLayoutVertexShader(filename, elements, ARRAYSIZE(elements), "colour");
+}
 
-	//Success! :D
+void Shader::loadSkinVertexShader(WCHAR * filename) {
+	const VertexElement layoutDesc[] = { POSITION_ELEMENT, ATTRIBUTE_ELEMENTS, SKIN_ELEMENTS };
+	loadLayoutVertexShader(filename, layoutDesc, ARRAYSIZE(layoutDesc), "skinning");
+	streams = STREAM_BIT(STREAM_POSITION) | STREAM_BIT(STREAM_ATTRIBUTES) | STREAM_BIT(STREAM_SKIN);
+}
+
+void Shader::loadTangentVertexShader(WCHAR * filename) {
+	const VertexElement layoutDesc[] = { POSITION_ELEMENT, ATTRIBUTE_ELEMENTS, INSTANCE_ELEMENTS };
+	loadLayoutVertexShader(filename, layoutDesc, ARRAYSIZE(layoutDesc), "tangent");
+	streams = STREAM_BIT(STREAM_POSITION) | STREAM_BIT(STREAM_ATTRIBUTES) | STREAM_BIT(STREAM_INSTANCE);
 }
 
-void Shader::printError(HRESULT errorCode){
-#define ERR(err) case err: printf(#err "\n"); return;
-	switch (errorCode) {
-		ERR(D3D11_ERROR_FILE_NOT_FOUND)
-		ERR(D3D11_ERROR_TOO_MANY_UNIQUE_STATE_OBJECTS)
-		ERR(D3D11_ERROR_TOO_MANY_UNIQUE_VIEW_OBJECTS)
-		ERR(D3D11_ERROR_DEFERRED_CONTEXT_MAP_WITHOUT_INITIAL_DISCARD)
-		ERR(DXGI_ERROR_INVALID_CALL)
-		ERR(DXGI_ERROR_WAS_STILL_DRAWING)
-		ERR(E_FAIL)
-		ERR(E_INVALIDARG)
-		ERR(E_OUTOFMEMORY)
-		ERR(E_NOTIMPL)
-		ERR(S_FALSE)
-	default:
-		printf("Unknown error\n");
+void Shader::loadPositionVertexShader(WCHAR* filename, bool skin) {
+	if (skin) {
+		const VertexElement layoutDesc[] = { POSITION_ELEMENT, SKIN_ELEMENTS };
+		loadLayoutVertexShader(filename, layoutDesc, ARRAYSIZE(layoutDesc), "skinned position only");
+		streams = STREAM_BIT(STREAM_POSITION) | STREAM_BIT(STREAM_SKIN);
+	}
+	else {
+		const VertexElement layoutDesc[] = { POSITION_ELEMENT, INSTANCE_ELEMENTS };
+		loadLayoutVertexShader(filename, layoutDesc, ARRAYSIZE(layoutDesc), "position only");
+		streams = STREAM_BIT(STREAM_POSITION) | STREAM_BIT(STREAM_INSTANCE);
 	}
-#undef ERR
 }
 
-void Shader::initShader(WCHAR* vsFilename, WCHAR* psFilename, bool skin, bool colour, bool tangent) {
+#undef POSITION_ELEMENT
+#undef ATTRIBUTE_ELEMENTS
+#undef SKIN_ELEMENTS
+#undef INSTANCE_ELEMENTS
+
+void Shader::initShader(WCHAR* vsFilename, WCHAR* psFilename, bool skin, bool colour, bool tangent, bool positionOnly) {
 
 	// Load (+ compile) shader files
-	if (skin)
+	if (positionOnly)
+		loadPositionVertexShader(vsFilename, skin);
+	else if (skin)
 		loadSkinVertexShader(vsFilename);
 	else if (tangent)
 		loadTangentVertexShader(vsFilename);
@@ -145,15 +173,8 @@ void Shader::initShader(WCHAR* vsFilename, WCHAR* psFilename, bool skin, bool co
 		loadVertexShader(vsFilename);
 	loadPixelShader(psFilename);
 
-	// Setup the description of the dynamic matrix constant buffer that is in the vertex shader.
-	D3D11_BUFFER_DESC matrixBufferDesc;
-	matrixBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-	matrixBufferDesc.ByteWidth = sizeof(MatrixBufferType);
-	matrixBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-	matrixBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-	matrixBufferDesc.MiscFlags = 0;
-	matrixBufferDesc.StructureByteStride = 0;
-	renderer->CreateBuffer(&matrixBufferDesc, NULL, &matrixBuffer);
+	// Setup the dynamic matrix constant buffer that is in the vertex shader.
+	SETUP_SHADER_BUFFER(MatrixBufferType, matrixConstants);
 
 	//If this is derived from Shader, will setup additional specific buffers
 	initBuffers();
@@ -174,48 +195,63 @@ void Shader::initGeometry(WCHAR* gsFilename) {
 	loadGeometryShader(gsFilename);
 }
 
-void Shader::setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX &worldMatrix, const XMMATRIX &viewMatrix, const XMMATRIX &projectionMatrix, XMFLOAT3 cameraPosition) {
+void Shader::bindStages(RenderDevice* device) {
+	device->setInputLayout(stages.layout);
+	device->setShader(STAGE_VS, stages.vertexShader);
+	device->setShader(STAGE_HS, stages.hullShader);
+	device->setShader(STAGE_DS, stages.domainShader);
+	device->setShader(STAGE_GS, stages.geometryShader);
+	device->setShader(STAGE_PS, stages.pixelShader);
+}
+
+void Shader::render(ID3D11DeviceContext* deviceContext, int indexCount) {
+	bindStages(GLOBALS.Backend);
+	GLOBALS.Backend->drawIndexed(indexCount);
+}
 
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void Shader::renderUnindexed(RenderDevice* device, int vertexCount, int startVertex) {
+	bindStages(device);
+	device->draw(vertexCount, startVertex);
+}
+
+void Shader::setShaderParameters(RenderDevice* device, const XMMATRIX &worldMatrix, const XMMATRIX &viewMatrix, const XMMATRIX &projectionMatrix, XMFLOAT3 cameraPosition) {
 
 	// Transpose the matrices to prepare them for the shader.
 	XMMATRIX tworld, tview, tproj;
 	tworld = XMMatrixTranspose(worldMatrix);
 	tview = XMMatrixTranspose(viewMatrix);
 	tproj = XMMatrixTranspose(projectionMatrix);
-	MatrixBufferType* dataPtr;
-	deviceContext->Map(matrixBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	dataPtr = (MatrixBufferType*)mappedResource.pData;
-	dataPtr->world = tworld;
-	dataPtr->view = tview;
-	dataPtr->projection = tproj;
-	deviceContext->Unmap(matrixBuffer, 0);
-	if (domainShader) {//if there is a domain shader, the matrices will be applied there.
-		deviceContext->DSSetConstantBuffers(0, 1, &matrixBuffer);
+	MatrixBufferType* dataPtr = (MatrixBufferType*)device->getTransientConstants()->map(device, sizeof(MatrixBufferType), matrixConstants);
+	if (dataPtr) {
+		dataPtr->world = tworld;
+		dataPtr->view = tview;
+		dataPtr->projection = tproj;
+	}
+	if (stages.domainShader) {//if there is a domain shader, the matrices will be applied there.
+		device->getTransientConstants()->unmapConstants(device, STAGE_DS, 0);
 	}
-	else if (geometryShader) {//instead if there is a geometry shader, the matrices will be applied there.
-		deviceContext->GSSetConstantBuffers(0, 1, &matrixBuffer);
+	else if (stages.geometryShader) {//instead if there is a geometry shader, the matrices will be applied there.
+		device->getTransientConstants()->unmapConstants(device, STAGE_GS, 0);
 	}
 	else {//otherwise, vertex shader it is
-		deviceContext->VSSetConstantBuffers(0, 1, &matrixBuffer);
+		device->getTransientConstants()->unmapConstants(device, STAGE_VS, 0);
 	}
 
 	//Send dynamic tessellation buffer if needed
-	if (hullShader) {
-		DynamicTessellationBufferType* dynPtr;
-		deviceContext->Map(dynamicTessellationBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-		dynPtr = (DynamicTessellationBufferType*)mappedResource.pData;
-		dynPtr->worldMatrix = tworld;
-		dynPtr->cameraPosition = cameraPosition;
-		dynPtr->oneOverFarPlane = 1 / FAR_PLANE;
-		dynPtr->tessellationMax = GLOBALS.TessellationMax;
-		dynPtr->tessellationMin = GLOBALS.TessellationMin;
-		dynPtr->tessellationRange = GLOBALS.TessellationRange <= 0 ? FLT_MAX : 1.0f/GLOBALS.TessellationRange;
-		deviceContext->Unmap(dynamicTessellationBuffer, 0);
-		deviceContext->HSSetConstantBuffers(0, 1, &dynamicTessellationBuffer);
+	if (stages.hullShader) {
+		DynamicTessellationBufferType* dynPtr = (DynamicTessellationBufferType*)device->getTransientConstants()->map(device, sizeof(DynamicTessellationBufferType), dynamicTessellationBuffer);
+		if (dynPtr) {
+			dynPtr->worldMatrix = tworld;
+			dynPtr->cameraPosition = cameraPosition;
+			dynPtr->oneOverFarPlane = 1 / FAR_PLANE;
+			dynPtr->tessellationMax = GLOBALS.TessellationMax;
+			dynPtr->tessellationMin = GLOBALS.TessellationMin;
+			dynPtr->tessellationRange = GLOBALS.TessellationRange <= 0 ? FLT_MAX : 1.0f/GLOBALS.TessellationRange;
+		}
+		device->getTransientConstants()->unmapConstants(device, STAGE_HS, 0);
 	}
 
 	// Set sampler resource in the pixel shader
-	deviceContext->PSSetSamplers(0, 1, &sampleState);
+	device->setSamplers(STAGE_PS, 0, 1, &sampler);
 
 }
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "DXF.h"
+#include "AppGlobals.h"
 #include "ExtendedLight.h"
 #include "Material.h"
+#include "TransientBuffer.h"
+#include <vector>
 
 #define SHADER_PATH "Debug/"
 
@@ -15,23 +18,28 @@
 #define SETUP_SHADER_COLOUR(vert, frag) initShader((WCHAR*)L"" SHADER_PATH #vert ".cso", (WCHAR*)L"" SHADER_PATH #frag ".cso", false, true)
 ///use SETUP_SHADER_TANGENT(default_vs, default_fs); for tangent access in shader
 #define SETUP_SHADER_TANGENT(vert, frag) initShader((WCHAR*)L"" SHADER_PATH #vert ".cso", (WCHAR*)L"" SHADER_PATH #frag ".cso", false, false, true)
+///use SETUP_SHADER_POSITION(depth_vs, depth_fs); for shaders that only read vertex positions (depth and shadow passes), so that only the position stream gets bound
+#define SETUP_SHADER_POSITION(vert, frag) initShader((WCHAR*)L"" SHADER_PATH #vert ".cso", (WCHAR*)L"" SHADER_PATH #frag ".cso", false, false, false, true)
+///same thing, for skinned shaders that only read positions and skinning data
+#define SETUP_SHADER_SKIN_POSITION(vert, frag) initShader((WCHAR*)L"" SHADER_PATH #vert ".cso", (WCHAR*)L"" SHADER_PATH #frag ".cso", true, false, false, true)
 ///use the following to also setup a hull and domain shader
 #define SETUP_TESSELATION(hull, domain) initHullDomain((WCHAR*)L"" SHADER_PATH #hull ".cso", (WCHAR*)L"" SHADER_PATH #domain ".cso")
 ///use the following to also setup a geometry shader
 #define SETUP_GEOMETRY(geom) initGeometry((WCHAR*)L"" SHADER_PATH #geom ".cso")
 
 ///use the following macro in initBuffer() to setup a shader buffer
-#define SETUP_SHADER_BUFFER(type, buffer) do{D3D11_BUFFER_DESC desc;\
-											desc.Usage = D3D11_USAGE_DYNAMIC;\
-											desc.ByteWidth = sizeof(type);\
-											desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;\
-											desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;\
-											desc.MiscFlags = 0;\
-											desc.StructureByteStride = 0;\
-											renderer->CreateBuffer(&desc, NULL, &buffer);}while(false)
+#define SETUP_SHADER_BUFFER(type, buffer) do{buffer = GLOBALS.Backend->createBuffer(sizeof(type), BUFFER_CONSTANT);}while(false)
 
 #define UNUSED_SHADER_PARAM 0
 
+//vertex streams FBX meshes are split into on import, each bound to the input slot of the same number
+#define STREAM_POSITION 0 //float3 position, 12 bytes
+#define STREAM_ATTRIBUTES 1 //uv, normal and tangent, 32 bytes
+#define STREAM_SKIN 2 //bone ids and weights, 64 bytes; skinned meshes only
+#define STREAM_INSTANCE 3 //per instance mesh to world matrix (on top of the world matrix), 64 bytes; read by the static mesh layouts, so every static mesh has one
+#define STREAM_COUNT 4
+#define STREAM_BIT(stream) (1u << (stream))
+
 #define FAR_PLANE GLOBALS.FarPlane //SCREEN_DEPTH // <-- changed because SCREEN_DEPTH is constant for some reason and its too high for this demo
 
 using namespace DirectX;
@@ -50,30 +58,75 @@ protected:
 	};
 
 public:
+	///everything render() binds before drawing; stages this shader doesn't use are null
+	struct ShaderStages {
+		GpuLayout* layout;
+		GpuShader* vertexShader;
+		GpuShader* hullShader;
+		GpuShader* domainShader;
+		GpuShader* geometryShader;
+		GpuShader* pixelShader;
+	};
+
 	Shader();
 	virtual ~Shader();
 
 	///setup the defaults parameters for any shader (matrices)
-	void setShaderParameters(ID3D11DeviceContext* deviceContext, const XMMATRIX &world, const XMMATRIX &view, const XMMATRIX &projection, XMFLOAT3 cameraPosition);
+	void setShaderParameters(RenderDevice* device, const XMMATRIX &world, const XMMATRIX &view, const XMMATRIX &projection, XMFLOAT3 cameraPosition);
+
+	///lets RenderQueue bind the stages itself, skipping the ones that are already set
+	inline const ShaderStages& getStages() { return stages; }
+	///STREAM_BIT()s of the vertex streams the input layout reads; the rest don't need binding
+	inline unsigned int getStreams() { return streams; }
+
+	///binds the stages through GLOBALS.Backend and draws whatever indices the mesh's sendData() bound; deviceContext is only there to override BaseShader's
+	void render(ID3D11DeviceContext* deviceContext, int indexCount) override;
+	///same as render(), for vertices without an index buffer
+	void renderUnindexed(RenderDevice* device, int vertexCount, int startVertex = 0);
+
+	///a compiled shader's bytes, from the asset loader if it read them ahead of time, off the disk otherwise; false (with an error printed) if there's no such file. Kind only goes into the error
+	static bool readBytecode(const wchar_t* filename, std::vector<char>& out_bytes, const char* kind);
 	
 protected:
 	///initializes the base buffers we need
 	inline void initShader(WCHAR* vsFilename, WCHAR* psFilename) override { initShader(vsFilename, psFilename, false); }//<--need this to override pure virtual in BaseShader
-	void initShader(WCHAR* vsFilename, WCHAR* psFilename, bool skin, bool colour = false, bool tangent = false);
+	void initShader(WCHAR* vsFilename, WCHAR* psFilename, bool skin, bool colour = false, bool tangent = false, bool positionOnly = false);
 	void initHullDomain(WCHAR* hsFilename, WCHAR* dsFilename);
 	void initGeometry(WCHAR* gsFilename);
 
 	///override this in deriving classes to setup additional buffers
 	inline virtual void initBuffers() = 0;
 
-	///similar to loadVertexShader(), loadColourVertexShader() and loadTextureVertexShader(), for skinned vertex shaders.
+	///same layouts as BaseShader's (position, uv and normal; or position and colour), all in one stream, but created through the backend
+	void loadVertexShader(WCHAR* filename);
+	void loadColourVertexShader(WCHAR* filename);
+	///similar to loadVertexShader() and loadColourVertexShader(), for skinned vertex shaders.
 	void loadSkinVertexShader(WCHAR* filename);
 	///same thing, for vertex shader with tangent input
 	void loadTangentVertexShader(WCHAR* filename);
+	///same thing, for vertex shaders that only take position (and skinning data, if skin is set)
+	void loadPositionVertexShader(WCHAR* filename, bool skin);
+	///loads a vertex shader and creates its input layout from elements; kind only goes into error messages
+	void loadLayoutVertexShader(WCHAR* filename, const VertexElement* elements, unsigned int count, const char* kind);
+	///same as BaseShader's, but reading the bytecode through readBytecode() and creating the stage through the backend
+	void loadPixelShader(WCHAR* filename);
+	void loadHullShader(WCHAR* filename);
+	void loadDomainShader(WCHAR* filename);
+	void loadGeometryShader(WCHAR* filename);
+	///reads filename and creates stage from it, into out_shader; kind only goes into error messages
+	void loadStage(WCHAR* filename, int stage, GpuShader*& out_shader, const char* kind);
+
+	///sets every stage, and the input layout
+	void bindStages(RenderDevice* device);
+
+	///these stand in for BaseShader's D3D11 members, which stay null
+	ShaderStages stages = {};
+	GpuBuffer* matrixConstants = nullptr;//fallback for the matrices when the transient buffer is full
+	GpuSampler* sampler = nullptr;//PS s0
 
-	static void printError(HRESULT errorCode);
+	unsigned int streams = STREAM_BIT(STREAM_POSITION) | STREAM_BIT(STREAM_ATTRIBUTES);
 
 private:
-	ID3D11Buffer* dynamicTessellationBuffer;//this will only be setup if SETUP_TESSELATION() is called!
+	GpuBuffer* dynamicTessellationBuffer = nullptr;//this will only be setup if SETUP_TESSELATION() is called!
 };
 
@@ -0,0 +1,106 @@
+#include "ShadowScheduler.h"
+
+#include <algorithm>
+#include "AppGlobals.h"
+#include "Utils.h"
+
+#define DYNAMIC_WEIGHT 3.f //how much more urgent a light gets when something moved inside of it
+#define CAMERA_WEIGHT 1.f //same, when the camera moved and the frustum has to be refitted
+#define AGE_WEIGHT 0.25f //each frame a dirty light waits makes it that much more urgent, so everyone gets a turn eventually
+#define DISTANCE_FALLOFF 20.f //lights this far from the camera count for half as much
+#define ATTENUATION_CUTOFF 64.f //a light stops mattering once attenuation divides it by this much
+
+ShadowScheduler::ShadowScheduler() {
+	XMStoreFloat4x4(&lastView, XMMatrixIdentity());
+}
+
+ShadowScheduler::~ShadowScheduler() {
+}
+
+///Rough fraction of the screen that can be lit by the light, from the sphere it reaches
+float ShadowScheduler::screenCoverage(ExtendedLight& light, float distance) {
+	if (light.getType() == DIRECTIONAL_LIGHT) return 1;
+
+	float range = Utils::attenuationRange(light.getAttenuation(), ATTENUATION_CUTOFF);
+	if (range >= FLT_MAX)
+		range = light.getShadowFar();//no falloff at all
+
+	if (distance <= range) return 1;//we're inside of it
+	return Utils::clamp((range * range) / (distance * distance), 0, 1);
+}
+
+void ShadowScheduler::schedule(ExtendedLight* lights, int numLights, XMFLOAT3 cameraPosition, const XMMATRIX& view, bool fittedFrustums, const std::vector<BoundingBox>& dynamicCasters) {
+	if (states.size() != numLights) states.resize(numLights);
+
+	//did the camera move? (fitted frustums depend on what's visible)
+	XMFLOAT4X4 currentView;
+	XMStoreFloat4x4(&currentView, view);
+	bool cameraMoved = memcmp(&currentView, &lastView, sizeof(XMFLOAT4X4)) != 0;
+	lastView = currentView;
+
+	std::vector<int> candidates;
+	for (int i = 0; i < numLights; ++i) {
+		LightState& state = states[i];
+		ExtendedLight& light = lights[i];
+		state.update = false;
+		state.priority = 0;
+		if (light.shouldBypassShadows() || light.getType() == INACTIVE_LIGHT) continue;//nothing to render, but keep its age for when it comes back
+
+		//anything that changes what the map looks like means we can't reuse it at all
+		XMFLOAT3 position = light.getPosition();
+		XMFLOAT3 direction = light.getDirection();
+		bool changed = state.type != light.getType() || state.res != light.getShadowmapRes() || state.size != light.getShadowmapSize() || state.fov != light.getProjectionFov() ||
+			memcmp(&state.position, &position, sizeof(XMFLOAT3)) != 0 || memcmp(&state.direction, &direction, sizeof(XMFLOAT3)) != 0;
+
+		//how urgent is it?
+		float dirty = 0;
+		if (changed) {
+			dirty = FLT_MAX;//always goes first
+		}
+		else {
+			for (const BoundingBox& box : dynamicCasters) {
+				if (light.affects(box)) {
+					dirty += DYNAMIC_WEIGHT;
+					break;
+				}
+			}
+			if (fittedFrustums && cameraMoved)
+				dirty += CAMERA_WEIGHT;
+		}
+		if (dirty <= 0) {//map is still good as it is
+			state.age = 0;
+			continue;
+		}
+		++state.age;
+
+		float dx = position.x - cameraPosition.x, dy = position.y - cameraPosition.y, dz = position.z - cameraPosition.z;
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+		float importance = 0.5f * screenCoverage(light, distance) + 0.5f / (1 + distance / DISTANCE_FALLOFF);
+		state.priority = changed ? FLT_MAX : dirty * importance * (1 + state.age * AGE_WEIGHT);
+		candidates.push_back(i);
+	}
+
+	//most urgent first
+	std::sort(candidates.begin(), candidates.end(), [this](int a, int b) { return states[a].priority > states[b].priority; });
+
+	//spend the budget
+	updatedLights = 0;
+	updatedTexels = 0;
+	for (int i : candidates) {
+		float texels = lights[i].getShadowmapRes() * lights[i].getShadowmapRes();
+		if (updatedLights > 0 && (updatedLights >= maxLightsPerFrame || updatedTexels + texels > maxTexelsPerFrame))
+			break;
+
+		LightState& state = states[i];
+		state.update = true;
+		state.age = 0;
+		state.position = lights[i].getPosition();
+		state.direction = lights[i].getDirection();
+		state.type = lights[i].getType();
+		state.res = lights[i].getShadowmapRes();
+		state.size = lights[i].getShadowmapSize();
+		state.fov = lights[i].getProjectionFov();
+		++updatedLights;
+		updatedTexels += texels;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+/// Decides which lights get their shadowmap re-rendered each frame, so that the cost of shadows stays bounded no matter how many lights there are.
+/// Lights that don't make the cut keep using the map (and matrices) from the last time they were rendered.
+
+#include "DXF.h"
+#include <DirectXCollision.h>
+#include <vector>
+#include "ExtendedLight.h"
+
+class ShadowScheduler {
+
+protected:
+	///What we remember about each light between frames
+	struct LightState {
+		XMFLOAT3 position;
+		XMFLOAT3 direction;
+		float type = -1;
+		float res = 0;
+		float size = 0;
+		float fov = 0;
+		int age = 0;//frames the light has been waiting for an update
+		float priority = 0;
+		bool update = false;
+	};
+
+public:
+	ShadowScheduler();
+	~ShadowScheduler();
+
+	///Budget: at most this many lights and this many shadowmap texels re-rendered per frame (at least one light always gets through)
+	int maxLightsPerFrame = 2;
+	float maxTexelsPerFrame = 2048.f * 2048.f * 2;
+
+	///Picks the lights to update this frame; dynamicCasters are the bounds of everything that can move (both where it is now and where it was last frame)
+	void schedule(ExtendedLight* lights, int numLights, XMFLOAT3 cameraPosition, const XMMATRIX& view, bool fittedFrustums, const std::vector<BoundingBox>& dynamicCasters);
+
+	///whether light i should be re-rendered this frame
+	inline bool shouldUpdate(int i) { return i < states.size() && states[i].update; }
+	///makes sure light i gets updated next time around (ie. its shadowmap got recreated)
+	inline void invalidate(int i) { if (i < states.size()) states[i].type = -1; }
+
+	///Stats for the last scheduled frame
+	inline int getUpdatedLights() { return updatedLights; }
+	inline float getUpdatedTexels() { return updatedTexels; }
+	inline int getAge(int i) { return i < states.size() ? states[i].age : 0; }
+	inline float getPriority(int i) { return i < states.size() ? states[i].priority : 0; }
+
+protected:
+	std::vector<LightState> states;
+	XMFLOAT4X4 lastView;
+	int updatedLights = 0;
+	float updatedTexels = 0;
+
+	///rough fraction of the screen lit by a light
+	float screenCoverage(ExtendedLight& light, float distance);
+
+};
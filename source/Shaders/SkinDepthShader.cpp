@@ -3,7 +3,7 @@
 
 
 SkinDepthShader::SkinDepthShader() : SkinnedShader(false) {
-	SETUP_SHADER_SKIN(skindepth_vs, depth_fs);
+	SETUP_SHADER_SKIN_POSITION(skindepth_vs, depth_fs);
 }
 
 
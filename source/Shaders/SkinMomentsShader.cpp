@@ -0,0 +1,11 @@
+#include "SkinMomentsShader.h"
+
+
+
+SkinMomentsShader::SkinMomentsShader() : SkinnedShader(false) {
+	SETUP_SHADER_SKIN_POSITION(skindepth_vs, moments_fs);
+}
+
+
+SkinMomentsShader::~SkinMomentsShader(){
+}
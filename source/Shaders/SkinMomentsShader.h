@@ -0,0 +1,10 @@
+#pragma once
+#include "SkinnedShader.h"
+
+///Same as MomentsShader, for skinned meshes
+class SkinMomentsShader : public SkinnedShader{
+public:
+	SkinMomentsShader();
+	~SkinMomentsShader();
+};
+
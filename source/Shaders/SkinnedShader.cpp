@@ -11,25 +11,23 @@ SkinnedShader::SkinnedShader(bool load){
 }
 
 SkinnedShader::~SkinnedShader(){
+	GLOBALS.Backend->releaseBuffer(boneBuffer);
 }
 
-void SkinnedShader::setBones(XMMATRIX** boneMatrices, int numBones){
+void SkinnedShader::setBones(RenderDevice* device, XMMATRIX** boneMatrices, int numBones){
 
 	if (numBones > NUM_BONES || numBones < 0) {
 		printf("Error! Cannot use %d bones, maximum is %d.\n", numBones, NUM_BONES);
 		return;
 	}
 
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-
-	BoneBufferType* bonePtr;
-	GLOBALS.DeviceContext->Map(boneBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	bonePtr = (BoneBufferType*)mappedResource.pData;
-	for (int i = 0; i < numBones; ++i) {
-		bonePtr->worldBoneTransform[i] = (*boneMatrices)[i];//note: no transposing here, it's assumed any transposition will have happened beforehand if needed (in FBXSkeleton.cpp)
-	}//Note that, for efficiency, we're not writing to whatever bones are between numBones and NUM_BONES; we're assuming the vertices will never attempt to read from that portion
-	GLOBALS.DeviceContext->Unmap(boneBuffer, 0);
-	GLOBALS.DeviceContext->VSSetConstantBuffers(2, 1, &boneBuffer);
+	BoneBufferType* bonePtr = (BoneBufferType*)device->getTransientConstants()->map(device, sizeof(BoneBufferType), boneBuffer);
+	if (bonePtr) {
+		for (int i = 0; i < numBones; ++i) {
+			bonePtr->worldBoneTransform[i] = (*boneMatrices)[i];//note: no transposing here, it's assumed any transposition will have happened beforehand if needed (in FBXSkeleton.cpp)
+		}//Note that, for efficiency, we're not writing to whatever bones are between numBones and NUM_BONES; we're assuming the vertices will never attempt to read from that portion
+	}
+	device->getTransientConstants()->unmapConstants(device, STAGE_VS, 2);
 
 }
 
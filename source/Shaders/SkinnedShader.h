@@ -13,13 +13,13 @@ public:
 	SkinnedShader(bool load = true);
 	~SkinnedShader();
 
-	void setBones(XMMATRIX** boneMatrices, int numBones);
+	void setBones(RenderDevice* device, XMMATRIX** boneMatrices, int numBones);
 
 protected:
 	void initBuffers() override;
 
 private:
-	ID3D11Buffer* boneBuffer;
+	GpuBuffer* boneBuffer = nullptr;
 
 };
 
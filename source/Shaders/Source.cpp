@@ -7,6 +7,14 @@
 
 #include "System.h"
 #include "App.h"
+#include "LightClusterBuilder.h"
+#include "PassRecorder.h"
+#include "OcclusionCuller.h"
+#include "FrameCheck.h"
+#include "HiZPyramid.h"
+#include "MeshletBuilder.h"
+#include "LodBuilder.h"
+#include "InstanceFinder.h"
 #include <random>
 #include <ctime>
 
@@ -22,6 +30,67 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR pScmdline,
 
 	srand(time(0));
 
+	//headless benchmarks, no window needed:
+	//light cluster builder: Shaders.exe -benchmark-clusters [number of lights]
+	//parallel pass recording, 6 shadow passes (one per shadowed light) over copies of the street scene tiled n x n, on the null device: Shaders.exe -benchmark-passes [n]
+	//occlusion culling of the street scene, cull rates and rasterization times: Shaders.exe -benchmark-occlusion
+	//the street drawn through the render queue onto the null device, its binds and draws checked and timed, without any D3D11 device: Shaders.exe -validate-frame
+	//hi-z pyramid and test (the cpu reference for the gpu culling shaders) against testing every pixel: Shaders.exe -validate-hiz
+	//meshlets of the street scene, how many there are and how many get culled off screen or back facing: Shaders.exe -report-meshlets
+	//levels of detail of the street scene, triangles and error per level and how long they take to build: Shaders.exe -report-lods
+	//copies of the same mesh in the street scene, and what instancing them saves: Shaders.exe -report-instances
+	const char* benchmark = strstr(pScmdline, "-benchmark-clusters");
+	const char* passBenchmark = strstr(pScmdline, "-benchmark-passes");
+	const char* occlusionBenchmark = strstr(pScmdline, "-benchmark-occlusion");
+	const char* frameValidation = strstr(pScmdline, "-validate-frame");
+	const char* hiZValidation = strstr(pScmdline, "-validate-hiz");
+	const char* meshletReport = strstr(pScmdline, "-report-meshlets");
+	const char* lodReport = strstr(pScmdline, "-report-lods");
+	const char* instanceReport = strstr(pScmdline, "-report-instances");
+	if (benchmark || passBenchmark || occlusionBenchmark || frameValidation || hiZValidation || meshletReport || lodReport || instanceReport) {
+#ifndef SHOW_CONSOLE
+		AllocConsole();
+		FILE* stream;
+		freopen_s(&stream, "conin$", "r", stdin);
+		freopen_s(&stream, "conout$", "w", stdout);
+#endif
+		if (benchmark) {
+			int numLights = 1024;
+			sscanf_s(benchmark + strlen("-benchmark-clusters"), "%d", &numLights);
+			LightClusterBuilder::benchmark(numLights, 1000);
+		}
+		if (passBenchmark) {
+			int tiles = 4;
+			sscanf_s(passBenchmark + strlen("-benchmark-passes"), "%d", &tiles);
+			FrameCheck::benchmarkPasses("res/scene/scene.fbx", 6, tiles, PASS_RECORDER_MAX_WORKERS, 200);
+		}
+		if (frameValidation)
+			FrameCheck::validate("res/scene/scene.fbx");
+		if (occlusionBenchmark || hiZValidation || meshletReport || lodReport || instanceReport) {
+			std::vector<std::vector<XMFLOAT3>> meshes;
+			FBXImportArgs fbxArgs;//same as the app's scene
+			FBXScene::Init();
+			FBXScene::loadTriangles("res/scene/scene.fbx", fbxArgs, meshes);
+			FBXScene::Release();
+			if (occlusionBenchmark)
+				OcclusionCuller::benchmark(meshes, OCCLUSION_MAX_WORKERS, 200);
+			if (hiZValidation)
+				HiZPyramid::validate(meshes, 200);
+			if (meshletReport)
+				MeshletBuilder::report(meshes);
+			if (lodReport)
+				LodBuilder::report(meshes);
+			if (instanceReport)
+				InstanceFinder::report(meshes);
+		}
+		printf("Press enter to exit.\n");
+		getchar();
+#ifndef SHOW_CONSOLE
+		FreeConsole();
+#endif
+		return 0;
+	}
+
 	//Initialize system
 	BaseApplication* app = new App();
 	System* system = new System(app, 1200, 675, true, false);
@@ -8,7 +8,7 @@ TonemappingShader::TonemappingShader(){
 
 
 TonemappingShader::~TonemappingShader(){
-	tonemappingBuffer->Release();
+	GLOBALS.Backend->releaseBuffer(tonemappingBuffer);
 }
 
 
@@ -18,13 +18,11 @@ void TonemappingShader::initBuffers() {
 	SETUP_SHADER_BUFFER(TonemappingType, tonemappingBuffer);
 }
 
-void TonemappingShader::setTonemapping(ID3D11DeviceContext* deviceContext) {
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+void TonemappingShader::setTonemapping(RenderDevice* device) {
 
 	// Send data to fragment shader
-	TonemappingType* ttPtr;
-	deviceContext->Map(tonemappingBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-	ttPtr = (TonemappingType*)mappedResource.pData;
+	TonemappingType* ttPtr = (TonemappingType*)device->map(tonemappingBuffer, false);
+	if (!ttPtr) return;
 	ttPtr->brightness = brightness;
 	ttPtr->contrast = contrast;
 	ttPtr->hue = hue;
@@ -32,7 +30,7 @@ void TonemappingShader::setTonemapping(ID3D11DeviceContext* deviceContext) {
 	ttPtr->value = value;
 	ttPtr->tonemapping = tonemapping;
 	ttPtr->exposure = exposure;
-	deviceContext->Unmap(tonemappingBuffer, 0);
-	deviceContext->PSSetConstantBuffers(0, 1, &tonemappingBuffer);
+	device->unmap(tonemappingBuffer);
+	device->setConstantBuffer(STAGE_PS, 0, tonemappingBuffer);
 
 }
\ No newline at end of file
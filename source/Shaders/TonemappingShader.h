@@ -23,7 +23,7 @@ public:
 	TonemappingShader();
 	~TonemappingShader();
 
-	void setTonemapping(ID3D11DeviceContext* deviceContext);
+	void setTonemapping(RenderDevice* device);
 
 	///Parameters
 	float tonemapping = TONEMAP_NONE;
@@ -38,7 +38,7 @@ protected:
 	void initBuffers() override;
 
 private:
-	ID3D11Buffer* tonemappingBuffer = nullptr;
+	GpuBuffer* tonemappingBuffer = nullptr;
 
 };
 
@@ -0,0 +1,130 @@
+#include "TransientBuffer.h"
+
+#include <cstdio>
+
+#define CONSTANT_ALIGNMENT 256 //constant offsets and sizes have to be multiples of 16 constants
+#define VERTEX_ALIGNMENT 16
+
+TransientBuffer::TransientBuffer(RenderDevice* device, int type, unsigned int pageSize, unsigned int maxPages) : owner(device), type(type), recorder(device->isRecorder()), allocator(pageSize, maxPages) {
+
+	if (type == BUFFER_CONSTANT) {
+		ring = device->supportsConstantOffsets();
+		if (!ring)
+			printf("Constant buffer offsets are not supported on this device; per-draw constants will use one buffer per shader instead.\n");
+	}
+}
+
+TransientBuffer::~TransientBuffer() {
+	for (GpuBuffer* page : pages)
+		owner->releaseBuffer(page);
+	for (Fence& fence : fences)
+		owner->releaseFence(fence.query);
+	for (GpuQuery* query : freeQueries)
+		owner->releaseFence(query);
+}
+
+GpuBuffer* TransientBuffer::createPage() {
+	GpuBuffer* buffer = owner->createBuffer(allocator.getPageSize(), type);
+	if (!buffer)
+		printf("Error: could not create %u byte transient buffer page.\n", allocator.getPageSize());
+	return buffer;
+}
+
+void* TransientBuffer::map(RenderDevice* device, unsigned int size, GpuBuffer* fallback) {
+	if (ring) {
+		unsigned int alignment = type == BUFFER_CONSTANT ? CONSTANT_ALIGNMENT : VERTEX_ALIGNMENT;
+		unsigned int alignedSize = (size + alignment - 1) / alignment * alignment;//constants get bound in whole blocks of 256 bytes
+		unsigned int page, offset;
+		bool fresh;
+		bool allocated = allocator.allocate(alignedSize, alignment, page, offset, fresh);
+		if (!allocated && alignedSize <= allocator.getPageSize() && !fences.empty()) {//every page is busy: wait for the gpu to catch up
+			reclaim(device, true);
+			allocated = allocator.allocate(alignedSize, alignment, page, offset, fresh);
+		}
+		if (allocated) {
+			while (pages.size() <= page) {
+				pages.push_back(createPage());
+				discarded.push_back(false);
+			}
+			bool noOverwrite = !fresh && !(recorder && !discarded[page]);
+			void* data = pages[page] ? device->map(pages[page], noOverwrite) : nullptr;
+			if (data) {
+				discarded[page] = true;
+				mappedBuffer = pages[page];
+				mappedOffset = offset;
+				mappedSize = alignedSize;
+				return (unsigned char*)data + offset;
+			}
+		}
+	}
+
+	//can't use the ring; write the whole fallback buffer instead, as it used to be done
+	if (!fallback) {
+		printf("Error: no room for %u bytes of transient data, and no fallback buffer.\n", size);
+		mappedBuffer = nullptr;
+		return nullptr;
+	}
+	++fallbacks;
+	void* data = device->map(fallback, false);
+	mappedBuffer = data ? fallback : nullptr;
+	mappedOffset = 0;
+	mappedSize = 0;//0: bind the whole buffer
+	return data;
+}
+
+void TransientBuffer::unmapConstants(RenderDevice* device, int stage, unsigned int slot) {
+	if (!mappedBuffer) return;
+	device->unmap(mappedBuffer);
+	device->setConstantBuffer(stage, slot, mappedBuffer, mappedOffset, mappedSize);
+	mappedBuffer = nullptr;
+}
+
+void TransientBuffer::unmapVertices(RenderDevice* device, unsigned int stride) {
+	if (!mappedBuffer) return;
+	device->unmap(mappedBuffer);
+	device->setVertexBuffer(mappedBuffer, stride, mappedOffset);
+	mappedBuffer = nullptr;
+}
+
+void TransientBuffer::endFrame(RenderDevice* device) {
+	if (recorder) {
+		//every page gets discarded before it's next written to, so the gpu never sees it change under it
+		allocator.retire(allocator.endFrame());
+		discarded.assign(discarded.size(), false);
+		fallbacks = 0;
+		return;
+	}
+
+	Fence fence;
+	fence.frame = allocator.endFrame();
+	if (!freeQueries.empty()) {
+		fence.query = freeQueries.back();
+		freeQueries.pop_back();
+	}
+	else {
+		fence.query = owner->createFence();
+		if (!fence.query) {
+			printf("Error: could not create transient buffer fence.\n");
+			return;
+		}
+	}
+	device->signalFence(fence.query);
+	fences.push_back(fence);
+	fallbacks = 0;
+
+	reclaim(device, false);
+}
+
+void TransientBuffer::reclaim(RenderDevice* device, bool wait) {
+	bool first = true;
+	while (!fences.empty()) {
+		Fence& fence = fences.front();
+		if (!device->fenceReached(fence.query, wait && first)) break;
+
+		allocator.retire(fence.frame);
+		freeQueries.push_back(fence.query);
+		fences.pop_front();
+		first = false;
+	}
+}
+
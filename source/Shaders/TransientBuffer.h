@@ -0,0 +1,64 @@
+#pragma once
+
+/// Per-draw data (constants, dynamic vertices) written into a few large dynamic buffers with WRITE_NO_OVERWRITE, instead of each shader Map(WRITE_DISCARD)-ing its own small buffer for every draw.
+/// Pages are handed out by RingAllocator and reclaimed through event queries once the gpu is done with the frames that used them.
+/// On a recorder, a page's first map in each command list discards it instead (that's all a deferred context allows), which renames it, so pages never wait on a fence there.
+/// Binding constants at an offset needs D3D11.1 (see RenderDevice::supportsConstantOffsets()); without it, constants go through the fallback buffer each caller still owns.
+
+#include <deque>
+#include <vector>
+#include "RenderDevice.h"
+#include "RingAllocator.h"
+
+class TransientBuffer {
+
+protected:
+	///a frame that's been submitted, and the query that tells when the gpu is done with it
+	struct Fence {
+		unsigned long long frame;
+		GpuQuery* query;
+	};
+
+public:
+	///type is either BUFFER_CONSTANT or BUFFER_VERTEX (constant buffers can't share a buffer with anything else)
+	TransientBuffer(RenderDevice* device, int type, unsigned int pageSize, unsigned int maxPages);
+	~TransientBuffer();
+
+	///Returns somewhere to write size bytes to, until the matching unmap call. Falls back to mapping fallback (with WRITE_DISCARD) if the ring can't be used.
+	void* map(RenderDevice* device, unsigned int size, GpuBuffer* fallback);
+	///finishes the last map() and binds the range as a constant buffer
+	void unmapConstants(RenderDevice* device, int stage, unsigned int slot);
+	///finishes the last map() and binds the range as vertex buffer 0
+	void unmapVertices(RenderDevice* device, unsigned int stride);
+
+	///call once all of the frame's draws have been issued; also reclaims pages from frames the gpu has finished. On a recorder, call after each finishRecording() instead
+	void endFrame(RenderDevice* device);
+
+	inline bool usesRing() { return ring; }
+	inline RingAllocator& getAllocator() { return allocator; }
+	inline unsigned int getFallbacks() { return fallbacks; }//maps that went through the fallback buffer this frame
+	inline unsigned int getPendingFrames() { return (unsigned int)fences.size(); }
+
+protected:
+	RenderDevice* owner;//creates and releases pages and fences
+	int type;
+	bool ring = true;//false if offsets can't be used for this kind of buffer on this device
+	bool recorder;
+	std::vector<bool> discarded;//per page, on a recorder: whether it's been mapped since the last endFrame()
+	RingAllocator allocator;
+	std::vector<GpuBuffer*> pages;
+	std::deque<Fence> fences;
+	std::vector<GpuQuery*> freeQueries;
+
+	//what the last map() went to
+	GpuBuffer* mappedBuffer = nullptr;
+	unsigned int mappedOffset = 0;
+	unsigned int mappedSize = 0;
+
+	unsigned int fallbacks = 0;
+
+	///retires every frame whose query has signalled; if wait is set, blocks until at least the oldest one has
+	void reclaim(RenderDevice* device, bool wait);
+	GpuBuffer* createPage();
+
+};
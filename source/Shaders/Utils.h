@@ -4,6 +4,7 @@
 #include <string>
 #include <sstream>
 #include "DXF.h"
+#include <DirectXCollision.h>
 #include <fbxsdk.h>
 
 #define PI 3.14159265f
@@ -109,6 +110,27 @@ public:
 		printf("[ %f , %f , %f , %f ]\n", f._41, f._42, f._43, f._44);
 	}
 
+	///intersection of two axis aligned boxes; returns false if they don't overlap at all
+	static inline bool intersect(const BoundingBox& a, const BoundingBox& b, BoundingBox& out_result) {
+		XMVECTOR min = XMVectorMax(XMVectorSubtract(XMLoadFloat3(&a.Center), XMLoadFloat3(&a.Extents)), XMVectorSubtract(XMLoadFloat3(&b.Center), XMLoadFloat3(&b.Extents)));
+		XMVECTOR max = XMVectorMin(XMVectorAdd(XMLoadFloat3(&a.Center), XMLoadFloat3(&a.Extents)), XMVectorAdd(XMLoadFloat3(&b.Center), XMLoadFloat3(&b.Extents)));
+		if (!XMVector3LessOrEqual(min, max)) return false;
+		BoundingBox::CreateFromPoints(out_result, min, max);
+		return true;
+	}
+
+	///distance at which a light's attenuation (constant, linear, quadratic) divides it by cutoff; FLT_MAX if it never does
+	static inline float attenuationRange(const XMFLOAT4& attenuation, float cutoff) {
+		//solve constant + linear*d + quadratic*d^2 = cutoff
+		float c = attenuation.x - cutoff;
+		if (c >= 0) return 0;//already too dim at the light itself
+		if (attenuation.z > 0)
+			return (-attenuation.y + sqrtf(attenuation.y * attenuation.y - 4 * attenuation.z * c)) / (2 * attenuation.z);
+		if (attenuation.y > 0)
+			return -c / attenuation.y;
+		return FLT_MAX;//no falloff at all
+	}
+
 	///rng between two floats
 	static inline float random(float min, float max) {
 		return float(rand() % 1000) / 1000.f * (max - min) + min;
@@ -0,0 +1,74 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool() {
+}
+
+WorkerPool::~WorkerPool() {
+	stopThreads();
+}
+
+void WorkerPool::setWorkers(int count) {
+	if (count < 1) count = 1;
+	if (count == workers) return;
+
+	stopThreads();
+	workers = count;
+	//new threads start from the current batch, so that they don't mistake the last run() for one they still have to do
+	unsigned long long current;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = false;
+		current = batch;
+	}
+	for (int i = 1; i < workers; ++i)
+		threads.push_back(std::thread(&WorkerPool::workerLoop, this, i, current));
+}
+
+void WorkerPool::stopThreads() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		quit = true;
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+void WorkerPool::run(const std::function<void(int)>& work) {
+	if (workers == 1) {
+		work(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->work = &work;
+		finished = 0;
+		++batch;
+	}
+	wake.notify_all();
+	work(0);
+	std::unique_lock<std::mutex> guard(lock);
+	done.wait(guard, [this] { return finished == workers - 1; });
+	this->work = nullptr;
+}
+
+void WorkerPool::workerLoop(int index, unsigned long long seen) {
+	while (true) {
+		const std::function<void(int)>* current;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			wake.wait(guard, [this, seen] { return quit || batch != seen; });
+			if (quit) return;
+			seen = batch;
+			current = work;
+		}
+		(*current)(index);
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			++finished;
+		}
+		done.notify_one();
+	}
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+/// A few threads that sit waiting until run() hands them something to do, then all do it alongside the calling thread, which returns once every one is done.
+/// What each one does is up to the work itself (usually taking items off a shared atomic counter until there are none left); the pool only hands it over.
+/// Shared by PassRecorder (a pass per item) and OcclusionCuller (a band per item). Only relies on std::thread, so it builds anywhere (see tests/CMakeLists.txt).
+
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class WorkerPool {
+
+public:
+	WorkerPool();
+	///waits for the threads to finish whatever they're on
+	~WorkerPool();
+
+	///how many threads run() uses, calling thread included; at least 1
+	void setWorkers(int count);
+	inline int getWorkers() { return workers; }
+
+	///calls work on every worker, with its index (0 for the calling thread, which always gets one), and returns once they've all returned
+	void run(const std::function<void(int)>& work);
+
+protected:
+	std::vector<std::thread> threads;//one less than workers
+	int workers = 1;
+
+	const std::function<void(int)>* work = nullptr;//the current batch's; run() keeps it alive until every thread is done with it
+	std::mutex lock;
+	std::condition_variable wake, done;
+	unsigned long long batch = 0;//goes up once per run()
+	int finished = 0;//threads done with the current batch
+	bool quit = false;
+
+	///runs every batch after seen, as the index'th worker
+	void workerLoop(int index, unsigned long long seen);
+	void stopThreads();
+
+};
@@ -0,0 +1,256 @@
+#include "WorldStreamer.h"
+
+#include <algorithm>
+#include <fstream>
+
+WorldStreamer::WorldStreamer(const std::string& indexFile) {
+	root = new SceneNode;
+	folder = indexFile.substr(0, indexFile.find_last_of('/') + 1);
+
+	std::ifstream input(indexFile, std::ios::binary);
+	unsigned int header[2];//version, cells
+	unsigned long long key;
+	BoundingBox sceneBounds;
+	if (!input.read((char*)header, sizeof(header)) || header[0] != CELL_CACHE_VERSION || !input.read((char*)&key, sizeof(key)) || !input.read((char*)&sceneBounds, sizeof(sceneBounds))) {
+		printf("Error: could not read cell index %s.\n", indexFile.c_str());
+		return;
+	}
+	std::vector<StreamCellEntry> entries(header[1]);
+	if (entries.empty() || !input.read((char*)&entries[0], sizeof(StreamCellEntry) * entries.size())) {
+		printf("Error: cell index %s is broken.\n", indexFile.c_str());
+		return;
+	}
+
+	//every block is a copy of the street, side by side with the first one, which is where the street itself is
+	cells.resize(entries.size() * STREAM_BLOCKS * STREAM_BLOCKS);
+	size_t c = 0;
+	for (int x = 0; x < STREAM_BLOCKS; ++x) {
+		for (int z = 0; z < STREAM_BLOCKS; ++z) {
+			XMFLOAT3 offset = XMFLOAT3(x * sceneBounds.Extents.x * 2, 0, z * sceneBounds.Extents.z * 2);
+			for (const StreamCellEntry& entry : entries) {
+				Cell& cell = cells[c++];
+				cell.file = cellFile(entry.coords);
+				cell.bounds = entry.bounds;
+				cell.bounds.Center.x += offset.x;
+				cell.bounds.Center.z += offset.z;
+				cell.offset = offset;
+				cell.gpuBytes = (size_t)entry.gpuBytes;
+			}
+		}
+	}
+
+	loader = std::thread(&WorldStreamer::loaderLoop, this);
+}
+
+WorldStreamer::~WorldStreamer() {
+	if (loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			quit = true;
+		}
+		wake.notify_all();
+		loader.join();
+	}
+	for (Cell& cell : cells)
+		drop(cell);
+	delete root;
+}
+
+std::string WorldStreamer::cellFile(const int coords[3]) {
+	return std::to_string(coords[0]) + "_" + std::to_string(coords[1]) + "_" + std::to_string(coords[2]) + ".cell";
+}
+
+///Takes the closest queued cell, and reads it without the lock held
+void WorldStreamer::loaderLoop() {
+	std::unique_lock<std::mutex> guard(lock);
+	while (true) {
+		wake.wait(guard, [this]() { return quit || !loadQueue.empty(); });
+		if (quit) return;
+		Cell& cell = cells[loadQueue.front()];
+		loadQueue.pop_front();
+		cell.state = CELL_LOADING;
+		std::string file = folder + cell.file;
+
+		guard.unlock();
+		std::vector<CookedMesh>* cooked = new std::vector<CookedMesh>;
+		size_t bytes = readCell(file, *cooked);
+		if (!bytes) {
+			printf("Error: could not read cell %s.\n", file.c_str());
+			delete cooked;
+			cooked = nullptr;
+		}
+		guard.lock();
+
+		bytesRead += bytes;
+		cell.cooked = cooked;
+		cell.state = CELL_LOADED;
+	}
+}
+
+size_t WorldStreamer::readCell(const std::string& file, std::vector<CookedMesh>& out_meshes) {
+	std::ifstream input(file, std::ios::binary | std::ios::ate);
+	if (!input) return 0;
+	size_t size = (size_t)input.tellg();
+	input.seekg(0);
+	unsigned int header[2];//version, meshes
+	if (!input.read((char*)header, sizeof(header)) || header[0] != CELL_CACHE_VERSION) return 0;
+	out_meshes.resize(header[1]);
+	for (CookedMesh& mesh : out_meshes)
+		if (!mesh.read(input)) return 0;
+	return size;
+}
+
+void WorldStreamer::drop(Cell& cell) {
+	if (!cell.meshes.empty()) changed.push_back(cell.bounds);
+	for (FBXMesh* mesh : cell.meshes)
+		delete mesh;
+	cell.meshes.clear();
+	cell.worlds.clear();
+	if (cell.cooked) {
+		delete cell.cooked;
+		cell.cooked = nullptr;
+	}
+	cell.state = CELL_UNLOADED;
+}
+
+///How far a point is from the closest point of a box; 0 inside it
+static float distanceTo(const BoundingBox& box, FXMVECTOR point) {
+	XMVECTOR outside = XMVectorMax(XMVectorAbs(point - XMLoadFloat3(&box.Center)) - XMLoadFloat3(&box.Extents), XMVectorZero());
+	return XMVectorGetX(XMVector3Length(outside));
+}
+
+void WorldStreamer::update(const XMFLOAT3& cameraPosition, float dt, RenderDevice* device) {
+	if (cells.empty()) return;
+
+	//where the camera is, in the streamer's space, and where it's heading
+	XMVECTOR eye = XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), XMMatrixInverse(nullptr, XMLoadFloat4x4(&root->getWorld())));
+	if (hasEye && dt > 0)//smoothed, so that a single long frame doesn't throw it off
+		XMStoreFloat3(&velocity, XMVectorLerp(XMLoadFloat3(&velocity), (eye - XMLoadFloat3(&lastEye)) / dt, STREAM_VELOCITY_SMOOTHING));
+	XMStoreFloat3(&lastEye, eye);
+	hasEye = true;
+	XMVECTOR ahead = eye + XMLoadFloat3(&velocity) * STREAM_LOOKAHEAD;
+
+	std::vector<size_t> order(cells.size());
+	for (size_t i = 0; i < cells.size(); ++i) {
+		order[i] = i;
+		cells[i].distance = (std::min)(distanceTo(cells[i].bounds, eye), distanceTo(cells[i].bounds, ahead));
+	}
+	std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return cells[a].distance < cells[b].distance; });
+
+	size_t budgetBytes = (size_t)budget * 1024 * 1024;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		//let go of what's too far to keep; cells being read get dropped once they're loaded
+		for (Cell& cell : cells)
+			if (cell.distance > radius * STREAM_HYSTERESIS && cell.state != CELL_LOADING)
+				drop(cell);
+
+		//what's resident, or on its way
+		size_t committed = 0;
+		for (Cell& cell : cells)
+			if (cell.state != CELL_UNLOADED) committed += cell.gpuBytes;
+
+		//closest first; a cell only pushes out the furthest ones if they're further than it by the hysteresis factor, and everything after one that can't fit is further still
+		for (size_t i : order) {
+			Cell& cell = cells[i];
+			if (cell.distance > radius) break;
+			if (cell.state != CELL_UNLOADED) continue;
+			for (size_t j = order.size(); j-- > 0 && committed + cell.gpuBytes > budgetBytes;) {
+				Cell& furthest = cells[order[j]];
+				if (furthest.distance <= cell.distance * STREAM_HYSTERESIS) break;
+				if (furthest.state == CELL_UNLOADED || furthest.state == CELL_LOADING) continue;
+				committed -= furthest.gpuBytes;
+				drop(furthest);
+			}
+			if (committed + cell.gpuBytes > budgetBytes) break;
+			cell.state = CELL_QUEUED;
+			committed += cell.gpuBytes;
+		}
+		loadQueue.clear();
+		for (size_t i : order)
+			if (cells[i].state == CELL_QUEUED) loadQueue.push_back(i);
+
+		//upload the closest of what the loader has read
+		int uploads = 0;
+		for (size_t i : order) {
+			Cell& cell = cells[i];
+			if (cell.state != CELL_LOADED) continue;
+			if (cell.distance > radius * STREAM_HYSTERESIS) {
+				drop(cell);//it got too far while it was being read
+				continue;
+			}
+			if (uploads == STREAM_UPLOADS_PER_FRAME) continue;
+			if (cell.cooked) {
+				XMMATRIX block = XMMatrixTranslation(cell.offset.x, cell.offset.y, cell.offset.z);
+				for (CookedMesh& cooked : *cell.cooked) {
+					cell.worlds.push_back(XMFLOAT4X4());
+					XMStoreFloat4x4(&cell.worlds.back(), XMLoadFloat4x4(&cooked.world) * block);
+					cell.meshes.push_back(new FBXMesh(cooked, device));
+				}
+				delete cell.cooked;
+				cell.cooked = nullptr;
+				bytesUploaded += cell.gpuBytes;
+				changed.push_back(cell.bounds);
+			}
+			cell.state = CELL_RESIDENT;
+			++uploads;
+		}
+
+		residentCount = pendingCount = 0;
+		residentBytes = 0;
+		for (Cell& cell : cells) {
+			if (cell.state == CELL_RESIDENT) {
+				++residentCount;
+				if (!cell.meshes.empty()) residentBytes += cell.gpuBytes;
+			}
+			else if (cell.state != CELL_UNLOADED) ++pendingCount;
+		}
+
+		rateTime += dt;
+		if (rateTime >= 1) {
+			readRate = bytesRead / rateTime;
+			uploadRate = bytesUploaded / rateTime;
+			bytesRead = bytesUploaded = 0;
+			rateTime = 0;
+		}
+	}
+	wake.notify_one();
+}
+
+///Only cells as a whole get culled here; batches and instances inside them get culled by the queue
+void WorldStreamer::submit(RenderQueue* queue, LitShader* shader, int top, OcclusionCuller* culler) {
+	XMMATRIX rootWorld = XMLoadFloat4x4(&root->getWorld());
+	for (Cell& cell : cells) {
+		if (cell.meshes.empty()) continue;//only ever touched on this thread, so no need for the lock
+		if (culler) {
+			BoundingBox bounds;
+			cell.bounds.Transform(bounds, rootWorld);
+			if (!culler->isVisible(bounds)) continue;
+		}
+		for (size_t m = 0; m < cell.meshes.size(); ++m)
+			queue->submit(shader, cell.meshes[m], XMLoadFloat4x4(&cell.worlds[m]) * rootWorld, top);
+	}
+}
+
+void WorldStreamer::getBounds(std::vector<BoundingBox>& out_bounds, float padding) {
+	XMMATRIX rootWorld = XMLoadFloat4x4(&root->getWorld());
+	for (Cell& cell : cells) {
+		if (cell.meshes.empty()) continue;
+		BoundingBox bounds;
+		cell.bounds.Transform(bounds, rootWorld);
+		bounds.Extents.x += padding;
+		bounds.Extents.y += padding;
+		bounds.Extents.z += padding;
+		out_bounds.push_back(bounds);
+	}
+}
+
+void WorldStreamer::takeChangedBounds(std::vector<BoundingBox>& out_bounds) {
+	XMMATRIX rootWorld = XMLoadFloat4x4(&root->getWorld());
+	for (const BoundingBox& bounds : changed) {
+		out_bounds.push_back(BoundingBox());
+		bounds.Transform(out_bounds.back(), rootWorld);
+	}
+	changed.clear();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/// Streams the cells FBXScene::cookCells() wrote in and out around the camera, so that only what's near it ever takes up memory on the gpu.
+/// There's only the one street, so its cells get tiled STREAM_BLOCKS times along x and along z into a city; each copy is a cell of its own, streamed as if it came from a different block.
+/// Cells within radius of the camera, or of where it'll be STREAM_LOOKAHEAD seconds from now, get queued closest first, as long as they fit in the budget;
+/// they're only let go of once further than radius by the hysteresis factor, or to make room for a cell that much closer, so that cells along the edge don't keep coming and going.
+/// Files get read and decoded on a loader thread of its own; update() uploads what it has read, a few cells a frame.
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "FBXMesh.h"
+#include "RenderQueue.h"
+#include "SceneNode.h"
+
+using namespace DirectX;
+
+#define STREAM_BLOCKS 4 //the city is this many copies of the street along x, and as many along z
+#define STREAM_HYSTERESIS 1.25f //cells are kept until this much further out than they get loaded from
+#define STREAM_LOOKAHEAD 1.5f //seconds; cells get loaded around where the camera is heading, as well as where it is
+#define STREAM_VELOCITY_SMOOTHING 0.1f //how much of each frame's camera velocity goes into the one the lookahead uses
+#define STREAM_UPLOADS_PER_FRAME 2 //cells uploaded in a single update(), so that a burst of them doesn't stall a frame
+
+#define CELL_UNLOADED 0
+#define CELL_QUEUED 1 //waiting for the loader thread
+#define CELL_LOADING 2 //being read by the loader thread
+#define CELL_LOADED 3 //read, waiting to be uploaded
+#define CELL_RESIDENT 4 //uploaded, and drawn
+
+///a cell as the index lists it, after its header: version, cell count, scene key, and the bounds of the whole scene
+struct StreamCellEntry {
+	int coords[3];//which STREAM_CELL_SIZE cube it is
+	BoundingBox bounds;//of its meshes, relative to the scene's root
+	unsigned long long gpuBytes;
+};
+
+class WorldStreamer {
+
+protected:
+	struct Cell {
+		std::string file;
+		BoundingBox bounds;//in the streamer's space, block included
+		XMFLOAT3 offset;//of its block
+		size_t gpuBytes;
+		int state = CELL_UNLOADED;
+		float distance = 0;//to the camera, or where it's heading, whichever is closer; as of the last update()
+		std::vector<CookedMesh>* cooked = nullptr;//what the loader read, until it gets uploaded; null if the file was broken
+		std::vector<FBXMesh*> meshes;
+		std::vector<XMFLOAT4X4> worlds;//each mesh's, in the streamer's space
+	};
+
+public:
+	///reads a cell index written by FBXScene::cookCells(); nothing gets loaded until update()
+	WorldStreamer(const std::string& indexFile);
+	~WorldStreamer();
+
+	///the file a cell's meshes are in, next to the index
+	static std::string cellFile(const int coords[3]);
+
+	///where the city goes; hang it wherever the scene it was cooked from is
+	inline SceneNode* getRoot() { return root; }
+
+	///queues and drops cells around the camera, in world space, and uploads some of the ones the loader has read since; the root's world should be up to date
+	void update(const XMFLOAT3& cameraPosition, float dt, RenderDevice* device);
+	///adds every resident mesh to a render queue, to be drawn on its next flush; with a culler, cells it can't see are left out
+	void submit(RenderQueue* queue, LitShader* shader, int top = TOPOLOGY_TRIANGLELIST, OcclusionCuller* culler = nullptr);
+	///appends the world space bounds of each resident cell to out_bounds, grown by padding on all sides
+	void getBounds(std::vector<BoundingBox>& out_bounds, float padding = 0);
+	///appends the world space bounds of the cells that were uploaded or dropped since the last call, for shadows to be redrawn over them
+	void takeChangedBounds(std::vector<BoundingBox>& out_bounds);
+
+	///cells get loaded within radius, as long as what's resident or on its way stays within budget megabytes
+	float radius = 60;
+	int budget = 64;
+
+	inline bool isValid() { return !cells.empty(); }
+	inline int getCellCount() { return (int)cells.size(); }
+	inline int getResidentCount() { return residentCount; }
+	///cells queued, being read, or waiting to be uploaded
+	inline int getPendingCount() { return pendingCount; }
+	inline size_t getResidentBytes() { return residentBytes; }
+	///bytes a second, over the last second or so: read off disk, and uploaded to the gpu
+	inline float getReadRate() { return readRate; }
+	inline float getUploadRate() { return uploadRate; }
+
+protected:
+	std::string folder;
+	std::vector<Cell> cells;
+	SceneNode* root;
+
+	//the camera, in the streamer's space
+	XMFLOAT3 lastEye = XMFLOAT3(0, 0, 0), velocity = XMFLOAT3(0, 0, 0);
+	bool hasEye = false;
+
+	//hands cells to the loader thread; cell states, and what it read, are only touched with the lock held
+	std::thread loader;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::deque<size_t> loadQueue;//closest first
+	bool quit = false;
+
+	int residentCount = 0, pendingCount = 0;
+	size_t residentBytes = 0;
+	size_t bytesRead = 0, bytesUploaded = 0;//since the rates were last worked out
+	float rateTime = 0, readRate = 0, uploadRate = 0;
+	std::vector<BoundingBox> changed;//cells uploaded or dropped, in the streamer's space
+
+	void loaderLoop();
+	///reads every mesh in a cell file; returns the file's size, or 0 if it couldn't be read
+	static size_t readCell(const std::string& file, std::vector<CookedMesh>& out_meshes);
+	///back to CELL_UNLOADED, from anything but CELL_LOADING; with the lock held
+	void drop(Cell& cell);
+
+};
@@ -16,7 +16,7 @@ cbuffer ColourGrading : register(b0) {
 	float vignette;//0: no vignette to 1: full vignette
 	float chromaticAberrationStrength;//0..1
 	float chromaticAberrationDistance;//0..1
-	float2 pad;
+	float2 depthParams;//x: projection _33, y: projection _43 / far plane
 }
 
 struct FS_IN {
@@ -74,7 +74,7 @@ float4 main(FS_IN input) : SV_TARGET{
 	color = lerp(color, float3(red, color.g, blue), chromaticAberrationStrength);
 
 	// Quadratic fog
-	float depth = 1.0f-depthTexture.Sample(Sampler0, input.tex).r;//0 at NEAR, 1 at FAR
+	float depth = saturate(depthParams.y / (depthTexture.Sample(Sampler0, input.tex).r - depthParams.x));//view depth over the far plane, from the scene's depth buffer: 0 at NEAR, 1 at FAR
 	color = lerp(color, fogColour, depth * depth);
 
 	// Vignette
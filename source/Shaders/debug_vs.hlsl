@@ -1,4 +1,4 @@
-///This shader simply converts a position; no normals or uvs.
+///Debug lines: transforms a position, passes its colour on to color_fs.
 
 cbuffer MatrixBuffer : register(b0) {
 	matrix worldMatrix;
@@ -8,19 +8,21 @@ cbuffer MatrixBuffer : register(b0) {
 
 struct VS_IN {
 	float3 position : POSITION;
+	float4 color : COLOR;
 };
 
 struct VS_OUT {
 	float4 position : SV_POSITION;
+	float4 color : COLOR;
 };
 
-VS_OUT main(VS_IN input) : SV_POSITION {
+VS_OUT main(VS_IN input) {
 	VS_OUT output;
 
-	// Calculate the position of the vertex against the world, view, and projection matrices.
 	float4 worldPosition = mul(float4(input.position, 1), worldMatrix);
 	output.position = mul(worldPosition, viewMatrix);
 	output.position = mul(output.position, projectionMatrix);
+	output.color = input.color;
 
 	return output;
-}
\ No newline at end of file
+}
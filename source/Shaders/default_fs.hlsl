@@ -1,6 +1,26 @@
 //default fragment shader: compute lighting and sample texture
 
-#define NUM_LIGHTS 8 //maximum number of lines in the scene - doesn't mean they're all necessarily active though
+#define NUM_LIGHTS 8 //number of shadowmap slots; the lights themselves come from the cluster lists, as many as needed
+
+#define PCF_TAPS 4 //comparison taps per shadowed light: 1, 4, 9 or 16 - each tap already filters 2x2 texels, so 4 taps cover the same 4x4 area the old 16 point samples did
+#if PCF_TAPS == 1
+#define PCF_SIDE 1
+#elif PCF_TAPS == 4
+#define PCF_SIDE 2
+#elif PCF_TAPS == 9
+#define PCF_SIDE 3
+#elif PCF_TAPS == 16
+#define PCF_SIDE 4
+#else
+#error PCF_TAPS must be 1, 4, 9 or 16
+#endif
+
+#define VSM_MIN_VARIANCE 0.00002f //keeps Chebyshev's bound stable on flat, fully lit surfaces
+#define VSM_BLEED_REDUCTION 0.2f //shadow amounts below this are clamped to full shadow, hides light bleeding where casters overlap
+
+//shadowmap modes
+#define SHADOWMAP_PCF 1
+#define SHADOWMAP_VSM 2
 
 //light types
 #define INACTIVE_LIGHT 0
@@ -18,15 +38,29 @@
 
 Texture2D texDiffuse : register(t0);//albedo texture
 Texture2D texNormalMap : register(t1);//normal map
-Texture2D shadowMap[NUM_LIGHTS] : register(t2);//one shadowmap per light
+Texture2D shadowMap[NUM_LIGHTS] : register(t2);//one shadowmap per slot
 SamplerState sampler0 : register(s0);
+SamplerComparisonState shadowSampler : register(s1);
+SamplerState vsmSampler : register(s2);//trilinear, for prefiltered variance shadowmaps
+
+//must match ClusteredLight in LightClusterBuilder.h
+struct Light {
+	float3 position;
+	float type;//POINT_LIGHT, DIRECTIONAL_LIGHT or SPOTLIGHT
+	float3 direction;//normalized
+	int shadowSlot;//which shadowmap to read, -1 for none
+	float3 colour;
+	float range;
+	float3 attenuation;//constant - linear - quadratic
+	float padding;
+};
+StructuredBuffer<Light> lights : register(t10);//every active light this frame
+Buffer<uint2> clusters : register(t11);//per cluster: offset into lightIndices, number of lights
+Buffer<uint> lightIndices : register(t12);
 
 cbuffer LightBuffer : register(b0){
 	float4 ambient;//unused alpha
-	float4 diffuse[NUM_LIGHTS];//unused alpha
-	float4 lightPosition[NUM_LIGHTS];//w is type (INACTIVE_LIGHT, POINT_LIGHT, DIRECTIONAL_LIGHT or SPOTLIGHT)
-	float4 lightDirection[NUM_LIGHTS];//unused w
-	float4 attenuation[NUM_LIGHTS];//constant - linear - quadratic - shadowmap mode (0 for no shadows, 1 for shadows)
+	float4 shadowParams[NUM_LIGHTS];//per shadowmap slot: 1 / the distance covered by the shadowmap - shadowmap mode (0 for no shadows, else SHADOWMAP_PCF or SHADOWMAP_VSM) - texel size at distance 1 (perspective) - texel size (orthographic)
 	float oneOverFarPlane;
 	float shadowmapBias;
 	float showShadowmapErrors;//if 1, shows red where shadowmaps dont extend far enough
@@ -40,6 +74,14 @@ cbuffer MaterialBuffer : register(b1) {
 	float specularPower;
 }
 
+cbuffer ClusterBuffer : register(b2) {
+	matrix clusterViewProjection;//camera the clusters were built for
+	float3 clusterGrid;//tiles x - tiles y - depth slices
+	float sliceScale;//depth slice = log(view depth) * sliceScale + sliceBias
+	float sliceBias;
+	float3 clusterPadding;
+}
+
 
 struct FS_IN{
 	float4 position : SV_POSITION;
@@ -90,6 +132,56 @@ float4 calculateLighting(float3 lightDirection, float3 normal, float3 binormal,
 	return float4(colour.rgb, 1);
 }
 
+//Variance shadowmaps: upper bound on the fraction of the filtered area that is lit at this depth
+float chebyshevUpperBound(float2 moments, float depth) {
+	if (depth <= moments.x) return 1;//in front of the average occluder
+	float variance = max(moments.y - moments.x * moments.x, VSM_MIN_VARIANCE);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+	return saturate((pMax - VSM_BLEED_REDUCTION) / (1 - VSM_BLEED_REDUCTION));
+}
+
+//How lit (0..1) a fragment is according to one shadowmap; -1 where the shadowmap doesn't reach and errors should be shown
+float shadowAmount(Texture2D map, float4 lightViewPos, float4 params, float dist, float fragmentSize) {
+	if (params.y == 0) return 1;//no shadows from this slot
+
+	//Compute projected uvs
+	float2 pTexCoord = lightViewPos.xy / lightViewPos.w;
+	pTexCoord *= float2(0.5f, -0.5f);
+	pTexCoord += float2(0.5f, 0.5f);
+
+	//if uvs are outside 0..1 range or we're past the shadowmap's reach, there's nothing to read
+	if (pTexCoord.x < 0 || pTexCoord.x > 1 || pTexCoord.y < 0 || pTexCoord.y > 1 || dist * params.x > 1)
+		return showShadowmapErrors == 1 ? -1 : 1;
+
+	if (params.y == SHADOWMAP_VSM) {
+		//Variance shadowmap: the moments are already blurred and mipmapped, so one filtered fetch is all we need
+		//no gradients inside the cluster loop, so pick the mip from how many shadowmap texels the fragment covers
+		float lod = log2(max(fragmentSize / (params.z * dist + params.w), 1));
+		float2 moments = map.SampleLevel(vsmSampler, pTexCoord, lod).rg;
+		return chebyshevUpperBound(moments, dist * params.x - shadowmapBias);
+	}
+
+	//Compare to distance to light
+	float lightDepthValue = 1 - dist * params.x;
+	//add bias
+	lightDepthValue += shadowmapBias;
+
+	//Soft shadows: a grid of bilinear comparison taps, 2 texels apart so each one covers a new 2x2 block
+	float shadow = 0;
+	[unroll] for (int y = 0; y < PCF_SIDE; ++y) {
+		[unroll] for (int x = 0; x < PCF_SIDE; ++x) {
+			float2 offset = (float2(x, y) - (PCF_SIDE - 1) * 0.5f) * 2.0f * oneOverShadowmapSize;
+			//the hardware does the comparison (and blends the 4 results) for us
+			shadow += map.SampleCmpLevelZero(shadowSampler, pTexCoord + offset, lightDepthValue);
+		}
+	}
+	return shadow / PCF_TAPS;
+}
+
+//resource arrays can't be indexed with a dynamic index, so each shadowmap slot gets its own case
+#define SHADOW_SLOT(slot) case slot: shadow = shadowAmount(shadowMap[slot], input.lightViewPos[slot], shadowParams[slot], dist, fragmentSize); break;
+
 #pragma endregion Lighting
 
 
@@ -106,91 +198,75 @@ float4 main(FS_IN input) : SV_TARGET {
 	tangentSpaceNormal -= 1.0f;
 	tangentSpaceNormal = normalize(tangentSpaceNormal);
 
+	//find which cluster this fragment falls in
+	float4 clusterPosition = mul(float4(input.worldPosition, 1), clusterViewProjection);
+	uint3 cluster;
+	cluster.x = (uint)clamp((clusterPosition.x / clusterPosition.w * 0.5f + 0.5f) * clusterGrid.x, 0, clusterGrid.x - 1);
+	cluster.y = (uint)clamp((0.5f - clusterPosition.y / clusterPosition.w * 0.5f) * clusterGrid.y, 0, clusterGrid.y - 1);
+	cluster.z = (uint)clamp(log(clusterPosition.w) * sliceScale + sliceBias, 0, clusterGrid.z - 1);//w is the view depth
+	uint2 clusterLights = clusters[(cluster.z * (uint)clusterGrid.y + cluster.y) * (uint)clusterGrid.x + cluster.x];
+
+	//how big this fragment is in the world, for variance shadowmap mips
+	float fragmentSize = max(length(ddx(input.worldPosition)), length(ddy(input.worldPosition)));
+
 	float4 lightColour = ambient;
 	float4 specular = float4(0, 0, 0, 0);
-	for (int light = 0; light < NUM_LIGHTS; ++light) {
-		if (lightPosition[light].w == INACTIVE_LIGHT) {//w component of light's position corresponds to light type
-			//inactive light, so nothing to add here
+	[loop] for (uint i = 0; i < clusterLights.y; ++i) {//only the lights that can reach this cluster
+		Light light = lights[lightIndices[clusterLights.x + i]];
+
+		//get distance from light and light vector (point lights, spotlights and shadowmapping)
+		float3 lightVector = light.position - input.worldPosition;
+		float dist = length(lightVector);//distance to point light for attenuation
+
+		//check relevant shadowmap to see if we should light this fragment from this light
+		float shadow = 1;//shadow multiplier is set to 1 in case shadowmap read is impossible or out of range
+		[branch] switch (light.shadowSlot) {
+			SHADOW_SLOT(0)
+			SHADOW_SLOT(1)
+			SHADOW_SLOT(2)
+			SHADOW_SLOT(3)
+			SHADOW_SLOT(4)
+			SHADOW_SLOT(5)
+			SHADOW_SLOT(6)
+			SHADOW_SLOT(7)
 		}
-		else {//compute lighting for this light:
-
-			//get distance from light and light vector (point lights, spotlights and shadowmapping)
-			float3 lightVector = lightPosition[light] - input.worldPosition;
-			float dist = length(lightVector);//distance to point light for attenuation
-
-
-			//check relevant shadowmap to see if we should light this fragment from this light
-			float shadow = 1;//shadow multiplier is set to 1 in case shadowmap read is impossible or out of range
-
-			if (attenuation[light].w == 1) {//read shadowmap
-				//Compute projected uvs
-				float2 pTexCoord = input.lightViewPos[light].xy / input.lightViewPos[light].w;
-				pTexCoord *= float2(0.5f, -0.5f);
-				pTexCoord += float2(0.5f, 0.5f);
-
-				//if uvs are in 0..1 range, keep going
-				if (pTexCoord.x >= 0 && pTexCoord.x <= 1 && pTexCoord.y >= 0 && pTexCoord.y <= 1) {
-					
-					//Compare to distance to light
-					float lightDepthValue = 1 - dist * oneOverFarPlane;
-					//add bias
-					lightDepthValue += shadowmapBias;
-
-					//Very simple soft shadow computation (16 samples instead of 1 to minimize jagged edges)
-					shadow = 0;
-					for (float y = -1.5f; y <= 1.5f; y += 1.0f) {
-						for (float x = -1.5f; x <= 1.5f; x += 1.0f) {
-							//Sample shadowmap (16 samples per light)
-							float depthValue = shadowMap[light].Sample(sampler0, pTexCoord + float2(x, y) * oneOverShadowmapSize).r;
-							if (lightDepthValue > depthValue) {
-								//add a bit of light (if all 16 samples result in passes on this condition, pixel will be totally lit)
-								shadow += 0.0625f;// 1/16
-							}
-						}
-					}
-
-				}
-				else if(showShadowmapErrors == 1) {//uvs outside 0..1
-					return float2(1, 0).rggr;// <-- see red where shadowmap is out of range
-				}
-				else {//uvs outside 0..1 but no error showing, just show shadow.
-					shadow = 1;
-				}
-			}
-
-			if (/*shouldLight*/shadow > 0) {
-				if (lightPosition[light].w == POINT_LIGHT) {
-					//point light
-					lightVector /= dist;//normalize
-					float attFactor = 1.0f / (attenuation[light].x + attenuation[light].y * dist + attenuation[light].z * dist * dist);
-					//diffuse lighting
-					lightColour += shadow * calculateLighting(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse[light].rgb * attFactor);
-					//specular component
-					specular += shadow * blinnPhong(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse[light] * attFactor;
-				}
-				else if (lightPosition[light].w == DIRECTIONAL_LIGHT) {
-					//directional light
-					float3 dir = -normalize(lightDirection[light].xyz);
-					//diffuse lighting
-					lightColour += shadow * calculateLighting(dir, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse[light].rgb);
-					//specular component
-					specular += shadow * blinnPhong(dir, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse[light];
-				}
-				else if (lightPosition[light].w == SPOTLIGHT) {
-					//spotlight
-					lightVector /= dist;//normalize
-					float attFactor = 1.0f / (attenuation[light].x + attenuation[light].y * dist + attenuation[light].z * dist * dist);
-					//compute cosine of the angle between [towards the light] and [spot light direction], base intensity off that
-					float3 dir = -normalize(lightDirection[light].xyz);
-					float dirDotlv = saturate(dot(dir, lightVector));
-					//diffuse lighting
-					lightColour += shadow * calculateLighting(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse[light].rgb * attFactor * dirDotlv);
-					//specular
-					specular += shadow * blinnPhong(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse[light] * dirDotlv * attFactor;
-				}
-			}//shouldLight == false (in shadow)
+		if (shadow < 0) {//uvs outside 0..1 or too far
+			return float2(1, 0).rggr;// <-- see red where shadowmap is out of range
 		}
-	}//foreach light
+
+		if (/*shouldLight*/shadow > 0) {
+			float4 diffuse = float4(light.colour, 1);
+			if (light.type == POINT_LIGHT) {
+				//point light
+				lightVector /= dist;//normalize
+				float attFactor = 1.0f / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * dist * dist);
+				//diffuse lighting
+				lightColour += shadow * calculateLighting(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse.rgb * attFactor);
+				//specular component
+				specular += shadow * blinnPhong(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse * attFactor;
+			}
+			else if (light.type == DIRECTIONAL_LIGHT) {
+				//directional light
+				float3 dir = -light.direction;
+				//diffuse lighting
+				lightColour += shadow * calculateLighting(dir, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse.rgb);
+				//specular component
+				specular += shadow * blinnPhong(dir, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse;
+			}
+			else if (light.type == SPOTLIGHT) {
+				//spotlight
+				lightVector /= dist;//normalize
+				float attFactor = 1.0f / (light.attenuation.x + light.attenuation.y * dist + light.attenuation.z * dist * dist);
+				//compute cosine of the angle between [towards the light] and [spot light direction], base intensity off that
+				float3 dir = -light.direction;
+				float dirDotlv = saturate(dot(dir, lightVector));
+				//diffuse lighting
+				lightColour += shadow * calculateLighting(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, diffuse.rgb * attFactor * dirDotlv);
+				//specular
+				specular += shadow * blinnPhong(lightVector, input.normal, input.binormal, input.tangent, tangentSpaceNormal, input.viewVector, specularColour, specularPower).rgbr * diffuse * dirDotlv * attFactor;
+			}
+		}//shouldLight == false (in shadow)
+	}//foreach light in cluster
 
 	if (mode == COLOUR || mode == NORMAL_MAP) {
 		return lightColour * float4(colour, 1) + specular;
@@ -24,6 +24,7 @@ struct VS_IN{
 	float2 tex : TEXCOORD0;
 	float3 normal : NORMAL;
 	float3 tangent : TANGENT;
+	row_major float4x4 instance : INSTANCE;//where this copy of the mesh is, before the world matrix
 };
 
 struct VS_OUT{
@@ -41,7 +42,7 @@ VS_OUT main(VS_IN input){
 	VS_OUT output;
 
 	// Calculate the position of the vertex against the world, view, and projection matrices.
-	float4 pos = float4(input.position.xyz, 1.0f);
+	float4 pos = mul(float4(input.position.xyz, 1.0f), input.instance);
 	float4 worldPosition = mul(pos, worldMatrix);
 	output.worldPosition = worldPosition.xyz;
 	output.position = mul(worldPosition, viewMatrix);
@@ -51,9 +52,9 @@ VS_OUT main(VS_IN input){
 	output.tex = input.tex;
 
 	// Calculate the normal and tangent vectors against the world matrix only and normalise.
-	output.normal = mul(input.normal, (float3x3)worldMatrix);
+	output.normal = mul(mul(input.normal, (float3x3)input.instance), (float3x3)worldMatrix);
 	output.normal = normalize(output.normal);
-	output.tangent = mul(input.tangent, (float3x3)worldMatrix);
+	output.tangent = mul(mul(input.tangent, (float3x3)input.instance), (float3x3)worldMatrix);
 	output.tangent = normalize(output.tangent);
 
 	// Build binormal from normal and tangent
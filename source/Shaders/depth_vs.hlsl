@@ -13,6 +13,7 @@ cbuffer CameraBuffer : register(b1) {
 
 struct VS_IN {
 	float3 position : POSITION;
+	row_major float4x4 instance : INSTANCE;//where this copy of the mesh is, before the world matrix
 };
 
 struct VS_OUT {
@@ -25,7 +26,7 @@ VS_OUT main(VS_IN input) {
 	VS_OUT output;
 
 	// Calculate the position of the vertex against the world, view, and projection matrices.
-	float4 pos = float4(input.position.xyz, 1.0f);
+	float4 pos = mul(float4(input.position.xyz, 1.0f), input.instance);
 	float4 worldPosition = mul(pos, worldMatrix);
 	output.worldPosition = worldPosition;
 	output.position = mul(worldPosition, viewMatrix);
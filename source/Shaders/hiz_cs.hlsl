@@ -0,0 +1,26 @@
+//hi-z pyramid: one level from the one before it (or from the depth buffer), each texel the farthest of the 2x2 it covers. See HiZPyramid::downsample()
+
+Texture2D<float> source : register(t0);
+RWTexture2D<float> destination : register(u0);
+
+[numthreads(8, 8, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+	uint width, height, sourceWidth, sourceHeight;
+	destination.GetDimensions(width, height);
+	source.GetDimensions(sourceWidth, sourceHeight);
+	if (id.x >= width || id.y >= height) return;
+
+	int3 position = int3(id.xy * 2, 0);
+	float farthest = max(max(source.Load(position), source.Load(position + int3(1, 0, 0))), max(source.Load(position + int3(0, 1, 0)), source.Load(position + int3(1, 1, 0))));
+
+	//the last row and column also take whatever an odd size leaves over; loads past the edge come back as 0, which never wins
+	bool extraX = id.x == width - 1 && (sourceWidth & 1);
+	bool extraY = id.y == height - 1 && (sourceHeight & 1);
+	if (extraX)
+		farthest = max(farthest, max(source.Load(position + int3(2, 0, 0)), source.Load(position + int3(2, 1, 0))));
+	if (extraY)
+		farthest = max(farthest, max(source.Load(position + int3(0, 2, 0)), source.Load(position + int3(1, 2, 0))));
+	if (extraX && extraY)
+		farthest = max(farthest, source.Load(position + int3(2, 2, 0)));
+	destination[id.xy] = farthest;
+}
@@ -0,0 +1,91 @@
+//hi-z culling: tests each static draw's bounds against the frustum, then against last frame's pyramid, and writes its indirect draw arguments.
+//See HiZPyramid::isVisible(), which does the same on the cpu
+
+cbuffer CullBuffer : register(b0) {
+	matrix viewProjection;//this frame's, for the frustum
+	matrix previousViewProjection;//the one the pyramid was built with
+	float2 depthSize;//the depth buffer the pyramid was built from, in pixels
+	uint drawCount;
+	uint levels;//0 if there's no pyramid, for frustum culling only
+};
+
+struct Draw {
+	float3 center;
+	uint indexCount;
+	float3 extents;
+	uint padding;
+};
+
+StructuredBuffer<Draw> draws : register(t0);
+Texture2D<float> pyramid : register(t1);
+RWBuffer<uint> args : register(u0);
+
+//false if every corner is past the same plane of the frustum
+bool inFrustum(float3 corners[8]) {
+	uint outside[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 8; ++i) {
+		float4 clip = mul(float4(corners[i], 1), viewProjection);
+		if (clip.x < -clip.w) ++outside[0];
+		if (clip.x > clip.w) ++outside[1];
+		if (clip.y < -clip.w) ++outside[2];
+		if (clip.y > clip.w) ++outside[3];
+		if (clip.z < 0) ++outside[4];
+		if (clip.z > clip.w) ++outside[5];
+	}
+	for (int j = 0; j < 6; ++j)
+		if (outside[j] == 8) return false;
+	return true;
+}
+
+//the texel covering depth buffer pixel x at level
+int texel(float x, uint level, uint size) {
+	return clamp((int)(x / (float)(2u << level)), 0, (int)size - 1);
+}
+
+bool isVisible(float3 corners[8]) {
+	if (!inFrustum(corners)) return false;
+	if (levels == 0) return true;
+
+	//screen rect and nearest depth as of last frame; anything that crossed the near plane or the screen's edges back then gets drawn
+	float4 rect = float4(1e30f, 1e30f, -1e30f, -1e30f);
+	float nearest = 1e30f;
+	for (int i = 0; i < 8; ++i) {
+		float4 clip = mul(float4(corners[i], 1), previousViewProjection);
+		if (clip.w <= 0 || clip.z < 0) return true;
+		float2 pixel = float2(clip.x / clip.w * 0.5f + 0.5f, 0.5f - clip.y / clip.w * 0.5f) * depthSize;
+		rect.xy = min(rect.xy, pixel);
+		rect.zw = max(rect.zw, pixel);
+		nearest = min(nearest, clip.z / clip.w);
+	}
+	if (any(rect.xy < 0) || any(rect.zw > depthSize)) return true;
+
+	//the first level whose texels are at least as big as the rect, so it spans 2x2 of them at most
+	float extent = max(rect.z - rect.x, rect.w - rect.y);
+	uint level = 0;
+	while (level < levels - 1 && (float)(2u << level) < extent)
+		++level;
+	uint width, height, mips;
+	pyramid.GetDimensions(level, width, height, mips);
+	int x0 = texel(rect.x, level, width), x1 = texel(rect.z, level, width);
+	int y0 = texel(rect.y, level, height), y1 = texel(rect.w, level, height);
+
+	float farthest = max(max(pyramid.Load(int3(x0, y0, level)), pyramid.Load(int3(x1, y0, level))), max(pyramid.Load(int3(x0, y1, level)), pyramid.Load(int3(x1, y1, level))));
+	return nearest <= farthest;
+}
+
+[numthreads(64, 1, 1)]
+void main(uint3 id : SV_DispatchThreadID) {
+	if (id.x >= drawCount) return;
+	Draw draw = draws[id.x];
+
+	float3 corners[8];
+	for (int i = 0; i < 8; ++i)
+		corners[i] = draw.center + draw.extents * float3(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+
+	uint base = id.x * 5;
+	args[base + 0] = draw.indexCount;
+	args[base + 1] = isVisible(corners) ? 1 : 0;//instance count
+	args[base + 2] = 0;
+	args[base + 3] = 0;
+	args[base + 4] = 0;
+}
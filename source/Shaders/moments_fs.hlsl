@@ -0,0 +1,16 @@
+//moments fragment shader: stores normalized distance to the light and its square, for variance shadow maps
+
+struct FS_IN {
+	float4 position : SV_POSITION;
+	float3 worldPosition : TEXCOORD1;
+	float4 cameraPosition : TEXCOORD2;
+};
+
+float4 main(FS_IN input) : SV_TARGET{
+	float depth = saturate(length(input.worldPosition - input.cameraPosition.xyz) * input.cameraPosition.w);//w of camera position is 1 / far plane (the light's reach here)
+
+	//bias the second moment using the depth's screen-space slope, so that surfaces don't shadow themselves once blurred
+	float dx = ddx(depth);
+	float dy = ddy(depth);
+	return float4(depth, depth * depth + 0.25f * (dx * dx + dy * dy), 0, 1);
+}
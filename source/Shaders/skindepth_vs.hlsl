@@ -19,9 +19,7 @@ cbuffer BoneBuffer : register(b2) {
 }
 
 struct VS_IN {
-	float3 position : POSITION;
-	float2 tex : TEXCOORD0;
-	float3 normal : NORMAL;
+	float3 position : POSITION;//position stream
 	uint4 boneIds : BLENDINDICES0;//8 bones acting on each vertex
 	uint4 boneIds2 : BLENDINDICES1;
 	float4 boneWeights : BLENDWEIGHT0;//the bone weights for each bone
@@ -5,6 +5,7 @@ struct VS_IN {
 	float2 tex : TEXCOORD0;
 	float3 normal : NORMAL;
 	float3 tangent : TANGENT;
+	row_major float4x4 instance : INSTANCE;
 };
 
 struct VS_OUT {
@@ -17,11 +18,11 @@ struct VS_OUT {
 VS_OUT main(VS_IN input) {
 	VS_OUT output;
 
-	//pass to hull
-	output.position = input.position;
+	//pass to hull, with this copy of the mesh moved where it goes; the world matrix is applied in the domain shader
+	output.position = mul(float4(input.position, 1.0f), input.instance).xyz;
 	output.tex = input.tex;
-	output.normal = input.normal;
-	output.tangent = input.tangent;
+	output.normal = mul(input.normal, (float3x3)input.instance);
+	output.tangent = mul(input.tangent, (float3x3)input.instance);
 
 	return output;
 }
\ No newline at end of file
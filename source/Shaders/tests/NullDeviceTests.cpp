@@ -0,0 +1,99 @@
+/// Headless checks of the null backend and of what's built on RenderDevice alone: that every kind of handle it hands out is its own,
+/// that static buffers copy and read back, that constant blocks only upload what changed, per device, and that recorders' draws end up counted on their device.
+/// Exits with the number of checks that failed.
+
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include "NullRenderDevice.h"
+#include "ConstantBlock.h"
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+	if (!ok) {
+		printf("Error: %s.\n", what);
+		++failures;
+	}
+}
+
+static void checkHandles() {
+	NullRenderDevice device;
+	std::set<const void*> handles;
+	const unsigned char pixel[4] = { 255, 255, 255, 255 };
+	const VertexElement element = { "POSITION", 0, FORMAT_R32G32B32_FLOAT, 0, 0, false };
+	for (int i = 0; i < 4; ++i) {
+		handles.insert(device.createBuffer(64, BUFFER_VERTEX));
+		handles.insert(device.createTexture(1, 1, pixel, false));
+		handles.insert(device.createShader(STAGE_PS, nullptr, 0));
+		handles.insert(device.createLayout(&element, 1, nullptr, 0));
+		handles.insert(device.createSampler(FILTER_LINEAR, ADDRESS_CLAMP));
+	}
+	check(handles.count(nullptr) == 0, "the null device handed out a null handle");
+	check(handles.size() == 20, "the null device handed out the same handle twice");
+}
+
+static void checkBuffers() {
+	NullRenderDevice device;
+	const unsigned int source[4] = { 1, 2, 3, 4 };
+	GpuBuffer* a = device.createStaticBuffer(sizeof(source), BUFFER_INDEX, source);
+	GpuBuffer* b = device.createStaticBuffer(2 * sizeof(source), BUFFER_INDEX, nullptr);
+	device.copyBuffer(b, sizeof(source), a, 0, sizeof(source));
+	std::vector<unsigned char> bytes;
+	check(device.readBuffer(b, bytes), "could not read a static buffer back");
+	check(bytes.size() == 2 * sizeof(source), "a static buffer read back at the wrong size");
+	if (bytes.size() == 2 * sizeof(source)) {
+		check(memcmp(&bytes[sizeof(source)], source, sizeof(source)) == 0, "copyBuffer() didn't copy to the right place");
+		unsigned int zeroes[4] = {};
+		check(memcmp(&bytes[0], zeroes, sizeof(zeroes)) == 0, "a static buffer created without data isn't zeroes");
+	}
+	check(device.getCount(COMMAND_COPY_BUFFER) == 1, "copyBuffer() wasn't counted");
+	device.releaseBuffer(a);
+	device.releaseBuffer(b);
+}
+
+static void checkConstants() {
+	struct Constants {
+		float colour[4];
+	};
+	NullRenderDevice device;
+	RenderDevice* recorder = device.createRecorder();
+	ConstantBlockStats::reset();
+	{
+		ConstantBlock<Constants> block;
+		block.init(&device);
+		Constants data = { { 1, 0, 0, 1 } };
+		check(block.update(&device, data), "the first upload of a constant block was skipped");
+		check(!block.update(&device, data), "the same constants were uploaded twice");
+		check(recorder && block.update(recorder, data), "a recorder skipped an upload only its device had made");
+		data.colour[1] = 1;
+		check(block.update(&device, data), "changed constants weren't uploaded");
+		check(ConstantBlockStats::uploads == 3 && ConstantBlockStats::skips == 1, "constant block stats don't add up");
+	}
+	delete recorder;
+}
+
+static void checkRecorders() {
+	NullRenderDevice device;
+	RenderDevice* recorder = device.createRecorder();
+	check(recorder && recorder->isRecorder() && recorder->getSlot() > 0, "a recorder doesn't know it is one");
+	if (!recorder) return;
+	for (int i = 0; i < 3; ++i)
+		recorder->drawIndexed(36);
+	device.drawIndexed(6);
+	device.execute(recorder->finishRecording());
+	check(device.getCount(COMMAND_DRAW_INDEXED) == 4, "a recorder's draws weren't counted on its device");
+	check(device.getVerticesDrawn() == 3 * 36 + 6, "a recorder's indices weren't counted on its device");
+	check(device.getCount(COMMAND_EXECUTE) == 1, "executing a command list wasn't counted");
+	delete recorder;
+}
+
+int main() {
+	checkHandles();
+	checkBuffers();
+	checkConstants();
+	checkRecorders();
+	if (failures == 0)
+		printf("Null device: every check passed.\n");
+	return failures;
+}
@@ -0,0 +1,189 @@
+/// Headless check that neither RingAllocator nor TransientBuffer (on a null device whose gpu lags a few frames behind) ever hands out a range
+/// from a page the gpu could still be reading, through page wraparound, late retires and running out of pages.
+/// Takes the number of frames to run, 5000 by default; exits with 1 if any range was handed out or bound wrong.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include "NullRenderDevice.h"
+#include "TransientBuffer.h"
+
+///Null device whose gpu finishes frames latency frames after they're submitted (or straight away, when waited on), and that counts every constant range
+///bound over one the gpu could still be reading
+class LaggingDevice : public NullRenderDevice {
+
+protected:
+	struct Range {
+		unsigned long long frame;
+		unsigned int offset, size;
+	};
+
+public:
+	LaggingDevice(unsigned long long latency) : NullRenderDevice(false), latency(latency) {}
+
+	GpuQuery* createFence() override { return (GpuQuery*)(uintptr_t)++fenceCount; }
+	void signalFence(GpuQuery* fence) override { signalled[fence] = ++submitted; }
+	bool fenceReached(GpuQuery* fence, bool wait) override {
+		unsigned long long frame = signalled[fence];
+		if (wait && frame > completed) {
+			completed = frame;
+			++waits;
+		}
+		return frame <= completed;
+	}
+	void setConstantBuffer(int stage, unsigned int slot, GpuBuffer* buffer, unsigned int offset = 0, unsigned int size = 0) override {
+		if (buffer != unchecked) {
+			std::vector<Range>& ranges = inFlight[buffer];
+			for (size_t i = 0; i < ranges.size(); ++i) {
+				if (ranges[i].frame <= completed) {
+					ranges.erase(ranges.begin() + i);
+					--i;
+				}
+				else if (offset < ranges[i].offset + ranges[i].size && ranges[i].offset < offset + size)
+					++overwrites;
+			}
+			ranges.push_back({ submitted + 1, offset, size });
+		}
+		NullRenderDevice::setConstantBuffer(stage, slot, buffer, offset, size);
+	}
+
+	///the gpu catches up to latency frames behind; call at the start of each frame
+	void advance() { if (submitted > latency + completed) completed = submitted - latency; }
+
+	GpuBuffer* unchecked = nullptr;//the fallback buffer, which gets discarded every time
+	unsigned int waits = 0, overwrites = 0;
+
+protected:
+	unsigned long long latency;
+	unsigned long long submitted = 0, completed = 0;
+	unsigned int fenceCount = 0;
+	std::map<GpuQuery*, unsigned long long> signalled;
+	std::map<GpuBuffer*, std::vector<Range>> inFlight;//ranges bound in frames the gpu isn't done with
+
+};
+
+///the allocator on its own, then through TransientBuffer on a LaggingDevice; returns how many ranges went wrong
+static unsigned int validate(int frames) {
+	unsigned int errors = 0;
+	//the allocator on its own, retiring frames anywhere from straight away to 3 frames late, with draws big enough to wrap around its 4 pages every frame or so
+	{
+		const unsigned int pageSize = 4096, maxPages = 4, alignment = 256;
+		RingAllocator allocator(pageSize, maxPages);
+		std::deque<unsigned long long> pending;
+		unsigned long long retired = 0;
+		std::vector<unsigned long long> lastFrame(maxPages, 0);//mirrors which frame last used each page, and how far into it
+		std::vector<unsigned int> heads(maxPages, 0);
+		int last = -1;//page of the last range
+		unsigned int allocations = 0, stalls = 0, full = 0, wrong = 0;//only the first wrong range gets described
+		for (int i = 0; i < frames; ++i) {
+			unsigned long long frame = allocator.getCurrentFrame();
+			int draws = rand() % 12;
+			for (int d = 0; d < draws; ++d) {
+				unsigned int size = alignment * (1 + rand() % (pageSize / alignment));
+				unsigned int page, offset;
+				bool fresh;
+				bool allocated = allocator.allocate(size, alignment, page, offset, fresh);
+				if (!allocated) {
+					if (allocator.getPageCount() < maxPages && wrong++ == 0)
+						printf("Error: allocation failed with room for %u more pages.\n", maxPages - allocator.getPageCount());
+					//what TransientBuffer does: wait for the oldest frame in flight, then try again
+					if (!pending.empty()) {
+						++stalls;
+						retired = pending.front();
+						pending.pop_front();
+						allocator.retire(retired);
+						allocated = allocator.allocate(size, alignment, page, offset, fresh);
+					}
+					if (!allocated) {
+						++full;//every page is this frame's already
+						continue;
+					}
+				}
+				++allocations;
+				if (page >= maxPages || offset % alignment != 0 || offset + size > pageSize) {
+					if (wrong++ == 0)
+						printf("Error: range %u+%u in page %u is out of bounds.\n", offset, size, page);
+					continue;
+				}
+				//carrying on in the same page is fine past anything handed out before (in flight or not); starting a page again isn't, until it's retired
+				if (!fresh) {
+					if (((int)page != last || offset < heads[page]) && wrong++ == 0)
+						printf("Error: range %u+%u in page %u overlaps one handed out earlier.\n", offset, size, page);
+				}
+				else if (lastFrame[page] > retired && wrong++ == 0)
+					printf("Error: page %u started again in frame %llu, while frame %llu (retired up to %llu) could still be reading it.\n", page, frame, lastFrame[page], retired);
+				lastFrame[page] = frame;
+				heads[page] = offset + size;
+				last = page;
+			}
+
+			pending.push_back(allocator.endFrame());
+			size_t lag = rand() % 4;
+			while (pending.size() > lag) {
+				retired = pending.front();
+				pending.pop_front();
+				allocator.retire(retired);
+			}
+		}
+		printf("Ring allocator: %u allocations over %d frames, %u stalls on the oldest frame, %u allocations with every page taken by their own frame.\n", allocations, frames, stalls, full);
+		if (wrong > 0) {
+			printf("Error: %u ranges were handed out wrong.\n", wrong);
+			errors += wrong;
+		}
+		else
+			printf("No range came from a page the gpu could still be reading, and %u pages (at most %u) were enough.\n", allocator.getPageCount(), maxPages);
+	}
+
+	//then through TransientBuffer, 2 frames behind on the gpu, with fewer pages than that needs so that it has to wait, and the odd draw too big for a page
+	{
+		const unsigned int pageSize = 4096, maxPages = 3;
+		LaggingDevice device(2);
+		GpuBuffer* fallback = device.createBuffer(2 * pageSize, BUFFER_CONSTANT);
+		device.unchecked = fallback;
+		unsigned int maps = 0, fallbacks = 0, failed = 0, wrong = 0, pages = 0;
+		{
+			TransientBuffer constants(&device, BUFFER_CONSTANT, pageSize, maxPages);
+			for (int i = 0; i < frames; ++i) {
+				device.advance();
+				int draws = rand() % 16;
+				for (int d = 0; d < draws; ++d) {
+					unsigned int size = rand() % 50 == 0 ? 2 * pageSize : 16 * (1 + rand() % 32);
+					void* data = constants.map(&device, size, fallback);
+					if (!data) {
+						++failed;
+						continue;
+					}
+					memset(data, i & 0xff, size);
+					constants.unmapConstants(&device, STAGE_VS, 0);
+					++maps;
+				}
+				fallbacks += constants.getFallbacks();
+				constants.endFrame(&device);
+				if (constants.getAllocator().getPageCount() > maxPages) {
+					printf("Error: %u pages, past the limit of %u.\n", constants.getAllocator().getPageCount(), maxPages);
+					++wrong;
+				}
+			}
+			pages = constants.getAllocator().getPageCount();
+		}
+		device.releaseBuffer(fallback);
+		printf("Transient buffer: %u maps over %d frames, %u through the fallback, %u waits on the gpu.\n", maps, frames, fallbacks, device.waits);
+		if (failed > 0)
+			printf("Error: %u maps failed.\n", failed);
+		if (device.overwrites > 0 || wrong > 0)
+			printf("Error: %u ranges were bound over ones the gpu could still be reading.\n", device.overwrites);
+		else if (failed == 0)
+			printf("No range was bound over one the gpu could still be reading, and %u pages (at most %u) were enough.\n", pages, maxPages);
+		errors += failed + device.overwrites + wrong;
+	}
+	return errors;
+}
+
+int main(int argc, char** argv) {
+	int frames = argc > 1 ? atoi(argv[1]) : 5000;
+	srand(1);//the same frames every run, so that a failure can be run again
+	return validate(frames) > 0 ? 1 : 0;
+}
@@ -0,0 +1,47 @@
+/// Headless check of WorkerPool: every run() reaches every worker exactly once, with its own index, and nothing runs after run() returns;
+/// through worker counts going up and down in between, since threads spawned again have to start from the current batch rather than redo the last one.
+/// Exits with the number of checks that failed.
+
+#include <cstdio>
+#include <atomic>
+#include <vector>
+#include "WorkerPool.h"
+
+int main() {
+	WorkerPool pool;
+	std::atomic<int> calls[8];
+	std::atomic<int> late(0);
+	std::atomic<bool> running(false);
+	int failures = 0;
+	const int counts[] = { 1, 4, 2, 8, 3, 1, 6 };
+	for (int count : counts) {
+		pool.setWorkers(count);
+		if (pool.getWorkers() != count) {
+			printf("Error: asked for %d workers, got %d.\n", count, pool.getWorkers());
+			++failures;
+		}
+		for (int run = 0; run < 200; ++run) {
+			for (std::atomic<int>& call : calls) call = 0;
+			running = true;
+			pool.run([&](int index) {
+				if (!running) ++late;
+				if (index >= 0 && index < 8) ++calls[index];
+			});
+			running = false;
+			for (int i = 0; i < 8; ++i) {
+				int expected = i < count ? 1 : 0;
+				if (calls[i] != expected) {
+					if (failures++ == 0)
+						printf("Error: with %d workers, worker %d was called %d times in one run.\n", count, i, (int)calls[i]);
+				}
+			}
+		}
+	}
+	if (late > 0) {
+		printf("Error: %d workers were still running after run() returned.\n", (int)late);
+		++failures;
+	}
+	if (failures == 0)
+		printf("Worker pool: every run reached every worker once, whatever the worker count before it.\n");
+	return failures;
+}